@@ -1,37 +1,376 @@
 //Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
-/*Contains the implementation of the buildActFunBundle function and the predefined activation
- *functions.*/
+/*Contains the implementation of the buildActFunBundle function, the span functions and the
+ *predefined activation functions.*/
 
 #include "activationFunctions.h"
 #include "neuralNetworkErrors.h"
+#include "vectorKernels.h"
+#include<algorithm>
 #include<math.h>
+#include<vector>
 
 namespace NeuralNetwork
 {
+	namespace
+	{
+		/*Constants of the tanh approximation of GELU. Since 0.5 * (1 + tanh(z)) = sigmoid(2z), the
+		  function is found as x * sigmoid(GELU_SCALE * (x + GELU_CUBIC * x^3)).*/
+		const float GELU_CUBIC = 0.044715f;
+		const float GELU_SCALE = 1.5957691216f;
+
+		/*Returns ln(1 + t) for t between zero and one. With s = t / (2 + t), ln(1 + t) is
+		  2 * atanh(s), and since s is at most a third the first seven terms of the series of atanh
+		  are enough for full float precision. Unlike log1p(), the loops calling it vectorize.*/
+		inline float logOnePlus(float t)
+		{
+			float s = t / (2.0f + t);
+			float u = s * s;
+			float series = 1.0f / 13.0f;
+			series = series * u + 1.0f / 11.0f;
+			series = series * u + 1.0f / 9.0f;
+			series = series * u + 1.0f / 7.0f;
+			series = series * u + 1.0f / 5.0f;
+			series = series * u + 1.0f / 3.0f;
+			series = series * u + 1.0f;
+			return 2.0f * s * series;
+		}
+
+		/*Returns a row of at least the given length for the span functions that need their input
+		  after writing an intermediate result. Each thread has its own row.*/
+		float* getScratch(int length)
+		{
+			static thread_local std::vector<float> scratch;
+			if ((int)scratch.size() < length)
+			{
+				scratch.resize(length);
+			}
+			return scratch.data();
+		}
+
+		//Used by the softmax bundle, since each neuron passes its raw value through.
+		float identity(const float input)
+		{
+			return input;
+		}
+
+		float identityGrad(const float)
+		{
+			return 1.0f;
+		}
+	}
+
+	void activateSpan(const activationFunctionInfo &info, float *values, int length)
+	{
+		const vectorKernels &kernels = getKernels();
+		void(*sigmoidKernel)(float*, int) = info.fastApproximation ? kernels.fastSigmoid : kernels.sigmoid;
+		float *scratch;
+		switch (info.type)
+		{
+		case sigmoidFunction:
+			sigmoidKernel(values, length);
+			break;
+		case tanhFunction:
+			//Uses tanh(x) = 2 * sigmoid(2x) - 1 so the vector sigmoid kernel does the work.
+			for (int i = 0; i < length; ++i)
+			{
+				values[i] *= 2.0f;
+			}
+			sigmoidKernel(values, length);
+			for (int i = 0; i < length; ++i)
+			{
+				values[i] = 2.0f * values[i] - 1.0f;
+			}
+			break;
+		case reLUFunction:
+			for (int i = 0; i < length; ++i)
+			{
+				values[i] = std::max(values[i], 0.0f);
+			}
+			break;
+		case leakyReLUFunction:
+			for (int i = 0; i < length; ++i)
+			{
+				values[i] = values[i] > 0.0f ? values[i] : values[i] * LEAKY_RELU_SLOPE;
+			}
+			break;
+		case gELUFunction:
+			scratch = getScratch(length);
+			for (int i = 0; i < length; ++i)
+			{
+				scratch[i] = GELU_SCALE * (values[i] + GELU_CUBIC * values[i] * values[i] * values[i]);
+			}
+			sigmoidKernel(scratch, length);
+			for (int i = 0; i < length; ++i)
+			{
+				values[i] *= scratch[i];
+			}
+			break;
+		case softplusFunction:
+			//Uses softplus(x) = max(x, 0) + ln(1 + e^-|x|) so the exponential can't overflow.
+			scratch = getScratch(length);
+			for (int i = 0; i < length; ++i)
+			{
+				scratch[i] = -fabsf(values[i]);
+			}
+			kernels.exponential(scratch, length);
+			for (int i = 0; i < length; ++i)
+			{
+				values[i] = std::max(values[i], 0.0f) + logOnePlus(scratch[i]);
+			}
+			break;
+		case softmaxFunction:
+			//The network applies softmax across the output nodes once every neuron has its value.
+			break;
+		default:
+			for (int i = 0; i < length; ++i)
+			{
+				values[i] = info.activationFunction(values[i]);
+			}
+		}
+	}
+
+	void activationDeltaSpan(const activationFunctionInfo &info, float *delta, const float *error, const float *input, int length)
+	{
+		const vectorKernels &kernels = getKernels();
+		void(*sigmoidKernel)(float*, int) = info.fastApproximation ? kernels.fastSigmoid : kernels.sigmoid;
+		float *scratch;
+		switch (info.type)
+		{
+		case sigmoidFunction:
+			kernels.sigmoidDelta(delta, error, input, length);
+			break;
+		case tanhFunction:
+			for (int i = 0; i < length; ++i)
+			{
+				delta[i] = error[i] * (1.0f - input[i] * input[i]);
+			}
+			break;
+		case reLUFunction:
+			for (int i = 0; i < length; ++i)
+			{
+				delta[i] = input[i] > 0.0f ? error[i] : 0.0f;
+			}
+			break;
+		case leakyReLUFunction:
+			for (int i = 0; i < length; ++i)
+			{
+				delta[i] = input[i] > 0.0f ? error[i] : error[i] * LEAKY_RELU_SLOPE;
+			}
+			break;
+		case gELUFunction:
+			//The input is the raw value, which the sigmoid is found from again.
+			scratch = getScratch(length);
+			for (int i = 0; i < length; ++i)
+			{
+				scratch[i] = GELU_SCALE * (input[i] + GELU_CUBIC * input[i] * input[i] * input[i]);
+			}
+			sigmoidKernel(scratch, length);
+			for (int i = 0; i < length; ++i)
+			{
+				float slope = GELU_SCALE * (1.0f + 3.0f * GELU_CUBIC * input[i] * input[i]);
+				delta[i] = error[i] * (scratch[i] + input[i] * scratch[i] * (1.0f - scratch[i]) * slope);
+			}
+			break;
+		case softplusFunction:
+			//The gradient is sigmoid(x), which is 1 - e^-y in terms of the output y.
+			scratch = getScratch(length);
+			for (int i = 0; i < length; ++i)
+			{
+				scratch[i] = -input[i];
+			}
+			kernels.exponential(scratch, length);
+			for (int i = 0; i < length; ++i)
+			{
+				delta[i] = error[i] * (1.0f - scratch[i]);
+			}
+			break;
+		case softmaxFunction:
+			//The network turns the errors of softmax output nodes into their deltas beforehand.
+			std::copy(error, error + length, delta);
+			break;
+		default:
+			for (int i = 0; i < length; ++i)
+			{
+				delta[i] = error[i] * info.activationFunctionGradient(input[i]);
+			}
+		}
+	}
+
 	activationFunctionInfo buildActFuncBundle(const std::string activationFunctionName)
 	{
-		activationFunctionInfo output;
 		if (activationFunctionName == "sigmoid")
 		{
-			output.activationFunction = sigmoid;
-			output.activationFunctionGradient = sigmoidGrad;
-			output.gradientInTermsOfFunc = true;
+			return buildActFuncBundle(sigmoidFunction);
+		}
+		else if (activationFunctionName == "tanh")
+		{
+			return buildActFuncBundle(tanhFunction);
+		}
+		else if (activationFunctionName == "relu")
+		{
+			return buildActFuncBundle(reLUFunction);
+		}
+		else if (activationFunctionName == "leakyRelu")
+		{
+			return buildActFuncBundle(leakyReLUFunction);
+		}
+		else if (activationFunctionName == "gelu")
+		{
+			return buildActFuncBundle(gELUFunction);
 		}
-		else
+		else if (activationFunctionName == "softplus")
 		{
+			return buildActFuncBundle(softplusFunction);
+		}
+		else if (activationFunctionName == "softmax")
+		{
+			return buildActFuncBundle(softmaxFunction);
+		}
+		throw activation_function_not_found();
+	}
+
+	activationFunctionInfo buildActFuncBundle(activationFunctionType type)
+	{
+		activationFunctionInfo output;
+		output.gradientInTermsOfFunc = true;
+		output.type = type;
+		switch (type)
+		{
+		case sigmoidFunction:
+			output.activationFunction = sigmoid;
+			output.activationFunctionGradient = sigmoidGrad;
+			break;
+		case tanhFunction:
+			output.activationFunction = hyperbolicTangent;
+			output.activationFunctionGradient = hyperbolicTangentGrad;
+			break;
+		case reLUFunction:
+			output.activationFunction = reLU;
+			output.activationFunctionGradient = reLUGrad;
+			break;
+		case leakyReLUFunction:
+			output.activationFunction = leakyReLU;
+			output.activationFunctionGradient = leakyReLUGrad;
+			break;
+		case gELUFunction:
+			//The gradient of GELU can't be written in terms of its output.
+			output.activationFunction = gELU;
+			output.activationFunctionGradient = gELUGrad;
+			output.gradientInTermsOfFunc = false;
+			break;
+		case softplusFunction:
+			output.activationFunction = softplus;
+			output.activationFunctionGradient = softplusGrad;
+			break;
+		case softmaxFunction:
+			output.activationFunction = identity;
+			output.activationFunctionGradient = identityGrad;
+			break;
+		default:
 			throw activation_function_not_found();
 		}
 		return output;
 	}
 
+	void softmaxDeltaSpan(float *delta, const float *error, const float *values, int length)
+	{
+		//The Jacobian is diag(y) - y * y^T, so each delta is y * (error - the sum of error * y).
+		float weightedError = getKernels().dotProduct(error, values, length);
+		for (int i = 0; i < length; ++i)
+		{
+			delta[i] = values[i] * (error[i] - weightedError);
+		}
+	}
+
+	void softmaxSpan(float *values, int length)
+	{
+		if (length < 1)
+		{
+			return;
+		}
+		float largest = *std::max_element(values, values + length);
+		for (int i = 0; i < length; ++i)
+		{
+			values[i] -= largest;
+		}
+		getKernels().exponential(values, length);
+		float sum = 0.0f;
+		for (int i = 0; i < length; ++i)
+		{
+			sum += values[i];
+		}
+		float scale = 1.0f / sum;
+		for (int i = 0; i < length; ++i)
+		{
+			values[i] *= scale;
+		}
+	}
+
+	float gELU(const float input)
+	{
+		return input * sigmoid(GELU_SCALE * (input + GELU_CUBIC * input * input * input));
+	}
+
+	float gELUGrad(const float input)
+	{
+		float sigmoidValue = sigmoid(GELU_SCALE * (input + GELU_CUBIC * input * input * input));
+		float slope = GELU_SCALE * (1.0f + 3.0f * GELU_CUBIC * input * input);
+		return sigmoidValue + input * sigmoidValue * (1.0f - sigmoidValue) * slope;
+	}
+
+	float hyperbolicTangent(const float input)
+	{
+		return tanhf(input);
+	}
+
+	float hyperbolicTangentGrad(const float input)
+	{
+		return 1 - input * input;
+	}
+
+	float leakyReLU(const float input)
+	{
+		return input > 0 ? input : input * LEAKY_RELU_SLOPE;
+	}
+
+	float leakyReLUGrad(const float input)
+	{
+		return input > 0 ? 1.0f : LEAKY_RELU_SLOPE;
+	}
+
+	float reLU(const float input)
+	{
+		return input > 0 ? input : 0.0f;
+	}
+
+	float reLUGrad(const float input)
+	{
+		return input > 0 ? 1.0f : 0.0f;
+	}
+
 	float sigmoid(const float input)
 	{
-		//TODO: add safety check for extremely high or low float values to prevent overflow.
-		return 1 / (1 + exp(-input));
+		//The exponential is only taken of negative values so it can't overflow.
+		if (input >= 0)
+		{
+			return 1 / (1 + expf(-input));
+		}
+		float exponential = expf(input);
+		return exponential / (1 + exponential);
 	}
 
 	float sigmoidGrad(const float input)
 	{
 		return input * (1 - input);
 	}
-}
\ No newline at end of file
+
+	float softplus(const float input)
+	{
+		return std::max(input, 0.0f) + log1pf(expf(-fabsf(input)));
+	}
+
+	float softplusGrad(const float input)
+	{
+		return 1 - expf(-input);
+	}
+}
@@ -1,16 +1,36 @@
 //Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
-/*Contains the prototypes for all the predefined activation functions along with the struct 
- *activationFunctionInfo that contains all the information needed on a certain activation function. 
+/*Contains the prototypes for all the predefined activation functions along with the struct
+ *activationFunctionInfo that contains all the information needed on a certain activation function.
  *This file also contains the prototype for the buildActFuncBundle which can create an instance
- *of the struct with all the filled-in information for any of the predefined activation functions.*/
+ *of the struct with all the filled-in information for any of the predefined activation functions.
+ *The predefined functions are also applied to whole rows of a batch at a time with the span
+ *functions, which switch on the type of the function once and run a loop using the vector kernels
+ *instead of calling through the function objects for every value.*/
 
 #ifndef NN_PROVIDED_ACT_FUNC
 #define NN_PROVIDED_ACT_FUNC
 
 #include<functional>
+#include<string>
 
 namespace NeuralNetwork
 {
+	/*Largest absolute error of the fast approximation of the sigmoid and tanh functions. The
+	 *approximation of sigmoid stays within half of this and tanh, which is found from sigmoid,
+	 *doubles it.*/
+	static const float FAST_ACTIVATION_MAX_ERROR = 5e-5f;
+	//Slope of the leaky ReLU function for negative inputs.
+	static const float LEAKY_RELU_SLOPE = 0.01f;
+
+	/*The predefined activation functions. Custom functions are only ever called through the
+	 *function objects of the bundle. Softmax is applied across the output nodes that use it, so
+	 *each neuron on its own only passes its raw value through.*/
+	enum activationFunctionType
+	{
+		customFunction = 0, sigmoidFunction = 1, tanhFunction = 2, reLUFunction = 3, leakyReLUFunction = 4,
+		gELUFunction = 5, softplusFunction = 6, softmaxFunction = 7
+	};
+
 	//The bundle that contains all the information needed on an activation function.
 	struct activationFunctionInfo
 	{
@@ -22,16 +42,51 @@ namespace NeuralNetwork
 		/*For example, the gradient function, f'(x), of the sigmoid function can be written as:
 		 *f'(x) = f(x)(1-f(x)) were f(x) is the sigmoid function.*/
 		bool gradientInTermsOfFunc;
+		//Which predefined function the bundle holds, which picks the span kernels used.
+		activationFunctionType type = customFunction;
+		/*Whether the span functions use the fast approximation of sigmoid for the sigmoid, tanh
+		 *and GELU functions instead of the exact exponential. The function objects are exact.*/
+		bool fastApproximation = false;
 	};
 
+	/*Applies the activation function to each value in place. Predefined functions use the vector
+	 *kernels while custom functions call the function object on each value.*/
+	void activateSpan(const activationFunctionInfo&, float*, int);
+	/*Sets each delta to the error multiplied by the gradient of the activation function. The
+	 *input is the output of the activation function when the gradient is in terms of the
+	 *function and the raw value otherwise.*/
+	void activationDeltaSpan(const activationFunctionInfo&, float*, const float*, const float*, int);
 	/*Given a string, attempts to find a predefined activation function that matches it and return an
 	 *instance of the activationFunctionInfo struct containing all the information on that activation
 	 *function. If one isn't found, the exception activation_function_not_found is thrown.*/
 	activationFunctionInfo buildActFuncBundle(const std::string);
+	//Same as above but for the type of a predefined function. Throws for customFunction.
+	activationFunctionInfo buildActFuncBundle(activationFunctionType);
+	/*Sets each delta to the error multiplied by the Jacobian of the softmax function, given the
+	 *output of the softmax function.*/
+	void softmaxDeltaSpan(float*, const float*, const float*, int);
+	/*Replaces the values with the softmax of them, which is found after subtracting the largest
+	 *value so the exponentials can't overflow.*/
+	void softmaxSpan(float*, int);
 
+	//GELU function and gradient function prototype, using the tanh approximation.
+	float gELU(const float);
+	float gELUGrad(const float);
+	//Tanh function and gradient function prototype.
+	float hyperbolicTangent(const float);
+	float hyperbolicTangentGrad(const float);
+	//Leaky ReLU function and gradient function prototype.
+	float leakyReLU(const float);
+	float leakyReLUGrad(const float);
+	//ReLU function and gradient function prototype.
+	float reLU(const float);
+	float reLUGrad(const float);
 	//Sigmoid function and gradient function prototype.
 	float sigmoid(const float);
 	float sigmoidGrad(const float);
+	//Softplus function and gradient function prototype.
+	float softplus(const float);
+	float softplusGrad(const float);
 }
 
 #endif
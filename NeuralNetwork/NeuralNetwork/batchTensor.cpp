@@ -0,0 +1,128 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "batchTensor.h"
+#include "helperFunctions.h"
+#include "preprocessorFlags.h"
+#include<algorithm>
+#include<stdexcept>
+#include<utility>
+
+namespace NeuralNetwork
+{
+	batchTensor::batchTensor() :batchSize(0), capacity(0), data(NULL), rowCount(0), rowStride(0)
+	{
+
+	}
+
+	batchTensor::batchTensor(int newRowCount, int newBatchSize) :batchSize(0), capacity(0), data(NULL), rowCount(0), rowStride(0)
+	{
+		resize(newRowCount, newBatchSize);
+	}
+
+	batchTensor::batchTensor(const batchTensor &ref) :batchSize(0), capacity(0), data(NULL), rowCount(0), rowStride(0)
+	{
+		resize(ref.rowCount, ref.batchSize);
+		std::copy(ref.data, ref.data + (std::size_t)rowCount * rowStride, data);
+	}
+
+	batchTensor::batchTensor(batchTensor &&ref) noexcept :batchSize(ref.batchSize), capacity(ref.capacity), data(ref.data), rowCount(ref.rowCount), rowStride(ref.rowStride)
+	{
+		ref.batchSize = 0;
+		ref.capacity = 0;
+		ref.data = NULL;
+		ref.rowCount = 0;
+		ref.rowStride = 0;
+	}
+
+	batchTensor::~batchTensor()
+	{
+		freeAligned(data);
+	}
+
+	batchTensor& batchTensor::operator=(const batchTensor &ref)
+	{
+		if (this != &ref)
+		{
+			resize(ref.rowCount, ref.batchSize);
+			std::copy(ref.data, ref.data + (std::size_t)rowCount * rowStride, data);
+		}
+		return *this;
+	}
+
+	//Swapping hands this tensor's memory to the other tensor, which frees it when it's destroyed.
+	batchTensor& batchTensor::operator=(batchTensor &&ref) noexcept
+	{
+		std::swap(batchSize, ref.batchSize);
+		std::swap(capacity, ref.capacity);
+		std::swap(data, ref.data);
+		std::swap(rowCount, ref.rowCount);
+		std::swap(rowStride, ref.rowStride);
+		return *this;
+	}
+
+	void batchTensor::fill(float value)
+	{
+		std::fill(data, data + (std::size_t)rowCount * rowStride, value);
+	}
+
+	int batchTensor::getBatchSize() const
+	{
+		return batchSize;
+	}
+
+	float* batchTensor::getRow(int row)
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= rowCount)
+		{
+			throw std::out_of_range("The requested row doesn't exist in the tensor.");
+		}
+#endif
+		return data + (std::size_t)row * rowStride;
+	}
+
+	const float* batchTensor::getRow(int row) const
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= rowCount)
+		{
+			throw std::out_of_range("The requested row doesn't exist in the tensor.");
+		}
+#endif
+		return data + (std::size_t)row * rowStride;
+	}
+
+	int batchTensor::getRowCount() const
+	{
+		return rowCount;
+	}
+
+	int batchTensor::getRowStride() const
+	{
+		return rowStride;
+	}
+
+	void batchTensor::resize(int newRowCount, int newBatchSize)
+	{
+		if (newRowCount < 0 || newBatchSize < 0)
+		{
+			throw std::out_of_range("A tensor can't have a negative number of rows or batch size.");
+		}
+
+		//Rounds the batch size up so every row starts on an aligned boundary.
+		const int floatsPerAlignment = TENSOR_ALIGNMENT / (int)sizeof(float);
+		int newRowStride = (newBatchSize + floatsPerAlignment - 1) / floatsPerAlignment * floatsPerAlignment;
+		std::size_t newSize = (std::size_t)newRowCount * newRowStride;
+		if (newSize > capacity)
+		{
+			float *newData = static_cast<float*>(allocateAligned(newSize * sizeof(float), TENSOR_ALIGNMENT));
+			freeAligned(data);
+			data = newData;
+			capacity = newSize;
+		}
+
+		batchSize = newBatchSize;
+		rowCount = newRowCount;
+		rowStride = newRowStride;
+		fill(0.0f);
+	}
+}
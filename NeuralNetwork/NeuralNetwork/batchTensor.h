@@ -0,0 +1,53 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the batchTensor class which holds a value for every batch element of
+ *every cell in one aligned block of memory.*/
+
+#ifndef NEURAL_NETWORK_BATCH_TENSOR
+#define NEURAL_NETWORK_BATCH_TENSOR
+
+#include<cstddef>
+
+namespace NeuralNetwork
+{
+	//The alignment in bytes of the start of every row in a batchTensor.
+	static const int TENSOR_ALIGNMENT = 64;
+
+	/*Stores the values of a batch for a list of cells as one contiguous [cell][batch] block. Each
+	 *row is padded so it starts on an aligned boundary, which gives constant time access to the
+	 *row of any cell index and lets each row be streamed through with vector instructions.*/
+	class batchTensor
+	{
+	public:
+		batchTensor();
+		/*Creates a tensor with the given number of rows and batch size with every value set to
+		 *zero.*/
+		batchTensor(int, int);
+		batchTensor(const batchTensor&);
+		//Takes the memory of the other tensor, leaving it empty.
+		batchTensor(batchTensor&&) noexcept;
+		~batchTensor();
+		batchTensor& operator=(const batchTensor&);
+		batchTensor& operator=(batchTensor&&) noexcept;
+
+		void fill(float);
+		int getBatchSize() const;
+		float* getRow(int);
+		const float* getRow(int) const;
+		int getRowCount() const;
+		//Returns the number of floats between the start of one row and the start of the next row.
+		int getRowStride() const;
+		/*Changes the number of rows and the batch size of the tensor and sets every value to zero.
+		 *The memory is only reallocated when the new shape doesn't fit in the current allocation.*/
+		void resize(int, int);
+
+	private:
+		int batchSize;
+		//Number of floats the current allocation can hold.
+		std::size_t capacity;
+		float *data;
+		int rowCount;
+		int rowStride;
+	};
+}
+
+#endif
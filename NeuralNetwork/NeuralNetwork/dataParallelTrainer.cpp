@@ -0,0 +1,118 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "dataParallelTrainer.h"
+#include "helperFunctions.h"
+#include "neuralNetworkErrors.h"
+#include<algorithm>
+#include<stdexcept>
+
+namespace NeuralNetwork
+{
+	//Number of state elements each task of the reduction adds up, enough to make each task worth handing out.
+	static const int REDUCE_CHUNK_SIZE = 4096;
+
+	dataParallelTrainer::dataParallelTrainer(const neuralNetwork &network, int replicaCount) :stateSize(0)
+	{
+		if (replicaCount < 1)
+		{
+			throw std::out_of_range("The trainer needs at least one replica.");
+		}
+		pool.reset(new threadPool(replicaCount));
+		for (int replicaIndex = 0; replicaIndex < replicaCount; ++replicaIndex)
+		{
+			replicas.push_back(std::unique_ptr<neuralNetwork>(new neuralNetwork(network)));
+			replicas.back()->setThreadCount(1);
+
+			//Each replica's shard starts at batch element zero, so the replicas need their own dropout masks.
+			replicas.back()->setDropoutSeed(network.getDropoutSeed() + (std::uint64_t)replicaIndex * 0x9E3779B97F4A7C15ULL);
+		}
+		stateSize = network.getTrainingStateSize();
+		states.resize((std::size_t)(replicaCount + 1) * stateSize);
+		shardInputs.resize(replicaCount);
+		shardSizes.resize(replicaCount);
+		shardTargets.resize(replicaCount);
+	}
+
+	const neuralNetwork& dataParallelTrainer::getNetwork() const
+	{
+		return *replicas.front();
+	}
+
+	int dataParallelTrainer::getReplicaCount() const
+	{
+		return (int)replicas.size();
+	}
+
+	void dataParallelTrainer::trainBatch(const batchTensor &input, const batchTensor &target)
+	{
+		int batchSize = input.getBatchSize();
+		if (input.getRowCount() != replicas.front()->getInputNodes() || target.getRowCount() != replicas.front()->getOutputNodes() || target.getBatchSize() != batchSize)
+		{
+			throw lists_not_same_length();
+		}
+		if (batchSize < 1)
+		{
+			throw std::out_of_range("Batch size must be greater then zero.");
+		}
+
+		//The batch is split into contiguous shards with the first few one element larger.
+		int replicaCount = (int)replicas.size();
+		int activeReplicas = std::min(replicaCount, batchSize);
+		pool->parallelFor(activeReplicas, 1, [&](int start, int end)
+		{
+			for (int replicaIndex = start; replicaIndex < end; ++replicaIndex)
+			{
+				int shardStart = replicaIndex * (batchSize / activeReplicas) + std::min(replicaIndex, batchSize % activeReplicas);
+				shardSizes[replicaIndex] = batchSize / activeReplicas + (replicaIndex < batchSize % activeReplicas ? 1 : 0);
+				shardInputs[replicaIndex].resize(input.getRowCount(), shardSizes[replicaIndex]);
+				shardTargets[replicaIndex].resize(target.getRowCount(), shardSizes[replicaIndex]);
+				for (int row = 0; row < input.getRowCount(); ++row)
+				{
+					std::copy(input.getRow(row) + shardStart, input.getRow(row) + shardStart + shardSizes[replicaIndex], shardInputs[replicaIndex].getRow(row));
+				}
+				for (int row = 0; row < target.getRowCount(); ++row)
+				{
+					std::copy(target.getRow(row) + shardStart, target.getRow(row) + shardStart + shardSizes[replicaIndex], shardTargets[replicaIndex].getRow(row));
+				}
+				replicas[replicaIndex]->forwardPropagate(shardInputs[replicaIndex]);
+				replicas[replicaIndex]->backwardPropagate(shardTargets[replicaIndex]);
+			}
+		});
+		allReduce(activeReplicas);
+	}
+
+	void dataParallelTrainer::allReduce(int activeReplicas)
+	{
+		int replicaCount = (int)replicas.size();
+		pool->parallelFor(activeReplicas, 1, [&](int start, int end)
+		{
+			for (int replicaIndex = start; replicaIndex < end; ++replicaIndex)
+			{
+				replicas[replicaIndex]->getTrainingState(states.data() + (std::size_t)replicaIndex * stateSize);
+			}
+		});
+
+		//Each element is summed over the replicas in the same order, so the result doesn't depend on how the work is split.
+		int batchSize = 0;
+		for (int replicaIndex = 0; replicaIndex < activeReplicas; ++replicaIndex)
+		{
+			batchSize += shardSizes[replicaIndex];
+		}
+		float *reduced = states.data() + (std::size_t)replicaCount * stateSize;
+		pool->parallelFor(stateSize, REDUCE_CHUNK_SIZE, [&](int start, int end)
+		{
+			std::fill(reduced + start, reduced + end, 0.0f);
+			for (int replicaIndex = 0; replicaIndex < activeReplicas; ++replicaIndex)
+			{
+				addVectors(reduced + start, states.data() + (std::size_t)replicaIndex * stateSize + start, (float)shardSizes[replicaIndex] / batchSize, end - start);
+			}
+		});
+
+		pool->parallelFor(replicaCount, 1, [&](int start, int end)
+		{
+			for (int replicaIndex = start; replicaIndex < end; ++replicaIndex)
+			{
+				replicas[replicaIndex]->setTrainingState(reduced);
+			}
+		});
+	}
+}
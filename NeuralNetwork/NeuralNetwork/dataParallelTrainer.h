@@ -0,0 +1,59 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the dataParallelTrainer class, which trains copies of a network on
+ *shards of each batch at the same time and combines them into one synchronized update.*/
+
+#ifndef NEURAL_NETWORK_DATA_PARALLEL_TRAINER
+#define NEURAL_NETWORK_DATA_PARALLEL_TRAINER
+
+#include "batchTensor.h"
+#include "neuralNetwork.h"
+#include "threadPool.h"
+#include<memory>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	/*Synchronous data-parallel training across replicas of a network in one process. Each batch
+	 *is split into a contiguous shard per replica, and every replica propagates its shard on its
+	 *own thread without any locking. The replicas then all-reduce their training states into one
+	 *before the next batch.
+	 *
+	 *The update of each weight is an affine function of the mean gradient, so when every replica
+	 *starts from the same state, the mean of their updated states weighted by shard size is
+	 *exactly the state a single network would reach on the whole batch. Reducing the weights
+	 *along with the previous changes, rather than the gradients alone, also keeps every replica
+	 *bit for bit the same, so rounding can't make them drift apart.*/
+	class dataParallelTrainer
+	{
+	public:
+		/*Creates the given number of replicas of the network, each running its propagation on a
+		 *single thread. Throws std::out_of_range if there isn't at least one replica.*/
+		dataParallelTrainer(const neuralNetwork&, int);
+
+		//Returns the network the replicas agree on, which is the first replica.
+		const neuralNetwork& getNetwork() const;
+		int getReplicaCount() const;
+		/*Forward propagates a shard of the batch on each replica and backward propagates the
+		 *matching shard of the targets, then all-reduces the replicas. Replicas without any
+		 *batch elements when the batch is smaller than the number of replicas sit the batch out.*/
+		void trainBatch(const batchTensor&, const batchTensor&);
+
+	private:
+		/*Sets every replica's training state to the mean of the states of the first given number
+		 *of replicas weighted by their shard sizes.*/
+		void allReduce(int);
+
+		//The threads the replicas run on, one per replica.
+		std::unique_ptr<threadPool> pool;
+		std::vector<std::unique_ptr<neuralNetwork>> replicas;
+		//The shard of the current batch each replica propagates.
+		std::vector<batchTensor> shardInputs;
+		std::vector<int> shardSizes;
+		std::vector<batchTensor> shardTargets;
+		//The training state of every replica stored back to back, followed by the reduced state.
+		std::vector<float> states;
+		int stateSize;
+	};
+}
+
+#endif
@@ -0,0 +1,276 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "dataset.h"
+#include "neuralNetworkErrors.h"
+#include<algorithm>
+#include<chrono>
+#include<cstring>
+#include<numeric>
+#include<random>
+#include<stdexcept>
+
+namespace NeuralNetwork
+{
+	//datasetWriter:
+	datasetWriter::datasetWriter(const std::string &fileName, int inputCount, int targetCount) :file(fileName.c_str(), std::ios::binary), header()
+	{
+		if (inputCount < 1 || targetCount < 0)
+		{
+			throw std::out_of_range("A dataset needs at least one input and can't have a negative number of targets.");
+		}
+		if (!file)
+		{
+			throw std::runtime_error("Couldn't open the dataset file for writing.");
+		}
+		std::copy("NNDATA\0", "NNDATA\0" + 8, header.magic);
+		header.version = DATASET_FILE_VERSION;
+		header.inputCount = inputCount;
+		header.targetCount = targetCount;
+		header.dataOffset = (sizeof(datasetFileHeader) + DATASET_FILE_ALIGNMENT - 1) / DATASET_FILE_ALIGNMENT * DATASET_FILE_ALIGNMENT;
+
+		//The header is written again with the sample count once the file is closed.
+		const char padding[DATASET_FILE_ALIGNMENT] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(padding, (std::streamsize)(header.dataOffset - sizeof(header)));
+	}
+
+	datasetWriter::~datasetWriter()
+	{
+		try
+		{
+			if (file.is_open())
+			{
+				close();
+			}
+		}
+		catch (const std::exception&)
+		{
+
+		}
+	}
+
+	void datasetWriter::addSample(const float *inputs, const float *targets)
+	{
+		file.write(reinterpret_cast<const char*>(inputs), header.inputCount * sizeof(float));
+		file.write(reinterpret_cast<const char*>(targets), header.targetCount * sizeof(float));
+		++header.sampleCount;
+	}
+
+	void datasetWriter::close()
+	{
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		bool written = (bool)file;
+		file.close();
+		if (!written || !file)
+		{
+			throw std::runtime_error("Couldn't write the dataset file.");
+		}
+	}
+
+	std::uint64_t datasetWriter::getSampleCount() const
+	{
+		return header.sampleCount;
+	}
+
+	//datasetReader:
+	datasetReader::datasetReader(const std::string &fileName) :file(fileName), header(NULL), samples(NULL)
+	{
+		if (file.getSize() < sizeof(datasetFileHeader))
+		{
+			throw dataset_file_not_valid();
+		}
+		header = reinterpret_cast<const datasetFileHeader*>(file.getData());
+		std::uint64_t sampleBytes = ((std::uint64_t)header->inputCount + header->targetCount) * sizeof(float);
+		if (std::memcmp(header->magic, "NNDATA\0", 8) != 0 || header->version != DATASET_FILE_VERSION || header->inputCount < 1 || header->targetCount < 0
+			|| header->dataOffset % DATASET_FILE_ALIGNMENT != 0 || header->dataOffset > file.getSize()
+			|| header->sampleCount > (file.getSize() - header->dataOffset) / sampleBytes)
+		{
+			throw dataset_file_not_valid();
+		}
+		samples = reinterpret_cast<const float*>(file.getData() + header->dataOffset);
+	}
+
+	void datasetReader::getBatch(const std::uint64_t *sampleIndexes, int count, batchTensor &inputs, batchTensor &targets) const
+	{
+		int inputCount = header->inputCount;
+		int targetCount = header->targetCount;
+		if (inputs.getBatchSize() != count || inputs.getRowCount() != inputCount || targets.getBatchSize() != count || targets.getRowCount() != targetCount)
+		{
+			inputs.resize(inputCount, count);
+			targets.resize(targetCount, count);
+		}
+		for (int batchIndex = 0; batchIndex < count; ++batchIndex)
+		{
+			const float *sample = getSample(sampleIndexes[batchIndex]);
+			for (int inputIndex = 0; inputIndex < inputCount; ++inputIndex)
+			{
+				inputs.getRow(inputIndex)[batchIndex] = sample[inputIndex];
+			}
+			for (int targetIndex = 0; targetIndex < targetCount; ++targetIndex)
+			{
+				targets.getRow(targetIndex)[batchIndex] = sample[inputCount + targetIndex];
+			}
+		}
+	}
+
+	int datasetReader::getInputCount() const
+	{
+		return header->inputCount;
+	}
+
+	const float* datasetReader::getSample(std::uint64_t sampleIndex) const
+	{
+		if (sampleIndex >= header->sampleCount)
+		{
+			throw std::out_of_range("The sample index is past the end of the dataset.");
+		}
+		return samples + sampleIndex * (std::uint64_t)(header->inputCount + header->targetCount);
+	}
+
+	std::uint64_t datasetReader::getSampleCount() const
+	{
+		return header->sampleCount;
+	}
+
+	int datasetReader::getTargetCount() const
+	{
+		return header->targetCount;
+	}
+
+	void shuffleSamples(std::uint64_t sampleCount, std::uint64_t seed, int epoch, std::vector<std::uint64_t> &order)
+	{
+		//Fisher-Yates shuffle with the generator's output used directly so the order is the same with any standard library.
+		std::mt19937_64 generator(seed + (std::uint64_t)epoch * 0x9E3779B97F4A7C15ULL);
+		order.resize(sampleCount);
+		std::iota(order.begin(), order.end(), (std::uint64_t)0);
+		for (std::uint64_t sampleIndex = sampleCount; sampleIndex > 1; --sampleIndex)
+		{
+			std::swap(order[sampleIndex - 1], order[generator() % sampleIndex]);
+		}
+	}
+
+	//batchProducer:
+	batchProducer::batchProducer(const datasetReader &newDataset, int newBatchSize, int newEpochCount, std::uint64_t newSeed) :batchSize(newBatchSize),
+		consumed(0), consumerWaitTime(0), currentEpoch(0), dataset(newDataset), epochCount(newEpochCount), finished(false), holdingSlot(false),
+		producerWaitTime(0), seed(newSeed), stopping(false)
+	{
+		if (newBatchSize < 1 || newEpochCount < 0)
+		{
+			throw std::out_of_range("The batch size has to be at least one and the number of epochs can't be negative.");
+		}
+		for (int slotIndex = 0; slotIndex < 2; ++slotIndex)
+		{
+			slots[slotIndex].epoch = 0;
+			slots[slotIndex].ready = false;
+		}
+		worker = std::thread(&batchProducer::produce, this);
+	}
+
+	batchProducer::~batchProducer()
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+		slotChanged.notify_all();
+		worker.join();
+	}
+
+	std::uint64_t batchProducer::getConsumerWaitTime()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return consumerWaitTime;
+	}
+
+	int batchProducer::getEpoch()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return currentEpoch;
+	}
+
+	std::uint64_t batchProducer::getProducerWaitTime()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return producerWaitTime;
+	}
+
+	bool batchProducer::nextBatch(const batchTensor *&input, const batchTensor *&target)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		if (holdingSlot)
+		{
+			slots[(consumed - 1) % 2].ready = false;
+			holdingSlot = false;
+			slotChanged.notify_all();
+		}
+
+		//The batches are handed out in the order they were produced, alternating between the slots.
+		batchSlot &slot = slots[consumed % 2];
+		std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+		slotChanged.wait(guard, [&] {return slot.ready || finished; });
+		consumerWaitTime += (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStart).count();
+		if (!slot.ready)
+		{
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+			return false;
+		}
+		holdingSlot = true;
+		++consumed;
+		currentEpoch = slot.epoch;
+		input = &slot.input;
+		target = &slot.target;
+		return true;
+	}
+
+	void batchProducer::produce()
+	{
+		try
+		{
+			std::uint64_t sampleCount = dataset.getSampleCount();
+			std::vector<std::uint64_t> order(sampleCount);
+			std::uint64_t produced = 0;
+			for (int epoch = 0; epoch < epochCount; ++epoch)
+			{
+				shuffleSamples(sampleCount, seed, epoch, order);
+
+				for (std::uint64_t start = 0; start < sampleCount; start += batchSize)
+				{
+					batchSlot &slot = slots[produced % 2];
+					{
+						std::unique_lock<std::mutex> guard(lock);
+						std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+						slotChanged.wait(guard, [&] {return !slot.ready || stopping; });
+						producerWaitTime += (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStart).count();
+						if (stopping)
+						{
+							return;
+						}
+					}
+
+					//The slot isn't ready, so the consumer won't touch it until it's marked ready again.
+					dataset.getBatch(order.data() + start, (int)std::min<std::uint64_t>(batchSize, sampleCount - start), slot.input, slot.target);
+					slot.epoch = epoch;
+					{
+						std::lock_guard<std::mutex> guard(lock);
+						slot.ready = true;
+						++produced;
+					}
+					slotChanged.notify_all();
+				}
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			error = std::current_exception();
+		}
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			finished = true;
+		}
+		slotChanged.notify_all();
+	}
+}
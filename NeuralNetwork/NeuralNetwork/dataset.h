@@ -0,0 +1,160 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the classes used to stream training data from disk. A dataset file is a header
+ *followed by every sample stored as its inputs and then its targets, and is written with the
+ *datasetWriter class one sample at a time. The datasetReader class memory maps the file, so
+ *datasets larger than memory are paged in as they're read, and the batchProducer class reads
+ *the samples in a shuffled order on a background thread into batch tensors ready for
+ *neuralNetwork::forwardPropagate().*/
+
+#ifndef NEURAL_NETWORK_DATASET
+#define NEURAL_NETWORK_DATASET
+
+#include "batchTensor.h"
+#include "mappedFile.h"
+#include<condition_variable>
+#include<cstdint>
+#include<exception>
+#include<fstream>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	//Alignment in bytes of the start of the samples in a dataset file.
+	static const int DATASET_FILE_ALIGNMENT = 64;
+	//Version of the dataset file format, increased whenever the layout changes.
+	static const std::uint32_t DATASET_FILE_VERSION = 1;
+
+	//Start of every dataset file. The data offset is in bytes from the start of the file.
+	struct datasetFileHeader
+	{
+		//The characters "NNDATA" followed by two zeros.
+		char magic[8];
+		std::uint32_t version;
+		std::int32_t inputCount;
+		std::int32_t targetCount;
+		std::uint32_t padding;
+		std::uint64_t sampleCount;
+		std::uint64_t dataOffset;
+		//Kept at zero for fields added by later versions.
+		std::uint8_t reserved[24];
+	};
+
+	/*Writes a dataset file one sample at a time so a dataset never has to fit in memory. The
+	 *number of samples is written into the header when the file is closed.*/
+	class datasetWriter
+	{
+	public:
+		//Creates the file for samples with the given number of inputs and targets.
+		datasetWriter(const std::string&, int, int);
+		datasetWriter(const datasetWriter&) = delete;
+		//Closes the file if it's still open, ignoring any error.
+		~datasetWriter();
+		datasetWriter& operator=(const datasetWriter&) = delete;
+
+		//Appends a sample given its inputs and targets.
+		void addSample(const float*, const float*);
+		/*Writes the sample count into the header and closes the file. Throws std::runtime_error if
+		 *the file couldn't be written.*/
+		void close();
+		std::uint64_t getSampleCount() const;
+
+	private:
+		std::ofstream file;
+		datasetFileHeader header;
+	};
+
+	/*Read-only view of a memory mapped dataset file. Only the samples that are read get paged in,
+	 *and processes reading the same file share its pages.*/
+	class datasetReader
+	{
+	public:
+		/*Maps the dataset file. Throws dataset_file_not_valid if it isn't a dataset file of this
+		 *version or is shorter than its header says.*/
+		explicit datasetReader(const std::string&);
+
+		/*Gathers the samples with the given indexes into a tensor of inputs and a tensor of
+		 *targets with a batch element per sample. The tensors are only resized if their shape
+		 *doesn't match, since every value is written anyway. Reading each sample is also what
+		 *pages it in, so the page faults land on the calling thread.*/
+		void getBatch(const std::uint64_t*, int, batchTensor&, batchTensor&) const;
+		int getInputCount() const;
+		//Returns the inputs of a sample, which are followed by its targets.
+		const float* getSample(std::uint64_t) const;
+		std::uint64_t getSampleCount() const;
+		int getTargetCount() const;
+
+	private:
+		mappedFile file;
+		const datasetFileHeader *header;
+		const float *samples;
+	};
+
+	/*Fills the vector with the indexes of the given number of samples in the shuffled order of an
+	 *epoch, which only depends on the seed and the epoch.*/
+	void shuffleSamples(std::uint64_t, std::uint64_t, int, std::vector<std::uint64_t>&);
+
+	/*Produces batches of a dataset in a new shuffled order each epoch. A background thread gathers
+	 *the samples into one pair of input and target tensors while the other pair is being used, so
+	 *the thread calling nextBatch() only waits when the reads can't keep up. The order only
+	 *depends on the seed, so a run can be repeated exactly.*/
+	class batchProducer
+	{
+	public:
+		/*Starts producing batches of the given size from the dataset for the given number of
+		 *epochs. The last batch of each epoch has the samples left over and may be smaller.*/
+		batchProducer(const datasetReader&, int, int, std::uint64_t);
+		batchProducer(const batchProducer&) = delete;
+		//Stops the background thread, waiting for the batch it's on.
+		~batchProducer();
+		batchProducer& operator=(const batchProducer&) = delete;
+
+		//Returns the total nanoseconds nextBatch() waited for a batch to be ready.
+		std::uint64_t getConsumerWaitTime();
+		//Returns the epoch of the last batch handed out.
+		int getEpoch();
+		//Returns the total nanoseconds the background thread waited for a free pair of tensors.
+		std::uint64_t getProducerWaitTime();
+		/*Hands back the tensors from the last call and waits for the next batch. Returns false
+		 *once every epoch has been produced. The tensors stay valid until the next call. If the
+		 *background thread threw, the exception is rethrown here.*/
+		bool nextBatch(const batchTensor*&, const batchTensor*&);
+
+	private:
+		//One of the two pairs of tensors the batches are gathered into.
+		struct batchSlot
+		{
+			int epoch;
+			batchTensor input;
+			bool ready;
+			batchTensor target;
+		};
+
+		//The loop the background thread runs until every epoch is produced or it's stopped.
+		void produce();
+
+		int batchSize;
+		//Number of batches handed out by nextBatch().
+		std::uint64_t consumed;
+		std::uint64_t consumerWaitTime;
+		int currentEpoch;
+		const datasetReader &dataset;
+		int epochCount;
+		std::exception_ptr error;
+		bool finished;
+		//Whether the last call of nextBatch() handed out a slot that hasn't been given back.
+		bool holdingSlot;
+		std::mutex lock;
+		std::uint64_t producerWaitTime;
+		std::uint64_t seed;
+		batchSlot slots[2];
+		//Signals both that a slot was filled and that one was given back.
+		std::condition_variable slotChanged;
+		bool stopping;
+		std::thread worker;
+	};
+}
+
+#endif
@@ -0,0 +1,153 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "distributedTrainer.h"
+#include<chrono>
+
+namespace NeuralNetwork
+{
+	distributedTrainer::distributedTrainer(neuralNetwork &newNetwork, ringCommunicator &newRing) :communicationTime(0), exposedCommunicationTime(0),
+		network(newNetwork), reducedStages(0), ring(newRing), stopping(false)
+	{
+		network.setDropoutSeed(network.getDropoutSeed() + (std::uint64_t)ring.getRank() * 0x9E3779B97F4A7C15ULL);
+
+		//The communication thread isn't running yet, so the starting states are averaged on this thread.
+		findStageOffsets();
+		for (int stageIndex = 0; stageIndex < network.getStageCount(); ++stageIndex)
+		{
+			copyStage(stageIndex, 1.0f);
+			ring.allReduce(states.data() + stageOffsets[stageIndex], stageOffsets[stageIndex + 1] - stageOffsets[stageIndex]);
+			finishStage(stageIndex);
+		}
+		worker = std::thread(&distributedTrainer::reduceStages, this);
+	}
+
+	distributedTrainer::~distributedTrainer()
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+		changed.notify_all();
+		worker.join();
+	}
+
+	std::uint64_t distributedTrainer::getCommunicationTime()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return communicationTime;
+	}
+
+	std::uint64_t distributedTrainer::getExposedCommunicationTime() const
+	{
+		return exposedCommunicationTime;
+	}
+
+	void distributedTrainer::trainBatch(const batchTensor &input, const batchTensor &target)
+	{
+		findStageOffsets();
+		network.forwardPropagate(input);
+		float batchSize = (float)input.getBatchSize();
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			pendingStages.clear();
+			reducedStages = 0;
+		}
+
+		//Each stage is copied out as soon as it's updated and handed to the communication thread.
+		network.backwardPropagate(target, [&](int stageIndex)
+		{
+			copyStage(stageIndex, batchSize);
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				pendingStages.push_back(stageIndex);
+			}
+			changed.notify_all();
+		});
+
+		std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [&] {return reducedStages == pendingStages.size() || error; });
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+		exposedCommunicationTime += (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStart).count();
+		for (int stageIndex = 0; stageIndex < network.getStageCount(); ++stageIndex)
+		{
+			finishStage(stageIndex);
+		}
+	}
+
+	void distributedTrainer::copyStage(int stageIndex, float batchSize)
+	{
+		float *stageState = states.data() + stageOffsets[stageIndex];
+		std::size_t stateSize = stageOffsets[stageIndex + 1] - stageOffsets[stageIndex] - 1;
+		network.getTrainingState(stageIndex, stageState);
+		for (std::size_t stateIndex = 0; stateIndex < stateSize; ++stateIndex)
+		{
+			stageState[stateIndex] *= batchSize;
+		}
+		stageState[stateSize] = batchSize;
+	}
+
+	void distributedTrainer::findStageOffsets()
+	{
+		stageOffsets.assign(1, 0);
+		for (int stageIndex = 0; stageIndex < network.getStageCount(); ++stageIndex)
+		{
+			stageOffsets.push_back(stageOffsets.back() + network.getTrainingStateSize(stageIndex) + 1);
+		}
+		states.resize(stageOffsets.back());
+	}
+
+	void distributedTrainer::finishStage(int stageIndex)
+	{
+		float *stageState = states.data() + stageOffsets[stageIndex];
+		std::size_t stateSize = stageOffsets[stageIndex + 1] - stageOffsets[stageIndex] - 1;
+		for (std::size_t stateIndex = 0; stateIndex < stateSize; ++stateIndex)
+		{
+			stageState[stateIndex] /= stageState[stateSize];
+		}
+		network.setTrainingState(stageIndex, stageState);
+	}
+
+	void distributedTrainer::reduceStages()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		while (true)
+		{
+			changed.wait(guard, [&] {return reducedStages < pendingStages.size() || stopping; });
+			if (stopping)
+			{
+				return;
+			}
+			int stageIndex = pendingStages[reducedStages];
+			guard.unlock();
+
+			//The stage's part of the buffer isn't touched by the training thread until every stage is reduced.
+			std::chrono::steady_clock::time_point reduceStart = std::chrono::steady_clock::now();
+			std::exception_ptr reduceError;
+			try
+			{
+				ring.allReduce(states.data() + stageOffsets[stageIndex], stageOffsets[stageIndex + 1] - stageOffsets[stageIndex]);
+			}
+			catch (...)
+			{
+				reduceError = std::current_exception();
+			}
+
+			guard.lock();
+			communicationTime += (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - reduceStart).count();
+			if (reduceError)
+			{
+				//The ring can't be used once a worker has left, so the thread stops reducing.
+				error = reduceError;
+				changed.notify_all();
+				return;
+			}
+			++reducedStages;
+			changed.notify_all();
+		}
+	}
+}
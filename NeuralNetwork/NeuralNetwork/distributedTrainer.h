@@ -0,0 +1,84 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the distributedTrainer class, which trains one network across a ring
+ *of worker processes with the communication overlapped with the backward propagation.*/
+
+#ifndef NEURAL_NETWORK_DISTRIBUTED_TRAINER
+#define NEURAL_NETWORK_DISTRIBUTED_TRAINER
+
+#include "batchTensor.h"
+#include "neuralNetwork.h"
+#include "ringCommunicator.h"
+#include<condition_variable>
+#include<cstddef>
+#include<cstdint>
+#include<exception>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	/*One worker of a network trained across processes. Every worker holds a replica of the same
+	 *network and trains it on its own batches, and after each batch the replicas are combined
+	 *into one with ringCommunicator::allReduce() the same way dataParallelTrainer combines its
+	 *replicas, so they end up bit for bit the same.
+	 *
+	 *The training state of a stage doesn't change once its backward propagation is done, so each
+	 *stage is handed to a communication thread right away, starting from the last stage. The
+	 *all-reduce of the later stages then runs while the earlier stages are still being backward
+	 *propagated, and only the communication of the first few stages is left waiting at the end.*/
+	class distributedTrainer
+	{
+	public:
+		/*Trains the given network as the worker the communicator was created for. The starting
+		 *states of every worker's network are averaged, so every worker starts from the same
+		 *network, and the dropout seed is offset by the rank so the workers drop different
+		 *elements. Every worker has to create its trainer at the same point. Throws
+		 *cell_not_neuron if the network has a cell that isn't a neuron.*/
+		distributedTrainer(neuralNetwork&, ringCommunicator&);
+		distributedTrainer(const distributedTrainer&) = delete;
+		~distributedTrainer();
+		distributedTrainer& operator=(const distributedTrainer&) = delete;
+
+		//Nanoseconds the communication thread has spent in all-reduces.
+		std::uint64_t getCommunicationTime();
+		/*Nanoseconds spent waiting for the all-reduces after the backward propagation was done,
+		 *which is the part of the communication that wasn't hidden.*/
+		std::uint64_t getExposedCommunicationTime() const;
+		/*Forward and backward propagates this worker's batch and combines the network with every
+		 *other worker. The batches of the workers can have different sizes and each worker's
+		 *network is weighted by its batch size, so the result is the same as one network trained
+		 *on every worker's batch at once. Every worker has to call it the same number of times.
+		 *Throws std::runtime_error if a worker leaves the ring.*/
+		void trainBatch(const batchTensor&, const batchTensor&);
+
+	private:
+		/*Copies the training state of a stage into its part of the buffer multiplied by the given
+		 *batch size, followed by the batch size itself, so the sum across the workers is weighted.*/
+		void copyStage(int, float);
+		//Finds where each stage's part of the buffer starts. Called before each batch in case the network changed.
+		void findStageOffsets();
+		//Divides the summed state of a stage by the summed batch sizes and gives it to the network.
+		void finishStage(int);
+		//Runs on the communication thread, all-reducing the stages in the order they're handed over.
+		void reduceStages();
+
+		std::condition_variable changed;
+		std::uint64_t communicationTime;
+		std::exception_ptr error;
+		std::uint64_t exposedCommunicationTime;
+		std::mutex lock;
+		neuralNetwork &network;
+		//Stages handed to the communication thread and how many of them have been all-reduced.
+		std::vector<int> pendingStages;
+		std::size_t reducedStages;
+		ringCommunicator &ring;
+		//Where each stage's part of the states starts along with a last entry marking the end.
+		std::vector<std::size_t> stageOffsets;
+		std::vector<float> states;
+		bool stopping;
+		std::thread worker;
+	};
+}
+
+#endif
@@ -0,0 +1,65 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "gradualPruner.h"
+#include<stdexcept>
+
+namespace NeuralNetwork
+{
+	gradualPruner::gradualPruner(neuralNetwork &newNetwork, float newTargetSparsity, std::uint64_t newStartStep, std::uint64_t newEndStep, std::uint64_t newInterval,
+		pruningScope newScope) :endStep(newEndStep), initialConnections(newNetwork.getConnectionCount()), interval(newInterval), network(newNetwork), scope(newScope),
+		startStep(newStartStep), targetSparsity(newTargetSparsity)
+	{
+		if (!(newTargetSparsity >= 0.0f && newTargetSparsity < 1.0f))
+		{
+			throw std::out_of_range("The target sparsity must be at least zero and less than one.");
+		}
+		if (newInterval == 0 || newEndStep < newStartStep)
+		{
+			throw std::out_of_range("The interval must be greater then zero and the end step can't be before the start step.");
+		}
+	}
+
+	float gradualPruner::getSparsity() const
+	{
+		if (initialConnections == 0)
+		{
+			return 0.0f;
+		}
+		return 1.0f - (float)network.getConnectionCount() / initialConnections;
+	}
+
+	float gradualPruner::getScheduledSparsity(std::uint64_t step) const
+	{
+		if (step < startStep)
+		{
+			return 0.0f;
+		}
+		if (step >= endStep)
+		{
+			return targetSparsity;
+		}
+		double remaining = 1.0 - (double)(step - startStep) / (double)(endStep - startStep);
+		return (float)(targetSparsity * (1.0 - remaining * remaining * remaining));
+	}
+
+	float gradualPruner::getTargetSparsity() const
+	{
+		return targetSparsity;
+	}
+
+	bool gradualPruner::update(std::uint64_t step)
+	{
+		if (step < startStep || (step < endStep && (step - startStep) % interval != 0))
+		{
+			return false;
+		}
+
+		//The fraction pruned is of the connections that are left, which brings the network to the scheduled sparsity.
+		float sparsity = getSparsity();
+		float scheduled = getScheduledSparsity(step);
+		if (scheduled <= sparsity)
+		{
+			return false;
+		}
+		return network.pruneConnections((scheduled - sparsity) / (1.0f - sparsity), scope) > 0;
+	}
+}
@@ -0,0 +1,50 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the gradualPruner class, which prunes a network a little at a time
+ *while it's being trained.*/
+
+#ifndef NEURAL_NETWORK_GRADUAL_PRUNER
+#define NEURAL_NETWORK_GRADUAL_PRUNER
+
+#include "neuralNetwork.h"
+#include<cstdint>
+
+namespace NeuralNetwork
+{
+	/*Raises the sparsity of a network from zero to the target between a start and end step with
+	 *the cubic schedule from "To prune, or not to prune" by Zhu and Gupta, which prunes quickly
+	 *while there are many redundant connections and slows down as it nears the target. Every
+	 *interval steps the smallest weights are pruned until the network reaches the sparsity of
+	 *the schedule, so training has the steps in between to recover from each round. The
+	 *sparsity is measured against the connections the network had when the pruner was made.*/
+	class gradualPruner
+	{
+	public:
+		/*Creates a pruner for the given network that reaches the target sparsity at the end step,
+		 *pruning every interval steps from the start step with the given scope. Throws
+		 *std::out_of_range if the target sparsity isn't at least zero and less than one, the
+		 *interval is zero or the end step is before the start step.*/
+		gradualPruner(neuralNetwork&, float, std::uint64_t, std::uint64_t, std::uint64_t, pruningScope);
+
+		//Returns the fraction of the network's starting connections that have been removed.
+		float getSparsity() const;
+		//Returns the sparsity the schedule has reached by the given step.
+		float getScheduledSparsity(std::uint64_t) const;
+		float getTargetSparsity() const;
+		/*Called after each training step with the number of the step. Prunes the network up to
+		 *the scheduled sparsity if the step is a pruning step and returns whether any
+		 *connections were removed. Every step from the end step on is a pruning step, so a
+		 *network that regrew connections is pruned back to the target.*/
+		bool update(std::uint64_t);
+
+	private:
+		std::uint64_t endStep;
+		int initialConnections;
+		std::uint64_t interval;
+		neuralNetwork &network;
+		pruningScope scope;
+		std::uint64_t startStep;
+		float targetSparsity;
+	};
+}
+
+#endif
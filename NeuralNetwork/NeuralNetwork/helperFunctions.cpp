@@ -1,28 +1,58 @@
 //Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
 #include "helperFunctions.h"
-#include "neuralNetworkErrors.h"
-#include "preprocessorFlags.h"
+#include "vectorKernels.h"
+#include<new>
+#include<stdlib.h>
+#ifdef _WIN32
+#include<malloc.h>
+#endif
 
 namespace NeuralNetwork
 {
-	void addVectors(std::vector<float> &target, const std::vector<float> &ref, const float multiplier)
+	void addVectors(float *target, const float *ref, const float multiplier, int length)
 	{
-		std::vector<float>::iterator targetIt = target.begin();
-		std::vector<float>::const_iterator refIt = ref.begin();
-#if SAFE_CELL
-		for (; targetIt != target.end() && refIt != ref.end(); ++targetIt, ++refIt)
+		getKernels().addVectors(target, ref, multiplier, length);
+	}
+
+	void addWeightedRows(float *target, const float *const *refs, const float *multipliers, int refCount, int length)
+	{
+		getKernels().addWeightedRows(target, refs, multipliers, refCount, length);
+	}
+
+	std::uint64_t getElapsed(std::chrono::steady_clock::time_point start)
+	{
+		return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void* allocateAligned(std::size_t size, std::size_t alignment)
+	{
+		//Zero byte allocations still return a unique pointer.
+		if (size == 0)
 		{
-			*targetIt += *refIt * multiplier;
+			size = alignment;
 		}
-		if (targetIt != target.end() ^ refIt != ref.end())
+#ifdef _WIN32
+		void *output = _aligned_malloc(size, alignment);
+#else
+		void *output = NULL;
+		if (posix_memalign(&output, alignment, size) != 0)
 		{
-			throw lists_not_same_length();
+			output = NULL;
 		}
-#else
-		for (; targetIt != target.end(); ++targetIt, ++refIt)
+#endif
+		if (!output)
 		{
-			*targetIt += *refIt * multiplier;
+			throw std::bad_alloc();
 		}
+		return output;
+	}
+
+	void freeAligned(void *ptr)
+	{
+#ifdef _WIN32
+		_aligned_free(ptr);
+#else
+		free(ptr);
 #endif
 	}
-}
\ No newline at end of file
+}
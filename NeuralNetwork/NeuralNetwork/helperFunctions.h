@@ -3,13 +3,54 @@
 #ifndef HELPER_FUNCTIONS_NEURAL_NETWORK
 #define HELPER_FUNCTIONS_NEURAL_NETWORK
 
-#include<vector>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
 
 namespace NeuralNetwork
 {
-	/*Takes two same-length lists and adds the reference vector to the target vector while multiplying
-	 *the value of the reference by a multiplier.*/
-	void addVectors(std::vector<float> &target, const std::vector<float> &ref, const float multiplier);
+	/*Takes two arrays of the given length and adds the reference array to the target array while
+	 *multiplying the value of the reference by a multiplier. Uses the vector kernels picked for
+	 *the processor.*/
+	void addVectors(float *target, const float *ref, const float multiplier, int length);
+	/*Adds each of the given number of reference arrays to the target array multiplied by its
+	 *weight. Same as calling addVectors() for each one, but the target is only read and written
+	 *once.*/
+	void addWeightedRows(float *target, const float *const *refs, const float *multipliers, int refCount, int length);
+
+	//Returns the nanoseconds since the given time.
+	std::uint64_t getElapsed(std::chrono::steady_clock::time_point);
+
+	/*Allocates the given number of bytes starting on a multiple of the alignment, which must be a
+	 *power of two. Throws std::bad_alloc if the memory can't be allocated.*/
+	void* allocateAligned(std::size_t, std::size_t);
+	//Frees memory allocated by allocateAligned(). Does nothing if given a null pointer.
+	void freeAligned(void*);
+
+	/*Reads or writes a float that other threads may be writing at the same time without ordering
+	 *it against any other memory. Each access sees a whole value written by some thread, but
+	 *updates from different threads can overwrite each other. Defined here so the loops using
+	 *them can inline them.*/
+	inline float loadRelaxed(const float *address)
+	{
+#ifdef _MSC_VER
+		//Aligned float accesses are atomic on every processor Visual Studio targets.
+		return *static_cast<const volatile float*>(address);
+#else
+		float output;
+		__atomic_load(address, &output, __ATOMIC_RELAXED);
+		return output;
+#endif
+	}
+
+	inline void storeRelaxed(float *address, float value)
+	{
+#ifdef _MSC_VER
+		*static_cast<volatile float*>(address) = value;
+#else
+		__atomic_store(address, &value, __ATOMIC_RELAXED);
+#endif
+	}
 }
 
 #endif
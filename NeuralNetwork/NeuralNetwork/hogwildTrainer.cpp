@@ -0,0 +1,280 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "hogwildTrainer.h"
+#include "helperFunctions.h"
+#include "neuralNetworkErrors.h"
+#include "philoxRandom.h"
+#include "vectorKernels.h"
+#include<algorithm>
+#include<chrono>
+#include<numeric>
+#include<stdexcept>
+
+namespace NeuralNetwork
+{
+	hogwildTrainer::hogwildTrainer(neuralNetwork &newNetwork, const datasetReader &newDataset, int newBatchSize, int threadCount) :batchSize(newBatchSize),
+		dataset(newDataset), network(newNetwork)
+	{
+		if (newBatchSize < 1 || threadCount < 1)
+		{
+			throw std::out_of_range("The batch size and thread count have to be at least one.");
+		}
+		if (newDataset.getInputCount() != newNetwork.getInputNodes() || newDataset.getTargetCount() != newNetwork.getOutputNodes())
+		{
+			throw lists_not_same_length();
+		}
+		pool.reset(new threadPool(threadCount));
+	}
+
+	int hogwildTrainer::getBatchSize() const
+	{
+		return batchSize;
+	}
+
+	int hogwildTrainer::getThreadCount() const
+	{
+		return pool->getThreadCount();
+	}
+
+	trainingStats hogwildTrainer::train(int epochCount, std::uint64_t seed)
+	{
+		//The threads write the weights in place, so the network can't share them with its copies.
+		for (std::list<std::list<neuralNetwork::cell*>>::iterator scheduleIt = network.schedule.begin(); scheduleIt != network.schedule.end(); ++scheduleIt)
+		{
+			network.separateSharedBlocks(*scheduleIt);
+		}
+		if (!network.stagesAnalyzed)
+		{
+			network.analyzeStages();
+		}
+		network.invalidatePackedWeights();
+		neurons.clear();
+		for (std::list<std::list<neuralNetwork::cell*>>::iterator scheduleIt = network.schedule.begin(); scheduleIt != network.schedule.end(); ++scheduleIt)
+		{
+			for (std::list<neuralNetwork::cell*>::iterator it = scheduleIt->begin(); it != scheduleIt->end(); ++it)
+			{
+				neuronPlan plan;
+				plan.target = dynamic_cast<neuralNetwork::neuron*>(*it);
+				if (!plan.target)
+				{
+					throw cell_not_neuron();
+				}
+				plan.activation = plan.target->getActivationFunction();
+				plan.cellIndex = plan.target->getIndex();
+				plan.columns = plan.target->getConnectionBlock().getColumns(plan.target->getConnectionRow());
+				plan.dropRatePercent = plan.target->getDropRatePercent();
+				plan.propagateFurther = plan.target->getPropagateFurther();
+				plan.rowLength = plan.target->getConnectionBlock().getRowLength(plan.target->getConnectionRow());
+				neurons.push_back(plan);
+			}
+		}
+
+		trainingStats stats = trainingStats();
+		stats.epochLosses.assign(std::max(epochCount, 0), 0.0);
+		std::uint64_t sampleCount = dataset.getSampleCount();
+		int batchCount = (int)((sampleCount + batchSize - 1) / batchSize);
+		int outputNodes = network.getOutputNodes();
+		int firstOutput = network.getCellCount() - outputNodes;
+
+		//Each batch keeps its own loss and times, which are added up in batch order once the epoch is done.
+		std::vector<double> batchLosses(batchCount);
+		std::vector<std::uint64_t> backwardTimes(batchCount), forwardTimes(batchCount), loadTimes(batchCount);
+		std::vector<std::uint64_t> order;
+		std::chrono::steady_clock::time_point trainStart = std::chrono::steady_clock::now();
+		for (int epoch = 0; epoch < epochCount; ++epoch)
+		{
+			shuffleSamples(sampleCount, seed, epoch, order);
+			std::uint64_t firstStep = network.trainingStep + (std::uint64_t)epoch * batchCount;
+			pool->parallelFor(batchCount, 1, [&](int start, int end)
+			{
+				static thread_local workspace buffers;
+				for (int batchIndex = start; batchIndex < end; ++batchIndex)
+				{
+					std::chrono::steady_clock::time_point stepStart = std::chrono::steady_clock::now();
+					int count = (int)std::min<std::uint64_t>(batchSize, sampleCount - (std::uint64_t)batchIndex * batchSize);
+					dataset.getBatch(order.data() + (std::uint64_t)batchIndex * batchSize, count, buffers.input, buffers.target);
+					loadTimes[batchIndex] = getElapsed(stepStart);
+
+					stepStart = std::chrono::steady_clock::now();
+					forwardPropagate(buffers, firstStep + batchIndex, count);
+					forwardTimes[batchIndex] = getElapsed(stepStart);
+
+					//The squared errors are summed per sample over the outputs and then averaged over them, the same as trainingDriver.
+					double batchLoss = 0.0;
+					for (int outputIndex = 0; outputIndex < outputNodes; ++outputIndex)
+					{
+						float rowLoss = 0.0f;
+						const float *outputRow = buffers.values.getRow(firstOutput + outputIndex);
+						const float *targetRow = buffers.target.getRow(outputIndex);
+						for (int sampleIndex = 0; sampleIndex < count; ++sampleIndex)
+						{
+							float error = targetRow[sampleIndex] - outputRow[sampleIndex];
+							rowLoss += error * error;
+						}
+						batchLoss += rowLoss;
+					}
+					batchLosses[batchIndex] = outputNodes > 0 ? batchLoss / outputNodes : 0.0;
+
+					stepStart = std::chrono::steady_clock::now();
+					backwardPropagate(buffers, count);
+					backwardTimes[batchIndex] = getElapsed(stepStart);
+				}
+			});
+
+			for (int batchIndex = 0; batchIndex < batchCount; ++batchIndex)
+			{
+				stats.backwardTime += backwardTimes[batchIndex];
+				stats.epochLosses[epoch] += batchLosses[batchIndex];
+				stats.forwardTime += forwardTimes[batchIndex];
+				stats.loadWaitTime += loadTimes[batchIndex];
+			}
+			stats.epochLosses[epoch] = sampleCount > 0 ? stats.epochLosses[epoch] / sampleCount : 0.0;
+			stats.batchCount += batchCount;
+			stats.sampleCount += sampleCount;
+		}
+		network.trainingStep += (std::uint64_t)std::max(epochCount, 0) * batchCount;
+		stats.totalTime = getElapsed(trainStart);
+		stats.samplesPerSecond = stats.totalTime > 0 ? stats.sampleCount * 1e9 / stats.totalTime : 0.0;
+		return stats;
+	}
+
+	void hogwildTrainer::backwardPropagate(workspace &buffers, int count) const
+	{
+		int cellCount = network.getCellCount();
+		int firstOutput = cellCount - network.getOutputNodes();
+		buffers.errors.resize(cellCount, count);
+		for (int outputIndex = 0; outputIndex < network.getOutputNodes(); ++outputIndex)
+		{
+			const float *targetValue = buffers.target.getRow(outputIndex);
+			const float *outputValue = buffers.values.getRow(firstOutput + outputIndex);
+			float *outputError = buffers.errors.getRow(firstOutput + outputIndex);
+			for (int batchIndex = 0; batchIndex < count; ++batchIndex)
+			{
+				outputError[batchIndex] = targetValue[batchIndex] - outputValue[batchIndex];
+			}
+		}
+		if (!network.softmaxOutputs.empty())
+		{
+			int outputCount = (int)network.softmaxOutputs.size();
+			std::vector<float> outputErrors(outputCount), outputValues(outputCount);
+			for (int batchIndex = 0; batchIndex < count; ++batchIndex)
+			{
+				for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+				{
+					outputErrors[outputIndex] = buffers.errors.getRow(network.softmaxOutputs[outputIndex])[batchIndex];
+					outputValues[outputIndex] = buffers.values.getRow(network.softmaxOutputs[outputIndex])[batchIndex];
+				}
+				softmaxDeltaSpan(outputErrors.data(), outputErrors.data(), outputValues.data(), outputCount);
+				for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+				{
+					buffers.errors.getRow(network.softmaxOutputs[outputIndex])[batchIndex] = outputErrors[outputIndex];
+				}
+			}
+		}
+
+		//A neuron's error is complete once every later neuron has propagated onto it, so the neurons go in reverse schedule order.
+		const vectorKernels &kernels = getKernels();
+		buffers.delta.resize(count);
+		for (std::vector<neuronPlan>::const_reverse_iterator it = neurons.rbegin(); it != neurons.rend(); ++it)
+		{
+			const float *cellError = buffers.errors.getRow(it->cellIndex);
+			const float *mask = buffers.dropoutMasks.getRow(it->cellIndex);
+			float *delta = buffers.delta.data();
+			if (it->dropRatePercent > 0 && buffers.keptCounts[it->cellIndex] == 0)
+			{
+				std::fill(delta, delta + count, 0.0f);
+			}
+			else
+			{
+				const float *cellValues = it->activation.gradientInTermsOfFunc ? buffers.values.getRow(it->cellIndex) : buffers.rawValues.getRow(it->cellIndex);
+				activationDeltaSpan(it->activation, delta, cellError, cellValues, count);
+				if (it->dropRatePercent > 0)
+				{
+					for (int batchIndex = 0; batchIndex < count; ++batchIndex)
+					{
+						delta[batchIndex] *= mask[batchIndex];
+					}
+				}
+			}
+			float errorSum = it->dropRatePercent > 0 ? kernels.dotProduct(cellError, mask, count) : std::accumulate(cellError, cellError + count, 0.0f);
+
+			//The error is propagated with the weights as they are now, before this thread's own update.
+			buffers.rowWeights.resize(it->rowLength);
+			buffers.gradients.resize(it->rowLength);
+			it->target->getWeightsRelaxed(buffers.rowWeights.data());
+			for (int connection = 0; connection < it->rowLength; ++connection)
+			{
+				if (it->propagateFurther)
+				{
+					kernels.addVectors(buffers.errors.getRow(it->columns[connection]), delta, buffers.rowWeights[connection], count);
+				}
+				buffers.gradients[connection] = kernels.dotProduct(delta, buffers.values.getRow(it->columns[connection]), count);
+			}
+			it->target->updateRelaxed(buffers.gradients.data(), errorSum, count);
+		}
+	}
+
+	void hogwildTrainer::forwardPropagate(workspace &buffers, std::uint64_t step, int count) const
+	{
+		int cellCount = network.getCellCount();
+		buffers.values.resize(cellCount, count);
+		buffers.rawValues.resize(cellCount, count);
+		buffers.dropoutMasks.resize(cellCount, count);
+		buffers.keptCounts.resize(cellCount);
+		for (int inputIndex = 0; inputIndex < network.getInputNodes(); ++inputIndex)
+		{
+			std::copy(buffers.input.getRow(inputIndex), buffers.input.getRow(inputIndex) + count, buffers.values.getRow(inputIndex));
+		}
+
+		const vectorKernels &kernels = getKernels();
+		for (std::vector<neuronPlan>::const_iterator it = neurons.begin(); it != neurons.end(); ++it)
+		{
+			float *cellValues = buffers.values.getRow(it->cellIndex);
+			float *mask = buffers.dropoutMasks.getRow(it->cellIndex);
+			if (it->dropRatePercent > 0)
+			{
+				buffers.keptCounts[it->cellIndex] = buildDropoutMask(network.dropoutSeed, step, it->cellIndex, it->dropRatePercent, count, mask);
+				if (buffers.keptCounts[it->cellIndex] == 0)
+				{
+					continue;
+				}
+			}
+
+			buffers.rowWeights.resize(it->rowLength);
+			std::fill(cellValues, cellValues + count, it->target->getWeightsRelaxed(buffers.rowWeights.data()));
+			for (int connection = 0; connection < it->rowLength; ++connection)
+			{
+				kernels.addVectors(cellValues, buffers.values.getRow(it->columns[connection]), buffers.rowWeights[connection], count);
+			}
+			if (!it->activation.gradientInTermsOfFunc)
+			{
+				std::copy(cellValues, cellValues + count, buffers.rawValues.getRow(it->cellIndex));
+			}
+			activateSpan(it->activation, cellValues, count);
+			if (it->dropRatePercent > 0)
+			{
+				for (int batchIndex = 0; batchIndex < count; ++batchIndex)
+				{
+					cellValues[batchIndex] *= mask[batchIndex];
+				}
+			}
+		}
+
+		if (!network.softmaxOutputs.empty())
+		{
+			int outputCount = (int)network.softmaxOutputs.size();
+			std::vector<float> outputValues(outputCount);
+			for (int batchIndex = 0; batchIndex < count; ++batchIndex)
+			{
+				for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+				{
+					outputValues[outputIndex] = buffers.values.getRow(network.softmaxOutputs[outputIndex])[batchIndex];
+				}
+				softmaxSpan(outputValues.data(), outputCount);
+				for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+				{
+					buffers.values.getRow(network.softmaxOutputs[outputIndex])[batchIndex] = outputValues[outputIndex];
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,95 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the hogwildTrainer class, which trains one network from many threads
+ *at once without any locking between their updates.*/
+
+#ifndef NEURAL_NETWORK_HOGWILD_TRAINER
+#define NEURAL_NETWORK_HOGWILD_TRAINER
+
+#include "activationFunctions.h"
+#include "batchTensor.h"
+#include "dataset.h"
+#include "neuralNetwork.h"
+#include "threadPool.h"
+#include "trainingDriver.h"
+#include<cstdint>
+#include<memory>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	/*Asynchronous training in the style of Hogwild. Each thread takes the next batch of the
+	 *epoch, forward and backward propagates it with its own values and errors, and updates the
+	 *weights and biases of the shared network in place as soon as its gradients are found. The
+	 *weights are read and written with relaxed atomic operations, so a thread may read a mix of
+	 *old and new weights and two threads updating the same weight may lose one of the updates.
+	 *When the gradients are sparse, as with sparse inputs, few updates collide and the threads
+	 *never wait on each other.
+	 *
+	 *The result depends on how the threads interleave, so unlike the other trainers it isn't
+	 *repeatable with more than one thread. With one thread it trains exactly like
+	 *trainingDriver with the same seed.*/
+	class hogwildTrainer
+	{
+	public:
+		/*Creates a trainer for the given network and dataset with the given batch size and
+		 *number of threads. Throws std::out_of_range if either is less than one and
+		 *lists_not_same_length if the samples don't have an input for every input node and a
+		 *target for every output node.*/
+		hogwildTrainer(neuralNetwork&, const datasetReader&, int, int);
+
+		int getBatchSize() const;
+		int getThreadCount() const;
+		/*Trains the network for the given number of epochs, shuffling with the given seed, and
+		 *returns the throughput and the loss of each epoch. The forward, backward and load times
+		 *are summed over the threads. Throws cell_not_neuron if the network has a cell that
+		 *isn't a neuron.*/
+		trainingStats train(int, std::uint64_t);
+
+	private:
+		//What propagating a neuron needs, gathered before training so the threads don't copy it.
+		struct neuronPlan
+		{
+			activationFunctionInfo activation;
+			int cellIndex;
+			const int *columns;
+			float dropRatePercent;
+			neuralNetwork::neuron *target;
+			bool propagateFurther;
+			int rowLength;
+		};
+
+		//The buffers of one thread, kept between batches so they're only reallocated when they grow.
+		struct workspace
+		{
+			std::vector<float> delta;
+			//Dropout mask of each neuron with a drop rate, indexed by cell index.
+			batchTensor dropoutMasks;
+			batchTensor errors;
+			std::vector<float> gradients;
+			batchTensor input;
+			//Number of kept batch elements of each neuron's mask, indexed by cell index.
+			std::vector<int> keptCounts;
+			//Values of the neurons before their activation function, for functions that need them.
+			batchTensor rawValues;
+			//Weights of the neuron being propagated as they were read from the network.
+			std::vector<float> rowWeights;
+			batchTensor target;
+			batchTensor values;
+		};
+
+		/*Backward propagates the batch held by the workspace from the last neuron to the first,
+		 *updating each neuron as soon as it has propagated its error.*/
+		void backwardPropagate(workspace&, int) const;
+		//Forward propagates the input held by the workspace using the given training step for dropout.
+		void forwardPropagate(workspace&, std::uint64_t, int) const;
+
+		int batchSize;
+		const datasetReader &dataset;
+		neuralNetwork &network;
+		//Every neuron of the network in schedule order.
+		std::vector<neuronPlan> neurons;
+		std::unique_ptr<threadPool> pool;
+	};
+}
+
+#endif
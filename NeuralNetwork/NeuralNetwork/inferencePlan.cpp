@@ -0,0 +1,287 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "inferencePlan.h"
+#include "helperFunctions.h"
+#include "matrixFunctions.h"
+#include "neuralNetworkErrors.h"
+#include<algorithm>
+#include<stdexcept>
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+		/*Number of values the 16-bit rows of a reduced precision run are rounded up to, which
+		  keeps every row 64-byte aligned like the rows of a batchTensor.*/
+		const int REDUCED_ROW_ALIGNMENT = 32;
+	}
+
+	inferencePlan::inferencePlan() :cellCount(0), columns(NULL), inputNodes(0), outputNodes(0), precision(floatPrecision), reducedWeights(NULL), weights(NULL)
+	{
+
+	}
+
+	int inferencePlan::getCellCount() const
+	{
+		return cellCount;
+	}
+
+	int inferencePlan::getInputNodes() const
+	{
+		return inputNodes;
+	}
+
+	int inferencePlan::getOutputNodes() const
+	{
+		return outputNodes;
+	}
+
+	storagePrecision inferencePlan::getPrecision() const
+	{
+		return precision;
+	}
+
+	int inferencePlan::getStageCount() const
+	{
+		return (int)stages.size();
+	}
+
+	void inferencePlan::run(const batchTensor &input, batchTensor &output) const
+	{
+		int batchSize = input.getBatchSize();
+		if (input.getRowCount() != inputNodes)
+		{
+			throw lists_not_same_length();
+		}
+		if (batchSize < 1)
+		{
+			throw std::out_of_range("Batch size must be greater then zero.");
+		}
+
+		if (precision != floatPrecision)
+		{
+			runReduced(input, output, batchSize);
+			return;
+		}
+
+		//The plan itself is never written to, so every thread keeps the values of its runs in its own tensor.
+		static thread_local batchTensor values;
+		findValues(input, values);
+
+		int firstOutput = cellCount - outputNodes;
+		output.resize(outputNodes, batchSize);
+		for (int outputIndex = 0; outputIndex < outputNodes; ++outputIndex)
+		{
+			std::copy(values.getRow(firstOutput + outputIndex), values.getRow(firstOutput + outputIndex) + batchSize, output.getRow(outputIndex));
+		}
+	}
+
+	void inferencePlan::applySoftmax(batchTensor &values, int firstRow, int batchSize) const
+	{
+		if (softmaxOutputs.empty())
+		{
+			return;
+		}
+
+		int outputCount = (int)softmaxOutputs.size();
+		std::vector<float> outputValues(outputCount);
+		for (int batchIndex = 0; batchIndex < batchSize; ++batchIndex)
+		{
+			for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+			{
+				outputValues[outputIndex] = values.getRow(softmaxOutputs[outputIndex] - firstRow)[batchIndex];
+			}
+			softmaxSpan(outputValues.data(), outputCount);
+			for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+			{
+				values.getRow(softmaxOutputs[outputIndex] - firstRow)[batchIndex] = outputValues[outputIndex];
+			}
+		}
+	}
+
+	void inferencePlan::findDenseLayout(stagePlan &stage) const
+	{
+		int neuronCount = (int)stage.cellIndexes.size();
+		stage.connectionCount = neuronCount > 0 ? stage.rowLengths[0] : 0;
+		stage.firstConnection = stage.connectionCount > 0 ? columns[stage.rowStarts[0]] : 0;
+		stage.dense = stage.connectionCount > 0;
+
+		//Since the columns of each row are sorted and unique, matching the first and last column means the row is the full range.
+		for (int neuronIndex = 0; neuronIndex < neuronCount && stage.dense; ++neuronIndex)
+		{
+			std::size_t rowStart = stage.rowStarts[neuronIndex];
+			stage.dense = stage.rowLengths[neuronIndex] == stage.connectionCount && stage.cellIndexes[neuronIndex] == stage.cellIndexes[0] + neuronIndex
+				&& rowStart == stage.rowStarts[0] + (std::size_t)neuronIndex * stage.connectionCount && columns[rowStart] == stage.firstConnection
+				&& columns[rowStart + stage.connectionCount - 1] == stage.firstConnection + stage.connectionCount - 1;
+		}
+
+		stage.packed = false;
+		stage.packedWeights.clear();
+		if (stage.dense || precision != floatPrecision || neuronCount == 0)
+		{
+			return;
+		}
+		int firstColumn = cellCount, lastColumn = -1;
+		std::size_t totalConnections = 0;
+		for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+		{
+			int rowLength = stage.rowLengths[neuronIndex];
+			if (stage.cellIndexes[neuronIndex] != stage.cellIndexes[0] + neuronIndex)
+			{
+				return;
+			}
+			if (rowLength > 0)
+			{
+				firstColumn = std::min(firstColumn, columns[stage.rowStarts[neuronIndex]]);
+				lastColumn = std::max(lastColumn, columns[stage.rowStarts[neuronIndex] + rowLength - 1]);
+				totalConnections += rowLength;
+			}
+		}
+		int span = lastColumn - firstColumn + 1;
+		if (lastColumn < firstColumn || totalConnections < PACKED_MATRIX_DENSITY * span * (float)neuronCount)
+		{
+			return;
+		}
+
+		stage.connectionCount = span;
+		stage.firstConnection = firstColumn;
+		stage.packed = true;
+		stage.packedWeights.assign((std::size_t)neuronCount * span, 0.0f);
+		for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+		{
+			float *packedRow = stage.packedWeights.data() + (std::size_t)neuronIndex * span;
+			for (std::size_t i = stage.rowStarts[neuronIndex]; i < stage.rowStarts[neuronIndex] + stage.rowLengths[neuronIndex]; ++i)
+			{
+				packedRow[columns[i] - firstColumn] = weights[i];
+			}
+		}
+	}
+
+	void inferencePlan::findValues(const batchTensor &input, batchTensor &values) const
+	{
+		int batchSize = input.getBatchSize();
+		values.resize(cellCount, batchSize);
+		for (int inputIndex = 0; inputIndex < inputNodes; ++inputIndex)
+		{
+			std::copy(input.getRow(inputIndex), input.getRow(inputIndex) + batchSize, values.getRow(inputIndex));
+		}
+		for (std::vector<stagePlan>::const_iterator it = stages.begin(); it != stages.end(); ++it)
+		{
+			if (it->dense || it->packed)
+			{
+				runDenseStage(*it, values, batchSize);
+			}
+			else
+			{
+				runSparseStage(*it, values, batchSize);
+			}
+		}
+		applySoftmax(values, 0, batchSize);
+	}
+
+	void inferencePlan::runDenseStage(const stagePlan &stage, batchTensor &values, int batchSize) const
+	{
+		int neuronCount = (int)stage.cellIndexes.size();
+		int firstCell = stage.cellIndexes.front();
+		for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+		{
+			std::fill(values.getRow(firstCell + neuronIndex), values.getRow(firstCell + neuronIndex) + batchSize, stage.biases[neuronIndex]);
+		}
+		multiplyMatrices(neuronCount, batchSize, stage.connectionCount, stage.packed ? stage.packedWeights.data() : weights + stage.rowStarts[0], stage.connectionCount,
+			values.getRow(stage.firstConnection), values.getRowStride(), values.getRow(firstCell), values.getRowStride());
+		for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+		{
+			activateSpan(stage.activations[neuronIndex], values.getRow(firstCell + neuronIndex), batchSize);
+		}
+	}
+
+	void inferencePlan::runReduced(const batchTensor &input, batchTensor &output, int batchSize) const
+	{
+		int rowLength = (batchSize + REDUCED_ROW_ALIGNMENT - 1) / REDUCED_ROW_ALIGNMENT * REDUCED_ROW_ALIGNMENT;
+		static thread_local std::vector<std::uint16_t> values;
+		//Each stage is calculated in floats here before being rounded into the values.
+		static thread_local batchTensor stageValues;
+		values.resize((std::size_t)cellCount * rowLength);
+		for (int inputIndex = 0; inputIndex < inputNodes; ++inputIndex)
+		{
+			narrowValues(precision, input.getRow(inputIndex), values.data() + (std::size_t)inputIndex * rowLength, batchSize);
+		}
+
+		int firstOutput = cellCount - outputNodes;
+		output.resize(outputNodes, batchSize);
+		for (std::vector<stagePlan>::const_iterator it = stages.begin(); it != stages.end(); ++it)
+		{
+			int neuronCount = (int)it->cellIndexes.size();
+			stageValues.resize(neuronCount, batchSize);
+			if (it->dense)
+			{
+				runReducedDenseStage(*it, values.data(), rowLength, stageValues, batchSize);
+			}
+			else
+			{
+				runReducedSparseStage(*it, values.data(), rowLength, stageValues, batchSize);
+			}
+
+			for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+			{
+				int cellIndex = it->cellIndexes[neuronIndex];
+				const float *cellValues = stageValues.getRow(neuronIndex);
+				narrowValues(precision, cellValues, values.data() + (std::size_t)cellIndex * rowLength, batchSize);
+				if (cellIndex >= firstOutput)
+				{
+					std::copy(cellValues, cellValues + batchSize, output.getRow(cellIndex - firstOutput));
+				}
+			}
+		}
+
+		applySoftmax(output, firstOutput, batchSize);
+	}
+
+	void inferencePlan::runReducedDenseStage(const stagePlan &stage, const std::uint16_t *values, int rowLength, batchTensor &stageValues, int batchSize) const
+	{
+		int neuronCount = (int)stage.cellIndexes.size();
+		for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+		{
+			std::fill(stageValues.getRow(neuronIndex), stageValues.getRow(neuronIndex) + batchSize, stage.biases[neuronIndex]);
+		}
+		multiplyReducedMatrices(precision, neuronCount, batchSize, stage.connectionCount, reducedWeights + stage.rowStarts[0], stage.connectionCount,
+			values + (std::size_t)stage.firstConnection * rowLength, rowLength, stageValues.getRow(0), stageValues.getRowStride());
+		for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+		{
+			activateSpan(stage.activations[neuronIndex], stageValues.getRow(neuronIndex), batchSize);
+		}
+	}
+
+	void inferencePlan::runReducedSparseStage(const stagePlan &stage, const std::uint16_t *values, int rowLength, batchTensor &stageValues, int batchSize) const
+	{
+		for (int neuronIndex = 0; neuronIndex < (int)stage.cellIndexes.size(); ++neuronIndex)
+		{
+			float *cellValues = stageValues.getRow(neuronIndex);
+			std::fill(cellValues, cellValues + batchSize, stage.biases[neuronIndex]);
+			const int *rowColumns = columns + stage.rowStarts[neuronIndex];
+			const std::uint16_t *rowWeights = reducedWeights + stage.rowStarts[neuronIndex];
+			for (int connection = 0; connection < stage.rowLengths[neuronIndex]; ++connection)
+			{
+				addReducedVectors(precision, cellValues, values + (std::size_t)rowColumns[connection] * rowLength, widenValue(precision, rowWeights[connection]), batchSize);
+			}
+			activateSpan(stage.activations[neuronIndex], cellValues, batchSize);
+		}
+	}
+
+	void inferencePlan::runSparseStage(const stagePlan &stage, batchTensor &values, int batchSize) const
+	{
+		for (int neuronIndex = 0; neuronIndex < (int)stage.cellIndexes.size(); ++neuronIndex)
+		{
+			float *cellValues = values.getRow(stage.cellIndexes[neuronIndex]);
+			std::fill(cellValues, cellValues + batchSize, stage.biases[neuronIndex]);
+			const int *rowColumns = columns + stage.rowStarts[neuronIndex];
+			static thread_local std::vector<const float*> connectedRows;
+			connectedRows.resize(stage.rowLengths[neuronIndex]);
+			for (int connection = 0; connection < stage.rowLengths[neuronIndex]; ++connection)
+			{
+				connectedRows[connection] = values.getRow(rowColumns[connection]);
+			}
+			addWeightedRows(cellValues, connectedRows.data(), weights + stage.rowStarts[neuronIndex], stage.rowLengths[neuronIndex], batchSize);
+			activateSpan(stage.activations[neuronIndex], cellValues, batchSize);
+		}
+	}
+}
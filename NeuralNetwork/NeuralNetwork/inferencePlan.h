@@ -0,0 +1,116 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the inferencePlan class, a frozen copy of a network made by
+ *neuralNetwork::compileForInference() that only holds what forward propagation needs.*/
+
+#ifndef NEURAL_NETWORK_INFERENCE_PLAN
+#define NEURAL_NETWORK_INFERENCE_PLAN
+
+#include "activationFunctions.h"
+#include "batchTensor.h"
+#include "reducedPrecision.h"
+#include<cstddef>
+#include<cstdint>
+#include<memory>
+#include<string>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	class inferencePlan;
+	class neuralNetwork;
+	class quantizedPlan;
+
+	inferencePlan loadInferencePlan(const std::string&);
+
+	/*Immutable forward-only copy of a network. Each stage keeps its weights, biases and
+	 *activation functions in flat arrays with none of the training state of the neurons, and
+	 *dropout is left out. Running the plan doesn't change it, so any number of threads can run
+	 *the same plan at once without locking. The connections are read from arrays that are either
+	 *owned by the plan or a memory mapped model file, and copies of a plan share them.
+ *
+ *A plan compiled with a 16-bit precision stores its weights and the values passed between its
+ *stages in that precision, which halves the memory read by each stage. Each stage widens what it
+ *reads back to floats and sums in single precision, and the output nodes are given to the caller
+ *as they were calculated before being rounded.*/
+	class inferencePlan
+	{
+	public:
+		//Creates an empty plan with no input or output nodes.
+		inferencePlan();
+
+		//Returns the number of cell indexes in the plan including the input nodes.
+		int getCellCount() const;
+		int getInputNodes() const;
+		int getOutputNodes() const;
+		storagePrecision getPrecision() const;
+		int getStageCount() const;
+		/*Runs a batch through the plan and stores the values of the output nodes in the output
+		 *tensor. The input tensor has a row for each input node. Each thread uses its own
+		 *workspace, so it's safe to call from many threads at once.*/
+		void run(const batchTensor&, batchTensor&) const;
+
+	private:
+		friend class neuralNetwork;
+		friend class quantizedPlan;
+		friend inferencePlan loadInferencePlan(const std::string&);
+
+		/*The neurons of one stage, whose connections are the rowLengths entries of the arrays
+		 *starting at each of the rowStarts. A dense stage has consecutive cells with their rows
+		 *stored back to back that all connect to the connectionCount cells starting at
+		 *firstConnection, so its weights are a row major matrix. A packed stage of a float plan
+		 *has consecutive cells whose connections fill at least PACKED_MATRIX_DENSITY of that
+		 *range, so it's run as a dense stage with a copy of its weights that has zeros for the
+		 *missing connections.*/
+		struct stagePlan
+		{
+			std::vector<activationFunctionInfo> activations;
+			std::vector<float> biases;
+			std::vector<int> cellIndexes;
+			int connectionCount;
+			bool dense;
+			int firstConnection;
+			bool packed;
+			std::vector<float> packedWeights;
+			std::vector<int> rowLengths;
+			std::vector<std::size_t> rowStarts;
+		};
+
+		//Applies softmax across the softmax outputs, which are the rows of the tensor starting from the given cell index.
+		void applySoftmax(batchTensor&, int, int) const;
+		/*Sets whether the stage is dense or packed and if so, the range of cells it connects to
+		 *along with the weight matrix of a packed stage.*/
+		void findDenseLayout(stagePlan&) const;
+		/*Runs a batch through the plan with floats and leaves the value of every cell in the
+		 *given tensor.*/
+		void findValues(const batchTensor&, batchTensor&) const;
+		//Runs the neurons of a dense or packed stage as one matrix multiplication.
+		void runDenseStage(const stagePlan&, batchTensor&, int) const;
+		/*Runs the plan with 16-bit weights and values. The values of every cell are kept in rows
+		 *of the given length.*/
+		void runReduced(const batchTensor&, batchTensor&, int) const;
+		/*Same as runDenseStage() reading 16-bit weights and values from rows of the given
+		 *length. The results are stored as floats in the rows of the stage's tensor.*/
+		void runReducedDenseStage(const stagePlan&, const std::uint16_t*, int, batchTensor&, int) const;
+		//Same as runSparseStage() reading 16-bit weights and values into the stage's tensor.
+		void runReducedSparseStage(const stagePlan&, const std::uint16_t*, int, batchTensor&, int) const;
+		//Runs the neurons of any other stage one at a time.
+		void runSparseStage(const stagePlan&, batchTensor&, int) const;
+
+		int cellCount;
+		//Column index and weight of every connection of the plan.
+		const int *columns;
+		int inputNodes;
+		int outputNodes;
+		storagePrecision precision;
+		//Weight of every connection of a plan with a 16-bit precision, which has no float weights.
+		const std::uint16_t *reducedWeights;
+		//Cell indexes of the output nodes that use softmax.
+		std::vector<int> softmaxOutputs;
+		std::vector<stagePlan> stages;
+		//Whatever owns the memory of the columns and weights.
+		std::shared_ptr<const void> storage;
+		const float *weights;
+	};
+}
+
+#endif
@@ -0,0 +1,105 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "mappedFile.h"
+#include<stdexcept>
+#ifdef _WIN32
+//Keeps windows.h from defining min and max, which would break std::min and std::max in any file included after this one.
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
+
+namespace NeuralNetwork
+{
+	mappedFile::mappedFile(const std::string &fileName) :data(NULL), size(0)
+	{
+#ifdef _WIN32
+		fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		mappingHandle = NULL;
+		LARGE_INTEGER fileSize;
+		if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &fileSize))
+		{
+			if (fileHandle != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(fileHandle);
+			}
+			throw std::runtime_error("Couldn't open the file for mapping.");
+		}
+		size = (std::size_t)fileSize.QuadPart;
+		if (size > 0)
+		{
+			mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+			data = mappingHandle ? static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0)) : NULL;
+			if (!data)
+			{
+				if (mappingHandle)
+				{
+					CloseHandle(mappingHandle);
+				}
+				CloseHandle(fileHandle);
+				throw std::runtime_error("Couldn't map the file.");
+			}
+		}
+#else
+		int descriptor = open(fileName.c_str(), O_RDONLY);
+		struct stat fileStatus;
+		if (descriptor < 0 || fstat(descriptor, &fileStatus) != 0)
+		{
+			if (descriptor >= 0)
+			{
+				close(descriptor);
+			}
+			throw std::runtime_error("Couldn't open the file for mapping.");
+		}
+		size = (std::size_t)fileStatus.st_size;
+
+		//The mapping keeps the file alive on its own, so the descriptor is closed right away.
+		if (size > 0)
+		{
+			void *mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, descriptor, 0);
+			if (mapping == MAP_FAILED)
+			{
+				close(descriptor);
+				throw std::runtime_error("Couldn't map the file.");
+			}
+			data = static_cast<const char*>(mapping);
+		}
+		close(descriptor);
+#endif
+	}
+
+	mappedFile::~mappedFile()
+	{
+#ifdef _WIN32
+		if (data)
+		{
+			UnmapViewOfFile(data);
+			CloseHandle(mappingHandle);
+		}
+		CloseHandle(fileHandle);
+#else
+		if (data)
+		{
+			munmap(const_cast<char*>(data), size);
+		}
+#endif
+	}
+
+	const char* mappedFile::getData() const
+	{
+		return data;
+	}
+
+	std::size_t mappedFile::getSize() const
+	{
+		return size;
+	}
+}
@@ -0,0 +1,36 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the mappedFile class, which memory maps a file so model and dataset
+ *files can be read in place and share the page cache between processes.*/
+
+#ifndef NEURAL_NETWORK_MAPPED_FILE
+#define NEURAL_NETWORK_MAPPED_FILE
+
+#include<cstddef>
+#include<string>
+
+namespace NeuralNetwork
+{
+	//Read-only memory mapping of a whole file, which is unmapped when the object is destroyed.
+	class mappedFile
+	{
+	public:
+		//Maps the file with the given name. Throws std::runtime_error if it can't be opened or mapped.
+		explicit mappedFile(const std::string&);
+		mappedFile(const mappedFile&) = delete;
+		~mappedFile();
+		mappedFile& operator=(const mappedFile&) = delete;
+
+		const char* getData() const;
+		std::size_t getSize() const;
+
+	private:
+		const char *data;
+#ifdef _WIN32
+		void *fileHandle;
+		void *mappingHandle;
+#endif
+		std::size_t size;
+	};
+}
+
+#endif
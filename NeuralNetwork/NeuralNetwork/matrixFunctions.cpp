@@ -0,0 +1,169 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "matrixFunctions.h"
+#include "vectorKernels.h"
+#include<algorithm>
+#include<cstddef>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+		//Size of the register tile each call of the multiplyTile kernel calculates.
+		const int TILE_ROWS = KERNEL_TILE_ROWS;
+		const int TILE_COLUMNS = KERNEL_TILE_COLUMNS;
+		//Size of the blocks of the matrices that are kept in cache while they're reused.
+		const int BLOCK_DEPTH = 256;
+		const int BLOCK_ROWS = 64;
+		const int BLOCK_COLUMNS = 512;
+
+		/*Calculates the partial tiles on the edges of C, which the multiplyTile kernel can't
+		  handle.*/
+		void multiplyEdgeTile(int tileRows, int tileColumns, int depth, const float *a, int aRowStep, int aDepthStep, const float *packedB, float *c, int cStride)
+		{
+			float accumulator[TILE_ROWS][TILE_COLUMNS] = {};
+			for (int p = 0; p < depth; ++p, a += aDepthStep, packedB += TILE_COLUMNS)
+			{
+				for (int i = 0; i < tileRows; ++i)
+				{
+					const float aValue = a[i * aRowStep];
+					for (int j = 0; j < TILE_COLUMNS; ++j)
+					{
+						accumulator[i][j] += aValue * packedB[j];
+					}
+				}
+			}
+			for (int i = 0; i < tileRows; ++i)
+			{
+				for (int j = 0; j < tileColumns; ++j)
+				{
+					c[i * cStride + j] += accumulator[i][j];
+				}
+			}
+		}
+
+		//Float blocks of A are read where they are.
+		const float* loadBlockA(storagePrecision, int, int, const float *a, int&, int&)
+		{
+			return a;
+		}
+
+		/*16-bit blocks of A are widened into a buffer the size of the largest block, which is
+		  only done once for all of the columns of the block. The rows of A have to be
+		  contiguous.*/
+		const float* loadBlockA(storagePrecision precision, int blockRows, int blockDepth, const std::uint16_t *a, int &aRowStep, int &aDepthStep)
+		{
+			static thread_local std::vector<float> widenedA;
+			widenedA.resize((std::size_t)BLOCK_ROWS * BLOCK_DEPTH);
+			for (int i = 0; i < blockRows; ++i)
+			{
+				widenValues(precision, a + (std::size_t)i * aRowStep, widenedA.data() + (std::size_t)i * blockDepth, blockDepth);
+			}
+			aRowStep = blockDepth;
+			aDepthStep = 1;
+			return widenedA.data();
+		}
+
+		void packRowB(storagePrecision, const float *bRow, int bColumnStep, int panelColumns, float *packedRow)
+		{
+			for (int j = 0; j < panelColumns; ++j)
+			{
+				packedRow[j] = bRow[j * bColumnStep];
+			}
+		}
+
+		//The columns of 16-bit rows of B have to be contiguous, so they're widened straight into the panel.
+		void packRowB(storagePrecision precision, const std::uint16_t *bRow, int, int panelColumns, float *packedRow)
+		{
+			widenValues(precision, bRow, packedRow, panelColumns);
+		}
+
+		/*Blocked multiplication shared by every public function. B is read through the element
+		  getter (p, j) -> b[p * bDepthStep + j * bColumnStep] and packed into panels of
+		  TILE_COLUMNS columns so the multiplyTile kernel reads it contiguously and each panel is
+		  reused for every row of the block. 16-bit matrices are widened to floats as they're
+		  packed, so the kernels and the sums are the same as for float matrices.*/
+		template<typename element>
+		void blockedMultiply(storagePrecision precision, int rows, int columns, int depth, const element *a, int aRowStep, int aDepthStep, const element *b, int bDepthStep, int bColumnStep, float *c, int cStride)
+		{
+			if (rows <= 0 || columns <= 0 || depth <= 0)
+			{
+				return;
+			}
+
+			const vectorKernels &kernels = getKernels();
+			//The packed panels are kept between calls so they are only reallocated when they grow.
+			static thread_local std::vector<float> packedB;
+			packedB.resize((std::size_t)BLOCK_DEPTH * (BLOCK_COLUMNS + TILE_COLUMNS));
+
+			for (int depthStart = 0; depthStart < depth; depthStart += BLOCK_DEPTH)
+			{
+				int blockDepth = std::min(BLOCK_DEPTH, depth - depthStart);
+				for (int columnStart = 0; columnStart < columns; columnStart += BLOCK_COLUMNS)
+				{
+					int blockColumns = std::min(BLOCK_COLUMNS, columns - columnStart);
+
+					//Packs each panel of the block of B with zeros past the last column.
+					for (int panel = 0; panel < blockColumns; panel += TILE_COLUMNS)
+					{
+						float *panelStart = packedB.data() + (std::size_t)panel * blockDepth;
+						int panelColumns = std::min(TILE_COLUMNS, blockColumns - panel);
+						for (int p = 0; p < blockDepth; ++p)
+						{
+							const element *bRow = b + (std::size_t)(depthStart + p) * bDepthStep + (std::size_t)(columnStart + panel) * bColumnStep;
+							float *packedRow = panelStart + (std::size_t)p * TILE_COLUMNS;
+							packRowB(precision, bRow, bColumnStep, panelColumns, packedRow);
+							std::fill(packedRow + panelColumns, packedRow + TILE_COLUMNS, 0.0f);
+						}
+					}
+
+					for (int rowStart = 0; rowStart < rows; rowStart += BLOCK_ROWS)
+					{
+						int blockRows = std::min(BLOCK_ROWS, rows - rowStart);
+						int blockRowStep = aRowStep, blockDepthStep = aDepthStep;
+						const float *blockA = loadBlockA(precision, blockRows, blockDepth, a + (std::size_t)rowStart * aRowStep + (std::size_t)depthStart * aDepthStep, blockRowStep, blockDepthStep);
+						for (int panel = 0; panel < blockColumns; panel += TILE_COLUMNS)
+						{
+							const float *panelStart = packedB.data() + (std::size_t)panel * blockDepth;
+							int panelColumns = std::min(TILE_COLUMNS, blockColumns - panel);
+							for (int i = 0; i < blockRows; i += TILE_ROWS)
+							{
+								const float *aStart = blockA + (std::size_t)i * blockRowStep;
+								float *cStart = c + (std::size_t)(rowStart + i) * cStride + columnStart + panel;
+								int tileRows = std::min(TILE_ROWS, blockRows - i);
+								if (tileRows == TILE_ROWS && panelColumns == TILE_COLUMNS)
+								{
+									kernels.multiplyTile(blockDepth, aStart, blockRowStep, blockDepthStep, panelStart, cStart, cStride);
+								}
+								else
+								{
+									multiplyEdgeTile(tileRows, panelColumns, blockDepth, aStart, blockRowStep, blockDepthStep, panelStart, cStart, cStride);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void multiplyMatrices(int rows, int columns, int depth, const float *a, int aStride, const float *b, int bStride, float *c, int cStride)
+	{
+		blockedMultiply(floatPrecision, rows, columns, depth, a, aStride, 1, b, bStride, 1, c, cStride);
+	}
+
+	void multiplyMatricesTransposedB(int rows, int columns, int depth, const float *a, int aStride, const float *b, int bStride, float *c, int cStride)
+	{
+		blockedMultiply(floatPrecision, rows, columns, depth, a, aStride, 1, b, 1, bStride, c, cStride);
+	}
+
+	void multiplyMatricesTransposedA(int rows, int columns, int depth, const float *a, int aStride, const float *b, int bStride, float *c, int cStride)
+	{
+		blockedMultiply(floatPrecision, rows, columns, depth, a, 1, aStride, b, bStride, 1, c, cStride);
+	}
+
+	void multiplyReducedMatrices(storagePrecision precision, int rows, int columns, int depth, const std::uint16_t *a, int aStride, const std::uint16_t *b, int bStride, float *c, int cStride)
+	{
+		blockedMultiply(precision, rows, columns, depth, a, aStride, 1, b, bStride, 1, c, cStride);
+	}
+}
@@ -0,0 +1,36 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the cache-blocked matrix multiplication functions used to run whole stages of fully
+ *connected neurons at once. Every matrix is stored row major with the given distance in floats
+ *between the start of each row, and every function adds the product to the output matrix.*/
+
+#ifndef NEURAL_NETWORK_MATRIX_FUNCTIONS
+#define NEURAL_NETWORK_MATRIX_FUNCTIONS
+
+#include "reducedPrecision.h"
+#include<cstdint>
+
+namespace NeuralNetwork
+{
+	/*Fraction of a matrix of weights that has to be connections for multiplying it with zeros in
+	 *place of the missing connections to be faster than adding the row of values of each
+	 *connection on its own.*/
+	const float PACKED_MATRIX_DENSITY = 0.3f;
+
+	/*Adds A * B to C where A is rows x depth, B is depth x columns and C is rows x columns.*/
+	void multiplyMatrices(int rows, int columns, int depth, const float *a, int aStride, const float *b, int bStride, float *c, int cStride);
+
+	/*Adds A * B^T to C where A is rows x depth, B is stored as columns x depth and C is rows x
+	 *columns.*/
+	void multiplyMatricesTransposedB(int rows, int columns, int depth, const float *a, int aStride, const float *b, int bStride, float *c, int cStride);
+
+	/*Adds A^T * B to C where A is stored as depth x rows, B is depth x columns and C is rows x
+	 *columns.*/
+	void multiplyMatricesTransposedA(int rows, int columns, int depth, const float *a, int aStride, const float *b, int bStride, float *c, int cStride);
+
+	/*Adds A * B to C the same way as multiplyMatrices() where A and B are stored with the given
+	 *16-bit precision. They're widened a block at a time as they're read, so the products are
+	 *summed in single precision.*/
+	void multiplyReducedMatrices(storagePrecision precision, int rows, int columns, int depth, const std::uint16_t *a, int aStride, const std::uint16_t *b, int bStride, float *c, int cStride);
+}
+
+#endif
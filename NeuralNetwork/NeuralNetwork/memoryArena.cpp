@@ -0,0 +1,71 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "memoryArena.h"
+#include "helperFunctions.h"
+#include<algorithm>
+#include<functional>
+#include<new>
+
+namespace NeuralNetwork
+{
+	memoryArena::memoryArena(std::size_t newFirstChunkSize) :allocatedBytes(0), firstChunkSize(std::max(newFirstChunkSize, MEMORY_ARENA_ALIGNMENT)), used(0)
+	{
+
+	}
+
+	memoryArena::~memoryArena()
+	{
+		release();
+	}
+
+	void* memoryArena::allocate(std::size_t size, std::size_t alignment)
+	{
+		if (alignment == 0 || alignment > MEMORY_ARENA_ALIGNMENT || (alignment & (alignment - 1)) != 0)
+		{
+			throw std::bad_alloc();
+		}
+
+		std::size_t start = (used + alignment - 1) & ~(alignment - 1);
+		if (chunks.empty() || start + size > chunks.back().size)
+		{
+			//The new chunk is at least big enough for the allocation on its own.
+			chunk newChunk;
+			newChunk.size = std::max(chunks.empty() ? firstChunkSize : chunks.back().size * 2, size);
+			newChunk.data = static_cast<char*>(allocateAligned(newChunk.size, MEMORY_ARENA_ALIGNMENT));
+			chunks.push_back(newChunk);
+			start = 0;
+		}
+		used = start + size;
+		allocatedBytes += size;
+		return chunks.back().data + start;
+	}
+
+	std::size_t memoryArena::getAllocatedBytes() const
+	{
+		return allocatedBytes;
+	}
+
+	//std::less gives a total order over pointers into different chunks.
+	bool memoryArena::owns(const void *ptr) const
+	{
+		const char *address = static_cast<const char*>(ptr);
+		for (std::vector<chunk>::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
+		{
+			if (!std::less<const char*>()(address, it->data) && std::less<const char*>()(address, it->data + it->size))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void memoryArena::release()
+	{
+		for (std::vector<chunk>::iterator it = chunks.begin(); it != chunks.end(); ++it)
+		{
+			freeAligned(it->data);
+		}
+		chunks.clear();
+		allocatedBytes = 0;
+		used = 0;
+	}
+}
@@ -0,0 +1,56 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the memoryArena class, which hands out memory from a few large
+ *chunks that are all freed at once.*/
+
+#ifndef NEURAL_NETWORK_MEMORY_ARENA
+#define NEURAL_NETWORK_MEMORY_ARENA
+
+#include<cstddef>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	//Alignment every chunk of a memoryArena starts on.
+	const std::size_t MEMORY_ARENA_ALIGNMENT = 64;
+
+	/*Bump allocator that carves allocations out of chunks allocated with allocateAligned(). Each
+	 *new chunk is twice the size of the last one, so an arena holding n bytes only has about
+	 *log(n) chunks. Nothing is freed until the arena is released or destroyed, which frees every
+	 *chunk without running any destructors, so the objects placed in it have to be destroyed by
+	 *whoever created them first.*/
+	class memoryArena
+	{
+	public:
+		//Creates an empty arena whose first chunk will be the given number of bytes.
+		explicit memoryArena(std::size_t);
+		memoryArena(const memoryArena&) = delete;
+		~memoryArena();
+		memoryArena& operator=(const memoryArena&) = delete;
+
+		/*Returns memory for the given number of bytes starting on a multiple of the alignment,
+		 *which must be a power of two no larger than MEMORY_ARENA_ALIGNMENT. Throws
+		 *std::bad_alloc if a new chunk can't be allocated.*/
+		void* allocate(std::size_t, std::size_t);
+		//Returns the number of bytes handed out since the arena was created or released.
+		std::size_t getAllocatedBytes() const;
+		//Returns whether the pointer is inside one of the arena's chunks.
+		bool owns(const void*) const;
+		//Frees every chunk, leaving the arena empty.
+		void release();
+
+	private:
+		struct chunk
+		{
+			char *data;
+			std::size_t size;
+		};
+
+		std::size_t allocatedBytes;
+		std::vector<chunk> chunks;
+		std::size_t firstChunkSize;
+		//How far into the last chunk the next allocation can start.
+		std::size_t used;
+	};
+}
+
+#endif
@@ -0,0 +1,111 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "modelFile.h"
+#include "neuralNetworkErrors.h"
+#include<cstring>
+#include<stdexcept>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+		//Returns whether the array of the given number of elements starting at the offset fits in the file.
+		bool arrayFits(std::uint64_t offset, std::uint64_t count, std::uint64_t elementSize, std::size_t fileSize)
+		{
+			return offset % MODEL_FILE_ALIGNMENT == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+		}
+	}
+
+	std::uint64_t alignModelOffset(std::uint64_t offset)
+	{
+		return (offset + MODEL_FILE_ALIGNMENT - 1) / MODEL_FILE_ALIGNMENT * MODEL_FILE_ALIGNMENT;
+	}
+
+	inferencePlan loadInferencePlan(const std::string &fileName)
+	{
+		std::shared_ptr<mappedFile> file = std::make_shared<mappedFile>(fileName);
+		validateModelFile(*file);
+		const modelFileHeader *header = reinterpret_cast<const modelFileHeader*>(file->getData());
+		const modelFileNeuron *records = reinterpret_cast<const modelFileNeuron*>(file->getData() + sizeof(modelFileHeader));
+
+		inferencePlan plan;
+		plan.cellCount = header->inputNodes + header->neuronCount;
+		plan.columns = reinterpret_cast<const int*>(file->getData() + header->columnsOffset);
+		plan.inputNodes = header->inputNodes;
+		plan.outputNodes = header->outputNodes;
+		plan.weights = reinterpret_cast<const float*>(file->getData() + header->weightsOffset);
+		plan.storage = file;
+
+		//The neurons are stored in cell index order, which is also the order they're in within each stage.
+		std::vector<inferencePlan::stagePlan> stages(header->stageCount);
+		for (int neuronIndex = 0; neuronIndex < header->neuronCount; ++neuronIndex)
+		{
+			const modelFileNeuron &record = records[neuronIndex];
+			inferencePlan::stagePlan &stage = stages[record.stage];
+			activationFunctionInfo actFunc = buildActFuncBundle((activationFunctionType)record.activationType);
+			actFunc.fastApproximation = (record.flags & modelNeuronFastActivation) != 0;
+			stage.activations.push_back(actFunc);
+			stage.biases.push_back(record.bias);
+			stage.cellIndexes.push_back(header->inputNodes + neuronIndex);
+			stage.rowLengths.push_back(record.connectionCount);
+			stage.rowStarts.push_back((std::size_t)record.firstConnection);
+			if (actFunc.type == softmaxFunction)
+			{
+				plan.softmaxOutputs.push_back(header->inputNodes + neuronIndex);
+			}
+		}
+		for (std::vector<inferencePlan::stagePlan>::iterator it = stages.begin(); it != stages.end(); ++it)
+		{
+			if (!it->cellIndexes.empty())
+			{
+				plan.findDenseLayout(*it);
+				plan.stages.push_back(*it);
+			}
+		}
+		return plan;
+	}
+
+	void validateModelFile(const mappedFile &file)
+	{
+		if (file.getSize() < sizeof(modelFileHeader))
+		{
+			throw model_file_not_valid();
+		}
+		const modelFileHeader *header = reinterpret_cast<const modelFileHeader*>(file.getData());
+		if (std::memcmp(header->magic, "NNMODEL", 8) != 0 || header->version != MODEL_FILE_VERSION || header->inputNodes < 0 || header->outputNodes < 0
+			|| header->neuronCount < 0 || header->stageCount < 0 || header->outputNodes > header->neuronCount
+			|| (std::uint64_t)header->neuronCount > (file.getSize() - sizeof(modelFileHeader)) / sizeof(modelFileNeuron)
+			|| !arrayFits(header->columnsOffset, header->connectionCount, sizeof(std::int32_t), file.getSize())
+			|| !arrayFits(header->weightsOffset, header->connectionCount, sizeof(float), file.getSize())
+			|| ((header->flags & modelHasOptimizerState) && !arrayFits(header->previousWeightChangesOffset, header->connectionCount, sizeof(float), file.getSize())))
+		{
+			throw model_file_not_valid();
+		}
+
+		//Each connection has to be to an input node or a cell in an earlier stage, which also keeps propagation inside the tensor.
+		const modelFileNeuron *records = reinterpret_cast<const modelFileNeuron*>(file.getData() + sizeof(modelFileHeader));
+		const std::int32_t *columns = reinterpret_cast<const std::int32_t*>(file.getData() + header->columnsOffset);
+		for (int neuronIndex = 0; neuronIndex < header->neuronCount; ++neuronIndex)
+		{
+			const modelFileNeuron &record = records[neuronIndex];
+			if (record.stage < 0 || record.stage >= header->stageCount || record.connectionCount < 0 || record.firstConnection > header->connectionCount
+				|| (std::uint64_t)record.connectionCount > header->connectionCount - record.firstConnection
+				|| record.activationType <= customFunction || record.activationType > softmaxFunction
+				|| (record.activationType == softmaxFunction && neuronIndex < header->neuronCount - header->outputNodes)
+				|| !(record.dropRatePercent >= 0.0f && record.dropRatePercent <= 1.0f))
+			{
+				throw model_file_not_valid();
+			}
+			const std::int32_t *rowColumns = columns + record.firstConnection;
+			for (int connection = 0; connection < record.connectionCount; ++connection)
+			{
+				int column = rowColumns[connection];
+				if (column < 0 || (connection > 0 && column <= rowColumns[connection - 1]) || column >= header->inputNodes + header->neuronCount
+					|| (column >= header->inputNodes && records[column - header->inputNodes].stage >= record.stage))
+				{
+					throw model_file_not_valid();
+				}
+			}
+		}
+	}
+}
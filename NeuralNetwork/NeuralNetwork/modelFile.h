@@ -0,0 +1,88 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the layout of the binary model files written by neuralNetwork::save() along with the
+ *functions that read them in place through a mappedFile. A model file is a header, a record for
+ *every neuron in cell index order and then the column indexes, weights and optionally the
+ *previous weight changes of every connection as flat arrays. Each array starts on a
+ *MODEL_FILE_ALIGNMENT boundary, so once the file is memory mapped the weights can be used where
+ *they are. Values are stored in the byte order of the machine that saved the file.*/
+
+#ifndef NEURAL_NETWORK_MODEL_FILE
+#define NEURAL_NETWORK_MODEL_FILE
+
+#include "inferencePlan.h"
+#include "mappedFile.h"
+#include<cstddef>
+#include<cstdint>
+#include<string>
+
+namespace NeuralNetwork
+{
+	//Alignment in bytes of the start of each array in a model file.
+	static const int MODEL_FILE_ALIGNMENT = 64;
+	//Version of the model file format, increased whenever the layout changes.
+	static const std::uint32_t MODEL_FILE_VERSION = 1;
+
+	enum modelFileFlags
+	{
+		//Set when the file has the previous weight changes and training step.
+		modelHasOptimizerState = 1
+	};
+
+	enum modelNeuronFlags
+	{
+		modelNeuronPropagateFurther = 1, modelNeuronFastActivation = 2
+	};
+
+	/*Start of every model file. The offsets are in bytes from the start of the file and the
+	 *previous weight changes offset is zero when the file doesn't have optimizer state.*/
+	struct modelFileHeader
+	{
+		//The characters "NNMODEL" followed by a zero.
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t flags;
+		std::int32_t inputNodes;
+		std::int32_t outputNodes;
+		std::int32_t neuronCount;
+		std::int32_t stageCount;
+		std::uint64_t connectionCount;
+		std::uint64_t columnsOffset;
+		std::uint64_t weightsOffset;
+		std::uint64_t previousWeightChangesOffset;
+		std::uint64_t dropoutSeed;
+		std::uint64_t trainingStep;
+		//Kept at zero for fields added by later versions.
+		std::uint8_t reserved[48];
+	};
+
+	/*Everything about a neuron except its connections, which are the connectionCount entries of
+	 *the arrays starting at firstConnection.*/
+	struct modelFileNeuron
+	{
+		std::uint64_t firstConnection;
+		std::int32_t connectionCount;
+		std::int32_t stage;
+		std::int32_t activationType;
+		std::uint32_t flags;
+		float bias;
+		float dropRatePercent;
+		float learningRate;
+		float momentum;
+		float previousBiasChange;
+		float weightDecay;
+	};
+
+	//Rounds an offset up to the next MODEL_FILE_ALIGNMENT boundary.
+	std::uint64_t alignModelOffset(std::uint64_t);
+	/*Maps a model file and builds an inference plan that uses its column indexes and weights in
+	 *place, so nothing proportional to the number of connections is copied and every process
+	 *loading the same file shares its pages. The plan keeps the file mapped for as long as any
+	 *copy of it exists. Throws model_file_not_valid if the file isn't a valid model file.*/
+	inferencePlan loadInferencePlan(const std::string&);
+	/*Checks that a mapped file is a model file of this version whose arrays fit in the file and
+	 *whose connections are sorted and only to input nodes or cells in earlier stages. Throws
+	 *model_file_not_valid otherwise.*/
+	void validateModelFile(const mappedFile&);
+}
+
+#endif
@@ -0,0 +1,228 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the modelHandle class template, which lets serving threads keep running batches on a
+ *model while a newly trained one is swapped in.*/
+
+#ifndef NEURAL_NETWORK_MODEL_HANDLE
+#define NEURAL_NETWORK_MODEL_HANDLE
+
+#include<atomic>
+#include<cstdint>
+#include<list>
+#include<memory>
+#include<mutex>
+#include<stdexcept>
+#include<utility>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	/*Versioned handle to the model being served, usually an inferencePlan or quantizedPlan, which
+	 *can be replaced while other threads are running batches on it. Each published model is
+	 *given the next version number starting from one.
+	 *
+	 *Serving threads each create a reader and call acquire() at the start of a batch and
+	 *release() at the end of it. Acquiring stamps the reader's slot with the current version and
+	 *then loads the current model, so it's a few atomic loads and stores with no lock and no
+	 *reference count shared between the threads. Publishing swaps the new model in and retires
+	 *the old one, which is only destroyed once every reader is either idle or stamped with a
+	 *later version, so a batch started on the old model finishes on it. Retired models are
+	 *destroyed by the next publish() or reclaim().
+	 *
+	 *Publishing and creating or destroying readers take a lock, so only the request path is
+	 *lock free. Every reader has to be destroyed before the handle.*/
+	template<typename modelType>
+	class modelHandle
+	{
+	private:
+		struct snapshot;
+		struct readerSlot;
+
+	public:
+		/*Reads the handle from one serving thread. The model returned by acquire() stays alive
+		 *until the reader is released, acquires again or is destroyed.*/
+		class reader
+		{
+		public:
+			explicit reader(modelHandle &newHandle) :acquired(NULL), handle(newHandle), slot(&newHandle.addSlot())
+			{
+
+			}
+
+			reader(const reader&) = delete;
+
+			~reader()
+			{
+				release();
+				handle.removeSlot(*slot);
+			}
+
+			reader& operator=(const reader&) = delete;
+
+			const modelType& acquire()
+			{
+				slot->version.store(handle.version.load());
+				acquired = handle.current.load();
+				return *acquired->model;
+			}
+
+			//Returns the version of the acquired model or zero if nothing is acquired.
+			std::uint64_t getVersion() const
+			{
+				return acquired == NULL ? 0 : acquired->version;
+			}
+
+			void release()
+			{
+				acquired = NULL;
+				slot->version.store(0);
+			}
+
+		private:
+			const snapshot *acquired;
+			modelHandle &handle;
+			readerSlot *slot;
+		};
+
+		//Creates a handle serving the given model as version one. Throws std::invalid_argument if there's no model.
+		explicit modelHandle(std::shared_ptr<const modelType> model) :current(NULL), version(1)
+		{
+			if (!model)
+			{
+				throw std::invalid_argument("A model handle needs a model to serve.");
+			}
+			current.store(new snapshot(std::move(model), 1));
+		}
+
+		modelHandle(const modelHandle&) = delete;
+
+		~modelHandle()
+		{
+			for (typename std::vector<std::pair<snapshot*, std::uint64_t>>::iterator it = retired.begin(); it != retired.end(); ++it)
+			{
+				delete it->first;
+			}
+			delete current.load();
+		}
+
+		modelHandle& operator=(const modelHandle&) = delete;
+
+		/*Returns a reference to the current model for code that isn't serving batches. It keeps
+		 *the model alive however long it's held, but takes the lock.*/
+		std::shared_ptr<const modelType> get() const
+		{
+			std::lock_guard<std::mutex> lock(publishLock);
+			return current.load()->model;
+		}
+
+		std::uint64_t getVersion() const
+		{
+			return version.load();
+		}
+
+		/*Replaces the model readers acquire from now on and returns its version. Throws
+		 *std::invalid_argument if there's no model.*/
+		std::uint64_t publish(std::shared_ptr<const modelType> model)
+		{
+			if (!model)
+			{
+				throw std::invalid_argument("A model handle needs a model to serve.");
+			}
+			std::lock_guard<std::mutex> lock(publishLock);
+			std::uint64_t newVersion = version.load() + 1;
+
+			//The model is swapped in before the version is raised, so a reader stamped with the new version can only load the new model.
+			snapshot *old = current.exchange(new snapshot(std::move(model), newVersion));
+			version.store(newVersion);
+			retired.push_back(std::make_pair(old, newVersion));
+			reclaimRetired();
+			return newVersion;
+		}
+
+		//Destroys the retired models no reader can still be using and returns how many are left.
+		int reclaim()
+		{
+			std::lock_guard<std::mutex> lock(publishLock);
+			reclaimRetired();
+			return (int)retired.size();
+		}
+
+	private:
+		struct snapshot
+		{
+			snapshot(std::shared_ptr<const modelType> &&newModel, std::uint64_t newVersion) :model(std::move(newModel)), version(newVersion)
+			{
+
+			}
+
+			std::shared_ptr<const modelType> model;
+			std::uint64_t version;
+		};
+
+		//The version a reader acquired, or zero while it's idle, padded so each reader has its own cache line.
+		struct readerSlot
+		{
+			std::atomic<std::uint64_t> version;
+			char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+		};
+
+		readerSlot& addSlot()
+		{
+			std::lock_guard<std::mutex> lock(publishLock);
+			slots.emplace_back();
+			slots.back().version.store(0);
+			return slots.back();
+		}
+
+		/*Destroys every retired model whose replacement's version every busy reader is stamped
+		 *with. The lock is expected to be held.*/
+		void reclaimRetired()
+		{
+			std::uint64_t oldestVersion = UINT64_MAX;
+			for (typename std::list<readerSlot>::const_iterator it = slots.begin(); it != slots.end(); ++it)
+			{
+				std::uint64_t slotVersion = it->version.load();
+				if (slotVersion != 0 && slotVersion < oldestVersion)
+				{
+					oldestVersion = slotVersion;
+				}
+			}
+
+			std::size_t kept = 0;
+			for (std::size_t i = 0; i < retired.size(); ++i)
+			{
+				if (retired[i].second <= oldestVersion)
+				{
+					delete retired[i].first;
+				}
+				else
+				{
+					retired[kept++] = retired[i];
+				}
+			}
+			retired.resize(kept);
+		}
+
+		void removeSlot(readerSlot &slot)
+		{
+			std::lock_guard<std::mutex> lock(publishLock);
+			for (typename std::list<readerSlot>::iterator it = slots.begin(); it != slots.end(); ++it)
+			{
+				if (&*it == &slot)
+				{
+					slots.erase(it);
+					break;
+				}
+			}
+		}
+
+		std::atomic<snapshot*> current;
+		//Guards publishing, reclaiming and the list of slots.
+		mutable std::mutex publishLock;
+		//Models that have been replaced along with the version that replaced them.
+		std::vector<std::pair<snapshot*, std::uint64_t>> retired;
+		std::list<readerSlot> slots;
+		std::atomic<std::uint64_t> version;
+	};
+}
+
+#endif
@@ -1,15 +1,236 @@
 //Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
 #include "neuralNetwork.h"
 #include "neuralNetworkErrors.h"
+#include "philoxRandom.h"
 #include "helperFunctions.h"
+#include "matrixFunctions.h"
+#include "modelFile.h"
+#include "trace.h"
+#include "vectorKernels.h"
+#include<algorithm>
+#include<cmath>
+#include<fstream>
 #include<numeric>
-#include<iostream>
+#include<thread>
+#include<unordered_map>
+#include<stdexcept>
+#include<utility>
 
 namespace NeuralNetwork
 {
 	//Nested classes implementations.
+	//connectionBlock:
+	neuralNetwork::connectionBlock::connectionBlock() :rowOffsets(1, 0)
+	{
+
+	}
+
+	int neuralNetwork::connectionBlock::addRow()
+	{
+		rowOffsets.push_back(rowOffsets.back());
+		return (int)rowOffsets.size() - 2;
+	}
+
+	int neuralNetwork::connectionBlock::appendRow(const connectionBlock &ref, int refRow)
+	{
+#if SAFE_CELL
+		if (refRow < 0 || refRow >= ref.getRowCount())
+		{
+			throw std::out_of_range("The row being copied doesn't exist in the provided block.");
+		}
+#endif
+		int rowStart = ref.rowOffsets[refRow];
+		int rowEnd = ref.rowOffsets[refRow + 1];
+		columnIndexes.insert(columnIndexes.end(), ref.columnIndexes.begin() + rowStart, ref.columnIndexes.begin() + rowEnd);
+		weights.insert(weights.end(), ref.weights.begin() + rowStart, ref.weights.begin() + rowEnd);
+		previousWeightChanges.insert(previousWeightChanges.end(), ref.previousWeightChanges.begin() + rowStart, ref.previousWeightChanges.begin() + rowEnd);
+		rowOffsets.push_back((int)columnIndexes.size());
+		return (int)rowOffsets.size() - 2;
+	}
+
+	int neuralNetwork::connectionBlock::appendRow(const int *newColumns, const float *newWeights, const float *newPreviousWeightChanges, int length)
+	{
+		columnIndexes.insert(columnIndexes.end(), newColumns, newColumns + length);
+		weights.insert(weights.end(), newWeights, newWeights + length);
+		if (newPreviousWeightChanges)
+		{
+			previousWeightChanges.insert(previousWeightChanges.end(), newPreviousWeightChanges, newPreviousWeightChanges + length);
+		}
+		else
+		{
+			previousWeightChanges.resize(previousWeightChanges.size() + length, 0.0f);
+		}
+		rowOffsets.push_back((int)columnIndexes.size());
+		return (int)rowOffsets.size() - 2;
+	}
+
+	const int* neuralNetwork::connectionBlock::getColumns(int row) const
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= getRowCount())
+		{
+			throw std::out_of_range("The requested row doesn't exist in the block.");
+		}
+#endif
+		return columnIndexes.data() + rowOffsets[row];
+	}
+
+	int neuralNetwork::connectionBlock::getConnectionCount() const
+	{
+		return (int)columnIndexes.size();
+	}
+
+	float* neuralNetwork::connectionBlock::getPreviousWeightChanges(int row)
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= getRowCount())
+		{
+			throw std::out_of_range("The requested row doesn't exist in the block.");
+		}
+#endif
+		return previousWeightChanges.data() + rowOffsets[row];
+	}
+
+	const float* neuralNetwork::connectionBlock::getPreviousWeightChanges(int row) const
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= getRowCount())
+		{
+			throw std::out_of_range("The requested row doesn't exist in the block.");
+		}
+#endif
+		return previousWeightChanges.data() + rowOffsets[row];
+	}
+
+	int neuralNetwork::connectionBlock::getRowCount() const
+	{
+		return (int)rowOffsets.size() - 1;
+	}
+
+	int neuralNetwork::connectionBlock::getRowLength(int row) const
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= getRowCount())
+		{
+			throw std::out_of_range("The requested row doesn't exist in the block.");
+		}
+#endif
+		return rowOffsets[row + 1] - rowOffsets[row];
+	}
+
+	float* neuralNetwork::connectionBlock::getWeights(int row)
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= getRowCount())
+		{
+			throw std::out_of_range("The requested row doesn't exist in the block.");
+		}
+#endif
+		return weights.data() + rowOffsets[row];
+	}
+
+	const float* neuralNetwork::connectionBlock::getWeights(int row) const
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= getRowCount())
+		{
+			throw std::out_of_range("The requested row doesn't exist in the block.");
+		}
+#endif
+		return weights.data() + rowOffsets[row];
+	}
+
+	/*Uses a binary search over the sorted columns of the row to find where the connection belongs.
+	  Every row after the inserted connection is shifted over by one.*/
+	bool neuralNetwork::connectionBlock::insertConnection(int row, int column, float weight)
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= getRowCount())
+		{
+			throw std::out_of_range("The requested row doesn't exist in the block.");
+		}
+#endif
+		std::vector<int>::iterator rowEnd = columnIndexes.begin() + rowOffsets[row + 1];
+		std::vector<int>::iterator position = std::lower_bound(columnIndexes.begin() + rowOffsets[row], rowEnd, column);
+		if (position != rowEnd && *position == column)
+		{
+			return false;
+		}
+
+		std::ptrdiff_t offset = position - columnIndexes.begin();
+		columnIndexes.insert(position, column);
+		weights.insert(weights.begin() + offset, weight);
+		previousWeightChanges.insert(previousWeightChanges.begin() + offset, 0.0f);
+		for (std::vector<int>::iterator it = rowOffsets.begin() + row + 1; it != rowOffsets.end(); ++it)
+		{
+			++*it;
+		}
+		return true;
+	}
+
+	bool neuralNetwork::connectionBlock::removeConnection(int row, int column)
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= getRowCount())
+		{
+			throw std::out_of_range("The requested row doesn't exist in the block.");
+		}
+#endif
+		std::vector<int>::iterator rowEnd = columnIndexes.begin() + rowOffsets[row + 1];
+		std::vector<int>::iterator position = std::lower_bound(columnIndexes.begin() + rowOffsets[row], rowEnd, column);
+		if (position == rowEnd || *position != column)
+		{
+			return false;
+		}
+
+		std::ptrdiff_t offset = position - columnIndexes.begin();
+		columnIndexes.erase(position);
+		weights.erase(weights.begin() + offset);
+		previousWeightChanges.erase(previousWeightChanges.begin() + offset);
+		for (std::vector<int>::iterator it = rowOffsets.begin() + row + 1; it != rowOffsets.end(); ++it)
+		{
+			--*it;
+		}
+		return true;
+	}
+
+	int neuralNetwork::connectionBlock::removeConnections(const std::vector<bool> &marked)
+	{
+#if SAFE_CELL
+		if ((int)marked.size() != getConnectionCount())
+		{
+			throw std::out_of_range("The vector of marked connections doesn't have an entry for each connection of the block.");
+		}
+#endif
+		//Every kept connection is moved back over the removed ones while the offset of each row is moved back by the removed connections before it.
+		int kept = 0, rowStart = 0;
+		for (int row = 0; row < getRowCount(); ++row)
+		{
+			int rowEnd = rowOffsets[row + 1];
+			for (int i = rowStart; i < rowEnd; ++i)
+			{
+				if (!marked[i])
+				{
+					columnIndexes[kept] = columnIndexes[i];
+					weights[kept] = weights[i];
+					previousWeightChanges[kept] = previousWeightChanges[i];
+					++kept;
+				}
+			}
+			rowOffsets[row + 1] = kept;
+			rowStart = rowEnd;
+		}
+
+		int removed = (int)columnIndexes.size() - kept;
+		columnIndexes.resize(kept);
+		weights.resize(kept);
+		previousWeightChanges.resize(kept);
+		return removed;
+	}
+
 	//cell:
-	neuralNetwork::cell::cell(bool propFurther, int newIndex) :backPropagateFurther(propFurther), cellIndex(newIndex)
+	neuralNetwork::cell::cell(bool propFurther, int newIndex) :backPropagateFurther(propFurther), cellIndex(newIndex),
+		connections(std::make_shared<connectionBlock>()), connectionRow(0)
 	{
 #if SAFE_CELL
 		if (newIndex < 0)
@@ -18,6 +239,42 @@ namespace NeuralNetwork
 			throw std::out_of_range("A negativate index isn't valid.");
 		}
 #endif
+		connectionRow = connections->addRow();
+	}
+
+	neuralNetwork::cell::cell(const cell &ref) :backPropagateFurther(ref.backPropagateFurther), cellIndex(ref.cellIndex),
+		connections(std::make_shared<connectionBlock>()), connectionRow(0)
+	{
+		connectionRow = connections->appendRow(*ref.connections, ref.connectionRow);
+	}
+
+	neuralNetwork::cell::cell(const cell &ref, const std::shared_ptr<connectionBlock> &block) :backPropagateFurther(ref.backPropagateFurther), cellIndex(ref.cellIndex),
+		connections(block), connectionRow(ref.connectionRow)
+	{
+#if SAFE_CELL
+		if (ref.connectionRow >= block->getRowCount())
+		{
+			throw std::out_of_range("The row doesn't exist in the provided block.");
+		}
+#endif
+	}
+
+	neuralNetwork::cell::~cell()
+	{
+
+	}
+
+	neuralNetwork::cell& neuralNetwork::cell::operator=(const cell &ref)
+	{
+		if (this != &ref)
+		{
+			backPropagateFurther = ref.backPropagateFurther;
+			cellIndex = ref.cellIndex;
+			std::shared_ptr<connectionBlock> newConnections = std::make_shared<connectionBlock>();
+			connectionRow = newConnections->appendRow(*ref.connections, ref.connectionRow);
+			connections = newConnections;
+		}
+		return *this;
 	}
 
 	/*Attempts to add a connection between this cell and another cell. If the connection already
@@ -33,52 +290,67 @@ namespace NeuralNetwork
 		}
 #endif
 
-		/*Iterates over the list of connections to see if this connection already exists. Otherwise,
-		  when it finds a connection with a higher index, the new connection is added.*/
-		std::list<int>::iterator it = connections.begin();
-		for (; it != connections.end(); ++it)
-		{
-			if (*it == connectionIndex)
-			{
-				return false;
-			}
-			if (*it > connectionIndex)
-			{
-				//TODO: Can replace these two lines with a break.
-				connections.insert(it, connectionIndex);
-				return true;
-			}
-		}
-		//If the end of the list is reached, the new connection is added to the end of the list.
-		connections.insert(it, connectionIndex);
-		return true;
+		//The block keeps the connections sorted and rejects duplicates.
+		return connections->insertConnection(connectionRow, connectionIndex, 0.0f);
 	}
 
 	//Checks a vector of booleans of cells that are able to be updated to see if it can update.
 	bool neuralNetwork::cell::canUpdate(const std::vector<bool> &updateVec) const
 	{
-		bool output = true;
-		for (int currentConnection : connections)
+		const int *currentConnection = connections->getColumns(connectionRow);
+		const int *lastConnection = currentConnection + connections->getRowLength(connectionRow);
+		for (; currentConnection != lastConnection; ++currentConnection)
 		{
 #if SAFE_CELL
-			if (currentConnection >= (int)updateVec.size())
+			if (*currentConnection >= (int)updateVec.size())
 			{
 				throw std::out_of_range("Cell contains a connection index outside the range of the provided vector.");
 			}
 #endif
-			if (!updateVec[currentConnection])
+			if (!updateVec[*currentConnection])
 			{
-				output = false;
-				break;
+				return false;
 			}
 		}
-		return output;
+		return true;
+	}
+
+	neuralNetwork::cell* neuralNetwork::cell::copyInto(memoryArena&, const std::shared_ptr<connectionBlock> &block) const
+	{
+		cell *target = NULL;
+		copy(target);
+		if (target)
+		{
+			target->setConnections(block, connectionRow);
+		}
+		return target;
+	}
+
+	neuralNetwork::connectionBlock& neuralNetwork::cell::getConnectionBlock()
+	{
+		return *connections;
+	}
+
+	const neuralNetwork::connectionBlock& neuralNetwork::cell::getConnectionBlock() const
+	{
+		return *connections;
+	}
+
+	const std::shared_ptr<neuralNetwork::connectionBlock>& neuralNetwork::cell::getConnectionBlockPointer() const
+	{
+		return connections;
+	}
+
+	int neuralNetwork::cell::getConnectionRow() const
+	{
+		return connectionRow;
 	}
 
 	//Copies the index of all the connections to this cell to an inputted list.
 	void neuralNetwork::cell::getConnections(std::list<int> &output) const
 	{
-		output = connections;
+		const int *firstConnection = connections->getColumns(connectionRow);
+		output.assign(firstConnection, firstConnection + connections->getRowLength(connectionRow));
 	}
 
 	int neuralNetwork::cell::getIndex() const
@@ -92,6 +364,13 @@ namespace NeuralNetwork
 		return backPropagateFurther;
 	}
 
+	void neuralNetwork::cell::moveConnections(const std::shared_ptr<connectionBlock> &target)
+	{
+		int newRow = target->appendRow(*connections, connectionRow);
+		connections = target;
+		connectionRow = newRow;
+	}
+
 	/*Attempts to remove a connection with the given index. If it removes something, this function
 	  will return true. Otherwise, this function will always be false.*/
 	bool neuralNetwork::cell::removeConnection(int connectionIndex)
@@ -104,25 +383,21 @@ namespace NeuralNetwork
 		}
 #endif
 
-		//Iterates over the sorted list of connections to find a connection with the given index.
-		std::list<int>::iterator it = connections.begin();
-		for (; it != connections.end(); ++it)
+		//Removing the connection from the block also removes its weight and previous change.
+		return connections->removeConnection(connectionRow, connectionIndex);
+	}
+
+	//Points the cell at a row of a connection block.
+	void neuralNetwork::cell::setConnections(const std::shared_ptr<connectionBlock> &target, int row)
+	{
+#if SAFE_CELL
+		if (row < 0 || row >= target->getRowCount())
 		{
-			if (*it < connectionIndex)
-			{
-				continue;
-			}
-			else if (*it == connectionIndex)
-			{
-				connections.erase(it);
-				return true;
-			}
-			else
-			{
-				break;
-			}
+			throw std::out_of_range("The row doesn't exist in the provided block.");
 		}
-		return false;
+#endif
+		connections = target;
+		connectionRow = row;
 	}
 
 	//Sets the boolean on whether the cell will backpropagate the error further.
@@ -133,348 +408,280 @@ namespace NeuralNetwork
 
 	//neuron:
 	neuralNetwork::neuron::neuron(bool propFurther, int newIndex) :cell(propFurther, newIndex), dropRatePercent(DEFAULT_DROP_OFF_RATE),
-		learningRate(DEFAULT_LEARNING_RATE), momentum(DEFAULT_MOMENTUM), previousBiasChange(0), weightDecay(DEFAULT_WEIGHT_DECAY)
+		keptCount(0), learningRate(DEFAULT_LEARNING_RATE), momentum(DEFAULT_MOMENTUM), previousBiasChange(0), weightDecay(DEFAULT_WEIGHT_DECAY)
 	{
 		bias = DEFAULT_MIN_START_WEIGHT + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (DEFAULT_MAX_START_WEIGHT - DEFAULT_MIN_START_WEIGHT)));
 		actFunc = buildActFuncBundle(DEFAULT_ACTIVATION_FUNCTION);
 	}
 
-	bool neuralNetwork::neuron::addConnection(int connectionIndex)
+	neuralNetwork::neuron::neuron(const neuron &ref, const std::shared_ptr<connectionBlock> &block) :cell(ref, block), actFunc(ref.actFunc), bias(ref.bias),
+		dropoutMask(ref.dropoutMask), dropRatePercent(ref.dropRatePercent), keptCount(ref.keptCount), learningRate(ref.learningRate), momentum(ref.momentum),
+		previousBiasChange(ref.previousBiasChange), rawValues(ref.rawValues), weightDecay(ref.weightDecay)
 	{
-		return addConnection(connectionIndex, DEFAULT_MIN_START_WEIGHT + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (DEFAULT_MAX_START_WEIGHT - DEFAULT_MIN_START_WEIGHT))));
+
 	}
 
-	bool neuralNetwork::neuron::addConnection(int connectionIndex, float connectionWeight)
+	void neuralNetwork::neuron::activate(batchTensor &batchInput, int batchSize)
 	{
-		//Checks if the inputted index is a possible index 
-#if SAFE_CELL
-		if (connectionIndex < 0)
+		float *cellBatchValues = batchInput.getRow(cellIndex);
+		float *cellBatchEnd = cellBatchValues + batchSize;
+
+		//Goes through and applies the activation function and save the raw values before applying the activation function.
+		if (!actFunc.gradientInTermsOfFunc)
 		{
-			throw std::out_of_range("A negative index isn't valid.");
+			//Reuses the raw value storage so it's only reallocated when the batch grows.
+			rawValues.assign(cellBatchValues, cellBatchEnd);
 		}
-#endif
-
-		/*Iterates over the list of connections to see if this connection already exists. Otherwise,
-		  when it finds a connection with a higher index, the new connection is added.*/
-		std::list<int>::iterator connectIt = connections.begin();
-		std::list<float>::iterator weightIt = connectionWeights.begin();
-		std::list<float>::iterator preWeightIt = previousWeightChange.begin();
+		activateSpan(actFunc, cellBatchValues, batchSize);
 
+		//If dropoff, the batch values dropped by the mask built before propagating are set to zero.
+		if (dropRatePercent > 0)
+		{
 #if SAFE_CELL
-		for (; connectIt != connections.end() && weightIt != connectionWeights.end() && preWeightIt != previousWeightChange.end(); ++connectIt, ++weightIt, ++preWeightIt)
-#else
-		for (; connectIt != connections.end(); ++connectIt, ++weightIt)
+			if ((int)dropoutMask.size() < batchSize)
+			{
+				throw lists_not_same_length();
+			}
 #endif
-
-		{
-			if (*connectIt == connectionIndex)
+			for (int batchIndex = 0; batchIndex < batchSize; ++batchIndex)
 			{
-				return false;
+				cellBatchValues[batchIndex] *= dropoutMask[batchIndex];
 			}
-			if (*connectIt > connectionIndex)
+		}
+	}
+
+	void neuralNetwork::neuron::activateColumns(batchTensor &batchInput, int start, int end)
+	{
+		float *cellBatchValues = batchInput.getRow(cellIndex);
+		activateSpan(actFunc, cellBatchValues + start, end - start);
+		if (dropRatePercent > 0)
+		{
+			for (int batchIndex = start; batchIndex < end; ++batchIndex)
 			{
-				//TODO: Can replace these three lines with a break.
-				connections.insert(connectIt, connectionIndex);
-				connectionWeights.insert(weightIt, connectionWeight);
-				previousWeightChange.insert(preWeightIt, 0.0f);
-				return true;
+				cellBatchValues[batchIndex] *= dropoutMask[batchIndex];
 			}
 		}
-		//Checks to make sure the loop wasn't broken because one list was a different length then another.
+	}
+
+	bool neuralNetwork::neuron::addConnection(int connectionIndex)
+	{
+		return addConnection(connectionIndex, DEFAULT_MIN_START_WEIGHT + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (DEFAULT_MAX_START_WEIGHT - DEFAULT_MIN_START_WEIGHT))));
+	}
+
+	bool neuralNetwork::neuron::addConnection(int connectionIndex, float connectionWeight)
+	{
+		//Checks if the inputted index is a possible index 
 #if SAFE_CELL
-		if (connectIt != connections.end() ^ weightIt != connectionWeights.end() ^ preWeightIt != previousWeightChange.end())
+		if (connectionIndex < 0)
 		{
-			throw lists_not_same_length();
+			throw std::out_of_range("A negative index isn't valid.");
 		}
 #endif
 
-		//If the end of the list is reached, the new connection is added to the end of the list.
-		connections.insert(connectIt, connectionIndex);
-		connectionWeights.insert(weightIt, connectionWeight);
-		previousWeightChange.insert(preWeightIt, 0.0f);
-		return true;
+		/*The block keeps the connection, weight and previous weight change arrays in the same
+		  sorted order and rejects duplicate connections.*/
+		return connections->insertConnection(connectionRow, connectionIndex, connectionWeight);
 	}
 
-	void neuralNetwork::neuron::backwardPropagate(std::list<std::vector<float>> &batchInput, int batchSize, std::list<std::vector<float>> &errorList, std::mutex &errorLock)
+	void neuralNetwork::neuron::backwardPropagate(batchTensor &batchInput, int batchSize, batchTensor &errorList)
 	{
 #if SAFE_CELL
 		//If the batch size provided isn't possible, an exception is thrown.
-		if (batchSize < 1)
+		if (batchSize < 1 || batchSize > batchInput.getBatchSize())
 		{
-			throw std::out_of_range("Batch size must be greater then zero.");
-		}
-		//Also checks that this neuron's cell index is within the range of batchInput length.
-		if (cellIndex >= (int)batchInput.size())
-		{
-			throw std::out_of_range("Provided list of all cell batch values isn't large enough to include the current cell's index.");
-		}
-		//Also checks that this neuron's cell index is within the range of the errorList length.
-		if (cellIndex >= (int)errorList.size())
-		{
-			throw std::out_of_range("Provided error list is too small to contain an index for this cell.");
-		}
-		//Also checks if the list of cell values and cell errors are different sizes.
-		if (batchInput.size() != (int)errorList.size())
-		{
-			throw lists_not_same_length();
+			throw std::out_of_range("Batch size must be greater then zero and fit in the provided tensor.");
 		}
-		//Also checks that weights and previous change lists are the same length.
-		if (connectionWeights.size() != previousWeightChange.size())
+		//Also checks that this neuron's cell index is within the range of batchInput rows.
+		if (cellIndex >= batchInput.getRowCount())
 		{
-			throw lists_not_same_length();
+			throw std::out_of_range("Provided tensor of all cell batch values isn't large enough to include the current cell's index.");
 		}
-		//Also checks that connections and connection weights are the same length.
-		if (connections.size() != connectionWeights.size())
+		//Also checks if the tensors of cell values and cell errors are different shapes.
+		if (batchInput.getRowCount() != errorList.getRowCount() || batchInput.getBatchSize() != errorList.getBatchSize())
 		{
 			throw lists_not_same_length();
 		}
 #endif
+		TRACE_SCOPE(backwardCellEvent, cellIndex, -1);
+
+		//Finds the error for the current cell.
+		float *cellError = errorList.getRow(cellIndex);
+		float *cellErrorEnd = cellError + batchSize;
 
 		//If there are no connections, the error for the current cell is reset to 0.
-		if (connections.size() == 0)
+		int connectionCount = connections->getRowLength(connectionRow);
+		if (connectionCount == 0)
 		{
-			std::list<std::vector<float>>::iterator errorIt = errorList.begin();
-			for (int currentIndex = 0; currentIndex < cellIndex; ++currentIndex, ++errorIt)
-			{
-			}
-			for (std::vector<float>::iterator currentErrorIt = errorIt->begin(); currentErrorIt != errorIt->end(); ++currentErrorIt)
-			{
-				*currentErrorIt = 0;
-			}
+			std::fill(cellError, cellErrorEnd, 0.0f);
 		}
 		else
 		{
-			//Finds the error and values for the current cell.
-			std::list<std::vector<float>>::iterator errorIt = errorList.begin();
-			std::list<std::vector<float>>::iterator currentCellValueIt = batchInput.begin();
-			if (actFunc.gradientInTermsOfFunc)
-			{
-				for (int currentIndex = 0; currentIndex < cellIndex; ++currentIndex, ++errorIt, ++currentCellValueIt)
-				{
-				}
-			}
-			else
+			updateBias(cellError, batchSize);
+
+			/*The error multiplied by the gradient is the same for every connection, so it's found
+			  once and each connection becomes a multiply-add onto the connected cell's error and a
+			  dot product with the connected cell's values.*/
+			static thread_local std::vector<float> delta, gradientSums;
+			delta.resize(batchSize);
+			gradientSums.resize(connectionCount);
+			calculateDelta(batchInput, batchSize, errorList, delta.data());
+			TRACE_SCOPE_STATS(delta.data(), batchSize);
+			calculateWeightGradients(batchInput, batchSize, delta.data(), gradientSums.data());
+
+			//If the error needs to be backprop further, it's added to each connected cell's error before the weights change.
+			if (backPropagateFurther)
 			{
-				for (int currentIndex = 0; currentIndex < cellIndex; ++currentIndex, ++errorIt)
+				const vectorKernels &kernels = getKernels();
+				const int *currentSearchIndex = connections->getColumns(connectionRow);
+				const int *lastSearchIndex = currentSearchIndex + connectionCount;
+				const float *currentSearchWeight = connections->getWeights(connectionRow);
+				for (; currentSearchIndex != lastSearchIndex; ++currentSearchIndex, ++currentSearchWeight)
 				{
+					kernels.addVectors(errorList.getRow(*currentSearchIndex), delta.data(), *currentSearchWeight, batchSize);
 				}
 			}
+			updateWeights(gradientSums.data(), batchSize);
 
-			//Updates the bias.
-			previousBiasChange *= momentum;
-			previousBiasChange += learningRate * (std::accumulate(errorIt->begin(), errorIt->end(), 0.0f) / batchSize);
-			previousBiasChange -= weightDecay * bias;
-			bias += previousBiasChange;
-
-			//Backpropagate the error and update that weight.
-			//TODO: check if copying the error improves performance.
-			std::list<int>::iterator currentSearchIndex = connections.begin();
-			std::list<float>::iterator currentSearchWeight = connectionWeights.begin();
-			std::list<float>::iterator currentSearchPrevWeight = previousWeightChange.begin();
-			std::list<std::vector<float>>::iterator errorBackIt = errorList.begin();
-			std::list<std::vector<float>>::iterator valueBackIt = batchInput.begin();
-			std::vector<float>::iterator currentError = errorIt->begin();
-			std::vector<float>::iterator currentValue = valueBackIt->begin();
-			std::vector<float>::iterator connectionError = errorBackIt->begin();
-			std::vector<float>::iterator currentCellValue;
-
-			float averageError = 0.0f;
-			int currentIndex = 0;
-			for (; currentSearchIndex != connections.end(); ++currentSearchIndex, ++currentSearchWeight, ++currentSearchPrevWeight)
-			{
-				//Iterates the value and error lists to the right connection index.
-				for (; currentIndex < *currentSearchIndex && errorBackIt != errorList.end(); ++currentIndex, ++errorBackIt, ++valueBackIt)
-				{
-				}
+			//At the end, sets the error of the current neuron back to 0.
+			std::fill(cellError, cellErrorEnd, 0.0f);
+		}
+	}
+
+	void neuralNetwork::neuron::calculateDelta(const batchTensor &batchInput, int batchSize, const batchTensor &errorList, float *delta) const
+	{
+		//A neuron with every batch element dropped has no gradient to find.
+		if (dropRatePercent > 0 && keptCount == 0)
+		{
+			std::fill(delta, delta + batchSize, 0.0f);
+			return;
+		}
+
+		const float *cellError = errorList.getRow(cellIndex);
+		const float *cellValues;
+		if (actFunc.gradientInTermsOfFunc)
+		{
+			cellValues = batchInput.getRow(cellIndex);
+		}
+		else
+		{
 #if SAFE_CELL
-				//Double checks that the value of the connected cell has the same length as the current.
-				if (errorIt->size() != valueBackIt->size())
-				{
-					throw lists_not_same_length();
-				}
+			if ((int)rawValues.size() < batchSize)
+			{
+				throw lists_not_same_length();
+			}
 #endif
-				//Backpropagates the error while updating the weights.
-				currentError = errorIt->begin();
-				currentValue = valueBackIt->begin();
-				connectionError = errorBackIt->begin();
-				averageError = 0.0f;
+			cellValues = rawValues.data();
+		}
 
-				if (actFunc.gradientInTermsOfFunc)
-				{
-					currentCellValue = currentCellValueIt->begin();
-				}
-				else
-				{
-#if SAFE_CELL
-					//Double checks that the rawValue vector is the correct size.
-					if (rawValues.size() != valueBackIt->size())
-					{
-						throw lists_not_same_length();
-					}
-#endif
-					currentCellValue = rawValues.begin();
-				}
-
-				if (backPropagateFurther)
-				{
-#if SAFE_CELL
-					//Checks that the error list of the connected has the same length as the current.
-					if (errorIt->size() != errorBackIt->size())
-					{
-						throw lists_not_same_length();
-					}
-#endif
-					errorLock.lock();
-					for (; currentError != errorIt->end(); ++currentError, ++currentValue, ++connectionError, ++currentCellValue)
-					{
-						std::cout << *connectionError << " " << *currentError << " " << *currentSearchWeight << " " << *currentCellValue << std::endl;
-						*connectionError += *currentError * *currentSearchWeight * actFunc.activationFunctionGradient(*currentCellValue);
-						averageError += *currentError * *currentValue * actFunc.activationFunctionGradient(*currentCellValue);
-					}
-					errorLock.unlock();
-
-					averageError /= batchSize;
-
-					*currentSearchPrevWeight *= momentum;
-					*currentSearchPrevWeight += learningRate * averageError;
-					*currentSearchPrevWeight -= *currentSearchWeight * weightDecay;
-					*currentSearchWeight += *currentSearchPrevWeight;
-				}
-
-				//If the error doesn't need to be backprop further, the value is used to update the weights.
-				else
-				{
-					for (; currentError != errorIt->end(); ++currentError, ++currentValue, ++connectionError, ++currentCellValue)
-					{
-						averageError += *currentError * *currentValue * actFunc.activationFunctionGradient(*currentCellValue);
-					}
-
-					averageError /= batchSize;
-
-					*currentSearchPrevWeight *= momentum;
-					*currentSearchPrevWeight += learningRate * averageError;
-					*currentSearchPrevWeight -= *currentSearchWeight * weightDecay;
-					*currentSearchWeight += *currentSearchPrevWeight;
-				}
+		activationDeltaSpan(actFunc, delta, cellError, cellValues, batchSize);
 
+		//The dropped batch elements didn't affect the output, so the same mask is applied to their deltas.
+		if (dropRatePercent > 0)
+		{
+			for (int batchIndex = 0; batchIndex < batchSize; ++batchIndex)
+			{
+				delta[batchIndex] *= dropoutMask[batchIndex];
 			}
+		}
+	}
 
-			//At the end, sets the error of the current neuron back to 0.
-			for (std::vector<float>::iterator erIt = errorIt->begin(); erIt != errorIt->end(); ++erIt)
+	void neuralNetwork::neuron::calculateWeightGradients(const batchTensor &batchInput, int batchSize, const float *delta, float *gradientSums) const
+	{
+		const vectorKernels &kernels = getKernels();
+		const int *currentSearchIndex = connections->getColumns(connectionRow);
+		const int *lastSearchIndex = currentSearchIndex + connections->getRowLength(connectionRow);
+		for (; currentSearchIndex != lastSearchIndex; ++currentSearchIndex, ++gradientSums)
+		{
+#if SAFE_CELL
+			//Double checks that the connected cell has a row in the tensor.
+			if (*currentSearchIndex >= batchInput.getRowCount())
 			{
-				*erIt = 0.0f;
+				throw std::out_of_range("Provided tensor of all cell batch values isn't large enough to include a connected cell's index.");
 			}
+#endif
+			*gradientSums = kernels.dotProduct(delta, batchInput.getRow(*currentSearchIndex), batchSize);
+		}
+	}
 
+	void neuralNetwork::neuron::buildDropoutMask(std::uint64_t seed, std::uint64_t step, int batchSize)
+	{
+		if (dropRatePercent <= 0)
+		{
+			return;
 		}
+		dropoutMask.resize(batchSize);
+		keptCount = NeuralNetwork::buildDropoutMask(seed, step, cellIndex, dropRatePercent, batchSize, dropoutMask.data());
+	}
+
+	bool neuralNetwork::neuron::canActivateColumns() const
+	{
+		return actFunc.type != customFunction && actFunc.gradientInTermsOfFunc;
 	}
 
 	void neuralNetwork::neuron::copy(cell *&target) const
 	{
 		//TODO: Add an exception if a non-null pointer is given.
 		if (!target)
-		{
-
-		}
-		else
 		{
 			target = new neuron(*this);
 		}
 	}
 
-	void neuralNetwork::neuron::forwardPropagate(std::list<std::vector<float>> &batchInput, int batchSize)
+	neuralNetwork::cell* neuralNetwork::neuron::copyInto(memoryArena &arena, const std::shared_ptr<connectionBlock> &block) const
+	{
+		return new (arena.allocate(sizeof(neuron), alignof(neuron))) neuron(*this, block);
+	}
+
+	void neuralNetwork::neuron::forwardPropagate(batchTensor &batchInput, int batchSize)
 	{
 #if SAFE_CELL
 		//If the batch size provided isn't possible, an exception is thrown.
-		if (batchSize < 1)
+		if (batchSize < 1 || batchSize > batchInput.getBatchSize())
 		{
-			throw std::out_of_range("Batch size must be greater then zero.");
+			throw std::out_of_range("Batch size must be greater then zero and fit in the provided tensor.");
 		}
-		//Also checks that this neuron's cell index is within the range of batchInput length.
-		if (cellIndex >= (int)batchInput.size())
+		//Also checks that this neuron's cell index is within the range of batchInput rows.
+		if (cellIndex >= batchInput.getRowCount())
 		{
-			throw std::out_of_range("Provided list of all cell batch values isn't large enough to include the current cell's index.");
+			throw std::out_of_range("Provided tensor of all cell batch values isn't large enough to include the current cell's index.");
 		}
 #endif
 
-		std::vector<float> cellBatchValues(batchSize, bias);
-		std::vector<float>::iterator valueIt, currentCellIt;
-		std::list<std::vector<float>>::iterator cellValueIt = batchInput.begin();
-		std::list<int>::iterator currentSearchIndex = connections.begin();
-		std::list<float>::iterator currentSearchWeight = connectionWeights.begin();
+		//The value of the neuron is calculated in place in its row of the tensor.
+		float *cellBatchValues = batchInput.getRow(cellIndex);
+		float *cellBatchEnd = cellBatchValues + batchSize;
 
-		//Iterates through the cell values while keeping tracking of the current index.
-		for (int currentCell = 0; cellValueIt != batchInput.end(); ++currentCell, ++cellValueIt)
+		//If the mask drops every batch element, the connections and activation function are skipped.
+		if (dropRatePercent > 0 && keptCount == 0 && (int)dropoutMask.size() >= batchSize)
 		{
-			//Once an index that has a connection is reached. Each value is added to the current batch value after
-			//being multiplied by the weight of the connection.
-			if (currentCell == *currentSearchIndex)
-			{
-				addVectors(cellBatchValues, *cellValueIt, *currentSearchWeight);
-				//Iterates the list of connections to the next search.
-				++currentSearchIndex;
-				++currentSearchWeight;
-			}
-
-			//If there isn't anymore connections that need to be searched for, the loop is broken.
-#if SAFE_CELL
-			if (currentSearchIndex == connections.end() || currentSearchWeight == connectionWeights.end())
+			std::fill(cellBatchValues, cellBatchEnd, 0.0f);
+			if (!actFunc.gradientInTermsOfFunc)
 			{
-				//Checks to make sure they are both at the end. Otherwise, an exception is thrown.
-				if (currentSearchIndex == connections.end() ^ currentSearchWeight == connectionWeights.end())
-				{
-					throw lists_not_same_length();
-				}
-				else
-				{
-					break;
-				}
-			}
-#else
-			if (currentSearchIndex == connections.end())
-			{
-				break;
+				rawValues.assign(batchSize, 0.0f);
 			}
-#endif
+			return;
 		}
-#if SAFE_CELL
-		//If there are some index connections that haven't been reach, an exception is thrown.
-		if (currentSearchIndex != connections.end())
-		{
-			throw std::out_of_range("Provide list of batch values of each index was too short.");
-		}
-#endif
-
-		//Goes through and applies the activation function and save the raw values before applying the activation function.
-		if (!actFunc.gradientInTermsOfFunc)
-		{
-			rawValues = cellBatchValues;
-		}
-		for (valueIt = cellBatchValues.begin(); valueIt != cellBatchValues.end(); ++valueIt)
-		{
-			*valueIt = actFunc.activationFunction(*valueIt);
-		}
-
-		//If dropoff, randomly sets some of the batch values to zero based on percent.
-		//TODO: Can rewrite this function where I figure out which values are going to be zero and not calculate them for performance.
-		if (dropRatePercent > 0)
+		const int *columns = connections->getColumns(connectionRow);
+		int connectionCount = connections->getRowLength(connectionRow);
+		std::fill(cellBatchValues, cellBatchEnd, bias);
+
+		//The rows of the connected cells are gathered so every weighted value is added in one pass over the batch values.
+		static thread_local std::vector<const float*> connectedRows;
+		connectedRows.resize(connectionCount);
+		for (int connection = 0; connection < connectionCount; ++connection)
 		{
-			for (valueIt = cellBatchValues.begin(); valueIt != cellBatchValues.end(); ++valueIt)
+#if SAFE_CELL
+			//If a connection doesn't have a row in the tensor, an exception is thrown.
+			if (columns[connection] >= batchInput.getRowCount())
 			{
-				if (dropRatePercent > static_cast <float> (rand()) / static_cast <float> (RAND_MAX))
-				{
-					*valueIt = 0;
-				}
+				throw std::out_of_range("Provided tensor of batch values of each index was too short.");
 			}
+#endif
+			connectedRows[connection] = batchInput.getRow(columns[connection]);
 		}
+		addWeightedRows(cellBatchValues, connectedRows.data(), connections->getWeights(connectionRow), connectionCount, batchSize);
 
-		//Updates the value in the list of all cells for this cell.
-		cellValueIt = batchInput.begin();
-		for (int currentCellIndex = 0; currentCellIndex < cellIndex; ++currentCellIndex, ++cellValueIt)
-		{
-		}
-
-
-		*cellValueIt = cellBatchValues;
+		activate(batchInput, batchSize);
 	}
 
 	activationFunctionInfo neuralNetwork::neuron::getActivationFunction() const
@@ -509,7 +716,23 @@ namespace NeuralNetwork
 
 	void neuralNetwork::neuron::getPreviousWeightChanges(std::list<float> &output) const
 	{
-		output = previousWeightChange;
+		const float *firstChange = connections->getPreviousWeightChanges(connectionRow);
+		output.assign(firstChange, firstChange + connections->getRowLength(connectionRow));
+	}
+
+	int neuralNetwork::neuron::getTrainingState(float *output) const
+	{
+		int rowLength = connections->getRowLength(connectionRow);
+		std::copy(connections->getWeights(connectionRow), connections->getWeights(connectionRow) + rowLength, output);
+		std::copy(connections->getPreviousWeightChanges(connectionRow), connections->getPreviousWeightChanges(connectionRow) + rowLength, output + rowLength);
+		output[2 * rowLength] = bias;
+		output[2 * rowLength + 1] = previousBiasChange;
+		return 2 * rowLength + 2;
+	}
+
+	int neuralNetwork::neuron::getTrainingStateSize() const
+	{
+		return 2 * connections->getRowLength(connectionRow) + 2;
 	}
 
 	float neuralNetwork::neuron::getWeightDecay() const
@@ -519,69 +742,23 @@ namespace NeuralNetwork
 
 	void neuralNetwork::neuron::getWeights(std::list<float> &output) const
 	{
-		output = connectionWeights;
+		const float *firstWeight = connections->getWeights(connectionRow);
+		output.assign(firstWeight, firstWeight + connections->getRowLength(connectionRow));
 	}
 
-	bool neuralNetwork::neuron::removeConnection(int connectionIndex)
+	float neuralNetwork::neuron::getWeightsRelaxed(float *output) const
 	{
-
-#if SAFE_CELL
-		//Checks if the inputted integer is a possible index.
-		if (connectionIndex < 0)
-		{
-			throw std::out_of_range("A negative index isn't valid.");
-		}
-#endif
-
-		//Iterates over the sorted list of connections to find a connection with the given index.
-		std::list<int>::iterator connectIt = connections.begin();
-		std::list<float>::iterator weightIt = connectionWeights.begin();
-		std::list<float>::iterator preWeightIt = previousWeightChange.begin();
-
-#if SAFE_CELL
-		for (; connectIt != connections.end() && weightIt != connectionWeights.end() && preWeightIt != previousWeightChange.end(); ++connectIt, ++weightIt, ++preWeightIt)
-#else
-		for (; connectIt != connections.end(); ++connectIt, ++weightIt, ++preWeightIt)
-#endif
-		{
-			if (*connectIt < connectionIndex)
-			{
-				continue;
-			}
-			//If the connection is found, it's erased from all lists.
-			else if (*connectIt == connectionIndex)
-			{
-				connections.erase(connectIt);
-				connectionWeights.erase(weightIt);
-				previousWeightChange.erase(preWeightIt);
-				return true;
-			}
-			else
-			{
-				break;
-			}
-		}
-
-#if SAFE_CELL
-		//Checks to make sure the loop wasn't broken because one list was a different length then another.
-		//TODO: This logic for checking whether all 3 lists are the same length can be simplified.
-		if (connectIt != connections.end())
-		{
-			if (weightIt == connectionWeights.end() || preWeightIt == previousWeightChange.end())
-			{
-				throw lists_not_same_length();
-			}
-		}
-		else
+		const float *weights = connections->getWeights(connectionRow);
+		for (int connection = 0; connection < connections->getRowLength(connectionRow); ++connection)
 		{
-			if (weightIt != connectionWeights.end() || preWeightIt != previousWeightChange.end())
-			{
-				throw lists_not_same_length();
-			}
+			output[connection] = loadRelaxed(weights + connection);
 		}
-#endif
+		return loadRelaxed(&bias);
+	}
 
-		return false;
+	void neuralNetwork::neuron::setActivationFunction(const activationFunctionInfo &newActFunc)
+	{
+		actFunc = newActFunc;
 	}
 
 	void neuralNetwork::neuron::setBias(float newBias)
@@ -630,12 +807,22 @@ namespace NeuralNetwork
 	void neuralNetwork::neuron::setPreviousWeightChanges(const std::list<float> &ref)
 	{
 #if SAFE_CELL
-		if (ref.size() != previousWeightChange.size())
+		if ((int)ref.size() != connections->getRowLength(connectionRow))
 		{
 			throw lists_not_same_length();
 		}
 #endif
-		previousWeightChange = ref;
+		std::copy(ref.begin(), ref.end(), connections->getPreviousWeightChanges(connectionRow));
+	}
+
+	int neuralNetwork::neuron::setTrainingState(const float *ref)
+	{
+		int rowLength = connections->getRowLength(connectionRow);
+		std::copy(ref, ref + rowLength, connections->getWeights(connectionRow));
+		std::copy(ref + rowLength, ref + 2 * rowLength, connections->getPreviousWeightChanges(connectionRow));
+		bias = ref[2 * rowLength];
+		previousBiasChange = ref[2 * rowLength + 1];
+		return 2 * rowLength + 2;
 	}
 
 	void neuralNetwork::neuron::setWeightDecay(float newWeightDecay)
@@ -652,79 +839,1651 @@ namespace NeuralNetwork
 	void neuralNetwork::neuron::setWeights(const std::list<float> &ref)
 	{
 #if SAFE_CELL
-		if (ref.size() != connectionWeights.size())
+		if ((int)ref.size() != connections->getRowLength(connectionRow))
 		{
 			throw lists_not_same_length();
 		}
 #endif
-		connectionWeights = ref;
+		std::copy(ref.begin(), ref.end(), connections->getWeights(connectionRow));
+	}
+
+	void neuralNetwork::neuron::updateBias(const float *cellError, int batchSize)
+	{
+		//The dropped batch elements have no error to add onto the bias.
+		float errorSum = dropRatePercent > 0 ? getKernels().dotProduct(cellError, dropoutMask.data(), batchSize)
+			: std::accumulate(cellError, cellError + batchSize, 0.0f);
+		previousBiasChange *= momentum;
+		previousBiasChange += learningRate * (errorSum / batchSize);
+		previousBiasChange -= weightDecay * bias;
+		bias += previousBiasChange;
+	}
+
+	void neuralNetwork::neuron::updateRelaxed(const float *gradientSums, float errorSum, int batchSize)
+	{
+		float *weights = connections->getWeights(connectionRow);
+		float *previousChanges = connections->getPreviousWeightChanges(connectionRow);
+		for (int connection = 0; connection < connections->getRowLength(connectionRow); ++connection)
+		{
+			float weight = loadRelaxed(weights + connection);
+			float change = loadRelaxed(previousChanges + connection) * momentum + learningRate * (gradientSums[connection] / batchSize) - weight * weightDecay;
+			storeRelaxed(previousChanges + connection, change);
+			storeRelaxed(weights + connection, weight + change);
+		}
+		float currentBias = loadRelaxed(&bias);
+		float biasChange = loadRelaxed(&previousBiasChange) * momentum + learningRate * (errorSum / batchSize) - weightDecay * currentBias;
+		storeRelaxed(&previousBiasChange, biasChange);
+		storeRelaxed(&bias, currentBias + biasChange);
+	}
+
+	void neuralNetwork::neuron::updateWeights(const float *gradientSums, int batchSize)
+	{
+		float *currentWeight = connections->getWeights(connectionRow);
+		float *lastWeight = currentWeight + connections->getRowLength(connectionRow);
+		float *currentPrevWeight = connections->getPreviousWeightChanges(connectionRow);
+		for (; currentWeight != lastWeight; ++currentWeight, ++currentPrevWeight, ++gradientSums)
+		{
+			*currentPrevWeight *= momentum;
+			*currentPrevWeight += learningRate * (*gradientSums / batchSize);
+			*currentPrevWeight -= *currentWeight * weightDecay;
+			*currentWeight += *currentPrevWeight;
+		}
 	}
 
 	//neuralNetwork:
-	neuralNetwork::neuralNetwork():inputNodes(0), outputNodes(0)
+	neuralNetwork::neuralNetwork():cellArena(new memoryArena(CELL_ARENA_CHUNK_SIZE)), dataflow(), dropoutSeed(DEFAULT_DROPOUT_SEED), execution(stageExecution), inputNodes(0),
+		outputNodes(0), pool(new threadPool(DEFAULT_THREAD_COUNT)), stagesAnalyzed(false), trainingStep(0)
 	{
 
 	}
 
-	neuralNetwork::neuralNetwork(const neuralNetwork &ref) : inputNodes(ref.inputNodes), outputNodes(ref.outputNodes)
+	neuralNetwork::neuralNetwork(int newInputNodes, int newOutputNodes) :cellArena(new memoryArena(CELL_ARENA_CHUNK_SIZE)), dataflow(), dropoutSeed(DEFAULT_DROPOUT_SEED),
+		execution(stageExecution), inputNodes(newInputNodes), outputNodes(newOutputNodes), pool(new threadPool(DEFAULT_THREAD_COUNT)), stagesAnalyzed(false), trainingStep(0)
 	{
-		cell *tempCell = NULL;
-		for (std::list<std::list<cell*>>::const_iterator scheduleIt = ref.schedule.begin(); scheduleIt != ref.schedule.end(); ++scheduleIt)
+		if (newInputNodes < 0 || newOutputNodes < 0)
 		{
-			schedule.push_back(std::list<cell*>());
-			for (std::list<cell*>::const_iterator it = scheduleIt->begin(); it != scheduleIt->end(); ++it)
-			{
-				(*it)->copy(tempCell);
-				schedule.back().push_back(tempCell);
-				tempCell = NULL;
-			}
+			inputNodes = 0;
+			outputNodes = 0;
+			throw std::out_of_range("The number of input and output nodes can't be negative.");
 		}
 	}
 
+	neuralNetwork::neuralNetwork(const neuralNetwork &ref) : cellArena(new memoryArena(CELL_ARENA_CHUNK_SIZE)), dataflow(), dropoutSeed(ref.dropoutSeed), execution(ref.execution),
+		inputNodes(ref.inputNodes), outputNodes(ref.outputNodes), pool(new threadPool(ref.getThreadCount())), stagesAnalyzed(false), trainingStep(ref.trainingStep)
+	{
+		copySchedule(ref);
+	}
+
+	//Starts with no arena or pool so nothing is allocated, and they go to the other network with the swap.
+	neuralNetwork::neuralNetwork(neuralNetwork &&ref) noexcept :cellArena(), dataflow(), dropoutSeed(DEFAULT_DROPOUT_SEED), execution(stageExecution),
+		inputNodes(0), outputNodes(0), pool(), stagesAnalyzed(false), trainingStep(0)
+	{
+		swap(ref);
+	}
+
 	neuralNetwork::~neuralNetwork()
 	{
 		inputNodes = 0;
 		outputNodes = 0;
-		for (std::list<std::list<cell*>>::iterator scheduleIt = schedule.begin(); scheduleIt != schedule.end(); ++scheduleIt)
-		{
-			for (std::list<cell*>::iterator it = scheduleIt->begin(); it != scheduleIt->end(); ++it)
-			{
-				delete *it;
-			}
-		}
-		schedule.clear();
+		deleteSchedule();
 	}
 
 	neuralNetwork& neuralNetwork::operator=(const neuralNetwork &ref)
 	{
-		cell *tempCell = NULL;
 		if (this != &ref)
 		{
+			dropoutSeed = ref.dropoutSeed;
+			execution = ref.execution;
 			inputNodes = ref.inputNodes;
 			outputNodes = ref.outputNodes;
+			setThreadCount(ref.getThreadCount());
+			trainingStep = ref.trainingStep;
 
 			//TODO: Could resize the list to match the reference and clear the list before copying.
 			//Deletes the schedule and creates a copy of the list.
-			for (std::list<std::list<cell*>>::iterator scheduleIt = schedule.begin(); scheduleIt != schedule.end(); ++scheduleIt)
+			deleteSchedule();
+			copySchedule(ref);
+		}
+		return *this;
+	}
+
+	//The old schedule goes to the temporary network, so it's destroyed here and the other network is left empty.
+	neuralNetwork& neuralNetwork::operator=(neuralNetwork &&ref) noexcept
+	{
+		if (this != &ref)
+		{
+			neuralNetwork temp(std::move(ref));
+			swap(temp);
+		}
+		return *this;
+	}
+
+	bool neuralNetwork::addConnection(int cellIndex, int connectionIndex)
+	{
+		return addConnection(cellIndex, connectionIndex, DEFAULT_MIN_START_WEIGHT + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (DEFAULT_MAX_START_WEIGHT - DEFAULT_MIN_START_WEIGHT))));
+	}
+
+	bool neuralNetwork::addConnection(int cellIndex, int connectionIndex, float connectionWeight)
+	{
+		neuron *target = findNeuron(cellIndex);
+		if (connectionIndex < 0 || connectionIndex >= getCellCount())
+		{
+			throw std::out_of_range("The connection index doesn't match an input node or a cell in the network.");
+		}
+
+		//The connected cell has to be an input node or be scheduled in an earlier stage.
+		if (connectionIndex >= inputNodes && cellStages[connectionIndex - inputNodes] >= cellStages[cellIndex - inputNodes])
+		{
+			throw connection_not_scheduled_before();
+		}
+		separateSharedBlocks(findStage(cellStages[cellIndex - inputNodes]));
+		stagesAnalyzed = false;
+		return target->addConnection(connectionIndex, connectionWeight);
+	}
+
+	int neuralNetwork::addNeuron(int stageIndex, bool propFurther)
+	{
+		if (stageIndex < 0)
+		{
+			throw std::out_of_range("A negative stage index isn't valid.");
+		}
+
+		//Creates any stages missing between the last stage and the requested one.
+		while ((int)schedule.size() <= stageIndex)
+		{
+			schedule.push_back(std::list<cell*>());
+		}
+		std::list<std::list<cell*>>::iterator scheduleIt = schedule.begin();
+		std::advance(scheduleIt, stageIndex);
+
+		restoreMovedFrom();
+		neuron *newNeuron = new (cellArena->allocate(sizeof(neuron), alignof(neuron))) neuron(propFurther, getCellCount());
+		scheduleIt->push_back(newNeuron);
+		cells.push_back(newNeuron);
+		cellStages.push_back(stageIndex);
+		stagesAnalyzed = false;
+		return newNeuron->getIndex();
+	}
+
+	/*The error of each output node is the target minus its output, which is the gradient of the
+	  mean squared error. Then each stage is backward propagated starting from the last stage.*/
+	void neuralNetwork::backwardPropagate(const batchTensor &target)
+	{
+		backwardPropagate(target, std::function<void(int)>());
+	}
+
+	void neuralNetwork::backwardPropagate(const batchTensor &target, const std::function<void(int)> &stageDone)
+	{
+		int batchSize = values.getBatchSize();
+		if (outputNodes > (int)cells.size())
+		{
+			throw std::out_of_range("The network has more output nodes than cells.");
+		}
+		//The target has to match the shape of the output from the last forward propagation.
+		if (target.getRowCount() != outputNodes || target.getBatchSize() != batchSize || values.getRowCount() != getCellCount())
+		{
+			throw lists_not_same_length();
+		}
+		restoreMovedFrom();
+
+		//Resizing clears the error left over on the input nodes from the last backward propagation.
+		errors.resize(getCellCount(), batchSize);
+		int firstOutput = getCellCount() - outputNodes;
+		for (int outputIndex = 0; outputIndex < outputNodes; ++outputIndex)
+		{
+			const float *targetValue = target.getRow(outputIndex);
+			const float *outputValue = values.getRow(firstOutput + outputIndex);
+			float *outputError = errors.getRow(firstOutput + outputIndex);
+			for (int batchIndex = 0; batchIndex < batchSize; ++batchIndex)
 			{
-				for (std::list<cell*>::iterator it = scheduleIt->begin(); it != scheduleIt->end(); ++it)
-				{
-					delete *it;
-				}
+				outputError[batchIndex] = targetValue[batchIndex] - outputValue[batchIndex];
 			}
-			schedule.clear();
+		}
 
-			for (std::list<std::list<cell*>>::const_iterator scheduleIt = ref.schedule.begin(); scheduleIt != ref.schedule.end(); ++scheduleIt)
+		//The weights of every stage are about to be updated, so blocks shared with other networks are copied before any thread writes to them.
+		for (std::list<std::list<cell*>>::iterator scheduleIt = schedule.begin(); scheduleIt != schedule.end(); ++scheduleIt)
+		{
+			separateSharedBlocks(*scheduleIt);
+		}
+		if (!stagesAnalyzed)
+		{
+			analyzeStages();
+		}
+		invalidatePackedWeights();
+		calculateSoftmaxErrors(batchSize);
+		if (execution == dataflowExecution && dataflow.usable)
+		{
+			backwardPropagateDataflow(batchSize);
+			for (int stageIndex = (int)stageLayouts.size() - 1; stageDone && stageIndex >= 0; --stageIndex)
+			{
+				stageDone(stageIndex);
+			}
+			return;
+		}
+		for (std::vector<stageLayout>::reverse_iterator layoutIt = stageLayouts.rbegin(); layoutIt != stageLayouts.rend(); ++layoutIt)
+		{
+			int stageIndex = (int)(stageLayouts.rend() - layoutIt) - 1;
 			{
-				schedule.push_back(std::list<cell*>());
-				for (std::list<cell*>::const_iterator it = scheduleIt->begin(); it != scheduleIt->end(); ++it)
+				TRACE_SCOPE(backwardStageEvent, layoutIt->firstCell, stageIndex);
+				if (layoutIt->dense)
 				{
-					(*it)->copy(tempCell);
-					schedule.back().push_back(tempCell);
-					tempCell = NULL;
+					backwardPropagateDenseStage(*layoutIt, batchSize);
 				}
+				else
+				{
+					backwardPropagateSparseStage(*layoutIt, batchSize);
+				}
+			}
+			if (stageDone)
+			{
+				stageDone(stageIndex);
 			}
 		}
-		return *this;
 	}
-}
\ No newline at end of file
+
+	/*Each stage gets a new block with the rows in the same order as the cells in the stage. Any
+	  block that was used before is released once no cell refers to it.*/
+	void neuralNetwork::compactStages()
+	{
+		for (std::list<std::list<cell*>>::iterator scheduleIt = schedule.begin(); scheduleIt != schedule.end(); ++scheduleIt)
+		{
+			//A stage whose cells already use the rows of one block in order, like a copied or loaded stage, is left as it is.
+			bool compact = !scheduleIt->empty() && scheduleIt->front()->getConnectionBlock().getRowCount() == (int)scheduleIt->size();
+			int row = 0;
+			for (std::list<cell*>::iterator it = scheduleIt->begin(); it != scheduleIt->end() && compact; ++it, ++row)
+			{
+				compact = &(*it)->getConnectionBlock() == &scheduleIt->front()->getConnectionBlock() && (*it)->getConnectionRow() == row;
+			}
+			if (compact)
+			{
+				continue;
+			}
+
+			std::shared_ptr<connectionBlock> stageBlock = std::make_shared<connectionBlock>();
+			for (std::list<cell*>::iterator it = scheduleIt->begin(); it != scheduleIt->end(); ++it)
+			{
+				(*it)->moveConnections(stageBlock);
+			}
+		}
+		stagesAnalyzed = false;
+	}
+
+	inferencePlan neuralNetwork::compileForInference()
+	{
+		return compileForInference(floatPrecision);
+	}
+
+	inferencePlan neuralNetwork::compileForInference(storagePrecision precision)
+	{
+		if (!stagesAnalyzed)
+		{
+			analyzeStages();
+		}
+
+		//The connections of every stage are copied into two arrays the plan and its copies share.
+		std::shared_ptr<std::pair<std::vector<int>, std::vector<float>>> arrays = std::make_shared<std::pair<std::vector<int>, std::vector<float>>>();
+		inferencePlan plan;
+		plan.cellCount = getCellCount();
+		plan.inputNodes = inputNodes;
+		plan.outputNodes = outputNodes;
+		plan.softmaxOutputs = softmaxOutputs;
+		for (std::vector<stageLayout>::const_iterator layoutIt = stageLayouts.begin(); layoutIt != stageLayouts.end(); ++layoutIt)
+		{
+			if (!layoutIt->otherCells.empty())
+			{
+				throw cell_not_neuron();
+			}
+			if (layoutIt->neurons.empty())
+			{
+				continue;
+			}
+
+			plan.stages.push_back(inferencePlan::stagePlan());
+			inferencePlan::stagePlan &stage = plan.stages.back();
+			for (std::vector<neuron*>::const_iterator it = layoutIt->neurons.begin(); it != layoutIt->neurons.end(); ++it)
+			{
+				const connectionBlock &block = (*it)->getConnectionBlock();
+				int rowLength = block.getRowLength((*it)->getConnectionRow());
+				stage.activations.push_back((*it)->getActivationFunction());
+				stage.biases.push_back((*it)->getBias());
+				stage.cellIndexes.push_back((*it)->getIndex());
+				stage.rowLengths.push_back(rowLength);
+				stage.rowStarts.push_back(arrays->first.size());
+				arrays->first.insert(arrays->first.end(), block.getColumns((*it)->getConnectionRow()), block.getColumns((*it)->getConnectionRow()) + rowLength);
+				arrays->second.insert(arrays->second.end(), block.getWeights((*it)->getConnectionRow()), block.getWeights((*it)->getConnectionRow()) + rowLength);
+			}
+		}
+
+		plan.precision = precision;
+		if (precision == floatPrecision)
+		{
+			plan.columns = arrays->first.data();
+			plan.weights = arrays->second.data();
+			plan.storage = arrays;
+		}
+		else
+		{
+			std::shared_ptr<std::pair<std::vector<int>, std::vector<std::uint16_t>>> reducedArrays = std::make_shared<std::pair<std::vector<int>, std::vector<std::uint16_t>>>();
+			reducedArrays->first.swap(arrays->first);
+			reducedArrays->second.resize(arrays->second.size());
+			narrowValues(precision, arrays->second.data(), reducedArrays->second.data(), (int)arrays->second.size());
+			plan.columns = reducedArrays->first.data();
+			plan.reducedWeights = reducedArrays->second.data();
+			plan.storage = reducedArrays;
+		}
+		for (std::vector<inferencePlan::stagePlan>::iterator it = plan.stages.begin(); it != plan.stages.end(); ++it)
+		{
+			plan.findDenseLayout(*it);
+		}
+		return plan;
+	}
+
+	void neuralNetwork::forwardPropagate(const batchTensor &input)
+	{
+		int batchSize = input.getBatchSize();
+		if (input.getRowCount() != inputNodes)
+		{
+			throw lists_not_same_length();
+		}
+		if (batchSize < 1)
+		{
+			throw std::out_of_range("Batch size must be greater then zero.");
+		}
+
+		restoreMovedFrom();
+		//The values are only reallocated when the batch size or number of cells grows.
+		values.resize(getCellCount(), batchSize);
+		for (int inputIndex = 0; inputIndex < inputNodes; ++inputIndex)
+		{
+			std::copy(input.getRow(inputIndex), input.getRow(inputIndex) + batchSize, values.getRow(inputIndex));
+		}
+
+		if (!stagesAnalyzed)
+		{
+			analyzeStages();
+		}
+		buildDropoutMasks(batchSize);
+		if (execution == dataflowExecution && dataflow.usable)
+		{
+			forwardPropagateDataflow(batchSize);
+			activateSoftmaxOutputs(batchSize);
+			return;
+		}
+		for (std::vector<stageLayout>::iterator layoutIt = stageLayouts.begin(); layoutIt != stageLayouts.end(); ++layoutIt)
+		{
+			TRACE_SCOPE(forwardStageEvent, layoutIt->firstCell, (int)(layoutIt - stageLayouts.begin()));
+			if (layoutIt->packed && !layoutIt->packedWeightsCurrent)
+			{
+				packStageWeights(*layoutIt);
+			}
+			if (layoutIt->dense || layoutIt->packed)
+			{
+				forwardPropagateDenseStage(*layoutIt, batchSize);
+				continue;
+			}
+
+			//Every cell only writes its own row, so the cells of a stage are split across the threads.
+			for (std::vector<cell*>::iterator it = layoutIt->otherCells.begin(); it != layoutIt->otherCells.end(); ++it)
+			{
+				(*it)->forwardPropagate(values, batchSize);
+			}
+			const std::vector<neuron*> &neurons = layoutIt->neurons;
+			pool->parallelFor((int)neurons.size(), getChunkSize((int)neurons.size(), 1), [&](int start, int end)
+			{
+				for (int neuronIndex = start; neuronIndex < end; ++neuronIndex)
+				{
+					TRACE_SCOPE(forwardCellEvent, neurons[neuronIndex]->getIndex(), (int)(layoutIt - stageLayouts.begin()));
+					neurons[neuronIndex]->forwardPropagate(values, batchSize);
+					TRACE_SCOPE_STATS(values.getRow(neurons[neuronIndex]->getIndex()), batchSize);
+				}
+			});
+		}
+		activateSoftmaxOutputs(batchSize);
+	}
+
+	activationFunctionType neuralNetwork::getActivationFunction(int cellIndex) const
+	{
+		return findNeuron(cellIndex)->getActivationFunction().type;
+	}
+
+	float neuralNetwork::getBias(int cellIndex) const
+	{
+		return findNeuron(cellIndex)->getBias();
+	}
+
+	int neuralNetwork::getCellCount() const
+	{
+		return inputNodes + (int)cells.size();
+	}
+
+	int neuralNetwork::getConnectionCount() const
+	{
+		int connectionCount = 0;
+		for (std::vector<cell*>::const_iterator it = cells.begin(); it != cells.end(); ++it)
+		{
+			connectionCount += (*it)->getConnectionBlock().getRowLength((*it)->getConnectionRow());
+		}
+		return connectionCount;
+	}
+
+	float neuralNetwork::getDropRatePercent(int cellIndex) const
+	{
+		return findNeuron(cellIndex)->getDropRatePercent();
+	}
+
+	std::uint64_t neuralNetwork::getDropoutSeed() const
+	{
+		return dropoutSeed;
+	}
+
+	executionMode neuralNetwork::getExecutionMode() const
+	{
+		return execution;
+	}
+
+	bool neuralNetwork::getFastActivation(int cellIndex) const
+	{
+		return findNeuron(cellIndex)->getActivationFunction().fastApproximation;
+	}
+
+	int neuralNetwork::getInputNodes() const
+	{
+		return inputNodes;
+	}
+
+	void neuralNetwork::getOutput(batchTensor &output) const
+	{
+		if (outputNodes > (int)cells.size())
+		{
+			throw std::out_of_range("The network has more output nodes than cells.");
+		}
+		int batchSize = values.getBatchSize();
+		int firstOutput = getCellCount() - outputNodes;
+		output.resize(outputNodes, batchSize);
+		for (int outputIndex = 0; outputIndex < outputNodes && firstOutput + outputIndex < values.getRowCount(); ++outputIndex)
+		{
+			std::copy(values.getRow(firstOutput + outputIndex), values.getRow(firstOutput + outputIndex) + batchSize, output.getRow(outputIndex));
+		}
+	}
+
+	int neuralNetwork::getOutputNodes() const
+	{
+		return outputNodes;
+	}
+
+	int neuralNetwork::getStageCount() const
+	{
+		return (int)schedule.size();
+	}
+
+	int neuralNetwork::getThreadCount() const
+	{
+		return pool ? pool->getThreadCount() : DEFAULT_THREAD_COUNT;
+	}
+
+	void neuralNetwork::getTrainingState(float *output) const
+	{
+		for (int stageIndex = 0; stageIndex < getStageCount(); ++stageIndex)
+		{
+			getTrainingState(stageIndex, output);
+			output += getTrainingStateSize(stageIndex);
+		}
+	}
+
+	void neuralNetwork::getTrainingState(int stageIndex, float *output) const
+	{
+		const std::list<cell*> &stage = findStage(stageIndex);
+		for (std::list<cell*>::const_iterator it = stage.begin(); it != stage.end(); ++it)
+		{
+			const neuron *current = dynamic_cast<const neuron*>(*it);
+			if (!current)
+			{
+				throw cell_not_neuron();
+			}
+			output += current->getTrainingState(output);
+		}
+	}
+
+	int neuralNetwork::getTrainingStateSize() const
+	{
+		int stateSize = 0;
+		for (int stageIndex = 0; stageIndex < getStageCount(); ++stageIndex)
+		{
+			stateSize += getTrainingStateSize(stageIndex);
+		}
+		return stateSize;
+	}
+
+	int neuralNetwork::getTrainingStateSize(int stageIndex) const
+	{
+		int stateSize = 0;
+		const std::list<cell*> &stage = findStage(stageIndex);
+		for (std::list<cell*>::const_iterator it = stage.begin(); it != stage.end(); ++it)
+		{
+			const neuron *current = dynamic_cast<const neuron*>(*it);
+			if (!current)
+			{
+				throw cell_not_neuron();
+			}
+			stateSize += current->getTrainingStateSize();
+		}
+		return stateSize;
+	}
+
+	void neuralNetwork::getWeights(int cellIndex, std::list<float> &output) const
+	{
+		findNeuron(cellIndex)->getWeights(output);
+	}
+
+	void neuralNetwork::load(const std::string &fileName)
+	{
+		mappedFile file(fileName);
+		validateModelFile(file);
+		const modelFileHeader *header = reinterpret_cast<const modelFileHeader*>(file.getData());
+		const modelFileNeuron *records = reinterpret_cast<const modelFileNeuron*>(file.getData() + sizeof(modelFileHeader));
+		const int *fileColumns = reinterpret_cast<const int*>(file.getData() + header->columnsOffset);
+		const float *fileWeights = reinterpret_cast<const float*>(file.getData() + header->weightsOffset);
+		bool hasOptimizerState = (header->flags & modelHasOptimizerState) != 0;
+		const float *filePreviousWeightChanges = hasOptimizerState ? reinterpret_cast<const float*>(file.getData() + header->previousWeightChangesOffset) : NULL;
+
+		deleteSchedule();
+		dropoutSeed = header->dropoutSeed;
+		inputNodes = header->inputNodes;
+		outputNodes = header->outputNodes;
+		trainingStep = hasOptimizerState ? header->trainingStep : 0;
+		while ((int)schedule.size() < header->stageCount)
+		{
+			schedule.push_back(std::list<cell*>());
+		}
+
+		//Adding the neurons in cell index order gives them their saved indexes, and each stage's rows go straight into one block.
+		std::vector<std::shared_ptr<connectionBlock>> stageBlocks(header->stageCount);
+		for (int neuronIndex = 0; neuronIndex < header->neuronCount; ++neuronIndex)
+		{
+			const modelFileNeuron &record = records[neuronIndex];
+			neuron *newNeuron = findNeuron(addNeuron(record.stage, (record.flags & modelNeuronPropagateFurther) != 0));
+			activationFunctionInfo newActFunc = buildActFuncBundle((activationFunctionType)record.activationType);
+			newActFunc.fastApproximation = (record.flags & modelNeuronFastActivation) != 0;
+			newNeuron->setActivationFunction(newActFunc);
+			newNeuron->setBias(record.bias);
+			newNeuron->setDropRatePercent(record.dropRatePercent);
+			newNeuron->setLearningRate(record.learningRate);
+			newNeuron->setMomentum(record.momentum);
+			newNeuron->setPreviousBiasChange(hasOptimizerState ? record.previousBiasChange : 0.0f);
+			newNeuron->setWeightDecay(record.weightDecay);
+			if (!stageBlocks[record.stage])
+			{
+				stageBlocks[record.stage] = std::make_shared<connectionBlock>();
+			}
+			newNeuron->setConnections(stageBlocks[record.stage], stageBlocks[record.stage]->appendRow(fileColumns + record.firstConnection, fileWeights + record.firstConnection,
+				filePreviousWeightChanges ? filePreviousWeightChanges + record.firstConnection : NULL, record.connectionCount));
+		}
+		stagesAnalyzed = false;
+	}
+
+	/*Analyzing the stages first gives every stage one block, so the connections picked across
+	  the stage are marked in one vector and the block is compacted once.*/
+	int neuralNetwork::pruneConnections(float fraction, pruningScope scope)
+	{
+		if (!(fraction >= 0.0f && fraction <= 1.0f))
+		{
+			throw std::out_of_range("The fraction of connections pruned must be between zero and one.");
+		}
+		for (std::list<std::list<cell*>>::iterator scheduleIt = schedule.begin(); scheduleIt != schedule.end(); ++scheduleIt)
+		{
+			separateSharedBlocks(*scheduleIt);
+		}
+		if (!stagesAnalyzed)
+		{
+			analyzeStages();
+		}
+
+		int removed = 0;
+		std::vector<bool> marked;
+		//Position in the block of each connection being compared, which are partly sorted by weight magnitude to find the smallest.
+		std::vector<int> candidates;
+		for (std::vector<stageLayout>::iterator layoutIt = stageLayouts.begin(); layoutIt != stageLayouts.end(); ++layoutIt)
+		{
+			if (layoutIt->neurons.empty())
+			{
+				continue;
+			}
+
+			connectionBlock &block = layoutIt->neurons.front()->getConnectionBlock();
+			const float *weights = block.getWeights(0);
+			marked.assign(block.getConnectionCount(), false);
+			candidates.clear();
+			for (std::vector<neuron*>::const_iterator it = layoutIt->neurons.begin(); it != layoutIt->neurons.end(); ++it)
+			{
+				int row = (*it)->getConnectionRow();
+				int rowStart = (int)(block.getWeights(row) - weights);
+				for (int i = 0; i < block.getRowLength(row); ++i)
+				{
+					candidates.push_back(rowStart + i);
+				}
+
+				//With per neuron pruning the candidates are picked from after each row is added.
+				if (scope == perNeuronPruning || it + 1 == layoutIt->neurons.end())
+				{
+					int pruned = (int)std::lround(candidates.size() * (double)fraction);
+					std::nth_element(candidates.begin(), candidates.begin() + pruned, candidates.end(), [weights](int first, int second)
+					{
+						return std::fabs(weights[first]) < std::fabs(weights[second]);
+					});
+					for (int i = 0; i < pruned; ++i)
+					{
+						marked[candidates[i]] = true;
+					}
+					candidates.clear();
+				}
+			}
+			removed += block.removeConnections(marked);
+		}
+		stagesAnalyzed = false;
+		return removed;
+	}
+
+	bool neuralNetwork::removeConnection(int cellIndex, int connectionIndex)
+	{
+		cell *target = findCell(cellIndex);
+		separateSharedBlocks(findStage(cellStages[cellIndex - inputNodes]));
+		stagesAnalyzed = false;
+		return target->removeConnection(connectionIndex);
+	}
+
+	void neuralNetwork::save(const std::string &fileName, bool includeOptimizerState) const
+	{
+		modelFileHeader header = modelFileHeader();
+		std::copy("NNMODEL", "NNMODEL" + 8, header.magic);
+		header.version = MODEL_FILE_VERSION;
+		header.flags = includeOptimizerState ? modelHasOptimizerState : 0;
+		header.inputNodes = inputNodes;
+		header.outputNodes = outputNodes;
+		header.neuronCount = (int)cells.size();
+		header.stageCount = (int)schedule.size();
+		header.dropoutSeed = dropoutSeed;
+		header.trainingStep = includeOptimizerState ? trainingStep : 0;
+
+		std::vector<modelFileNeuron> records(cells.size());
+		std::vector<const neuron*> neurons(cells.size());
+		for (std::size_t neuronIndex = 0; neuronIndex < cells.size(); ++neuronIndex)
+		{
+			neurons[neuronIndex] = dynamic_cast<const neuron*>(cells[neuronIndex]);
+			if (!neurons[neuronIndex])
+			{
+				throw cell_not_neuron();
+			}
+			const neuron &current = *neurons[neuronIndex];
+			activationFunctionInfo actFunc = current.getActivationFunction();
+			if (actFunc.type == customFunction)
+			{
+				throw activation_function_not_found();
+			}
+			modelFileNeuron &record = records[neuronIndex];
+			record.firstConnection = header.connectionCount;
+			record.connectionCount = current.getConnectionBlock().getRowLength(current.getConnectionRow());
+			record.stage = cellStages[neuronIndex];
+			record.activationType = actFunc.type;
+			record.flags = (current.getPropagateFurther() ? modelNeuronPropagateFurther : 0) | (actFunc.fastApproximation ? modelNeuronFastActivation : 0);
+			record.bias = current.getBias();
+			record.dropRatePercent = current.getDropRatePercent();
+			record.learningRate = current.getLearningRate();
+			record.momentum = current.getMomentum();
+			record.previousBiasChange = includeOptimizerState ? current.getPreviousBiasChange() : 0.0f;
+			record.weightDecay = current.getWeightDecay();
+			header.connectionCount += record.connectionCount;
+		}
+		header.columnsOffset = alignModelOffset(sizeof(modelFileHeader) + records.size() * sizeof(modelFileNeuron));
+		header.weightsOffset = alignModelOffset(header.columnsOffset + header.connectionCount * sizeof(std::int32_t));
+		header.previousWeightChangesOffset = includeOptimizerState ? alignModelOffset(header.weightsOffset + header.connectionCount * sizeof(float)) : 0;
+
+		std::ofstream file(fileName.c_str(), std::ios::binary);
+		if (!file)
+		{
+			throw std::runtime_error("Couldn't open the model file for writing.");
+		}
+		const char padding[MODEL_FILE_ALIGNMENT] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!records.empty())
+		{
+			file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(modelFileNeuron));
+		}
+
+		//Each array is written row by row straight from the blocks after padding up to its offset.
+		for (int array = 0; array < (includeOptimizerState ? 3 : 2); ++array)
+		{
+			std::uint64_t offset = array == 0 ? header.columnsOffset : array == 1 ? header.weightsOffset : header.previousWeightChangesOffset;
+			file.write(padding, (std::streamsize)(offset - (std::uint64_t)file.tellp()));
+			for (std::vector<const neuron*>::const_iterator it = neurons.begin(); it != neurons.end(); ++it)
+			{
+				const connectionBlock &block = (*it)->getConnectionBlock();
+				int row = (*it)->getConnectionRow();
+				const void *rowData = array == 0 ? (const void*)block.getColumns(row) : array == 1 ? (const void*)block.getWeights(row) : (const void*)block.getPreviousWeightChanges(row);
+				file.write(static_cast<const char*>(rowData), block.getRowLength(row) * (array == 0 ? sizeof(std::int32_t) : sizeof(float)));
+			}
+		}
+		if (!file)
+		{
+			throw std::runtime_error("Couldn't write the model file.");
+		}
+	}
+
+	void neuralNetwork::setActivationFunction(int cellIndex, activationFunctionType newType)
+	{
+		setActivationFunction(cellIndex, buildActFuncBundle(newType));
+	}
+
+	void neuralNetwork::setActivationFunction(int cellIndex, const activationFunctionInfo &newActFunc)
+	{
+		neuron *target = findNeuron(cellIndex);
+		if (newActFunc.type == softmaxFunction && cellIndex < getCellCount() - outputNodes)
+		{
+			throw std::out_of_range("Softmax can only be used by output nodes.");
+		}
+		target->setActivationFunction(newActFunc);
+		stagesAnalyzed = false;
+	}
+
+	void neuralNetwork::setBias(int cellIndex, float newBias)
+	{
+		findNeuron(cellIndex)->setBias(newBias);
+	}
+
+	void neuralNetwork::setDropRatePercent(int cellIndex, float newDropRatePercent)
+	{
+		if (newDropRatePercent < 0 || newDropRatePercent > 1)
+		{
+			throw std::out_of_range("The drop rate has to be between zero and one.");
+		}
+		findNeuron(cellIndex)->setDropRatePercent(newDropRatePercent);
+		stagesAnalyzed = false;
+	}
+
+	void neuralNetwork::setDropoutSeed(std::uint64_t newDropoutSeed)
+	{
+		dropoutSeed = newDropoutSeed;
+		trainingStep = 0;
+	}
+
+	void neuralNetwork::setExecutionMode(executionMode newExecution)
+	{
+		execution = newExecution;
+		stagesAnalyzed = false;
+	}
+
+	void neuralNetwork::setFastActivation(int cellIndex, bool newFastApproximation)
+	{
+		neuron *target = findNeuron(cellIndex);
+		activationFunctionInfo newActFunc = target->getActivationFunction();
+		newActFunc.fastApproximation = newFastApproximation;
+		target->setActivationFunction(newActFunc);
+	}
+
+	void neuralNetwork::setFastActivations(bool newFastApproximation)
+	{
+		for (std::vector<cell*>::iterator it = cells.begin(); it != cells.end(); ++it)
+		{
+			if (dynamic_cast<neuron*>(*it))
+			{
+				setFastActivation((*it)->getIndex(), newFastApproximation);
+			}
+		}
+	}
+
+	void neuralNetwork::setThreadCount(int newThreadCount)
+	{
+		if (newThreadCount < 1)
+		{
+			throw std::out_of_range("The network needs at least one thread.");
+		}
+		if (!pool || newThreadCount != pool->getThreadCount())
+		{
+			pool.reset(new threadPool(newThreadCount));
+		}
+	}
+
+	void neuralNetwork::setTrainingState(const float *ref)
+	{
+		for (int stageIndex = 0; stageIndex < getStageCount(); ++stageIndex)
+		{
+			setTrainingState(stageIndex, ref);
+			ref += getTrainingStateSize(stageIndex);
+		}
+	}
+
+	void neuralNetwork::setTrainingState(int stageIndex, const float *ref)
+	{
+		const std::list<cell*> &stage = findStage(stageIndex);
+		separateSharedBlocks(stage);
+		for (std::list<cell*>::const_iterator it = stage.begin(); it != stage.end(); ++it)
+		{
+			neuron *current = dynamic_cast<neuron*>(*it);
+			if (!current)
+			{
+				throw cell_not_neuron();
+			}
+			ref += current->setTrainingState(ref);
+		}
+		invalidatePackedWeights();
+	}
+
+	void neuralNetwork::setWeights(int cellIndex, const std::list<float> &ref)
+	{
+		neuron *target = findNeuron(cellIndex);
+		separateSharedBlocks(findStage(cellStages[cellIndex - inputNodes]));
+		target->setWeights(ref);
+		invalidatePackedWeights();
+	}
+
+	void neuralNetwork::activateSoftmaxOutputs(int batchSize)
+	{
+		if (softmaxOutputs.empty())
+		{
+			return;
+		}
+
+		//Each batch element is gathered into a contiguous row so the softmax runs over the outputs together.
+		int outputCount = (int)softmaxOutputs.size();
+		pool->parallelFor(batchSize, getChunkSize(batchSize, KERNEL_TILE_COLUMNS), [&](int start, int end)
+		{
+			static thread_local std::vector<float> outputValues;
+			outputValues.resize(outputCount);
+			for (int batchIndex = start; batchIndex < end; ++batchIndex)
+			{
+				for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+				{
+					outputValues[outputIndex] = values.getRow(softmaxOutputs[outputIndex])[batchIndex];
+				}
+				softmaxSpan(outputValues.data(), outputCount);
+				for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+				{
+					values.getRow(softmaxOutputs[outputIndex])[batchIndex] = outputValues[outputIndex];
+				}
+			}
+		});
+	}
+
+	void neuralNetwork::analyzeDataflow()
+	{
+		int cellCount = (int)cells.size();
+		dataflow.usable = true;
+		dataflow.neurons.assign(cellCount, NULL);
+		for (int cellIndex = 0; cellIndex < cellCount; ++cellIndex)
+		{
+			dataflow.neurons[cellIndex] = dynamic_cast<neuron*>(cells[cellIndex]);
+			dataflow.usable = dataflow.usable && dataflow.neurons[cellIndex];
+		}
+		if (!dataflow.usable)
+		{
+			return;
+		}
+
+		//Counts the dependencies of each cell before placing the entries back to back.
+		dataflow.forwardDependencies.assign(cellCount, 0);
+		dataflow.backwardDependencies.assign(cellCount, 0);
+		dataflow.dependentOffsets.assign(cellCount + 1, 0);
+		dataflow.errorOffsets.assign(cellCount + 1, 0);
+		dataflow.gradientOffsets.assign(cellCount + 1, 0);
+		for (int cellIndex = 0; cellIndex < cellCount; ++cellIndex)
+		{
+			const connectionBlock &block = cells[cellIndex]->getConnectionBlock();
+			int row = cells[cellIndex]->getConnectionRow();
+			const int *columns = block.getColumns(row);
+			dataflow.gradientOffsets[cellIndex + 1] = dataflow.gradientOffsets[cellIndex] + block.getRowLength(row);
+			for (int i = 0; i < block.getRowLength(row); ++i)
+			{
+				if (columns[i] < inputNodes)
+				{
+					continue;
+				}
+				int connectedCell = columns[i] - inputNodes;
+				++dataflow.forwardDependencies[cellIndex];
+				++dataflow.dependentOffsets[connectedCell + 1];
+				if (cells[cellIndex]->getPropagateFurther())
+				{
+					++dataflow.backwardDependencies[connectedCell];
+					++dataflow.errorOffsets[connectedCell + 1];
+				}
+			}
+		}
+		std::partial_sum(dataflow.dependentOffsets.begin(), dataflow.dependentOffsets.end(), dataflow.dependentOffsets.begin());
+		std::partial_sum(dataflow.errorOffsets.begin(), dataflow.errorOffsets.end(), dataflow.errorOffsets.begin());
+
+		//The entries of each cell are placed in order of cell index, so the errors are gathered in a fixed order.
+		std::vector<int> dependentEnds(dataflow.dependentOffsets.begin(), dataflow.dependentOffsets.end() - 1);
+		std::vector<int> errorEnds(dataflow.errorOffsets.begin(), dataflow.errorOffsets.end() - 1);
+		dataflow.dependents.resize(dataflow.dependentOffsets.back());
+		dataflow.errorSources.resize(dataflow.errorOffsets.back());
+		dataflow.errorWeights.resize(dataflow.errorOffsets.back());
+		for (int cellIndex = 0; cellIndex < cellCount; ++cellIndex)
+		{
+			const connectionBlock &block = cells[cellIndex]->getConnectionBlock();
+			int row = cells[cellIndex]->getConnectionRow();
+			const int *columns = block.getColumns(row);
+			const float *weights = block.getWeights(row);
+			for (int i = 0; i < block.getRowLength(row); ++i)
+			{
+				if (columns[i] < inputNodes)
+				{
+					continue;
+				}
+				int connectedCell = columns[i] - inputNodes;
+				dataflow.dependents[dependentEnds[connectedCell]++] = cellIndex;
+				if (cells[cellIndex]->getPropagateFurther())
+				{
+					dataflow.errorSources[errorEnds[connectedCell]] = cellIndex;
+					dataflow.errorWeights[errorEnds[connectedCell]++] = weights + i;
+				}
+			}
+		}
+
+		dataflow.pendingDependencies.reset(new std::atomic<int>[cellCount]);
+		dataflow.readyCells.reset(new std::atomic<int>[cellCount]);
+	}
+
+	void neuralNetwork::analyzePacking(stageLayout &layout) const
+	{
+		if (layout.neurons.empty() || !layout.otherCells.empty())
+		{
+			return;
+		}
+
+		const connectionBlock &block = layout.neurons.front()->getConnectionBlock();
+		int firstColumn = getCellCount(), lastColumn = -1;
+		for (int neuronIndex = 0; neuronIndex < (int)layout.neurons.size(); ++neuronIndex)
+		{
+			const neuron *currentNeuron = layout.neurons[neuronIndex];
+			int row = currentNeuron->getConnectionRow();
+			int rowLength = block.getRowLength(row);
+			if (currentNeuron->getIndex() != layout.firstCell + neuronIndex)
+			{
+				return;
+			}
+			if (rowLength > 0)
+			{
+				firstColumn = std::min(firstColumn, block.getColumns(row)[0]);
+				lastColumn = std::max(lastColumn, block.getColumns(row)[rowLength - 1]);
+			}
+		}
+		if (lastColumn < firstColumn)
+		{
+			return;
+		}
+
+		int span = lastColumn - firstColumn + 1;
+		if (block.getConnectionCount() >= PACKED_MATRIX_DENSITY * span * (float)layout.neurons.size())
+		{
+			layout.connectionCount = span;
+			layout.firstConnection = firstColumn;
+			layout.packed = true;
+		}
+	}
+
+	void neuralNetwork::analyzeStages()
+	{
+		compactStages();
+		stageLayouts.assign(schedule.size(), stageLayout());
+		std::vector<stageLayout>::iterator layoutIt = stageLayouts.begin();
+		for (std::list<std::list<cell*>>::iterator scheduleIt = schedule.begin(); scheduleIt != schedule.end(); ++scheduleIt, ++layoutIt)
+		{
+			layoutIt->dense = !scheduleIt->empty();
+			layoutIt->firstCell = scheduleIt->empty() ? 0 : scheduleIt->front()->getIndex();
+			layoutIt->propagateFurther = scheduleIt->empty() ? false : scheduleIt->front()->getPropagateFurther();
+			layoutIt->connectionCount = 0;
+			layoutIt->firstConnection = 0;
+
+			int row = 0;
+			for (std::list<cell*>::iterator it = scheduleIt->begin(); it != scheduleIt->end(); ++it, ++row)
+			{
+				neuron *currentNeuron = dynamic_cast<neuron*>(*it);
+				if (currentNeuron)
+				{
+					layoutIt->neurons.push_back(currentNeuron);
+				}
+				else
+				{
+					layoutIt->otherCells.push_back(*it);
+				}
+				if (!layoutIt->dense)
+				{
+					continue;
+				}
+
+				const connectionBlock &block = (*it)->getConnectionBlock();
+				int rowLength = block.getRowLength((*it)->getConnectionRow());
+
+				//The first row decides the range of connections every other row has to match.
+				if (row == 0)
+				{
+					layoutIt->connectionCount = rowLength;
+					layoutIt->firstConnection = rowLength > 0 ? block.getColumns((*it)->getConnectionRow())[0] : 0;
+				}
+
+				//Since the columns are sorted and unique, matching the first and last column means the row is the full range.
+				const int *columns = rowLength > 0 ? block.getColumns((*it)->getConnectionRow()) : NULL;
+				if (!currentNeuron || rowLength == 0 || rowLength != layoutIt->connectionCount || (*it)->getConnectionRow() != row
+					|| &block != &scheduleIt->front()->getConnectionBlock() || (*it)->getIndex() != layoutIt->firstCell + row
+					|| (*it)->getPropagateFurther() != layoutIt->propagateFurther
+					|| columns[0] != layoutIt->firstConnection || columns[rowLength - 1] != layoutIt->firstConnection + rowLength - 1)
+				{
+					layoutIt->dense = false;
+				}
+			}
+			layoutIt->packed = false;
+			if (!layoutIt->dense)
+			{
+				indexStageErrors(*layoutIt);
+				analyzePacking(*layoutIt);
+			}
+		}
+
+		dropoutNeurons.clear();
+		for (std::vector<cell*>::iterator it = cells.begin(); it != cells.end(); ++it)
+		{
+			neuron *currentNeuron = dynamic_cast<neuron*>(*it);
+			if (currentNeuron && currentNeuron->getDropRatePercent() > 0)
+			{
+				dropoutNeurons.push_back(currentNeuron);
+			}
+		}
+
+		softmaxOutputs.clear();
+		for (int cellIndex = getCellCount() - outputNodes; cellIndex < getCellCount(); ++cellIndex)
+		{
+			neuron *output = dynamic_cast<neuron*>(cells[cellIndex - inputNodes]);
+			if (output && output->getActivationFunction().type == softmaxFunction)
+			{
+				softmaxOutputs.push_back(cellIndex);
+			}
+		}
+
+		dataflow.usable = false;
+		if (execution == dataflowExecution)
+		{
+			analyzeDataflow();
+		}
+		stagesAnalyzed = true;
+	}
+
+	void neuralNetwork::backwardPropagateDataflow(int batchSize)
+	{
+		int cellCount = (int)cells.size();
+		cellDeltas.resize(cellCount, batchSize);
+		weightGradients.resize(dataflow.gradientOffsets.back());
+
+		//A cell is ready once every cell that propagates its error onto it has found its delta.
+		runDataflow(dataflow.backwardDependencies, [&](int cellIndex)
+		{
+			TRACE_SCOPE(backwardCellEvent, inputNodes + cellIndex, cellStages[cellIndex]);
+			neuron *currentNeuron = dataflow.neurons[cellIndex];
+			float *cellError = errors.getRow(inputNodes + cellIndex);
+			const vectorKernels &kernels = getKernels();
+			for (int entry = dataflow.errorOffsets[cellIndex]; entry < dataflow.errorOffsets[cellIndex + 1]; ++entry)
+			{
+				kernels.addVectors(cellError, cellDeltas.getRow(dataflow.errorSources[entry]), *dataflow.errorWeights[entry], batchSize);
+			}
+
+			if (dataflow.gradientOffsets[cellIndex + 1] > dataflow.gradientOffsets[cellIndex])
+			{
+				float *delta = cellDeltas.getRow(cellIndex);
+				currentNeuron->calculateDelta(values, batchSize, errors, delta);
+				TRACE_SCOPE_STATS(delta, batchSize);
+				currentNeuron->updateBias(cellError, batchSize);
+				currentNeuron->calculateWeightGradients(values, batchSize, delta, weightGradients.data() + dataflow.gradientOffsets[cellIndex]);
+			}
+			std::fill(cellError, cellError + batchSize, 0.0f);
+		}, true);
+
+		pool->parallelFor(cellCount, getChunkSize(cellCount, 1), [&](int start, int end)
+		{
+			for (int cellIndex = start; cellIndex < end; ++cellIndex)
+			{
+				if (dataflow.gradientOffsets[cellIndex + 1] > dataflow.gradientOffsets[cellIndex])
+				{
+					dataflow.neurons[cellIndex]->updateWeights(weightGradients.data() + dataflow.gradientOffsets[cellIndex], batchSize);
+				}
+			}
+		});
+	}
+
+	void neuralNetwork::backwardPropagateDenseStage(const stageLayout &layout, int batchSize)
+	{
+		int neuronCount = (int)layout.neurons.size();
+		int connectionCount = layout.connectionCount;
+		const float *weights = layout.neurons.front()->getConnectionBlock().getWeights(0);
+
+		//The deltas are calculated and the biases updated before any weights change.
+		stageDeltas.resize(neuronCount, batchSize);
+		pool->parallelFor(neuronCount, getChunkSize(neuronCount, 1), [&](int start, int end)
+		{
+			for (int neuronIndex = start; neuronIndex < end; ++neuronIndex)
+			{
+				layout.neurons[neuronIndex]->calculateDelta(values, batchSize, errors, stageDeltas.getRow(neuronIndex));
+				layout.neurons[neuronIndex]->updateBias(errors.getRow(layout.firstCell + neuronIndex), batchSize);
+			}
+		});
+
+		//Propagates the error to the connected cells using the weights from before the update, split by batch columns.
+		if (layout.propagateFurther)
+		{
+			pool->parallelFor(batchSize, getChunkSize(batchSize, KERNEL_TILE_COLUMNS), [&](int start, int end)
+			{
+				multiplyMatricesTransposedA(connectionCount, end - start, neuronCount, weights, connectionCount,
+					stageDeltas.getRow(0) + start, stageDeltas.getRowStride(), errors.getRow(layout.firstConnection) + start, errors.getRowStride());
+			});
+		}
+
+		//The weight gradients are split by connection so each task only packs its own part of the values.
+		weightGradients.resize((std::size_t)neuronCount * connectionCount);
+		pool->parallelFor(connectionCount, getChunkSize(connectionCount, KERNEL_TILE_COLUMNS), [&](int start, int end)
+		{
+			for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+			{
+				float *gradientRow = weightGradients.data() + (std::size_t)neuronIndex * connectionCount;
+				std::fill(gradientRow + start, gradientRow + end, 0.0f);
+			}
+			multiplyMatricesTransposedB(neuronCount, end - start, batchSize, stageDeltas.getRow(0), stageDeltas.getRowStride(),
+				values.getRow(layout.firstConnection + start), values.getRowStride(), weightGradients.data() + start, connectionCount);
+		});
+
+		//Updates the weights and sets the error of each neuron back to 0.
+		pool->parallelFor(neuronCount, getChunkSize(neuronCount, 1), [&](int start, int end)
+		{
+			for (int neuronIndex = start; neuronIndex < end; ++neuronIndex)
+			{
+				layout.neurons[neuronIndex]->updateWeights(weightGradients.data() + (std::size_t)neuronIndex * connectionCount, batchSize);
+				float *cellError = errors.getRow(layout.firstCell + neuronIndex);
+				std::fill(cellError, cellError + batchSize, 0.0f);
+			}
+		});
+	}
+
+	void neuralNetwork::backwardPropagateSparseStage(const stageLayout &layout, int batchSize)
+	{
+		int neuronCount = (int)layout.neurons.size();
+
+		//Cells that aren't neurons are run first since they add onto the error rows themselves.
+		for (std::vector<cell*>::const_iterator it = layout.otherCells.begin(); it != layout.otherCells.end(); ++it)
+		{
+			(*it)->backwardPropagate(values, batchSize, errors);
+		}
+		if (neuronCount == 0)
+		{
+			return;
+		}
+
+		//Each neuron only writes its own delta row and bias, so the neurons don't depend on each other.
+		stageDeltas.resize(neuronCount, batchSize);
+		pool->parallelFor(neuronCount, getChunkSize(neuronCount, 1), [&](int start, int end)
+		{
+			for (int neuronIndex = start; neuronIndex < end; ++neuronIndex)
+			{
+				neuron *currentNeuron = layout.neurons[neuronIndex];
+				TRACE_SCOPE(backwardCellEvent, currentNeuron->getIndex(), cellStages[currentNeuron->getIndex() - inputNodes]);
+				currentNeuron->calculateDelta(values, batchSize, errors, stageDeltas.getRow(neuronIndex));
+				TRACE_SCOPE_STATS(stageDeltas.getRow(neuronIndex), batchSize);
+				if (currentNeuron->getConnectionBlock().getRowLength(currentNeuron->getConnectionRow()) > 0)
+				{
+					currentNeuron->updateBias(errors.getRow(currentNeuron->getIndex()), batchSize);
+				}
+			}
+		});
+
+		/*Every connected cell gathers its error from the deltas in the order of the index, which
+		  gives the same sums no matter how the connected cells are split across the threads.*/
+		const connectionBlock &block = layout.neurons.front()->getConnectionBlock();
+		const float *weights = block.getWeights(0);
+		int targetCount = (int)layout.errorTargets.size();
+		pool->parallelFor(targetCount, getChunkSize(targetCount, 1), [&](int start, int end)
+		{
+			const vectorKernels &kernels = getKernels();
+			for (int targetIndex = start; targetIndex < end; ++targetIndex)
+			{
+				float *targetError = errors.getRow(layout.errorTargets[targetIndex]);
+				for (int entry = layout.errorOffsets[targetIndex]; entry < layout.errorOffsets[targetIndex + 1]; ++entry)
+				{
+					kernels.addVectors(targetError, stageDeltas.getRow(layout.errorNeurons[entry]), weights[layout.errorWeights[entry]], batchSize);
+				}
+			}
+		});
+
+		//Updates the weights and sets the error of each neuron back to 0. Each neuron's gradients are kept where its weights are in the block.
+		weightGradients.resize(block.getConnectionCount());
+		pool->parallelFor(neuronCount, getChunkSize(neuronCount, 1), [&](int start, int end)
+		{
+			for (int neuronIndex = start; neuronIndex < end; ++neuronIndex)
+			{
+				neuron *currentNeuron = layout.neurons[neuronIndex];
+				float *gradientSums = weightGradients.data() + (block.getWeights(currentNeuron->getConnectionRow()) - weights);
+				currentNeuron->calculateWeightGradients(values, batchSize, stageDeltas.getRow(neuronIndex), gradientSums);
+				currentNeuron->updateWeights(gradientSums, batchSize);
+				float *cellError = errors.getRow(currentNeuron->getIndex());
+				std::fill(cellError, cellError + batchSize, 0.0f);
+			}
+		});
+	}
+
+	void neuralNetwork::buildDropoutMasks(int batchSize)
+	{
+		//Each mask is keyed by the seed, step and cell index, so which thread builds it doesn't matter.
+		std::uint64_t step = trainingStep++;
+		pool->parallelFor((int)dropoutNeurons.size(), getChunkSize((int)dropoutNeurons.size(), 1), [&](int start, int end)
+		{
+			for (int neuronIndex = start; neuronIndex < end; ++neuronIndex)
+			{
+				dropoutNeurons[neuronIndex]->buildDropoutMask(dropoutSeed, step, batchSize);
+			}
+		});
+	}
+
+	void neuralNetwork::calculateSoftmaxErrors(int batchSize)
+	{
+		if (softmaxOutputs.empty())
+		{
+			return;
+		}
+
+		int outputCount = (int)softmaxOutputs.size();
+		pool->parallelFor(batchSize, getChunkSize(batchSize, KERNEL_TILE_COLUMNS), [&](int start, int end)
+		{
+			static thread_local std::vector<float> outputErrors, outputValues;
+			outputErrors.resize(outputCount);
+			outputValues.resize(outputCount);
+			for (int batchIndex = start; batchIndex < end; ++batchIndex)
+			{
+				for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+				{
+					outputErrors[outputIndex] = errors.getRow(softmaxOutputs[outputIndex])[batchIndex];
+					outputValues[outputIndex] = values.getRow(softmaxOutputs[outputIndex])[batchIndex];
+				}
+				softmaxDeltaSpan(outputErrors.data(), outputErrors.data(), outputValues.data(), outputCount);
+				for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+				{
+					errors.getRow(softmaxOutputs[outputIndex])[batchIndex] = outputErrors[outputIndex];
+				}
+			}
+		});
+	}
+
+	void neuralNetwork::copySchedule(const neuralNetwork &ref)
+	{
+		restoreMovedFrom();
+		cells.resize(ref.cells.size(), NULL);
+		cellStages = ref.cellStages;
+		for (std::list<std::list<cell*>>::const_iterator scheduleIt = ref.schedule.begin(); scheduleIt != ref.schedule.end(); ++scheduleIt)
+		{
+			schedule.push_back(std::list<cell*>());
+			for (std::list<cell*>::const_iterator it = scheduleIt->begin(); it != scheduleIt->end(); ++it)
+			{
+				cell *newCell = (*it)->copyInto(*cellArena, (*it)->getConnectionBlockPointer());
+				schedule.back().push_back(newCell);
+				cells[newCell->getIndex() - inputNodes] = newCell;
+			}
+		}
+	}
+
+	void neuralNetwork::deleteSchedule()
+	{
+		for (std::list<std::list<cell*>>::iterator scheduleIt = schedule.begin(); scheduleIt != schedule.end(); ++scheduleIt)
+		{
+			for (std::list<cell*>::iterator it = scheduleIt->begin(); it != scheduleIt->end(); ++it)
+			{
+				if (cellArena && cellArena->owns(*it))
+				{
+					(*it)->~cell();
+				}
+				else
+				{
+					delete *it;
+				}
+			}
+		}
+		if (cellArena)
+		{
+			cellArena->release();
+		}
+		schedule.clear();
+		cells.clear();
+		cellStages.clear();
+		stageLayouts.clear();
+		stagesAnalyzed = false;
+	}
+
+	neuralNetwork::cell* neuralNetwork::findCell(int cellIndex) const
+	{
+		if (cellIndex < inputNodes || cellIndex >= getCellCount())
+		{
+			throw std::out_of_range("The index doesn't match a cell in the network.");
+		}
+		return cells[cellIndex - inputNodes];
+	}
+
+	void neuralNetwork::forwardPropagateDataflow(int batchSize)
+	{
+		//A cell is ready once every cell it's connected to has its value.
+		runDataflow(dataflow.forwardDependencies, [&](int cellIndex)
+		{
+			TRACE_SCOPE(forwardCellEvent, inputNodes + cellIndex, cellStages[cellIndex]);
+			dataflow.neurons[cellIndex]->forwardPropagate(values, batchSize);
+			TRACE_SCOPE_STATS(values.getRow(inputNodes + cellIndex), batchSize);
+		}, false);
+	}
+
+	void neuralNetwork::forwardPropagateDenseStage(const stageLayout &layout, int batchSize)
+	{
+		int neuronCount = (int)layout.neurons.size();
+		const float *weights = layout.packed ? layout.packedWeights.data() : layout.neurons.front()->getConnectionBlock().getWeights(0);
+
+		//Predefined activations are applied to each group of columns right after it's multiplied, while it's still in the cache.
+		bool fuseActivation = true;
+		for (std::vector<neuron*>::const_iterator it = layout.neurons.begin(); it != layout.neurons.end() && fuseActivation; ++it)
+		{
+			fuseActivation = (*it)->canActivateColumns();
+		}
+
+		//The batch is split into groups of columns that each start at the bias of every neuron before the weighted values are added.
+		pool->parallelFor(batchSize, getChunkSize(batchSize, KERNEL_TILE_COLUMNS), [&](int start, int end)
+		{
+			for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+			{
+				float *cellValues = values.getRow(layout.firstCell + neuronIndex);
+				std::fill(cellValues + start, cellValues + end, layout.neurons[neuronIndex]->getBias());
+			}
+			multiplyMatrices(neuronCount, end - start, layout.connectionCount, weights, layout.connectionCount,
+				values.getRow(layout.firstConnection) + start, values.getRowStride(), values.getRow(layout.firstCell) + start, values.getRowStride());
+			if (fuseActivation)
+			{
+				for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+				{
+					layout.neurons[neuronIndex]->activateColumns(values, start, end);
+				}
+			}
+		});
+		if (fuseActivation)
+		{
+			return;
+		}
+
+		pool->parallelFor(neuronCount, getChunkSize(neuronCount, 1), [&](int start, int end)
+		{
+			for (int neuronIndex = start; neuronIndex < end; ++neuronIndex)
+			{
+				layout.neurons[neuronIndex]->activate(values, batchSize);
+			}
+		});
+	}
+
+	neuralNetwork::neuron* neuralNetwork::findNeuron(int cellIndex) const
+	{
+		neuron *output = dynamic_cast<neuron*>(findCell(cellIndex));
+		if (!output)
+		{
+			throw cell_not_neuron();
+		}
+		return output;
+	}
+
+	const std::list<neuralNetwork::cell*>& neuralNetwork::findStage(int stageIndex) const
+	{
+		if (stageIndex < 0 || stageIndex >= (int)schedule.size())
+		{
+			throw std::out_of_range("The stage index doesn't match a stage in the network.");
+		}
+		std::list<std::list<cell*>>::const_iterator scheduleIt = schedule.begin();
+		std::advance(scheduleIt, stageIndex);
+		return *scheduleIt;
+	}
+
+	int neuralNetwork::getChunkSize(int count, int minimum) const
+	{
+		//Four tasks per thread leaves enough tasks to steal without making each one too small.
+		int tasks = pool->getThreadCount() * 4;
+		int chunkSize = (count + tasks - 1) / tasks;
+		return std::max(minimum, (chunkSize + minimum - 1) / minimum * minimum);
+	}
+
+	void neuralNetwork::indexStageErrors(stageLayout &layout) const
+	{
+		layout.errorNeurons.clear();
+		layout.errorOffsets.assign(1, 0);
+		layout.errorTargets.clear();
+		layout.errorWeights.clear();
+		if (layout.neurons.empty())
+		{
+			return;
+		}
+
+		//Counts the connections to each cell so the entries can be placed in order of the cell they connect to.
+		const connectionBlock &block = layout.neurons.front()->getConnectionBlock();
+		std::vector<int> targetStarts(getCellCount() + 1, 0);
+		for (std::vector<neuron*>::const_iterator it = layout.neurons.begin(); it != layout.neurons.end(); ++it)
+		{
+			if (!(*it)->getPropagateFurther())
+			{
+				continue;
+			}
+			const int *columns = block.getColumns((*it)->getConnectionRow());
+			for (int i = 0; i < block.getRowLength((*it)->getConnectionRow()); ++i)
+			{
+				++targetStarts[columns[i] + 1];
+			}
+		}
+		for (int cellIndex = 0; cellIndex < getCellCount(); ++cellIndex)
+		{
+			if (targetStarts[cellIndex + 1] > 0)
+			{
+				layout.errorTargets.push_back(cellIndex);
+				layout.errorOffsets.push_back(layout.errorOffsets.back() + targetStarts[cellIndex + 1]);
+			}
+			targetStarts[cellIndex + 1] += targetStarts[cellIndex];
+		}
+
+		//Entries for the same cell are placed in the order of the neurons in the stage.
+		layout.errorNeurons.resize(targetStarts.back());
+		layout.errorWeights.resize(targetStarts.back());
+		const float *firstWeight = block.getWeights(0);
+		for (int neuronIndex = 0; neuronIndex < (int)layout.neurons.size(); ++neuronIndex)
+		{
+			const neuron *currentNeuron = layout.neurons[neuronIndex];
+			if (!currentNeuron->getPropagateFurther())
+			{
+				continue;
+			}
+			int row = currentNeuron->getConnectionRow();
+			const int *columns = block.getColumns(row);
+			int rowStart = (int)(block.getWeights(row) - firstWeight);
+			for (int i = 0; i < block.getRowLength(row); ++i)
+			{
+				int entry = targetStarts[columns[i]]++;
+				layout.errorNeurons[entry] = neuronIndex;
+				layout.errorWeights[entry] = rowStart + i;
+			}
+		}
+	}
+
+	void neuralNetwork::invalidatePackedWeights()
+	{
+		for (std::vector<stageLayout>::iterator layoutIt = stageLayouts.begin(); layoutIt != stageLayouts.end(); ++layoutIt)
+		{
+			layoutIt->packedWeightsCurrent = false;
+		}
+	}
+
+	void neuralNetwork::packStageWeights(stageLayout &layout) const
+	{
+		const connectionBlock &block = layout.neurons.front()->getConnectionBlock();
+		layout.packedWeights.assign((std::size_t)layout.neurons.size() * layout.connectionCount, 0.0f);
+		for (int neuronIndex = 0; neuronIndex < (int)layout.neurons.size(); ++neuronIndex)
+		{
+			int row = layout.neurons[neuronIndex]->getConnectionRow();
+			const int *columns = block.getColumns(row);
+			const float *weights = block.getWeights(row);
+			float *packedRow = layout.packedWeights.data() + (std::size_t)neuronIndex * layout.connectionCount;
+			for (int i = 0; i < block.getRowLength(row); ++i)
+			{
+				packedRow[columns[i] - layout.firstConnection] = weights[i];
+			}
+		}
+		layout.packedWeightsCurrent = true;
+	}
+
+	void neuralNetwork::restoreMovedFrom()
+	{
+		if (!cellArena)
+		{
+			cellArena.reset(new memoryArena(CELL_ARENA_CHUNK_SIZE));
+		}
+		if (!pool)
+		{
+			pool.reset(new threadPool(DEFAULT_THREAD_COUNT));
+		}
+	}
+
+	template<typename cellFunction>
+	void neuralNetwork::runDataflow(const std::vector<int> &dependencies, const cellFunction &runCell, bool backward)
+	{
+		int cellCount = (int)cells.size();
+		dataflow.readyClaimed.store(0);
+		dataflow.readyCount.store(0);
+		dataflow.stopped.store(false);
+		for (int cellIndex = 0; cellIndex < cellCount; ++cellIndex)
+		{
+			dataflow.readyCells[cellIndex].store(-1, std::memory_order_relaxed);
+			dataflow.pendingDependencies[cellIndex].store(dependencies[cellIndex], std::memory_order_relaxed);
+		}
+		for (int cellIndex = 0; cellIndex < cellCount; ++cellIndex)
+		{
+			if (dependencies[cellIndex] == 0)
+			{
+				dataflow.readyCells[dataflow.readyCount.fetch_add(1)].store(cellIndex, std::memory_order_release);
+			}
+		}
+
+		//Every cell is added to the ready list exactly once, so each thread claims slots until every cell has been run.
+		pool->parallelFor(pool->getThreadCount(), 1, [&](int, int)
+		{
+			try
+			{
+				for (int slot = dataflow.readyClaimed.fetch_add(1); slot < cellCount; slot = dataflow.readyClaimed.fetch_add(1))
+				{
+					int cellIndex;
+					while ((cellIndex = dataflow.readyCells[slot].load(std::memory_order_acquire)) < 0)
+					{
+						if (dataflow.stopped.load(std::memory_order_relaxed))
+						{
+							return;
+						}
+						std::this_thread::yield();
+					}
+					runCell(cellIndex);
+
+					//Forward notifies the cells connected to this one while backward notifies the cells this one is connected to.
+					const int *waiting;
+					int waitingCount;
+					if (backward)
+					{
+						const connectionBlock &block = cells[cellIndex]->getConnectionBlock();
+						waiting = block.getColumns(cells[cellIndex]->getConnectionRow());
+						waitingCount = cells[cellIndex]->getPropagateFurther() ? block.getRowLength(cells[cellIndex]->getConnectionRow()) : 0;
+					}
+					else
+					{
+						waiting = dataflow.dependents.data() + dataflow.dependentOffsets[cellIndex];
+						waitingCount = dataflow.dependentOffsets[cellIndex + 1] - dataflow.dependentOffsets[cellIndex];
+					}
+					for (int i = 0; i < waitingCount; ++i)
+					{
+						int waitingCell = backward ? waiting[i] - inputNodes : waiting[i];
+						if (waitingCell >= 0 && dataflow.pendingDependencies[waitingCell].fetch_sub(1, std::memory_order_acq_rel) == 1)
+						{
+							dataflow.readyCells[dataflow.readyCount.fetch_add(1)].store(waitingCell, std::memory_order_release);
+						}
+					}
+				}
+			}
+			catch (...)
+			{
+				dataflow.stopped.store(true);
+				throw;
+			}
+		});
+	}
+
+	bool neuralNetwork::separateSharedBlocks(const std::list<cell*> &stage)
+	{
+		//Counts how many of the stage's cells use each block, so any other use of a block is from another network.
+		std::unordered_map<const connectionBlock*, long> uses;
+		for (std::list<cell*>::const_iterator it = stage.begin(); it != stage.end(); ++it)
+		{
+			++uses[&(*it)->getConnectionBlock()];
+		}
+
+		bool separated = false, ownsBlocks = false;
+		std::unordered_map<const connectionBlock*, std::shared_ptr<connectionBlock>> copies;
+		for (std::list<cell*>::const_iterator it = stage.begin(); it != stage.end(); ++it)
+		{
+			const connectionBlock *block = &(*it)->getConnectionBlock();
+			std::shared_ptr<connectionBlock> &copied = copies[block];
+			if (!copied && (*it)->getConnectionBlockPointer().use_count() > uses[block])
+			{
+				copied = std::make_shared<connectionBlock>(*block);
+				separated = true;
+			}
+			else if (!copied)
+			{
+				ownsBlocks = true;
+			}
+			if (copied)
+			{
+				(*it)->setConnections(copied, (*it)->getConnectionRow());
+			}
+		}
+
+		/*use_count() is a relaxed load. Another network on another thread may have just finished
+		  copying a block and released it, and that release has to happen before this network writes
+		  to the block it now owns, or the writes race with the other network's reads.*/
+		if (ownsBlocks)
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}
+		if (separated)
+		{
+			stagesAnalyzed = false;
+		}
+		return separated;
+	}
+
+	void neuralNetwork::swap(neuralNetwork &ref) noexcept
+	{
+		std::swap(cellArena, ref.cellArena);
+		std::swap(cells, ref.cells);
+		std::swap(cellStages, ref.cellStages);
+		std::swap(cellDeltas, ref.cellDeltas);
+		std::swap(dataflow.forwardDependencies, ref.dataflow.forwardDependencies);
+		std::swap(dataflow.backwardDependencies, ref.dataflow.backwardDependencies);
+		std::swap(dataflow.dependentOffsets, ref.dataflow.dependentOffsets);
+		std::swap(dataflow.dependents, ref.dataflow.dependents);
+		std::swap(dataflow.errorOffsets, ref.dataflow.errorOffsets);
+		std::swap(dataflow.errorSources, ref.dataflow.errorSources);
+		std::swap(dataflow.errorWeights, ref.dataflow.errorWeights);
+		std::swap(dataflow.gradientOffsets, ref.dataflow.gradientOffsets);
+		std::swap(dataflow.neurons, ref.dataflow.neurons);
+		std::swap(dataflow.pendingDependencies, ref.dataflow.pendingDependencies);
+		std::swap(dataflow.readyCells, ref.dataflow.readyCells);
+		std::swap(dataflow.usable, ref.dataflow.usable);
+		std::swap(dropoutNeurons, ref.dropoutNeurons);
+		std::swap(dropoutSeed, ref.dropoutSeed);
+		std::swap(errors, ref.errors);
+		std::swap(execution, ref.execution);
+		std::swap(inputNodes, ref.inputNodes);
+		std::swap(outputNodes, ref.outputNodes);
+		std::swap(pool, ref.pool);
+		std::swap(schedule, ref.schedule);
+		std::swap(softmaxOutputs, ref.softmaxOutputs);
+		std::swap(stageDeltas, ref.stageDeltas);
+		std::swap(stageLayouts, ref.stageLayouts);
+		std::swap(stagesAnalyzed, ref.stagesAnalyzed);
+		std::swap(trainingStep, ref.trainingStep);
+		std::swap(values, ref.values);
+		std::swap(weightGradients, ref.weightGradients);
+	}
+}
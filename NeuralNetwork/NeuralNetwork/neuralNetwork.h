@@ -6,9 +6,17 @@
 #define NEURAL_NET_LIB
 
 #include "activationFunctions.h"
+#include "batchTensor.h"
+#include "inferencePlan.h"
+#include "memoryArena.h"
 #include "preprocessorFlags.h"
+#include "reducedPrecision.h"
+#include "threadPool.h"
+#include<atomic>
+#include<cstdint>
+#include<functional>
 #include<list>
-#include<mutex>
+#include<memory>
 #include<vector>
 
 namespace NeuralNetwork
@@ -16,10 +24,14 @@ namespace NeuralNetwork
 	//Default values used by the neuralNetwork.
 	static std::string DEFAULT_ACTIVATION_FUNCTION = "sigmoid";
 	static float DEFAULT_DROP_OFF_RATE = 0.0f;
+	static std::uint64_t DEFAULT_DROPOUT_SEED = 0x2545F4914F6CDD1DULL;
 	static float DEFAULT_LEARNING_RATE = 0.2f;
 	static float DEFAULT_MAX_START_WEIGHT = 1.0f;
 	static float DEFAULT_MIN_START_WEIGHT = -1.0f;
 	static float DEFAULT_MOMENTUM = 0.9f;
+	static int DEFAULT_THREAD_COUNT = 1;
+	//Size in bytes of the first chunk of the arena each network places its neurons in.
+	static std::size_t CELL_ARENA_CHUNK_SIZE = 16384;
 	static float DEFAULT_WEIGHT_DECAY = 0.0f;
 
 	enum lossType
@@ -27,53 +39,270 @@ namespace NeuralNetwork
 		mSE = 0, categoricalCrossEntropy = 1
 	};
 
+	/*How the network orders the cells while propagating. Stage execution runs each stage as a
+	 *whole before starting the next one. Dataflow execution runs each cell as soon as the cells
+	 *it depends on are done, which keeps the threads busy on irregular networks with skip
+	 *connections but runs dense stages one neuron at a time.*/
+	enum executionMode
+	{
+		stageExecution = 0, dataflowExecution = 1
+	};
+
+	/*Which connections are compared with each other while pruning. Per neuron pruning removes the
+	 *same fraction of every neuron's connections while per stage pruning removes the smallest
+	 *weights of the whole stage, so some neurons can lose more of their connections than others.*/
+	enum pruningScope
+	{
+		perNeuronPruning = 0, perStagePruning = 1
+	};
+
 	class neuralNetwork
 	{
 	public:
 		neuralNetwork();
+		/*Creates an empty network with the given number of input and output nodes. The input nodes
+		 *take up the first cell indexes and every neuron added afterwards is given the next index.*/
+		neuralNetwork(int, int);
+		/*Copies share the blocks of connections and weights of the network they're copied from
+		 *until one of them changes a block by adding, removing or pruning connections, setting
+		 *weights or training, which gives that network its own copy of the block first. Copies
+		 *that are only forward propagated or compiled never copy the weights.*/
 		neuralNetwork(const neuralNetwork&);
+		/*Takes the schedule, arena, thread pool and buffers of the other network without copying
+		 *or allocating anything, leaving it an empty network with no input or output nodes. The
+		 *moved network gets a new arena and thread pool once it's given neurons, copied into or
+		 *propagated.*/
+		neuralNetwork(neuralNetwork&&) noexcept;
 		~neuralNetwork();
 		neuralNetwork& operator=(const neuralNetwork&);
+		neuralNetwork& operator=(neuralNetwork&&) noexcept;
+
+		/*Attempts to add a connection from a cell to an input node or a cell scheduled in an earlier
+		 *stage. Will return false if the connection already exists. Also, if no weight is given, a
+		 *random weight is generated for the connection.*/
+		bool addConnection(int, int);
+		bool addConnection(int, int, float);
+		/*Adds a new neuron to the given stage, creating any stages needed before it, and returns
+		 *the cell index of the new neuron.*/
+		int addNeuron(int, bool);
+		/*Backward propagates the difference between the target tensor, which has a row for each
+		 *output node, and the output of the last forward propagation through the network while
+		 *updating the weights of every neuron.*/
+		void backwardPropagate(const batchTensor&);
+		/*Same as above while calling the function with the index of each stage once the stage
+		 *has been updated, starting from the last stage. The stage's training state is final for
+		 *the batch by then, so it can be sent elsewhere while the earlier stages are still being
+		 *backward propagated. With dataflow execution every stage is called at the end.*/
+		void backwardPropagate(const batchTensor&, const std::function<void(int)>&);
+		/*Packs the connections of every cell in a stage into one compressed sparse row block per
+		 *stage, so propagating a stage streams through contiguous memory.*/
+		void compactStages();
+		/*Returns a frozen copy of the network for serving that only holds the weights, biases and
+		 *activation functions of each stage. Dropout isn't applied by the plan. Throws
+		 *cell_not_neuron if the network has a cell that isn't a neuron.*/
+		inferencePlan compileForInference();
+		/*Same as above with the weights of the plan and the values it passes between stages
+		 *stored in the given precision. The network keeps its float weights as the master copy,
+		 *so training isn't affected and the plan is compiled again to pick up the updates.*/
+		inferencePlan compileForInference(storagePrecision);
+		/*Runs a batch through the network. The input tensor has a row for each input node and the
+		 *batch size of the tensor is used as the batch size of the network.*/
+		void forwardPropagate(const batchTensor&);
+		activationFunctionType getActivationFunction(int) const;
+		float getBias(int) const;
+		//Returns the number of cell indexes in the network including the input nodes.
+		int getCellCount() const;
+		//Returns the number of connections of every cell in the network.
+		int getConnectionCount() const;
+		float getDropRatePercent(int) const;
+		std::uint64_t getDropoutSeed() const;
+		executionMode getExecutionMode() const;
+		bool getFastActivation(int) const;
+		int getInputNodes() const;
+		//Copies the values of the output nodes from the last forward propagation into the tensor.
+		void getOutput(batchTensor&) const;
+		int getOutputNodes() const;
+		int getStageCount() const;
+		int getThreadCount() const;
+		/*Copies every weight, previous weight change, bias and previous bias change into the
+		 *array, one stage after another with the neurons of each stage in schedule order.
+		 *Replicas of the same network use the same order, so their states can be combined
+		 *element by element. Throws cell_not_neuron if the network has a cell that isn't a
+		 *neuron.*/
+		void getTrainingState(float*) const;
+		//Same as above for only the neurons of the given stage.
+		void getTrainingState(int, float*) const;
+		//Returns the number of floats written by getTrainingState().
+		int getTrainingStateSize() const;
+		int getTrainingStateSize(int) const;
+		void getWeights(int, std::list<float>&) const;
+		/*Replaces the network with the one saved in a model file, along with its optimizer state
+		 *if the file has it. The file is memory mapped while it's read, but the weights are copied
+		 *since training changes them. Throws model_file_not_valid if the file isn't a valid model
+		 *file and std::runtime_error if it can't be opened.*/
+		void load(const std::string&);
+		/*Removes the given fraction of the connections of each neuron or stage, rounded to the
+		 *nearest connection, picking the ones with the smallest weight magnitudes, and returns
+		 *how many were removed. Throws std::out_of_range if the fraction isn't between zero and
+		 *one.*/
+		int pruneConnections(float, pruningScope);
+		/*Attempts to remove the connection between two cells. Will return false if the connection
+		 *doesn't exist.*/
+		bool removeConnection(int, int);
+		/*Writes the schedule, connections, weights and settings of every neuron to a model file
+		 *described in modelFile.h. The previous weight and bias changes and the training step are
+		 *also written if asked for. Throws cell_not_neuron for a cell that isn't a neuron,
+		 *activation_function_not_found for a custom activation function and std::runtime_error
+		 *if the file can't be written.*/
+		void save(const std::string&, bool) const;
+		/*Sets the activation function of a neuron to a predefined function or to the given bundle.
+		 *Softmax is applied across every output node that uses it, so it throws
+		 *std::out_of_range when given a neuron that isn't an output node.*/
+		void setActivationFunction(int, activationFunctionType);
+		void setActivationFunction(int, const activationFunctionInfo&);
+		void setBias(int, float);
+		/*Sets the chance of each batch element of a neuron being dropped while propagating. The
+		 *mask of dropped elements is built before each forward propagation and reused by the
+		 *backward propagation after it.*/
+		void setDropRatePercent(int, float);
+		/*Sets the seed of the dropout masks and restarts the count of forward propagations. The
+		 *mask of each neuron only depends on the seed, how many forward propagations came before
+		 *and the cell index, so it's the same for any thread count or execution mode.*/
+		void setDropoutSeed(std::uint64_t);
+		/*Sets how the cells are ordered while propagating. Networks with cells that aren't
+		 *neurons always use stage execution.*/
+		void setExecutionMode(executionMode);
+		/*Sets whether a neuron uses the fast approximation of sigmoid for its sigmoid, tanh or
+		 *GELU function, which is within FAST_ACTIVATION_MAX_ERROR of the exact function.*/
+		void setFastActivation(int, bool);
+		//Same as above for every neuron currently in the network.
+		void setFastActivations(bool);
+		/*Sets the number of threads, including the calling thread, that each stage is split
+		 *across during propagation. The worker threads are kept alive until the thread count
+		 *changes or the network is destroyed.*/
+		void setThreadCount(int);
+		//Replaces the training state with one written by getTrainingState() of the same network.
+		void setTrainingState(const float*);
+		void setTrainingState(int, const float*);
+		void setWeights(int, const std::list<float>&);
 
 	protected:
+		/*Nested class that stores the connections of a group of cells in compressed sparse row
+		 *form. Each row holds one cell's connections with the column indexes kept sorted and the
+		 *weights and previous weight changes stored in the same order, so all three are streamed
+		 *through as flat arrays. A standalone cell owns a block with a single row while
+		 *compactStages() gives every cell in a stage a row in one shared block.*/
+		class connectionBlock
+		{
+		public:
+			connectionBlock();
+			//Adds an empty row to the end of the block and returns its index.
+			int addRow();
+			/*Copies a row of another block onto the end of this block and returns the index of the
+			 *new row.*/
+			int appendRow(const connectionBlock&, int);
+			/*Adds a row with the given columns, weights and previous weight changes onto the end of
+			 *the block and returns its index. The previous weight changes are set to zero if none
+			 *are given.*/
+			int appendRow(const int*, const float*, const float*, int);
+			const int* getColumns(int) const;
+			int getConnectionCount() const;
+			float* getPreviousWeightChanges(int);
+			const float* getPreviousWeightChanges(int) const;
+			int getRowCount() const;
+			int getRowLength(int) const;
+			float* getWeights(int);
+			const float* getWeights(int) const;
+			/*Attempts to insert a connection into a row while keeping the columns sorted. Will
+			 *return false if the row already has a connection to that column.*/
+			bool insertConnection(int, int, float);
+			/*Attempts to remove a connection from a row. Will return false if the row doesn't
+			 *have a connection to that column.*/
+			bool removeConnection(int, int);
+			/*Removes every connection marked in the vector, which has an entry for each
+			 *connection of the block in order, in one pass and returns how many were removed.*/
+			int removeConnections(const std::vector<bool>&);
+
+		private:
+			//Column index of every connection with each row stored back to back.
+			std::vector<int> columnIndexes;
+			//The amount each weight was changed last time stored in the same order as the columns.
+			std::vector<float> previousWeightChanges;
+			//Where each row starts in the arrays along with a last entry marking the end of the block.
+			std::vector<int> rowOffsets;
+			//The weight of each connection stored in the same order as the columns.
+			std::vector<float> weights;
+		};
+
 		/*Nested abstract cell class which represents each cell in the neural network.*/
 		class cell
 		{
 		public:
 			cell(bool, int);
+			/*Copies the connections of the other cell into a block owned by the new cell.*/
+			cell(const cell&);
+			virtual ~cell();
+			cell& operator=(const cell&);
 			/*Attempts to add a connection with the given index. Will return false if a connection
 			 *with that index already exists.*/
 			virtual bool addConnection(int);
 			/*Checks a vector of all indexes that can update and returns whether it can update.*/
 			bool canUpdate(const std::vector<bool>&) const;
+			/*Creates a copy of the cell that uses the same row of the given block, which is either
+			 *this cell's block or a copy of it, and returns it. Cells that don't place themselves in the
+			 *arena are created by copy() instead, so the caller has to check which it owns.*/
+			virtual cell* copyInto(memoryArena&, const std::shared_ptr<connectionBlock>&) const;
+			connectionBlock& getConnectionBlock();
+			const connectionBlock& getConnectionBlock() const;
+			//Returns the pointer to the cell's block, which other cells may share.
+			const std::shared_ptr<connectionBlock>& getConnectionBlockPointer() const;
+			int getConnectionRow() const;
 			void getConnections(std::list<int>&) const;
 			int getIndex() const;
 			bool getPropagateFurther() const;
+			/*Copies this cell's connections onto the end of the given block and switches the cell
+			 *over to using that row.*/
+			void moveConnections(const std::shared_ptr<connectionBlock>&);
 			/*Attempts to remove a connection with the given index. Will return false if a connection
 			 *doesn't exist with index already.*/
 			virtual bool removeConnection(int);
+			//Switches the cell over to using the given row of a block for its connections.
+			void setConnections(const std::shared_ptr<connectionBlock>&, int);
 			void setPropagateFurther(bool);
 
 			//Pure virutal functions:
-			virtual void backwardPropagate(std::list < std::vector<float>>&, int, std::list<std::vector<float>>&, std::mutex&) = 0;
+			/*Backward propagates the cell's error onto the cells it's connected to. The network runs
+			 *cells that aren't neurons one at a time, so they can add onto those rows directly.*/
+			virtual void backwardPropagate(batchTensor&, int, batchTensor&) = 0;
 			virtual void copy(cell*&) const = 0;
-			virtual void forwardPropagate(std::list < std::vector<float>>&, int) = 0;
+			virtual void forwardPropagate(batchTensor&, int) = 0;
 		protected:
+			//Copies the other cell while using the same row of the given block for its connections.
+			cell(const cell&, const std::shared_ptr<connectionBlock>&);
+
 			//Whether the error needs to be back propagated further.
 			bool backPropagateFurther;
 			//Index of this cell.
 			int cellIndex;
-			//List of cells connections.
-			std::list<int> connections;
+			//Block containing the cell's connections, which may be shared with the rest of its stage.
+			std::shared_ptr<connectionBlock> connections;
+			//The row of the block containing this cell's connections.
+			int connectionRow;
 		};
 		/*Nested neuron class that represents a neuron in a neural network.*/
 		//TODO: Add in final keyword and rewrite test neuralNetwork class.
-		//TODO: Consider keeping pointers to the vectors of connected cell's values and error to prevent
-		//looping.
 		class neuron : public cell
 		{
 		public:
 			neuron(bool, int);
+			//Copies the other neuron while using the same row of the given block for its connections.
+			neuron(const neuron&, const std::shared_ptr<connectionBlock>&);
+			/*Applies the activation function and drop off to the neuron's row of the tensor once the
+			 *bias and weighted connections have been added into it.*/
+			void activate(batchTensor&, int);
+			/*Applies the activation function to the columns [start, end) of the neuron's row of the
+			 *tensor. Only valid when canActivateColumns() returns true.*/
+			void activateColumns(batchTensor&, int, int);
 			/*Attempts to add a connection given an index. Will return false if a connection to
 			 *that index already exists. Also, if no weight is given, a random weight is generated
 			 *for the connection.*/
@@ -82,12 +311,26 @@ namespace NeuralNetwork
 			/*Backwards propagates the error of this neuron onto the cells it's connect to. Then,
 			 *the weights to each connection is updated before returning the error of this cell to
 			 *zero.*/
-			void backwardPropagate(std::list < std::vector<float>>&, int, std::list<std::vector<float>>&, std::mutex&);
+			void backwardPropagate(batchTensor&, int, batchTensor&);
+			/*Builds the dropout mask used by the next forward and backward propagation from the
+			 *seed and training step. Does nothing if the drop rate is zero.*/
+			void buildDropoutMask(std::uint64_t, std::uint64_t, int);
+			/*Calculates the error of the neuron multiplied by the gradient of the activation function
+			 *for each batch element and stores it in the provided array.*/
+			void calculateDelta(const batchTensor&, int, const batchTensor&, float*) const;
+			/*Calculates the sum over the batch of the given deltas multiplied by the value of each
+			 *connected cell and stores them in the same order as the connections.*/
+			void calculateWeightGradients(const batchTensor&, int, const float*, float*) const;
+			/*Returns whether the activation can be applied to part of the batch at a time, which
+			 *needs a predefined function that doesn't keep the raw values and no drop off.*/
+			bool canActivateColumns() const;
 			/*Creates a copy of the object and returns the copy in a pointer.*/
 			void copy(cell*&) const;
+			//Places the copy in the arena.
+			cell* copyInto(memoryArena&, const std::shared_ptr<connectionBlock>&) const;
 			/*Uses the values from the cells that this neuron is connected to calculate the value of 
 			 *this neuron.*/
-			void forwardPropagate(std::list < std::vector<float>>&, int);
+			void forwardPropagate(batchTensor&, int);
 			activationFunctionInfo getActivationFunction() const;
 			float getBias() const;
 			float getDropRatePercent() const;
@@ -95,43 +338,232 @@ namespace NeuralNetwork
 			float getMomentum() const;
 			float getPreviousBiasChange() const;
 			void getPreviousWeightChanges(std::list<float>&) const;
+			/*Copies the weights, previous weight changes, bias and previous bias change into the
+			 *array and returns how many floats were written.*/
+			int getTrainingState(float*) const;
+			int getTrainingStateSize() const;
 			float getWeightDecay() const;
 			void getWeights(std::list<float>&) const;
-			/*Attempts to remove a connection to the given index. Returns false if one isn't found*/
-			bool removeConnection(int);
+			/*Copies the weights into the array and returns the bias, reading each with a relaxed
+			 *atomic load so other threads can be updating them at the same time.*/
+			float getWeightsRelaxed(float*) const;
+			void setActivationFunction(const activationFunctionInfo&);
 			void setBias(float);
 			void setDropRatePercent(float);
 			void setLearningRate(float);
 			void setMomentum(float);
 			void setPreviousBiasChange(float);
 			void setPreviousWeightChanges(const std::list<float>&);
+			//Reads the state written by getTrainingState() and returns how many floats were read.
+			int setTrainingState(const float*);
 			void setWeightDecay(float);
 			void setWeights(const std::list<float>&);
+			//Updates the bias using the error of the neuron for each batch element.
+			void updateBias(const float*, int);
+			/*Same as updateWeights() followed by updateBias() given the sum of the error instead,
+			 *with every weight, bias and previous change read and written with relaxed atomic
+			 *operations. Updates from other threads at the same time may be lost but never tear.*/
+			void updateRelaxed(const float*, float, int);
+			/*Updates each weight using the sum over the batch of the delta multiplied by the value of
+			 *the connected cell, given in the same order as the connections.*/
+			void updateWeights(const float*, int);
 
 		private:
 			//The bundle of the activation function used by this neuron.
 			activationFunctionInfo actFunc;
 			//The bias value the neuron uses when calculating its value.
 			float bias;
-			//The weight of each connection this neuron is connected to.
-			std::list<float> connectionWeights;
+			//Whether each batch element is kept (1) or dropped (0) by the current dropout mask.
+			std::vector<float> dropoutMask;
 			//What percentage of the time the value from the neuron is set to 0 regardless of input.
 			float dropRatePercent;
+			//Number of batch elements the dropout mask keeps.
+			int keptCount;
 			float learningRate;
 			float momentum;
 			//The amount the bias changed last time it was changed.
 			float previousBiasChange;
-			//The amount each weight was changed last time they were all changed.
-			std::list<float> previousWeightChange;
-			//The raw value of the neuron.
+			//The raw value of the neuron for each batch element of the last forward propagation.
 			std::vector<float> rawValues;
 			float weightDecay;
 		};
 
 	private:
+		//Propagates through the neurons directly so each of its threads can keep its own buffers.
+		friend class hogwildTrainer;
+
+		/*Dependencies between the cells found by analyzeDataflow() along with the counters used
+		 *while running the cells in dataflow order. Everything is indexed like the cells vector.
+		 *Each cell waits on a counter of the cells it still needs. A finished cell decrements the
+		 *counters of the cells waiting on it and adds any that reach zero to the ready list,
+		 *which the threads claim slots of in order.*/
+		struct dataflowGraph
+		{
+			//Number of connections to cells that aren't input nodes.
+			std::vector<int> forwardDependencies;
+			//Number of cells that backward propagate their error onto the cell.
+			std::vector<int> backwardDependencies;
+			//The cells connected to each cell, stored back to back.
+			std::vector<int> dependentOffsets;
+			std::vector<int> dependents;
+			//The cells that propagate their error onto each cell along with the weight used.
+			std::vector<int> errorOffsets;
+			std::vector<int> errorSources;
+			std::vector<const float*> errorWeights;
+			//Where each cell's weight gradients start in the weightGradients vector.
+			std::vector<int> gradientOffsets;
+			std::vector<neuron*> neurons;
+			std::unique_ptr<std::atomic<int>[]> pendingDependencies;
+			std::atomic<int> readyClaimed;
+			std::unique_ptr<std::atomic<int>[]> readyCells;
+			std::atomic<int> readyCount;
+			//Set when a cell throws so the other threads stop waiting for cells that won't be ready.
+			std::atomic<bool> stopped;
+			//Whether every cell is a neuron, which dataflow execution needs.
+			bool usable;
+		};
+
+		/*Layout of a stage found by analyzeStages(). A stage is dense when its cells are neurons
+		 *with consecutive cell indexes, have their rows in order in one block and every row
+		 *connects to the same consecutive range of cells, so the stage can be run as one matrix
+		 *multiplication. Any other stage keeps a transposed index of its connections, so the
+		 *error of each connected cell is gathered from the deltas of the stage in a fixed order
+		 *instead of every neuron adding onto shared rows.
+		 *
+		 *A stage that isn't dense but whose neurons have consecutive cell indexes and connect to
+		 *at least PACKED_MATRIX_DENSITY of the range of cells between their lowest and highest
+		 *connections is packed. Its weights are copied into a matrix over that range with zeros
+		 *for the missing connections before each forward propagation, which is then run like a
+		 *dense stage, since skipping the zeros costs more than multiplying them at that
+		 *density. Backward propagation still uses the connections. The matrix is only copied
+		 *again after the weights have changed.*/
+		struct stageLayout
+		{
+			int connectionCount;
+			bool dense;
+			//Index of each connection of the stage grouped by the cell it connects to.
+			std::vector<int> errorNeurons;
+			std::vector<int> errorOffsets;
+			std::vector<int> errorTargets;
+			std::vector<int> errorWeights;
+			int firstCell;
+			int firstConnection;
+			std::vector<neuron*> neurons;
+			//Cells in the stage that aren't neurons, which backward propagate by themselves.
+			std::vector<cell*> otherCells;
+			bool packed;
+			//Weights of a packed stage as a row major matrix with a row for each neuron.
+			std::vector<float> packedWeights;
+			//Whether packedWeights holds the current weights, cleared whenever they're written.
+			bool packedWeightsCurrent;
+			bool propagateFurther;
+		};
+
+		/*Replaces the values of the output nodes that use softmax with the softmax across them for
+		 *each batch element.*/
+		void activateSoftmaxOutputs(int);
+		//Finds the dependencies between the cells for dataflow execution.
+		void analyzeDataflow();
+		/*Sets whether a stage that isn't dense is packed and if so, the range of cells its
+		 *weight matrix covers.*/
+		void analyzePacking(stageLayout&) const;
+		/*Compacts the stages and finds which ones are dense along with the dataflow graph when
+		 *it's used. Called before propagating whenever the schedule or connections have changed.*/
+		void analyzeStages();
+		//Builds the dropout mask of every neuron with a drop rate for the coming forward propagation.
+		void buildDropoutMasks(int);
+		/*Backward propagates every cell in dataflow order. Each cell gathers its error from the
+		 *deltas of the cells connected to it, so no two cells write the same row, and the weights
+		 *are updated once every cell is done so the errors use the weights from before the update.*/
+		void backwardPropagateDataflow(int);
+		/*Backward propagates a dense stage by multiplying the transposed weights by the deltas of
+		 *the stage and updates the weights using the deltas multiplied by the transposed values.*/
+		void backwardPropagateDenseStage(const stageLayout&, int);
+		/*Backward propagates any other stage. The deltas of every neuron are found first, then
+		 *the error of each connected cell is gathered using the weights from before the update
+		 *and finally each neuron updates its own weights.*/
+		void backwardPropagateSparseStage(const stageLayout&, int);
+		/*Replaces the errors of the output nodes that use softmax with the errors multiplied by
+		 *the Jacobian of the softmax, which the neurons then use as their deltas.*/
+		void calculateSoftmaxErrors(int);
+		/*Copies the schedule of another network into this network. The schedule is expected to
+		 *be empty beforehand. The copied cells are placed in the arena and share the blocks of
+		 *connections of the other network's cells.*/
+		void copySchedule(const neuralNetwork&);
+		/*Destroys every cell in the schedule, empties it and releases the arena the neurons were
+		 *placed in.*/
+		void deleteSchedule();
+		//Finds the cell with the given index and throws an exception if one doesn't exist.
+		cell* findCell(int) const;
+		//Finds the neuron with the given index and throws an exception if it isn't a neuron.
+		neuron* findNeuron(int) const;
+		//Finds the stage with the given index and throws std::out_of_range if it doesn't exist.
+		const std::list<cell*>& findStage(int) const;
+		//Forward propagates every cell in dataflow order.
+		void forwardPropagateDataflow(int);
+		/*Forward propagates a dense stage by multiplying its weights by the values of the
+		 *connected cells.*/
+		void forwardPropagateDenseStage(const stageLayout&, int);
+		/*Returns how many of the given number of items each task of a parallel loop should take,
+		 *aiming for a few tasks per thread so stolen tasks can even out the work. The size is
+		 *kept at or above the minimum and rounded up to a multiple of the minimum.*/
+		int getChunkSize(int, int) const;
+		//Builds the transposed index of the connections of a stage that isn't dense.
+		void indexStageErrors(stageLayout&) const;
+		//Marks the weight matrices of the packed stages as out of date after the weights were written.
+		void invalidatePackedWeights();
+		//Copies the current weights of a packed stage into its weight matrix.
+		void packStageWeights(stageLayout&) const;
+		//Gives a network that was moved from a new arena and thread pool if it doesn't have them.
+		void restoreMovedFrom();
+		/*Runs the given function on every cell in dataflow order across the threads. The counters
+		 *start at the given dependencies and a finished cell is notified to the given lists of
+		 *waiting cells.*/
+		template<typename cellFunction>
+		void runDataflow(const std::vector<int>&, const cellFunction&, bool);
+		/*Gives the cells of a stage their own copy of any block they share with another network,
+		 *which is called before anything writes to the stage's blocks. Returns whether any block
+		 *was copied, in which case the stages are marked to be analyzed again.*/
+		bool separateSharedBlocks(const std::list<cell*>&);
+		/*Exchanges everything with the other network. The counters of the dataflow graph are
+		 *only used while propagating, so they're left where they are.*/
+		void swap(neuralNetwork&) noexcept;
+
+		/*Memory the neurons are placed in, which is released all at once along with the schedule.
+		 *Null along with the pool after the network has been moved from.*/
+		std::unique_ptr<memoryArena> cellArena;
+		//Every cell in the schedule indexed by its cell index minus the number of input nodes.
+		std::vector<cell*> cells;
+		//The stage each cell is scheduled in indexed the same as the cells vector.
+		std::vector<int> cellStages;
+		//Delta of every cell during dataflow backward propagation indexed like the cells vector.
+		batchTensor cellDeltas;
+		dataflowGraph dataflow;
+		//Neurons with a drop rate, found by analyzeStages().
+		std::vector<neuron*> dropoutNeurons;
+		std::uint64_t dropoutSeed;
+		//The error of every cell index for each batch element during backward propagation.
+		batchTensor errors;
+		executionMode execution;
 		int inputNodes;
 		int outputNodes;
+		//The threads the work of each stage is split across.
+		std::unique_ptr<threadPool> pool;
 		std::list<std::list<cell*>> schedule;
+		//Cell indexes of the output nodes that use softmax, found by analyzeStages().
+		std::vector<int> softmaxOutputs;
+		//Delta of each neuron in the stage being backward propagated.
+		batchTensor stageDeltas;
+		//The layout of each stage in the same order as the schedule.
+		std::vector<stageLayout> stageLayouts;
+		//Whether stageLayouts matches the current schedule and connections.
+		bool stagesAnalyzed;
+		//Number of forward propagations since the dropout seed was set, which keys the dropout masks.
+		std::uint64_t trainingStep;
+		//The value of every cell index for each batch element of the last forward propagation.
+		batchTensor values;
+		//Sum of the weight gradients of the stage being backward propagated.
+		std::vector<float> weightGradients;
 	};
 
 }
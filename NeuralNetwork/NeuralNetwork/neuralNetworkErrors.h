@@ -18,5 +18,40 @@ namespace NeuralNetwork
 	{
 
 	};
+
+	/*Thrown by the neuralNetwork class when a neuron specific operation is requested on a cell that
+	 *isn't a neuron.*/
+	struct cell_not_neuron : public std::exception
+	{
+
+	};
+
+	/*Thrown by the getKernels() function when the kernels for an instruction set the processor
+	 *doesn't support are requested.*/
+	struct instruction_set_not_supported : public std::exception
+	{
+
+	};
+
+	/*Thrown by the neuralNetwork class when a connection would make a cell depend on a cell that
+	 *isn't an input node or scheduled in an earlier stage.*/
+	struct connection_not_scheduled_before : public std::exception
+	{
+
+	};
+
+	/*Thrown by the datasetReader class when the file isn't a dataset file of this version or is
+	 *shorter than its header says.*/
+	struct dataset_file_not_valid : public std::exception
+	{
+
+	};
+
+	/*Thrown when loading a model file that's truncated, from an unknown version of the format or
+	 *describes a network that couldn't have been saved.*/
+	struct model_file_not_valid : public std::exception
+	{
+
+	};
 }
 #endif
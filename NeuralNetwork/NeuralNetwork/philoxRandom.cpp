@@ -0,0 +1,61 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the implementation of the Philox4x32-10 generator and the dropout masks built from it.*/
+
+#include "philoxRandom.h"
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+		//Multipliers and key increments of Philox4x32 from Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3".
+		const std::uint32_t PHILOX_MULTIPLIER_0 = 0xD2511F53u;
+		const std::uint32_t PHILOX_MULTIPLIER_1 = 0xCD9E8D57u;
+		const std::uint32_t PHILOX_WEYL_0 = 0x9E3779B9u;
+		const std::uint32_t PHILOX_WEYL_1 = 0xBB67AE85u;
+		const int PHILOX_ROUNDS = 10;
+		//Scales the top 24 bits of a random word to a float in [0, 1) without rounding up to 1.
+		const float UNIFORM_SCALE = 1.0f / 16777216.0f;
+	}
+
+	int buildDropoutMask(std::uint64_t seed, std::uint64_t step, int cellIndex, float dropRate, int batchSize, float *mask)
+	{
+		const std::uint32_t key[2] = { (std::uint32_t)seed, (std::uint32_t)(seed >> 32) };
+		int keptCount = 0;
+
+		//Each call of the generator covers four batch elements.
+		for (int blockStart = 0; blockStart < batchSize; blockStart += 4)
+		{
+			const std::uint32_t counter[4] = { (std::uint32_t)(blockStart / 4), (std::uint32_t)cellIndex, (std::uint32_t)step, (std::uint32_t)(step >> 32) };
+			std::uint32_t random[4];
+			philox4x32(counter, key, random);
+			for (int i = 0; i < 4 && blockStart + i < batchSize; ++i)
+			{
+				bool kept = (float)(random[i] >> 8) * UNIFORM_SCALE >= dropRate;
+				mask[blockStart + i] = kept ? 1.0f : 0.0f;
+				keptCount += kept ? 1 : 0;
+			}
+		}
+		return keptCount;
+	}
+
+	void philox4x32(const std::uint32_t *counter, const std::uint32_t *key, std::uint32_t *output)
+	{
+		std::uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+		std::uint32_t k0 = key[0], k1 = key[1];
+		for (int round = 0; round < PHILOX_ROUNDS; ++round)
+		{
+			std::uint64_t product0 = (std::uint64_t)PHILOX_MULTIPLIER_0 * c0;
+			std::uint64_t product1 = (std::uint64_t)PHILOX_MULTIPLIER_1 * c2;
+			c0 = (std::uint32_t)(product1 >> 32) ^ c1 ^ k0;
+			c2 = (std::uint32_t)(product0 >> 32) ^ c3 ^ k1;
+			c1 = (std::uint32_t)product1;
+			c3 = (std::uint32_t)product0;
+			k0 += PHILOX_WEYL_0;
+			k1 += PHILOX_WEYL_1;
+		}
+		output[0] = c0;
+		output[1] = c1;
+		output[2] = c2;
+		output[3] = c3;
+	}
+}
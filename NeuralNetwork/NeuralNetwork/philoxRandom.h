@@ -0,0 +1,24 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the counter-based random number generator used for dropout. Philox4x32-10 turns a
+ *counter and a key into four random integers with no state between calls, so the number for
+ *any (seed, step, cell, batch element) can be found by any thread in any order and the masks
+ *come out the same no matter how the work is split.*/
+
+#ifndef NEURAL_NETWORK_PHILOX_RANDOM
+#define NEURAL_NETWORK_PHILOX_RANDOM
+
+#include<cstdint>
+
+namespace NeuralNetwork
+{
+	/*Fills the mask with 1 for each batch element of the cell that's kept and 0 for each one
+	 *that's dropped, where an element is dropped when its uniform number in [0, 1) is below the
+	 *drop rate. The seed is the key and the step, cell index and batch element make up the
+	 *counter. Returns the number of kept elements.*/
+	int buildDropoutMask(std::uint64_t, std::uint64_t, int, float, int, float*);
+	/*Runs the ten rounds of Philox4x32 on the four counter words with the two key words and
+	 *stores the four random words in the output.*/
+	void philox4x32(const std::uint32_t*, const std::uint32_t*, std::uint32_t*);
+}
+
+#endif
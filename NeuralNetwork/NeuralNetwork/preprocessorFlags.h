@@ -9,4 +9,14 @@
  *performance.*/
 #define SAFE_CELL true
 
+/*This preprocessor flag lets the vector kernels use the SSE4.2, AVX2 and AVX-512 instructions on
+ *x86 processors. The widest instruction set the processor supports is picked at runtime, so the
+ *same build runs on older processors. Turning it off makes every kernel use the scalar loops.*/
+#define SIMD_KERNELS true
+
+/*This preprocessor flag records a trace event for every stage and cell that's propagated, which
+ *can be written out as a Chrome trace to see where the time goes. When it's turned off, the
+ *tracing macros compile to nothing, so leave it off unless profiling.*/
+#define TRACE_EVENTS false
+
 #endif
@@ -0,0 +1,358 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "quantizedPlan.h"
+#include "helperFunctions.h"
+#include "neuralNetwork.h"
+#include "neuralNetworkErrors.h"
+#include "vectorKernels.h"
+#include<algorithm>
+#include<cmath>
+#include<stdexcept>
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+		//Largest magnitude of a quantized weight, which leaves -128 unused so the weights are symmetric around zero.
+		const int MAX_QUANTIZED_WEIGHT = 127;
+		const int MAX_QUANTIZED_VALUE = 255;
+		//Number of bytes the row of each batch element is rounded up to, which keeps every row on its own cache line.
+		const int QUANTIZED_ROW_ALIGNMENT = 64;
+
+		std::uint8_t quantizeValue(float value, float scale, int zeroPoint)
+		{
+			long quantized = std::lround(value / scale) + zeroPoint;
+			return (std::uint8_t)std::min<long>(std::max<long>(quantized, 0), MAX_QUANTIZED_VALUE);
+		}
+	}
+
+	quantizationReport measureQuantizationDrift(const inferencePlan &floatPlan, const quantizedPlan &plan, const batchTensor &input)
+	{
+		if (floatPlan.getInputNodes() != plan.getInputNodes() || floatPlan.getOutputNodes() != plan.getOutputNodes())
+		{
+			throw lists_not_same_length();
+		}
+
+		batchTensor floatOutput, quantizedOutput;
+		floatPlan.run(input, floatOutput);
+		plan.run(input, quantizedOutput);
+
+		int batchSize = input.getBatchSize(), outputNodes = plan.getOutputNodes();
+		quantizationReport report;
+		report.maxAbsoluteError = 0.0;
+		report.outputMaxErrors.assign(outputNodes, 0.0);
+		report.sampleCount = batchSize;
+		double errorSum = 0.0;
+		int agreements = 0;
+		for (int batchIndex = 0; batchIndex < batchSize; ++batchIndex)
+		{
+			int floatArgmax = 0, quantizedArgmax = 0;
+			for (int outputIndex = 0; outputIndex < outputNodes; ++outputIndex)
+			{
+				double error = std::fabs((double)floatOutput.getRow(outputIndex)[batchIndex] - quantizedOutput.getRow(outputIndex)[batchIndex]);
+				errorSum += error;
+				report.outputMaxErrors[outputIndex] = std::max(report.outputMaxErrors[outputIndex], error);
+				if (floatOutput.getRow(outputIndex)[batchIndex] > floatOutput.getRow(floatArgmax)[batchIndex])
+				{
+					floatArgmax = outputIndex;
+				}
+				if (quantizedOutput.getRow(outputIndex)[batchIndex] > quantizedOutput.getRow(quantizedArgmax)[batchIndex])
+				{
+					quantizedArgmax = outputIndex;
+				}
+			}
+			if (floatArgmax == quantizedArgmax)
+			{
+				++agreements;
+			}
+		}
+		for (int outputIndex = 0; outputIndex < outputNodes; ++outputIndex)
+		{
+			report.maxAbsoluteError = std::max(report.maxAbsoluteError, report.outputMaxErrors[outputIndex]);
+		}
+		report.meanAbsoluteError = outputNodes > 0 ? errorSum / ((double)batchSize * outputNodes) : 0.0;
+		report.argmaxAgreement = (double)agreements / batchSize;
+		return report;
+	}
+
+	quantizedPlan quantizeNetwork(neuralNetwork &network, const batchTensor &calibration, quantizationGranularity granularity)
+	{
+		return quantizedPlan(network.compileForInference(), calibration, granularity);
+	}
+
+	quantizedPlan::quantizedPlan() :cellCount(0), granularity(perNeuronScales), inputNodes(0), outputNodes(0)
+	{
+
+	}
+
+	quantizedPlan::quantizedPlan(const inferencePlan &plan, const batchTensor &calibration, quantizationGranularity granularity)
+		:cellCount(plan.cellCount), granularity(granularity), inputNodes(plan.inputNodes), outputNodes(plan.outputNodes), softmaxOutputs(plan.softmaxOutputs)
+	{
+		findScales(plan, calibration);
+
+		for (std::vector<inferencePlan::stagePlan>::const_iterator it = plan.stages.begin(); it != plan.stages.end(); ++it)
+		{
+			stages.push_back(stagePlan());
+			stagePlan &stage = stages.back();
+			stage.activations = it->activations;
+			stage.biases = it->biases;
+			stage.cellIndexes = it->cellIndexes;
+			stage.rowLengths = it->rowLengths;
+
+			//The scale of each connection's value is folded into its weight before the weights are quantized.
+			int neuronCount = (int)it->cellIndexes.size();
+			std::vector<std::vector<float>> foldedWeights(neuronCount);
+			float stageMaximum = 0.0f;
+			for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+			{
+				const int *rowColumns = plan.columns + it->rowStarts[neuronIndex];
+				const float *rowWeights = plan.weights + it->rowStarts[neuronIndex];
+				float maximum = 0.0f;
+				for (int connection = 0; connection < it->rowLengths[neuronIndex]; ++connection)
+				{
+					foldedWeights[neuronIndex].push_back(rowWeights[connection] * scales[rowColumns[connection]]);
+					maximum = std::max(maximum, std::fabs(foldedWeights[neuronIndex].back()));
+				}
+				stage.weightScales.push_back(maximum > 0.0f ? maximum / MAX_QUANTIZED_WEIGHT : 1.0f);
+				stageMaximum = std::max(stageMaximum, maximum);
+			}
+			if (granularity == perStageScales)
+			{
+				stage.weightScales.assign(neuronCount, stageMaximum > 0.0f ? stageMaximum / MAX_QUANTIZED_WEIGHT : 1.0f);
+			}
+
+			for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+			{
+				const int *rowColumns = plan.columns + it->rowStarts[neuronIndex];
+				int rowLength = it->rowLengths[neuronIndex];
+				std::int32_t offset = 0;
+				stage.rowStarts.push_back(weights.size());
+				stage.consecutive.push_back(rowLength > 0 && rowColumns[rowLength - 1] - rowColumns[0] == rowLength - 1);
+				for (int connection = 0; connection < rowLength; ++connection)
+				{
+					long quantized = std::lround(foldedWeights[neuronIndex][connection] / stage.weightScales[neuronIndex]);
+					quantized = std::min<long>(std::max<long>(quantized, -MAX_QUANTIZED_WEIGHT), MAX_QUANTIZED_WEIGHT);
+					columns.push_back(rowColumns[connection]);
+					weights.push_back((std::int8_t)quantized);
+					offset += (std::int32_t)quantized * zeroPoints[rowColumns[connection]];
+				}
+				stage.offsets.push_back(offset);
+			}
+		}
+	}
+
+	int quantizedPlan::getCellCount() const
+	{
+		return cellCount;
+	}
+
+	quantizationGranularity quantizedPlan::getGranularity() const
+	{
+		return granularity;
+	}
+
+	int quantizedPlan::getInputNodes() const
+	{
+		return inputNodes;
+	}
+
+	int quantizedPlan::getOutputNodes() const
+	{
+		return outputNodes;
+	}
+
+	float quantizedPlan::getScale(int cellIndex) const
+	{
+		if (cellIndex < 0 || cellIndex >= cellCount)
+		{
+			throw std::out_of_range("The requested cell doesn't exist in the plan.");
+		}
+		return scales[cellIndex];
+	}
+
+	int quantizedPlan::getStageCount() const
+	{
+		return (int)stages.size();
+	}
+
+	int quantizedPlan::getZeroPoint(int cellIndex) const
+	{
+		if (cellIndex < 0 || cellIndex >= cellCount)
+		{
+			throw std::out_of_range("The requested cell doesn't exist in the plan.");
+		}
+		return zeroPoints[cellIndex];
+	}
+
+	void quantizedPlan::run(const batchTensor &input, batchTensor &output) const
+	{
+		int batchSize = input.getBatchSize();
+		if (input.getRowCount() != inputNodes)
+		{
+			throw lists_not_same_length();
+		}
+		if (batchSize < 1)
+		{
+			throw std::out_of_range("Batch size must be greater then zero.");
+		}
+
+		int rowLength = (cellCount + QUANTIZED_ROW_ALIGNMENT - 1) / QUANTIZED_ROW_ALIGNMENT * QUANTIZED_ROW_ALIGNMENT;
+		static thread_local std::vector<std::uint8_t> values;
+		//Each stage is calculated in floats here before being rounded into the values.
+		static thread_local batchTensor stageValues;
+		values.resize((std::size_t)batchSize * rowLength);
+		for (int inputIndex = 0; inputIndex < inputNodes; ++inputIndex)
+		{
+			const float *inputValues = input.getRow(inputIndex);
+			for (int batchIndex = 0; batchIndex < batchSize; ++batchIndex)
+			{
+				values[(std::size_t)batchIndex * rowLength + inputIndex] = quantizeValue(inputValues[batchIndex], scales[inputIndex], zeroPoints[inputIndex]);
+			}
+		}
+
+		int firstOutput = cellCount - outputNodes;
+		output.resize(outputNodes, batchSize);
+		for (std::vector<stagePlan>::const_iterator it = stages.begin(); it != stages.end(); ++it)
+		{
+			int neuronCount = (int)it->cellIndexes.size();
+			stageValues.resize(neuronCount, batchSize);
+			runStage(*it, values.data(), rowLength, stageValues, batchSize);
+			for (int neuronIndex = 0; neuronIndex < neuronCount; ++neuronIndex)
+			{
+				int cellIndex = it->cellIndexes[neuronIndex];
+				const float *cellValues = stageValues.getRow(neuronIndex);
+				for (int batchIndex = 0; batchIndex < batchSize; ++batchIndex)
+				{
+					values[(std::size_t)batchIndex * rowLength + cellIndex] = quantizeValue(cellValues[batchIndex], scales[cellIndex], zeroPoints[cellIndex]);
+				}
+				if (cellIndex >= firstOutput)
+				{
+					std::copy(cellValues, cellValues + batchSize, output.getRow(cellIndex - firstOutput));
+				}
+			}
+		}
+
+		applySoftmax(output, firstOutput, batchSize);
+	}
+
+	void quantizedPlan::applySoftmax(batchTensor &values, int firstRow, int batchSize) const
+	{
+		if (softmaxOutputs.empty())
+		{
+			return;
+		}
+
+		int outputCount = (int)softmaxOutputs.size();
+		std::vector<float> outputValues(outputCount);
+		for (int batchIndex = 0; batchIndex < batchSize; ++batchIndex)
+		{
+			for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+			{
+				outputValues[outputIndex] = values.getRow(softmaxOutputs[outputIndex] - firstRow)[batchIndex];
+			}
+			softmaxSpan(outputValues.data(), outputCount);
+			for (int outputIndex = 0; outputIndex < outputCount; ++outputIndex)
+			{
+				values.getRow(softmaxOutputs[outputIndex] - firstRow)[batchIndex] = outputValues[outputIndex];
+			}
+		}
+	}
+
+	/*The range of each cell is widened to include zero, so zero is always exact and the zeros of
+	  a ReLU stay zero.*/
+	void quantizedPlan::findScales(const inferencePlan &plan, const batchTensor &calibration)
+	{
+		if (calibration.getRowCount() != inputNodes)
+		{
+			throw lists_not_same_length();
+		}
+		if (calibration.getBatchSize() < 1)
+		{
+			throw std::out_of_range("Batch size must be greater then zero.");
+		}
+
+		batchTensor values;
+		plan.findValues(calibration, values);
+		std::vector<float> minimums(cellCount, 0.0f), maximums(cellCount, 0.0f);
+		for (int cellIndex = 0; cellIndex < cellCount; ++cellIndex)
+		{
+			const float *cellValues = values.getRow(cellIndex);
+			for (int batchIndex = 0; batchIndex < calibration.getBatchSize(); ++batchIndex)
+			{
+				minimums[cellIndex] = std::min(minimums[cellIndex], cellValues[batchIndex]);
+				maximums[cellIndex] = std::max(maximums[cellIndex], cellValues[batchIndex]);
+			}
+		}
+
+		if (granularity == perStageScales)
+		{
+			std::vector<std::vector<int>> groups(1);
+			for (int inputIndex = 0; inputIndex < inputNodes; ++inputIndex)
+			{
+				groups[0].push_back(inputIndex);
+			}
+			for (std::vector<inferencePlan::stagePlan>::const_iterator it = plan.stages.begin(); it != plan.stages.end(); ++it)
+			{
+				groups.push_back(it->cellIndexes);
+			}
+			for (std::vector<std::vector<int>>::const_iterator it = groups.begin(); it != groups.end(); ++it)
+			{
+				float minimum = 0.0f, maximum = 0.0f;
+				for (std::vector<int>::const_iterator cellIt = it->begin(); cellIt != it->end(); ++cellIt)
+				{
+					minimum = std::min(minimum, minimums[*cellIt]);
+					maximum = std::max(maximum, maximums[*cellIt]);
+				}
+				for (std::vector<int>::const_iterator cellIt = it->begin(); cellIt != it->end(); ++cellIt)
+				{
+					minimums[*cellIt] = minimum;
+					maximums[*cellIt] = maximum;
+				}
+			}
+		}
+
+		scales.resize(cellCount);
+		zeroPoints.resize(cellCount);
+		for (int cellIndex = 0; cellIndex < cellCount; ++cellIndex)
+		{
+			float range = maximums[cellIndex] - minimums[cellIndex];
+			//A cell that was always zero gets the scale of a range of one, which is small enough not to throw off the scales of the weights it's folded into.
+			scales[cellIndex] = (range > 0.0f ? range : 1.0f) / MAX_QUANTIZED_VALUE;
+			long zeroPoint = std::lround(-minimums[cellIndex] / scales[cellIndex]);
+			zeroPoints[cellIndex] = (std::uint8_t)std::min<long>(std::max<long>(zeroPoint, 0), MAX_QUANTIZED_VALUE);
+		}
+	}
+
+	void quantizedPlan::runStage(const stagePlan &stage, const std::uint8_t *values, int rowLength, batchTensor &stageValues, int batchSize) const
+	{
+		const vectorKernels &kernels = getKernels();
+		//Values of the connections of a neuron that aren't consecutive cells, gathered for each batch element.
+		static thread_local std::vector<std::uint8_t> gathered;
+		for (int neuronIndex = 0; neuronIndex < (int)stage.cellIndexes.size(); ++neuronIndex)
+		{
+			int connectionCount = stage.rowLengths[neuronIndex];
+			const int *rowColumns = columns.data() + stage.rowStarts[neuronIndex];
+			const std::int8_t *rowWeights = weights.data() + stage.rowStarts[neuronIndex];
+			float *cellValues = stageValues.getRow(neuronIndex);
+			gathered.resize(connectionCount);
+			for (int batchIndex = 0; batchIndex < batchSize; ++batchIndex)
+			{
+				const std::uint8_t *batchValues = values + (std::size_t)batchIndex * rowLength;
+				const std::uint8_t *rowValues = gathered.data();
+				if (stage.consecutive[neuronIndex])
+				{
+					rowValues = batchValues + rowColumns[0];
+				}
+				else
+				{
+					for (int connection = 0; connection < connectionCount; ++connection)
+					{
+						gathered[connection] = batchValues[rowColumns[connection]];
+					}
+				}
+				std::int32_t sum = kernels.dotProductInt8(rowValues, rowWeights, connectionCount) - stage.offsets[neuronIndex];
+				cellValues[batchIndex] = stage.biases[neuronIndex] + stage.weightScales[neuronIndex] * (float)sum;
+			}
+			activateSpan(stage.activations[neuronIndex], cellValues, batchSize);
+		}
+	}
+}
@@ -0,0 +1,130 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the quantizedPlan class, a forward-only copy of a trained network that
+ *stores its weights and values as 8-bit integers, along with the functions that make one and
+ *measure how far it drifts from the float network.*/
+
+#ifndef NEURAL_NETWORK_QUANTIZED_PLAN
+#define NEURAL_NETWORK_QUANTIZED_PLAN
+
+#include "activationFunctions.h"
+#include "batchTensor.h"
+#include "inferencePlan.h"
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	class neuralNetwork;
+	class quantizedPlan;
+
+	/*Which values share a scale. With per neuron scales every cell has its own scale and zero
+	 *point and every neuron's weights have their own scale. With per stage scales they're shared
+	 *by every cell of a stage, with the input nodes counted as one stage.*/
+	enum quantizationGranularity
+	{
+		perNeuronScales = 0, perStageScales = 1
+	};
+
+	//How far the outputs of a quantized plan are from the outputs of the float plan for the same batch.
+	struct quantizationReport
+	{
+		//Fraction of the batch elements whose largest output is from the same output node in both plans.
+		double argmaxAgreement;
+		double maxAbsoluteError;
+		double meanAbsoluteError;
+		//Largest absolute error of each output node.
+		std::vector<double> outputMaxErrors;
+		std::uint64_t sampleCount;
+	};
+
+	/*Runs the batch through both plans and compares their outputs. Throws lists_not_same_length
+	 *if the plans don't have the same input and output nodes or the batch doesn't have a row for
+	 *each input node.*/
+	quantizationReport measureQuantizationDrift(const inferencePlan&, const quantizedPlan&, const batchTensor&);
+	/*Quantizes a trained network after training using the range of values each cell takes on for
+	 *the calibration batch. Throws cell_not_neuron if the network has a cell that isn't a neuron,
+	 *lists_not_same_length if the batch doesn't have a row for each input node and
+	 *std::out_of_range if the batch is empty.*/
+	quantizedPlan quantizeNetwork(neuralNetwork&, const batchTensor&, quantizationGranularity);
+
+	/*Immutable forward-only copy of a network with 8-bit integer weights and values. The value of
+	 *each cell is stored as an unsigned byte q standing for (q - zeroPoint) * scale, where the
+	 *scale and zero point are chosen so the range seen during calibration fits and zero is exact.
+	 *The weights are signed bytes with a symmetric scale that has the scale of each connection's
+	 *value folded in, so every neuron is one integer dot product plus a correction for the zero
+	 *points, which runs on the VNNI instructions when the processor has them. The biases and the
+	 *activation functions stay in floats, and the output nodes are given to the caller before
+	 *being rounded to bytes.
+	 *
+	 *The values are stored with every cell of a batch element next to each other, so the
+	 *connections of a neuron are read as one contiguous run when they're consecutive cells. Like
+	 *inferencePlan, any number of threads can run the same plan at once.*/
+	class quantizedPlan
+	{
+	public:
+		//Creates an empty plan with no input or output nodes.
+		quantizedPlan();
+
+		//Returns the number of cell indexes in the plan including the input nodes.
+		int getCellCount() const;
+		quantizationGranularity getGranularity() const;
+		int getInputNodes() const;
+		int getOutputNodes() const;
+		//Returns the scale of the given cell's values. Throws std::out_of_range if there's no such cell.
+		float getScale(int) const;
+		int getStageCount() const;
+		//Returns the byte that stands for zero in the given cell's values. Throws std::out_of_range if there's no such cell.
+		int getZeroPoint(int) const;
+		/*Runs a batch through the plan and stores the values of the output nodes in the output
+		 *tensor. The input tensor has a row for each input node. Each thread uses its own
+		 *workspace, so it's safe to call from many threads at once.*/
+		void run(const batchTensor&, batchTensor&) const;
+
+	private:
+		friend quantizedPlan quantizeNetwork(neuralNetwork&, const batchTensor&, quantizationGranularity);
+
+		//The neurons of one stage, whose connections are the rowLengths entries of the arrays starting at each of the rowStarts.
+		struct stagePlan
+		{
+			std::vector<activationFunctionInfo> activations;
+			std::vector<float> biases;
+			std::vector<int> cellIndexes;
+			//Whether the connections of each neuron are consecutive cells, so the values are read without gathering them.
+			std::vector<bool> consecutive;
+			//Sum of each neuron's weights multiplied by the zero points of the cells they connect to.
+			std::vector<std::int32_t> offsets;
+			std::vector<int> rowLengths;
+			std::vector<std::size_t> rowStarts;
+			//Scale of each neuron's weights with the scales of the values folded in.
+			std::vector<float> weightScales;
+		};
+
+		//Quantizes the stages of the float plan with the ranges found by running it on the calibration batch.
+		quantizedPlan(const inferencePlan&, const batchTensor&, quantizationGranularity);
+
+		//Applies softmax across the softmax outputs, which are the rows of the tensor starting from the given cell index.
+		void applySoftmax(batchTensor&, int, int) const;
+		//Sets the scale and zero point of each cell from the calibration values.
+		void findScales(const inferencePlan&, const batchTensor&);
+		/*Runs the neurons of a stage reading the values of each batch element from rows of the
+		 *given length and stores the results as floats in the rows of the stage's tensor.*/
+		void runStage(const stagePlan&, const std::uint8_t*, int, batchTensor&, int) const;
+
+		int cellCount;
+		//Column index and weight of every connection of the plan.
+		std::vector<int> columns;
+		quantizationGranularity granularity;
+		int inputNodes;
+		int outputNodes;
+		//Scale and zero point of the values of every cell.
+		std::vector<float> scales;
+		//Cell indexes of the output nodes that use softmax.
+		std::vector<int> softmaxOutputs;
+		std::vector<stagePlan> stages;
+		std::vector<std::int8_t> weights;
+		std::vector<std::uint8_t> zeroPoints;
+	};
+}
+
+#endif
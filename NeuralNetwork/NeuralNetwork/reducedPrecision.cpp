@@ -0,0 +1,137 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "reducedPrecision.h"
+#include "vectorKernels.h"
+#include<algorithm>
+#include<cstring>
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+		//Number of values widened onto the stack at a time by addReducedVectors().
+		const int WIDEN_CHUNK_SIZE = 256;
+
+		std::uint32_t getBits(float value)
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		float fromBits(std::uint32_t bits)
+		{
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+	}
+
+	void addReducedVectors(storagePrecision precision, float *target, const std::uint16_t *ref, float multiplier, int length)
+	{
+		const vectorKernels &kernels = getKernels();
+		float widened[WIDEN_CHUNK_SIZE];
+		for (int start = 0; start < length; start += WIDEN_CHUNK_SIZE)
+		{
+			int count = std::min(WIDEN_CHUNK_SIZE, length - start);
+			widenValues(precision, ref + start, widened, count);
+			kernels.addVectors(target + start, widened, multiplier, count);
+		}
+	}
+
+	float fromBfloat16(std::uint16_t value)
+	{
+		return fromBits((std::uint32_t)value << 16);
+	}
+
+	/*The exponent is rebiased by adding the difference of the biases to the shifted bits. The
+	  largest exponent gets the rest of the float exponent range so infinity and NaN carry over,
+	  and subnormals are made normal with the smallest exponent and then have that subtracted
+	  as a float so the hardware renormalizes them.*/
+	float fromHalf(std::uint16_t value)
+	{
+		const std::uint32_t shiftedExponent = 0x7C00u << 13;
+		std::uint32_t bits = ((std::uint32_t)value & 0x7FFFu) << 13;
+		std::uint32_t exponent = bits & shiftedExponent;
+		bits += (127u - 15u) << 23;
+		if (exponent == shiftedExponent)
+		{
+			bits += (128u - 16u) << 23;
+		}
+		else if (exponent == 0)
+		{
+			bits = getBits(fromBits(bits + (1u << 23)) - fromBits(113u << 23));
+		}
+		return fromBits(bits | (((std::uint32_t)value & 0x8000u) << 16));
+	}
+
+	void narrowValues(storagePrecision precision, const float *values, std::uint16_t *output, int length)
+	{
+		if (precision == halfPrecision)
+		{
+			getKernels().convertToHalf(values, output, length);
+			return;
+		}
+		for (int i = 0; i < length; ++i)
+		{
+			output[i] = toBfloat16(values[i]);
+		}
+	}
+
+	//Adding 0x7FFF plus the lowest kept bit carries into the kept bits exactly when rounding up to the nearest even value.
+	std::uint16_t toBfloat16(float value)
+	{
+		std::uint32_t bits = getBits(value);
+		if ((bits & 0x7FFFFFFFu) > 0x7F800000u)
+		{
+			return (std::uint16_t)((bits >> 16) | 0x0040u);
+		}
+		bits += 0x7FFFu + ((bits >> 16) & 1u);
+		return (std::uint16_t)(bits >> 16);
+	}
+
+	/*Values too large for a half become infinity. Values too small for a normal half are added to
+	  a float whose exponent puts the half's last mantissa bit at the float's last bit, which
+	  makes the hardware round them. Everything else is rebiased with the rounding done the same
+	  way as toBfloat16().*/
+	std::uint16_t toHalf(float value)
+	{
+		std::uint32_t bits = getBits(value);
+		std::uint32_t sign = (bits >> 16) & 0x8000u;
+		bits &= 0x7FFFFFFFu;
+		std::uint32_t output;
+		if (bits >= (127u + 16u) << 23)
+		{
+			output = bits > 0x7F800000u ? 0x7E00u : 0x7C00u;
+		}
+		else if (bits < 113u << 23)
+		{
+			const std::uint32_t subnormalMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+			output = getBits(fromBits(bits) + fromBits(subnormalMagic)) - subnormalMagic;
+		}
+		else
+		{
+			std::uint32_t lowestKeptBit = (bits >> 13) & 1u;
+			bits += ((std::uint32_t)(15 - 127) << 23) + 0xFFFu + lowestKeptBit;
+			output = bits >> 13;
+		}
+		return (std::uint16_t)(output | sign);
+	}
+
+	float widenValue(storagePrecision precision, std::uint16_t value)
+	{
+		return precision == halfPrecision ? fromHalf(value) : fromBfloat16(value);
+	}
+
+	void widenValues(storagePrecision precision, const std::uint16_t *values, float *output, int length)
+	{
+		if (precision == halfPrecision)
+		{
+			getKernels().convertFromHalf(values, output, length);
+			return;
+		}
+		for (int i = 0; i < length; ++i)
+		{
+			output[i] = fromBfloat16(values[i]);
+		}
+	}
+}
@@ -0,0 +1,38 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the conversions between floats and the 16-bit formats weights and values can be stored
+ *in to halve the memory they take up and the bandwidth spent reading them. The values are always
+ *widened back to floats before any arithmetic, so sums are still accumulated in single
+ *precision.*/
+
+#ifndef NEURAL_NETWORK_REDUCED_PRECISION
+#define NEURAL_NETWORK_REDUCED_PRECISION
+
+#include<cstdint>
+
+namespace NeuralNetwork
+{
+	/*How values are stored. bfloat16 keeps the 8 exponent bits of a float with 7 mantissa bits,
+	 *so it has the range of a float with about 2 to 3 decimal digits. IEEE half precision has 5
+	 *exponent bits and 10 mantissa bits, which is more precise but overflows past 65504.*/
+	enum storagePrecision
+	{
+		floatPrecision = 0, bfloat16Precision = 1, halfPrecision = 2
+	};
+
+	//Adds the 16-bit reference array widened to floats and multiplied by the multiplier to the target array.
+	void addReducedVectors(storagePrecision, float*, const std::uint16_t*, float, int);
+	float fromBfloat16(std::uint16_t);
+	float fromHalf(std::uint16_t);
+	/*Rounds each float to the nearest 16-bit value, with ties going to the even value. Half
+	 *precision uses the F16C instructions when the processor has them.*/
+	void narrowValues(storagePrecision, const float*, std::uint16_t*, int);
+	/*Rounds a float to the nearest value with ties going to the even value. NaN stays NaN and
+	 *values past the largest half precision value become infinity.*/
+	std::uint16_t toBfloat16(float);
+	std::uint16_t toHalf(float);
+	float widenValue(storagePrecision, std::uint16_t);
+	//Widens each 16-bit value to a float, which is always exact.
+	void widenValues(storagePrecision, const std::uint16_t*, float*, int);
+}
+
+#endif
@@ -0,0 +1,439 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "ringCommunicator.h"
+#include "helperFunctions.h"
+#include<algorithm>
+#include<chrono>
+#include<cstring>
+#include<stdexcept>
+#include<thread>
+#ifdef _WIN32
+//Without WIN32_LEAN_AND_MEAN, a windows.h included earlier brings in the old winsock.h, which conflicts with winsock2.h.
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include<winsock2.h>
+#include<ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include<cerrno>
+#include<fcntl.h>
+#include<netdb.h>
+#include<netinet/in.h>
+#include<netinet/tcp.h>
+#include<poll.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<unistd.h>
+#endif
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+#ifdef _WIN32
+		typedef SOCKET socketHandle;
+		const socketHandle NO_SOCKET = INVALID_SOCKET;
+		const int SEND_FLAGS = 0;
+#else
+		typedef int socketHandle;
+		const socketHandle NO_SOCKET = -1;
+#ifdef MSG_NOSIGNAL
+		//A worker that left the ring shows up as an error from send instead of killing the process.
+		const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+		const int SEND_FLAGS = 0;
+#endif
+#endif
+		//Largest number of bytes handed to a single send or receive call, which take an int on Windows.
+		const std::size_t MAX_TRANSFER = 1 << 30;
+
+		void closeSocket(socketHandle handle)
+		{
+#ifdef _WIN32
+			closesocket(handle);
+#else
+			close(handle);
+#endif
+		}
+
+		//Returns whether the last socket call failed only because it would have blocked or was interrupted.
+		bool shouldRetry()
+		{
+#ifdef _WIN32
+			int error = WSAGetLastError();
+			return error == WSAEWOULDBLOCK || error == WSAEINTR;
+#else
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+		}
+
+		int pollSockets(pollfd *sockets, int count, int timeout)
+		{
+#ifdef _WIN32
+			return WSAPoll(sockets, (ULONG)count, timeout);
+#else
+			return poll(sockets, (nfds_t)count, timeout);
+#endif
+		}
+
+		//Closes the socket it holds when it goes out of scope unless the socket is released.
+		class ownedSocket
+		{
+		public:
+			explicit ownedSocket(socketHandle newHandle) :handle(newHandle)
+			{
+
+			}
+
+			ownedSocket(const ownedSocket&) = delete;
+
+			~ownedSocket()
+			{
+				if (handle != NO_SOCKET)
+				{
+					closeSocket(handle);
+				}
+			}
+
+			ownedSocket& operator=(const ownedSocket&) = delete;
+
+			socketHandle get() const
+			{
+				return handle;
+			}
+
+			socketHandle release()
+			{
+				socketHandle output = handle;
+				handle = NO_SOCKET;
+				return output;
+			}
+
+		private:
+			socketHandle handle;
+		};
+
+		//The socket address an address string refers to.
+		struct socketAddress
+		{
+			int family;
+			socklen_t length;
+			//Path of the socket file for a Unix domain address, which is removed before listening.
+			std::string path;
+			sockaddr_storage storage;
+		};
+
+		socketAddress parseAddress(const std::string &address)
+		{
+			socketAddress output = socketAddress();
+			if (address.compare(0, 5, "unix:") == 0)
+			{
+#ifdef _WIN32
+				throw std::runtime_error("Unix domain socket addresses aren't supported on this platform.");
+#else
+				sockaddr_un *unixAddress = reinterpret_cast<sockaddr_un*>(&output.storage);
+				output.path = address.substr(5);
+				if (output.path.empty() || output.path.size() >= sizeof(unixAddress->sun_path))
+				{
+					throw std::runtime_error("The Unix domain socket path is empty or too long.");
+				}
+				unixAddress->sun_family = AF_UNIX;
+				std::memcpy(unixAddress->sun_path, output.path.c_str(), output.path.size() + 1);
+				output.family = AF_UNIX;
+				output.length = (socklen_t)sizeof(sockaddr_un);
+				return output;
+#endif
+			}
+
+			//The port follows the last colon so the host can be anything getaddrinfo understands.
+			std::size_t portStart = address.rfind(':');
+			if (address.compare(0, 4, "tcp:") != 0 || portStart == std::string::npos || portStart < 4)
+			{
+				throw std::runtime_error("The address isn't a tcp:host:port or unix:path address.");
+			}
+			std::string host = address.substr(4, portStart - 4);
+			std::string port = address.substr(portStart + 1);
+			addrinfo hints = addrinfo();
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			addrinfo *results = NULL;
+			if (getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0 || !results)
+			{
+				throw std::runtime_error("Couldn't resolve the address.");
+			}
+			output.family = results->ai_family;
+			output.length = (socklen_t)results->ai_addrlen;
+			std::memcpy(&output.storage, results->ai_addr, results->ai_addrlen);
+			freeaddrinfo(results);
+			return output;
+		}
+
+		//Connects to the address, retrying until it's listening or the deadline passes.
+		socketHandle connectBefore(const socketAddress &address, std::chrono::steady_clock::time_point deadline)
+		{
+			while (true)
+			{
+				ownedSocket attempt(socket(address.family, SOCK_STREAM, 0));
+				if (attempt.get() != NO_SOCKET && connect(attempt.get(), reinterpret_cast<const sockaddr*>(&address.storage), address.length) == 0)
+				{
+					return attempt.release();
+				}
+				if (std::chrono::steady_clock::now() >= deadline)
+				{
+					throw std::runtime_error("Timed out connecting to the next worker.");
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
+
+		void removeSocketFile(const socketAddress &address)
+		{
+#ifndef _WIN32
+			if (!address.path.empty())
+			{
+				unlink(address.path.c_str());
+			}
+#endif
+		}
+
+		void setBlocking(socketHandle handle, bool blocking)
+		{
+#ifdef _WIN32
+			u_long nonBlocking = blocking ? 0 : 1;
+			ioctlsocket(handle, FIONBIO, &nonBlocking);
+#else
+			int flags = fcntl(handle, F_GETFL, 0);
+			fcntl(handle, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+#endif
+		}
+
+		//Sends or receives the whole buffer on a blocking socket, returning false if the connection failed.
+		bool sendAll(socketHandle handle, const char *data, std::size_t length)
+		{
+			while (length > 0)
+			{
+				int sent = (int)send(handle, data, (int)std::min(length, MAX_TRANSFER), SEND_FLAGS);
+				if (sent <= 0 && !(sent < 0 && shouldRetry()))
+				{
+					return false;
+				}
+				data += std::max(sent, 0);
+				length -= std::max(sent, 0);
+			}
+			return true;
+		}
+
+		bool receiveAll(socketHandle handle, char *data, std::size_t length)
+		{
+			while (length > 0)
+			{
+				int received = (int)recv(handle, data, (int)std::min(length, MAX_TRANSFER), 0);
+				if (received <= 0 && !(received < 0 && shouldRetry()))
+				{
+					return false;
+				}
+				data += std::max(received, 0);
+				length -= std::max(received, 0);
+			}
+			return true;
+		}
+	}
+
+	/*Each worker listens first, then connects to the next worker, retrying until it's listening,
+	  and finally accepts the connection from the previous worker. A connection is queued by the
+	  listener before it's accepted, so every worker can finish connecting before any accepts.*/
+	ringCommunicator::ringCommunicator(int newRank, const std::vector<std::string> &addresses, int timeoutMilliseconds) :nextSocket((std::intptr_t)NO_SOCKET),
+		previousSocket((std::intptr_t)NO_SOCKET), rank(newRank), workerCount((int)addresses.size())
+	{
+		if (newRank < 0 || newRank >= (int)addresses.size())
+		{
+			throw std::out_of_range("The rank doesn't match one of the addresses.");
+		}
+		if (workerCount == 1)
+		{
+			return;
+		}
+#ifdef _WIN32
+		WSADATA startupData;
+		if (WSAStartup(MAKEWORD(2, 2), &startupData) != 0)
+		{
+			throw std::runtime_error("Couldn't start up the sockets library.");
+		}
+#endif
+		try
+		{
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+			socketAddress ownAddress = parseAddress(addresses[rank]);
+			socketAddress nextAddress = parseAddress(addresses[(rank + 1) % workerCount]);
+
+			ownedSocket listener(socket(ownAddress.family, SOCK_STREAM, 0));
+			int reuse = 1;
+			removeSocketFile(ownAddress);
+			setsockopt(listener.get(), SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+			if (listener.get() == NO_SOCKET || bind(listener.get(), reinterpret_cast<const sockaddr*>(&ownAddress.storage), ownAddress.length) != 0
+				|| listen(listener.get(), 1) != 0)
+			{
+				throw std::runtime_error("Couldn't listen on the worker's address.");
+			}
+
+			ownedSocket next(connectBefore(nextAddress, deadline));
+			std::int32_t sentRank = rank;
+			if (!sendAll(next.get(), reinterpret_cast<const char*>(&sentRank), sizeof(sentRank)))
+			{
+				throw std::runtime_error("Couldn't send the rank to the next worker.");
+			}
+
+			pollfd listening = pollfd();
+			listening.fd = listener.get();
+			listening.events = POLLIN;
+			int remaining = (int)std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+			if (pollSockets(&listening, 1, remaining) <= 0)
+			{
+				throw std::runtime_error("Timed out waiting for the previous worker to connect.");
+			}
+			ownedSocket previous(accept(listener.get(), NULL, NULL));
+			std::int32_t receivedRank = -1;
+			if (previous.get() == NO_SOCKET || !receiveAll(previous.get(), reinterpret_cast<char*>(&receivedRank), sizeof(receivedRank))
+				|| receivedRank != (rank + workerCount - 1) % workerCount)
+			{
+				throw std::runtime_error("The connection didn't come from the previous worker.");
+			}
+			removeSocketFile(ownAddress);
+
+			//Each step of the all-reduce is small enough that Nagle's algorithm would only delay it.
+			int noDelay = 1;
+			if (ownAddress.family != AF_UNIX)
+			{
+				setsockopt(previous.get(), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+			}
+			if (nextAddress.family != AF_UNIX)
+			{
+				setsockopt(next.get(), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+			}
+			setBlocking(next.get(), false);
+			setBlocking(previous.get(), false);
+			nextSocket = (std::intptr_t)next.release();
+			previousSocket = (std::intptr_t)previous.release();
+		}
+		catch (...)
+		{
+#ifdef _WIN32
+			WSACleanup();
+#endif
+			throw;
+		}
+	}
+
+	ringCommunicator::~ringCommunicator()
+	{
+		if (workerCount > 1)
+		{
+			closeSocket((socketHandle)nextSocket);
+			closeSocket((socketHandle)previousSocket);
+#ifdef _WIN32
+			WSACleanup();
+#endif
+		}
+	}
+
+	/*The first pass sends chunk rank - step while adding the chunk from the previous worker onto
+	  the array, so after it each worker holds the full sum of chunk rank + 1. The second pass
+	  passes those sums around the ring in the same pattern shifted by one.*/
+	void ringCommunicator::allReduce(float *data, std::size_t length)
+	{
+		if (workerCount == 1)
+		{
+			return;
+		}
+		std::vector<std::size_t> chunkStarts(workerCount + 1);
+		for (int chunkIndex = 0; chunkIndex <= workerCount; ++chunkIndex)
+		{
+			chunkStarts[chunkIndex] = length / workerCount * chunkIndex + std::min<std::size_t>(chunkIndex, length % workerCount);
+		}
+		received.resize(length / workerCount + 1);
+
+		for (int step = 0; step < workerCount - 1; ++step)
+		{
+			int sendChunk = (rank - step + workerCount) % workerCount;
+			int receiveChunk = (rank - step - 1 + 2 * workerCount) % workerCount;
+			std::size_t receiveLength = chunkStarts[receiveChunk + 1] - chunkStarts[receiveChunk];
+			exchange(data + chunkStarts[sendChunk], chunkStarts[sendChunk + 1] - chunkStarts[sendChunk], received.data(), receiveLength);
+			addVectors(data + chunkStarts[receiveChunk], received.data(), 1.0f, (int)receiveLength);
+		}
+		for (int step = 0; step < workerCount - 1; ++step)
+		{
+			int sendChunk = (rank + 1 - step + workerCount) % workerCount;
+			int receiveChunk = (rank - step + workerCount) % workerCount;
+			exchange(data + chunkStarts[sendChunk], chunkStarts[sendChunk + 1] - chunkStarts[sendChunk], data + chunkStarts[receiveChunk],
+				chunkStarts[receiveChunk + 1] - chunkStarts[receiveChunk]);
+		}
+	}
+
+	int ringCommunicator::getRank() const
+	{
+		return rank;
+	}
+
+	int ringCommunicator::getWorkerCount() const
+	{
+		return workerCount;
+	}
+
+	void ringCommunicator::exchange(const float *sendData, std::size_t sendLength, float *receiveData, std::size_t receiveLength)
+	{
+		const char *sendBytes = reinterpret_cast<const char*>(sendData);
+		std::size_t sendLeft = sendLength * sizeof(float);
+		char *receiveBytes = reinterpret_cast<char*>(receiveData);
+		std::size_t receiveLeft = receiveLength * sizeof(float);
+		while (sendLeft > 0 || receiveLeft > 0)
+		{
+			pollfd sockets[2];
+			int socketCount = 0;
+			if (sendLeft > 0)
+			{
+				sockets[socketCount].fd = (socketHandle)nextSocket;
+				sockets[socketCount].events = POLLOUT;
+				sockets[socketCount++].revents = 0;
+			}
+			if (receiveLeft > 0)
+			{
+				sockets[socketCount].fd = (socketHandle)previousSocket;
+				sockets[socketCount].events = POLLIN;
+				sockets[socketCount++].revents = 0;
+			}
+			if (pollSockets(sockets, socketCount, -1) < 0)
+			{
+				if (shouldRetry())
+				{
+					continue;
+				}
+				throw std::runtime_error("Couldn't wait on the connections to the other workers.");
+			}
+
+			//A failed connection shows up as an event too, so the calls below are what find it.
+			if (sendLeft > 0 && sockets[0].revents != 0)
+			{
+				int sent = (int)send((socketHandle)nextSocket, sendBytes, (int)std::min(sendLeft, MAX_TRANSFER), SEND_FLAGS);
+				if (sent <= 0 && !(sent < 0 && shouldRetry()))
+				{
+					throw std::runtime_error("The next worker left the ring.");
+				}
+				sendBytes += std::max(sent, 0);
+				sendLeft -= std::max(sent, 0);
+			}
+			if (receiveLeft > 0 && sockets[socketCount - 1].revents != 0)
+			{
+				int received = (int)recv((socketHandle)previousSocket, receiveBytes, (int)std::min(receiveLeft, MAX_TRANSFER), 0);
+				if (received <= 0 && !(received < 0 && shouldRetry()))
+				{
+					throw std::runtime_error("The previous worker left the ring.");
+				}
+				receiveBytes += std::max(received, 0);
+				receiveLeft -= std::max(received, 0);
+			}
+		}
+	}
+}
@@ -0,0 +1,59 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the ringCommunicator class, which connects a group of worker
+ *processes in a ring over sockets and sums arrays across them.*/
+
+#ifndef NEURAL_NETWORK_RING_COMMUNICATOR
+#define NEURAL_NETWORK_RING_COMMUNICATOR
+
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	/*One worker's connections in a ring of workers, each of which sends to the next worker and
+	 *receives from the previous one. The workers can be threads, processes on one machine or
+	 *processes on different machines, since they only share the list of addresses.
+	 *
+	 *The all-reduce splits the array into a chunk per worker and passes the chunks around the
+	 *ring twice, first adding each chunk up and then handing the sums back out. Every worker
+	 *sends and receives 2 * (workers - 1) / workers of the array no matter how many workers there
+	 *are, which is the least any all-reduce can move, and the sending and receiving of each step
+	 *happen at the same time.*/
+	class ringCommunicator
+	{
+	public:
+		/*Joins the ring as the worker with the given rank. Each address is "tcp:host:port" or
+		 *"unix:path" and the worker listens on the one matching its rank. Waits up to the given
+		 *number of milliseconds for the other workers to start listening. Throws
+		 *std::out_of_range if the rank doesn't match an address and std::runtime_error if an
+		 *address isn't valid or the ring couldn't be connected in time.*/
+		ringCommunicator(int, const std::vector<std::string>&, int);
+		ringCommunicator(const ringCommunicator&) = delete;
+		~ringCommunicator();
+		ringCommunicator& operator=(const ringCommunicator&) = delete;
+
+		/*Replaces the array of the given length on every worker with the sum of the arrays of
+		 *every worker. Every worker has to call it with the same length in the same order. Each
+		 *element ends up the same bit for bit on every worker. Throws std::runtime_error if a
+		 *worker leaves the ring.*/
+		void allReduce(float*, std::size_t);
+		int getRank() const;
+		int getWorkerCount() const;
+
+	private:
+		//Sends one array to the next worker while receiving another from the previous worker.
+		void exchange(const float*, std::size_t, float*, std::size_t);
+
+		//The socket to the next worker, kept in an integer wide enough for a socket on any platform.
+		std::intptr_t nextSocket;
+		std::intptr_t previousSocket;
+		int rank;
+		//The chunk being received during the first pass before it's added onto the array.
+		std::vector<float> received;
+		int workerCount;
+	};
+}
+
+#endif
@@ -0,0 +1,157 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "threadPool.h"
+#include<algorithm>
+#include<stdexcept>
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+		/*Number of times a worker checks for new work before going to sleep, so the stages run
+		  back to back don't pay for waking the threads.*/
+		const int WORKER_SPIN_COUNT = 4096;
+	}
+
+	threadPool::threadPool(int newThreadCount) :busyWorkers(0), chunkCount(0), chunkSize(1), loopContext(NULL), loopFunction(NULL),
+		loopCount(0), sleepingWorkers(0), stopping(false), threadCount(newThreadCount)
+	{
+		if (newThreadCount < 1)
+		{
+			threadCount = 1;
+			throw std::out_of_range("A thread pool needs at least one thread.");
+		}
+		generation.store(0);
+		chunkRanges.reset(new chunkRange[threadCount]);
+		for (int threadIndex = 1; threadIndex < threadCount; ++threadIndex)
+		{
+			workers.push_back(std::thread(&threadPool::workerLoop, this, threadIndex));
+		}
+	}
+
+	threadPool::~threadPool()
+	{
+		{
+			std::lock_guard<std::mutex> guard(wakeLock);
+			stopping.store(true);
+			generation.fetch_add(1, std::memory_order_release);
+		}
+		wakeCondition.notify_all();
+		for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it)
+		{
+			it->join();
+		}
+	}
+
+	int threadPool::getThreadCount() const
+	{
+		return threadCount;
+	}
+
+	void threadPool::runChunks(int threadIndex)
+	{
+		for (int offset = 0; offset < threadCount; ++offset)
+		{
+			chunkRange &range = chunkRanges[(threadIndex + offset) % threadCount];
+			for (int chunk = range.next.fetch_add(1, std::memory_order_relaxed); chunk < range.end; chunk = range.next.fetch_add(1, std::memory_order_relaxed))
+			{
+				int start = chunk * chunkSize;
+				try
+				{
+					loopFunction(loopContext, start, std::min(start + chunkSize, loopCount));
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> guard(exceptionLock);
+					if (!exception)
+					{
+						exception = std::current_exception();
+					}
+				}
+			}
+		}
+	}
+
+	void threadPool::run(int count, int newChunkSize, void(*function)(const void*, int, int), const void *context)
+	{
+		if (count <= 0)
+		{
+			return;
+		}
+		newChunkSize = std::max(newChunkSize, 1);
+		int newChunkCount = (count - 1) / newChunkSize + 1;
+
+		//Small loops are run on the calling thread since waking the workers would cost more than the work.
+		if (threadCount == 1 || newChunkCount == 1)
+		{
+			for (int start = 0; start < count; start += newChunkSize)
+			{
+				function(context, start, std::min(start + newChunkSize, count));
+			}
+			return;
+		}
+
+		loopFunction = function;
+		loopContext = context;
+		loopCount = count;
+		chunkSize = newChunkSize;
+		chunkCount = newChunkCount;
+		//Each thread starts with an even share of the chunks.
+		for (int threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+		{
+			chunkRanges[threadIndex].next.store(chunkCount * threadIndex / threadCount, std::memory_order_relaxed);
+			chunkRanges[threadIndex].end = chunkCount * (threadIndex + 1) / threadCount;
+		}
+		busyWorkers.store(threadCount - 1, std::memory_order_relaxed);
+
+		bool notify;
+		{
+			std::lock_guard<std::mutex> guard(wakeLock);
+			generation.fetch_add(1, std::memory_order_release);
+			notify = sleepingWorkers > 0;
+		}
+		if (notify)
+		{
+			wakeCondition.notify_all();
+		}
+
+		runChunks(0);
+		while (busyWorkers.load(std::memory_order_acquire) != 0)
+		{
+			std::this_thread::yield();
+		}
+
+		if (exception)
+		{
+			std::exception_ptr thrown = exception;
+			exception = std::exception_ptr();
+			std::rethrow_exception(thrown);
+		}
+	}
+
+	void threadPool::workerLoop(int threadIndex)
+	{
+		unsigned int seenGeneration = 0;
+		while (true)
+		{
+			for (int spin = 0; spin < WORKER_SPIN_COUNT && generation.load(std::memory_order_acquire) == seenGeneration; ++spin)
+			{
+				std::this_thread::yield();
+			}
+			if (generation.load(std::memory_order_acquire) == seenGeneration)
+			{
+				std::unique_lock<std::mutex> guard(wakeLock);
+				++sleepingWorkers;
+				wakeCondition.wait(guard, [&] { return generation.load(std::memory_order_acquire) != seenGeneration; });
+				--sleepingWorkers;
+			}
+			if (stopping.load())
+			{
+				return;
+			}
+
+			seenGeneration = generation.load(std::memory_order_acquire);
+			runChunks(threadIndex);
+			busyWorkers.fetch_sub(1, std::memory_order_release);
+		}
+	}
+}
@@ -0,0 +1,88 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the threadPool class which splits the independent work of a stage
+ *across a set of threads that are kept alive between calls.*/
+
+#ifndef NEURAL_NETWORK_THREAD_POOL
+#define NEURAL_NETWORK_THREAD_POOL
+
+#include<atomic>
+#include<condition_variable>
+#include<exception>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	/*Runs loops split into chunks across persistent worker threads with the calling thread
+	 *working alongside them. Each thread starts on its own range of chunks and claims them one
+	 *at a time with an atomic counter. Once its range runs out it steals the remaining chunks
+	 *of the other ranges, so uneven chunks still keep every thread busy. Only one loop can run
+	 *on a pool at a time.*/
+	class threadPool
+	{
+	public:
+		/*Creates a pool that runs loops on the given number of threads including the calling
+		 *thread. A pool with one thread runs every loop on the calling thread.*/
+		explicit threadPool(int);
+		threadPool(const threadPool&) = delete;
+		~threadPool();
+		threadPool& operator=(const threadPool&) = delete;
+
+		int getThreadCount() const;
+		/*Calls the body with each range [start, end) of at most chunkSize indexes covering
+		 *[0, count) and returns once every call has finished. Loops with a single chunk are run
+		 *on the calling thread. If a call throws, the first exception is rethrown once the
+		 *other calls are done.*/
+		template<typename loopBody>
+		void parallelFor(int count, int chunkSize, const loopBody &body)
+		{
+			run(count, chunkSize, &callBody<loopBody>, &body);
+		}
+
+	private:
+		//The range of chunks a thread starts with, padded so each counter has its own cache line.
+		struct chunkRange
+		{
+			std::atomic<int> next;
+			int end;
+			char padding[64 - sizeof(std::atomic<int>) - sizeof(int)];
+		};
+
+		template<typename loopBody>
+		static void callBody(const void *body, int start, int end)
+		{
+			(*static_cast<const loopBody*>(body))(start, end);
+		}
+
+		//Runs chunks starting with the given thread's range and then stealing from the others.
+		void runChunks(int);
+		void run(int, int, void(*)(const void*, int, int), const void*);
+		//The loop each worker thread runs until the pool is destroyed.
+		void workerLoop(int);
+
+		//Workers that haven't finished the current loop.
+		std::atomic<int> busyWorkers;
+		int chunkCount;
+		int chunkSize;
+		std::unique_ptr<chunkRange[]> chunkRanges;
+		//The first exception thrown by the current loop.
+		std::exception_ptr exception;
+		std::mutex exceptionLock;
+		//Incremented each time a loop starts so the workers know there's new work.
+		std::atomic<unsigned int> generation;
+		const void *loopContext;
+		void(*loopFunction)(const void*, int, int);
+		int loopCount;
+		//Workers waiting on the wake condition, which only need to be notified when there are any.
+		int sleepingWorkers;
+		std::atomic<bool> stopping;
+		int threadCount;
+		std::condition_variable wakeCondition;
+		std::mutex wakeLock;
+		std::vector<std::thread> workers;
+	};
+}
+
+#endif
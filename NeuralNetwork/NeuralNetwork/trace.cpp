@@ -0,0 +1,241 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "trace.h"
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<fstream>
+#include<memory>
+#include<mutex>
+#include<stdexcept>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+		//Version of the binary trace format, increased whenever the traceEvent struct changes.
+		const char BINARY_TRACE_VERSION = 1;
+
+		/*Ring buffer of the events of one thread. Only the owning thread writes to it, so the
+		  count of written events is the only thing that needs to be atomic.*/
+		struct traceBuffer
+		{
+			std::unique_ptr<traceEvent[]> events;
+			std::uint32_t thread;
+			std::atomic<std::uint64_t> written;
+		};
+
+		//Every buffer ever created, which are kept after their thread exits so they can be written out.
+		struct traceRegistry
+		{
+			traceRegistry() :enabled(true), epoch(std::chrono::steady_clock::now()), stats(false)
+			{
+
+			}
+
+			std::vector<std::shared_ptr<traceBuffer>> buffers;
+			std::atomic<bool> enabled;
+			std::chrono::steady_clock::time_point epoch;
+			std::mutex lock;
+			std::atomic<bool> stats;
+		};
+
+		traceRegistry& getRegistry()
+		{
+			static traceRegistry registry;
+			return registry;
+		}
+
+		//Returns the calling thread's buffer, creating and registering it on the first event.
+		traceBuffer& getThreadBuffer()
+		{
+			thread_local std::shared_ptr<traceBuffer> buffer;
+			if (!buffer)
+			{
+				traceRegistry &registry = getRegistry();
+				buffer = std::make_shared<traceBuffer>();
+				buffer->events.reset(new traceEvent[TRACE_BUFFER_EVENTS]);
+				buffer->written.store(0);
+				std::lock_guard<std::mutex> guard(registry.lock);
+				buffer->thread = (std::uint32_t)registry.buffers.size();
+				registry.buffers.push_back(buffer);
+			}
+			return *buffer;
+		}
+
+		//Copies the events still in every buffer, oldest first within each thread.
+		void collectEvents(std::vector<traceEvent> &output)
+		{
+			traceRegistry &registry = getRegistry();
+			std::lock_guard<std::mutex> guard(registry.lock);
+			output.clear();
+			for (std::vector<std::shared_ptr<traceBuffer>>::iterator it = registry.buffers.begin(); it != registry.buffers.end(); ++it)
+			{
+				std::uint64_t written = (*it)->written.load(std::memory_order_acquire);
+				std::uint64_t first = written > (std::uint64_t)TRACE_BUFFER_EVENTS ? written - TRACE_BUFFER_EVENTS : 0;
+				for (std::uint64_t eventIndex = first; eventIndex < written; ++eventIndex)
+				{
+					output.push_back((*it)->events[eventIndex % TRACE_BUFFER_EVENTS]);
+				}
+			}
+		}
+
+		const char* getEventName(std::uint32_t type)
+		{
+			switch (type)
+			{
+			case forwardStageEvent:
+				return "forward stage";
+			case backwardStageEvent:
+				return "backward stage";
+			case forwardCellEvent:
+				return "forward cell";
+			default:
+				return "backward cell";
+			}
+		}
+	}
+
+	void clearTrace()
+	{
+		traceRegistry &registry = getRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		for (std::vector<std::shared_ptr<traceBuffer>>::iterator it = registry.buffers.begin(); it != registry.buffers.end(); ++it)
+		{
+			(*it)->written.store(0, std::memory_order_release);
+		}
+	}
+
+	std::uint64_t getTraceTime()
+	{
+		return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - getRegistry().epoch).count();
+	}
+
+	bool getTraceStatsEnabled()
+	{
+		return getRegistry().stats.load(std::memory_order_relaxed);
+	}
+
+	bool getTracingEnabled()
+	{
+		return getRegistry().enabled.load(std::memory_order_relaxed);
+	}
+
+	void recordTraceEvent(const traceEvent &event)
+	{
+		traceBuffer &buffer = getThreadBuffer();
+		std::uint64_t written = buffer.written.load(std::memory_order_relaxed);
+		buffer.events[written % TRACE_BUFFER_EVENTS] = event;
+		buffer.events[written % TRACE_BUFFER_EVENTS].thread = buffer.thread;
+		buffer.written.store(written + 1, std::memory_order_release);
+	}
+
+	void setTraceStatsEnabled(bool newStats)
+	{
+		getRegistry().stats.store(newStats);
+	}
+
+	void setTracingEnabled(bool newEnabled)
+	{
+		getRegistry().enabled.store(newEnabled);
+	}
+
+	void writeBinaryTrace(const std::string &fileName)
+	{
+		std::vector<traceEvent> events;
+		collectEvents(events);
+		std::ofstream file(fileName.c_str(), std::ios::binary);
+		if (!file)
+		{
+			throw std::runtime_error("Couldn't open the trace file for writing.");
+		}
+		std::uint64_t eventCount = events.size();
+		file.write("NNTRACE", 7);
+		file.put(BINARY_TRACE_VERSION);
+		file.write(reinterpret_cast<const char*>(&eventCount), sizeof(eventCount));
+		if (!events.empty())
+		{
+			file.write(reinterpret_cast<const char*>(events.data()), events.size() * sizeof(traceEvent));
+		}
+		if (!file)
+		{
+			throw std::runtime_error("Couldn't write the trace file.");
+		}
+	}
+
+	void writeChromeTrace(const std::string &fileName)
+	{
+		std::vector<traceEvent> events;
+		collectEvents(events);
+		std::ofstream file(fileName.c_str());
+		if (!file)
+		{
+			throw std::runtime_error("Couldn't open the trace file for writing.");
+		}
+
+		//Complete events with the times in microseconds as Chrome expects.
+		file.precision(9);
+		file << "{\"traceEvents\":[";
+		for (std::size_t eventIndex = 0; eventIndex < events.size(); ++eventIndex)
+		{
+			const traceEvent &event = events[eventIndex];
+			file << (eventIndex == 0 ? "\n" : ",\n");
+			file << "{\"name\":\"" << getEventName(event.type) << ' ' << (event.type == forwardStageEvent || event.type == backwardStageEvent ? event.stage : event.cellIndex) << "\",\"cat\":\""
+				<< (event.type == forwardStageEvent || event.type == forwardCellEvent ? "forward" : "backward")
+				<< "\",\"ph\":\"X\",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0
+				<< ",\"pid\":0,\"tid\":" << event.thread << ",\"args\":{\"cell\":" << event.cellIndex << ",\"stage\":" << event.stage;
+			if (event.hasStats)
+			{
+				file << ",\"min\":" << event.minimum << ",\"mean\":" << event.mean << ",\"max\":" << event.maximum;
+			}
+			file << "}}";
+		}
+		file << "\n],\"displayTimeUnit\":\"ns\"}\n";
+		if (!file)
+		{
+			throw std::runtime_error("Couldn't write the trace file.");
+		}
+	}
+
+	//traceScope:
+	traceScope::traceScope(traceEventType type, int cellIndex, int stage) :recording(getTracingEnabled())
+	{
+		if (recording)
+		{
+			event.cellIndex = cellIndex;
+			event.hasStats = 0;
+			event.maximum = event.mean = event.minimum = 0.0f;
+			event.stage = stage;
+			event.thread = 0;
+			event.type = type;
+			event.start = getTraceTime();
+		}
+	}
+
+	traceScope::~traceScope()
+	{
+		if (recording)
+		{
+			event.duration = getTraceTime() - event.start;
+			recordTraceEvent(event);
+		}
+	}
+
+	void traceScope::setStats(const float *values, int length)
+	{
+		if (!recording || length < 1 || !getTraceStatsEnabled())
+		{
+			return;
+		}
+		event.hasStats = 1;
+		event.minimum = event.maximum = values[0];
+		double sum = 0.0;
+		for (int i = 0; i < length; ++i)
+		{
+			event.minimum = std::min(event.minimum, values[i]);
+			event.maximum = std::max(event.maximum, values[i]);
+			sum += values[i];
+		}
+		event.mean = (float)(sum / length);
+	}
+}
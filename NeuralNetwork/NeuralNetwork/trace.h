@@ -0,0 +1,88 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the tracing functions used to profile propagation. Each thread writes its events into
+ *its own ring buffer without any locking, and the buffers of every thread are written out as a
+ *Chrome trace or a binary file after the run. The TRACE_SCOPE macros compile to nothing unless
+ *the TRACE_EVENTS flag in preprocessorFlags.h is turned on.*/
+
+#ifndef NEURAL_NETWORK_TRACE
+#define NEURAL_NETWORK_TRACE
+
+#include "preprocessorFlags.h"
+#include<cstdint>
+#include<string>
+
+namespace NeuralNetwork
+{
+	//Number of events each thread keeps before the oldest ones are overwritten.
+	static const int TRACE_BUFFER_EVENTS = 1 << 16;
+
+	enum traceEventType
+	{
+		forwardStageEvent = 0, backwardStageEvent = 1, forwardCellEvent = 2, backwardCellEvent = 3
+	};
+
+	/*One traced stage or cell. The times are in nanoseconds since tracing started, and the
+	 *tensor stats are of the values of a forward event or the deltas of a backward event.*/
+	struct traceEvent
+	{
+		std::uint64_t start;
+		std::uint64_t duration;
+		std::int32_t cellIndex;
+		std::int32_t stage;
+		std::uint32_t thread;
+		std::uint32_t type;
+		//Whether the tensor stats were recorded.
+		std::uint32_t hasStats;
+		float maximum;
+		float mean;
+		float minimum;
+	};
+
+	//Removes the recorded events of every thread.
+	void clearTrace();
+	//Returns the nanoseconds since tracing started.
+	std::uint64_t getTraceTime();
+	bool getTraceStatsEnabled();
+	bool getTracingEnabled();
+	/*Adds an event to the calling thread's ring buffer. Only the calling thread writes to its
+	 *buffer, so no locking is needed.*/
+	void recordTraceEvent(const traceEvent&);
+	//Sets whether the traced tensors have their minimum, mean and maximum recorded.
+	void setTraceStatsEnabled(bool);
+	//Turns recording on or off at runtime for builds with the TRACE_EVENTS flag turned on.
+	void setTracingEnabled(bool);
+	/*Writes the recorded events as a header followed by the traceEvent structs. The header is
+	 *the characters "NNTRACE", a version byte and the number of events as a 64 bit integer.
+	 *Should only be called while nothing is being traced. Throws std::runtime_error if the file
+	 *can't be written.*/
+	void writeBinaryTrace(const std::string&);
+	/*Writes the recorded events as a Chrome trace JSON file, which can be opened with
+	 *chrome://tracing or Perfetto. Should only be called while nothing is being traced. Throws
+	 *std::runtime_error if the file can't be written.*/
+	void writeChromeTrace(const std::string&);
+
+	/*Times the scope it's created in and records an event for it when destroyed. Used through
+	 *the TRACE_SCOPE macros.*/
+	class traceScope
+	{
+	public:
+		traceScope(traceEventType, int, int);
+		~traceScope();
+		//Records the minimum, mean and maximum of the tensor row if stats are enabled.
+		void setStats(const float*, int);
+
+	private:
+		traceEvent event;
+		bool recording;
+	};
+}
+
+#if TRACE_EVENTS
+#define TRACE_SCOPE(type, cellIndex, stage) NeuralNetwork::traceScope traceScopeInstance(type, cellIndex, stage)
+#define TRACE_SCOPE_STATS(values, length) traceScopeInstance.setStats(values, length)
+#else
+#define TRACE_SCOPE(type, cellIndex, stage)
+#define TRACE_SCOPE_STATS(values, length)
+#endif
+
+#endif
@@ -0,0 +1,187 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+#include "trainingDriver.h"
+#include "helperFunctions.h"
+#include "neuralNetworkErrors.h"
+#include<algorithm>
+#include<chrono>
+#include<condition_variable>
+#include<mutex>
+#include<stdexcept>
+#include<thread>
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+		/*Thread that finds the loss of one batch at a time from copies of its outputs and targets,
+		 *adding it onto the sum of the batch's epoch. There are two pairs of copies, so the next
+		 *batch can be copied while the last one is still being worked on.*/
+		class lossWorker
+		{
+		public:
+			lossWorker(std::vector<double> &newEpochLosses) :busy(false), epochLosses(newEpochLosses), stopping(false)
+			{
+				worker = std::thread(&lossWorker::run, this);
+			}
+
+			~lossWorker()
+			{
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					stopping = true;
+				}
+				changed.notify_all();
+				worker.join();
+			}
+
+			//Returns the pair of tensors the next batch should be copied into.
+			batchTensor& getOutputs(int slot)
+			{
+				return outputs[slot];
+			}
+
+			batchTensor& getTargets(int slot)
+			{
+				return targets[slot];
+			}
+
+			//Hands a copied batch over to the thread once the last one is done and returns how long that took.
+			std::uint64_t submit(int slot, int epoch)
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+				changed.wait(guard, [&] {return !busy; });
+				std::uint64_t waited = getElapsed(waitStart);
+				busy = true;
+				pendingEpoch = epoch;
+				pendingSlot = slot;
+				changed.notify_all();
+				return waited;
+			}
+
+			//Waits for the last batch handed over and returns how long that took.
+			std::uint64_t wait()
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+				changed.wait(guard, [&] {return !busy; });
+				return getElapsed(waitStart);
+			}
+
+		private:
+			void run()
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				while (true)
+				{
+					changed.wait(guard, [&] {return busy || stopping; });
+					if (stopping)
+					{
+						return;
+					}
+					int slot = pendingSlot;
+					int epoch = pendingEpoch;
+					guard.unlock();
+
+					//The squared errors are summed per sample over the outputs and then averaged over them.
+					const batchTensor &output = outputs[slot];
+					const batchTensor &target = targets[slot];
+					double batchLoss = 0.0;
+					for (int row = 0; row < output.getRowCount(); ++row)
+					{
+						float rowLoss = 0.0f;
+						const float *outputRow = output.getRow(row);
+						const float *targetRow = target.getRow(row);
+						for (int batchIndex = 0; batchIndex < output.getBatchSize(); ++batchIndex)
+						{
+							float error = targetRow[batchIndex] - outputRow[batchIndex];
+							rowLoss += error * error;
+						}
+						batchLoss += rowLoss;
+					}
+
+					guard.lock();
+					epochLosses[epoch] += output.getRowCount() > 0 ? batchLoss / output.getRowCount() : 0.0;
+					busy = false;
+					changed.notify_all();
+				}
+			}
+
+			bool busy;
+			std::condition_variable changed;
+			std::vector<double> &epochLosses;
+			std::mutex lock;
+			batchTensor outputs[2];
+			int pendingEpoch;
+			int pendingSlot;
+			bool stopping;
+			batchTensor targets[2];
+			std::thread worker;
+		};
+	}
+
+	trainingDriver::trainingDriver(neuralNetwork &newNetwork, const datasetReader &newDataset, int newBatchSize) :batchSize(newBatchSize),
+		dataset(newDataset), network(newNetwork)
+	{
+		if (newBatchSize < 1)
+		{
+			throw std::out_of_range("Batch size must be greater then zero.");
+		}
+		if (newDataset.getInputCount() != newNetwork.getInputNodes() || newDataset.getTargetCount() != newNetwork.getOutputNodes())
+		{
+			throw lists_not_same_length();
+		}
+	}
+
+	int trainingDriver::getBatchSize() const
+	{
+		return batchSize;
+	}
+
+	trainingStats trainingDriver::train(int epochCount, std::uint64_t seed)
+	{
+		trainingStats stats = trainingStats();
+		stats.epochLosses.assign(std::max(epochCount, 0), 0.0);
+		std::chrono::steady_clock::time_point trainStart = std::chrono::steady_clock::now();
+		{
+			batchProducer producer(dataset, batchSize, epochCount, seed);
+			lossWorker losses(stats.epochLosses);
+			const batchTensor *input, *target;
+			while (true)
+			{
+				std::chrono::steady_clock::time_point stepStart = std::chrono::steady_clock::now();
+				if (!producer.nextBatch(input, target))
+				{
+					stats.loadWaitTime += getElapsed(stepStart);
+					break;
+				}
+				stats.loadWaitTime += getElapsed(stepStart);
+
+				stepStart = std::chrono::steady_clock::now();
+				network.forwardPropagate(*input);
+				stats.forwardTime += getElapsed(stepStart);
+
+				//The batches alternate between the two pairs of copies, so the loss worker is at most one batch behind.
+				int slot = (int)(stats.batchCount % 2);
+				network.getOutput(losses.getOutputs(slot));
+				losses.getTargets(slot) = *target;
+				stats.lossWaitTime += losses.submit(slot, producer.getEpoch());
+
+				stepStart = std::chrono::steady_clock::now();
+				network.backwardPropagate(*target);
+				stats.backwardTime += getElapsed(stepStart);
+				++stats.batchCount;
+				stats.sampleCount += input->getBatchSize();
+			}
+			stats.lossWaitTime += losses.wait();
+			stats.producerWaitTime = producer.getProducerWaitTime();
+		}
+		stats.totalTime = getElapsed(trainStart);
+		stats.samplesPerSecond = stats.totalTime > 0 ? stats.sampleCount * 1e9 / stats.totalTime : 0.0;
+		for (std::vector<double>::iterator it = stats.epochLosses.begin(); it != stats.epochLosses.end(); ++it)
+		{
+			*it = dataset.getSampleCount() > 0 ? *it / dataset.getSampleCount() : 0.0;
+		}
+		return stats;
+	}
+}
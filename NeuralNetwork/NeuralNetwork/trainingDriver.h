@@ -0,0 +1,62 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the prototype for the trainingDriver class, which trains a network on a dataset file
+ *with the loading of batches, the loss and the propagation overlapped, and the
+ *trainingStats struct it reports the time spent in each part of a step with.*/
+
+#ifndef NEURAL_NETWORK_TRAINING_DRIVER
+#define NEURAL_NETWORK_TRAINING_DRIVER
+
+#include "batchTensor.h"
+#include "dataset.h"
+#include "neuralNetwork.h"
+#include<cstdint>
+#include<vector>
+
+namespace NeuralNetwork
+{
+	/*Where the time of a training run went. The times are in nanoseconds and, other than the
+	 *producer wait, are measured on the thread running the network.*/
+	struct trainingStats
+	{
+		std::uint64_t backwardTime;
+		std::uint64_t batchCount;
+		//Mean squared error of the outputs over every sample of each epoch.
+		std::vector<double> epochLosses;
+		std::uint64_t forwardTime;
+		//Time spent waiting for the next batch to be loaded, which is high when bound by I/O.
+		std::uint64_t loadWaitTime;
+		//Time spent waiting for the loss of the previous batch before handing over the next one.
+		std::uint64_t lossWaitTime;
+		//Time the loading thread spent waiting for a free buffer, which is high when bound by compute.
+		std::uint64_t producerWaitTime;
+		std::uint64_t sampleCount;
+		double samplesPerSecond;
+		std::uint64_t totalTime;
+	};
+
+	/*Trains a network on a dataset with each step overlapped with the steps around it. While the
+	 *network runs batch N, a background thread loads batch N + 1 into the other buffer, and once
+	 *batch N has been forward propagated its outputs are copied so a second thread can find its
+	 *loss during the backward propagation. Forward and backward propagation of one network can't
+	 *overlap each other, since the backward propagation of a batch needs the values its forward
+	 *propagation left in the network.*/
+	class trainingDriver
+	{
+	public:
+		/*Creates a driver for the given network and dataset. Throws lists_not_same_length if the
+		 *samples don't have an input for every input node and a target for every output node.*/
+		trainingDriver(neuralNetwork&, const datasetReader&, int);
+
+		int getBatchSize() const;
+		/*Trains the network for the given number of epochs, shuffling with the given seed, and
+		 *returns where the time went.*/
+		trainingStats train(int, std::uint64_t);
+
+	private:
+		int batchSize;
+		const datasetReader &dataset;
+		neuralNetwork &network;
+	};
+}
+
+#endif
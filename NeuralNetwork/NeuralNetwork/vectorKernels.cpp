@@ -0,0 +1,979 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the scalar, SSE4.2, AVX2 and AVX-512 versions of the vector kernels along with the
+ *processor feature detection used to pick between them.*/
+
+#include "vectorKernels.h"
+#include "activationFunctions.h"
+#include "neuralNetworkErrors.h"
+#include "preprocessorFlags.h"
+#include "reducedPrecision.h"
+#include<algorithm>
+#include<cstdint>
+#include<cstring>
+#include<math.h>
+
+#if SIMD_KERNELS && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define NEURAL_NETWORK_X86_KERNELS 1
+#include<immintrin.h>
+#ifdef _MSC_VER
+#include<intrin.h>
+//MSVC allows the intrinsics of every instruction set in any function.
+#define KERNEL_TARGET(instructions)
+#else
+//GCC and Clang need each function to be marked with the instruction sets it uses.
+#define KERNEL_TARGET(instructions) __attribute__((target(instructions)))
+#endif
+#else
+#define NEURAL_NETWORK_X86_KERNELS 0
+#endif
+
+namespace NeuralNetwork
+{
+	namespace
+	{
+		/*Constants of the fast sigmoid approximation. e^-x is found as 2^t with t = -x * log2(e)
+		 *split into n + f with |f| <= 0.5, where 2^f comes from a degree 3 minimax polynomial with
+		 *a relative error below 7.5e-5 and 2^n is built directly in the exponent bits. Clamping t
+		 *to +-126 keeps 2^n a normal float, so nothing overflows, and the vector kernels replace
+		 *the division with a reciprocal estimate refined by one Newton step.*/
+		const float FAST_EXP_LOG2E = 1.44269504088896341f;
+		const float FAST_EXP_MAX_POWER = 126.0f;
+		const float FAST_EXP_P0 = 9.9992807354e-1f;
+		const float FAST_EXP_P1 = 6.9326098546e-1f;
+		const float FAST_EXP_P2 = 2.4261112219e-1f;
+		const float FAST_EXP_P3 = 5.5171669075e-2f;
+
+		//Scalar kernels, which are also used for the elements left over after the vector loops.
+		void addVectorsScalar(float *target, const float *ref, float multiplier, int length)
+		{
+			for (float *targetEnd = target + length; target != targetEnd; ++target, ++ref)
+			{
+				*target += *ref * multiplier;
+			}
+		}
+
+		void addWeightedRowsScalar(float *target, const float *const *rows, const float *weights, int rowCount, int length)
+		{
+			for (int row = 0; row < rowCount; ++row)
+			{
+				addVectorsScalar(target, rows[row], weights[row], length);
+			}
+		}
+
+		//Adds the rows to the elements [start, length) of the target, which the vector kernels use for their leftover elements.
+		void addWeightedRowsTail(float *target, const float *const *rows, const float *weights, int rowCount, int start, int length)
+		{
+			for (int i = start; i < length; ++i)
+			{
+				float sum = target[i];
+				for (int row = 0; row < rowCount; ++row)
+				{
+					sum += rows[row][i] * weights[row];
+				}
+				target[i] = sum;
+			}
+		}
+
+		void convertFromHalfScalar(const std::uint16_t *values, float *output, int length)
+		{
+			for (int i = 0; i < length; ++i)
+			{
+				output[i] = fromHalf(values[i]);
+			}
+		}
+
+		void convertToHalfScalar(const float *values, std::uint16_t *output, int length)
+		{
+			for (int i = 0; i < length; ++i)
+			{
+				output[i] = toHalf(values[i]);
+			}
+		}
+
+		float dotProductScalar(const float *first, const float *second, int length)
+		{
+			float output = 0.0f;
+			for (int i = 0; i < length; ++i)
+			{
+				output += first[i] * second[i];
+			}
+			return output;
+		}
+
+		std::int32_t dotProductInt8Scalar(const std::uint8_t *values, const std::int8_t *weights, int length)
+		{
+			std::int32_t output = 0;
+			for (int i = 0; i < length; ++i)
+			{
+				output += (std::int32_t)values[i] * weights[i];
+			}
+			return output;
+		}
+
+		void exponentialScalar(float *values, int length)
+		{
+			for (float *valuesEnd = values + length; values != valuesEnd; ++values)
+			{
+				*values = exp(*values);
+			}
+		}
+
+		void fastSigmoidScalar(float *values, int length)
+		{
+			for (int i = 0; i < length; ++i)
+			{
+				//The constants go first so NaN inputs are clamped as well.
+				float power = std::max(-FAST_EXP_MAX_POWER, std::min(FAST_EXP_MAX_POWER, -values[i] * FAST_EXP_LOG2E));
+				float wholePower = floorf(power + 0.5f);
+				float fraction = power - wholePower;
+				float polynomial = ((FAST_EXP_P3 * fraction + FAST_EXP_P2) * fraction + FAST_EXP_P1) * fraction + FAST_EXP_P0;
+				std::int32_t exponentBits = ((std::int32_t)wholePower + 127) << 23;
+				float scale;
+				std::memcpy(&scale, &exponentBits, sizeof(scale));
+				values[i] = 1.0f / (1.0f + polynomial * scale);
+			}
+		}
+
+		void multiplyTileScalar(int depth, const float *a, int aRowStep, int aDepthStep, const float *packedB, float *c, int cStride)
+		{
+			//Each row of the tile is kept in its own accumulator so they can stay in registers.
+			float row0[KERNEL_TILE_COLUMNS] = {}, row1[KERNEL_TILE_COLUMNS] = {}, row2[KERNEL_TILE_COLUMNS] = {}, row3[KERNEL_TILE_COLUMNS] = {};
+			for (int p = 0; p < depth; ++p, a += aDepthStep, packedB += KERNEL_TILE_COLUMNS)
+			{
+				const float a0 = a[0], a1 = a[aRowStep], a2 = a[2 * aRowStep], a3 = a[3 * aRowStep];
+				for (int j = 0; j < KERNEL_TILE_COLUMNS; ++j)
+				{
+					const float bValue = packedB[j];
+					row0[j] += a0 * bValue;
+					row1[j] += a1 * bValue;
+					row2[j] += a2 * bValue;
+					row3[j] += a3 * bValue;
+				}
+			}
+			for (int j = 0; j < KERNEL_TILE_COLUMNS; ++j)
+			{
+				c[j] += row0[j];
+				c[cStride + j] += row1[j];
+				c[2 * cStride + j] += row2[j];
+				c[3 * cStride + j] += row3[j];
+			}
+		}
+
+		void sigmoidScalar(float *values, int length)
+		{
+			for (float *valuesEnd = values + length; values != valuesEnd; ++values)
+			{
+				*values = NeuralNetwork::sigmoid(*values);
+			}
+		}
+
+		void sigmoidDeltaScalar(float *delta, const float *error, const float *values, int length)
+		{
+			for (int i = 0; i < length; ++i)
+			{
+				delta[i] = error[i] * sigmoidGrad(values[i]);
+			}
+		}
+
+		const vectorKernels SCALAR_KERNELS = { scalar, addVectorsScalar, addWeightedRowsScalar, convertFromHalfScalar, convertToHalfScalar, dotProductScalar, dotProductInt8Scalar, exponentialScalar, fastSigmoidScalar, multiplyTileScalar, sigmoidScalar, sigmoidDeltaScalar };
+
+#if NEURAL_NETWORK_X86_KERNELS
+		/*Constants of the exponential approximation used by the vector exponential and sigmoid
+		 *kernels. The input is split into n * ln(2) + r with |r| <= ln(2) / 2, e^r is found with
+		 *a polynomial and 2^n is built directly in the exponent bits, which stays within a few
+		 *units in the last place of expf(). Inputs are clamped so 2^n can't overflow.*/
+		const float EXP_MAX_INPUT = 87.0f;
+		const float EXP_MIN_INPUT = -87.0f;
+		const float EXP_LOG2E = 1.44269504088896341f;
+		const float EXP_LN2_HIGH = 0.693359375f;
+		const float EXP_LN2_LOW = -2.12194440e-4f;
+		const float EXP_P0 = 1.9875691500e-4f;
+		const float EXP_P1 = 1.3981999507e-3f;
+		const float EXP_P2 = 8.3334519073e-3f;
+		const float EXP_P3 = 4.1665795894e-2f;
+		const float EXP_P4 = 1.6666665459e-1f;
+		const float EXP_P5 = 5.0000001201e-1f;
+
+		//SSE4.2 kernels:
+		KERNEL_TARGET("sse4.2")
+		void addVectorsSSE42(float *target, const float *ref, float multiplier, int length)
+		{
+			const __m128 scale = _mm_set1_ps(multiplier);
+			int i = 0;
+			for (; i + 4 <= length; i += 4)
+			{
+				_mm_storeu_ps(target + i, _mm_add_ps(_mm_loadu_ps(target + i), _mm_mul_ps(_mm_loadu_ps(ref + i), scale)));
+			}
+			addVectorsScalar(target + i, ref + i, multiplier, length - i);
+		}
+
+		KERNEL_TARGET("sse4.2")
+		void addWeightedRowsSSE42(float *target, const float *const *rows, const float *weights, int rowCount, int length)
+		{
+			int i = 0;
+			for (; i + 16 <= length; i += 16)
+			{
+				__m128 sum0 = _mm_loadu_ps(target + i), sum1 = _mm_loadu_ps(target + i + 4), sum2 = _mm_loadu_ps(target + i + 8), sum3 = _mm_loadu_ps(target + i + 12);
+				for (int row = 0; row < rowCount; ++row)
+				{
+					const __m128 scale = _mm_set1_ps(weights[row]);
+					const float *rowStart = rows[row] + i;
+					sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(rowStart), scale));
+					sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(rowStart + 4), scale));
+					sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(rowStart + 8), scale));
+					sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(rowStart + 12), scale));
+				}
+				_mm_storeu_ps(target + i, sum0);
+				_mm_storeu_ps(target + i + 4, sum1);
+				_mm_storeu_ps(target + i + 8, sum2);
+				_mm_storeu_ps(target + i + 12, sum3);
+			}
+			addWeightedRowsTail(target, rows, weights, rowCount, i, length);
+		}
+
+		KERNEL_TARGET("sse4.2")
+		float dotProductSSE42(const float *first, const float *second, int length)
+		{
+			__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+			int i = 0;
+			for (; i + 8 <= length; i += 8)
+			{
+				sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(first + i), _mm_loadu_ps(second + i)));
+				sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(first + i + 4), _mm_loadu_ps(second + i + 4)));
+			}
+			sum0 = _mm_add_ps(sum0, sum1);
+			sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+			sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+			return _mm_cvtss_f32(sum0) + dotProductScalar(first + i, second + i, length - i);
+		}
+
+		KERNEL_TARGET("sse4.2")
+		std::int32_t sumInt32(__m128i sum)
+		{
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+			return _mm_cvtsi128_si32(sum);
+		}
+
+		/*The bytes are widened to 16 bits before multiplying, since multiplying the bytes directly
+		  with pmaddubsw saturates the sum of each pair.*/
+		KERNEL_TARGET("sse4.2")
+		std::int32_t dotProductInt8SSE42(const std::uint8_t *values, const std::int8_t *weights, int length)
+		{
+			__m128i sum = _mm_setzero_si128();
+			int i = 0;
+			for (; i + 8 <= length; i += 8)
+			{
+				__m128i widenedValues = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values + i)));
+				__m128i widenedWeights = _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights + i)));
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(widenedValues, widenedWeights));
+			}
+			return sumInt32(sum) + dotProductInt8Scalar(values + i, weights + i, length - i);
+		}
+
+		KERNEL_TARGET("sse4.2")
+		void multiplyTileSSE42(int depth, const float *a, int aRowStep, int aDepthStep, const float *packedB, float *c, int cStride)
+		{
+			__m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps(), c02 = _mm_setzero_ps(), c03 = _mm_setzero_ps();
+			__m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps(), c12 = _mm_setzero_ps(), c13 = _mm_setzero_ps();
+			__m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps(), c22 = _mm_setzero_ps(), c23 = _mm_setzero_ps();
+			__m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps(), c32 = _mm_setzero_ps(), c33 = _mm_setzero_ps();
+			for (int p = 0; p < depth; ++p, a += aDepthStep, packedB += KERNEL_TILE_COLUMNS)
+			{
+				const __m128 b0 = _mm_loadu_ps(packedB), b1 = _mm_loadu_ps(packedB + 4), b2 = _mm_loadu_ps(packedB + 8), b3 = _mm_loadu_ps(packedB + 12);
+				__m128 aValue = _mm_set1_ps(a[0]);
+				c00 = _mm_add_ps(c00, _mm_mul_ps(aValue, b0));
+				c01 = _mm_add_ps(c01, _mm_mul_ps(aValue, b1));
+				c02 = _mm_add_ps(c02, _mm_mul_ps(aValue, b2));
+				c03 = _mm_add_ps(c03, _mm_mul_ps(aValue, b3));
+				aValue = _mm_set1_ps(a[aRowStep]);
+				c10 = _mm_add_ps(c10, _mm_mul_ps(aValue, b0));
+				c11 = _mm_add_ps(c11, _mm_mul_ps(aValue, b1));
+				c12 = _mm_add_ps(c12, _mm_mul_ps(aValue, b2));
+				c13 = _mm_add_ps(c13, _mm_mul_ps(aValue, b3));
+				aValue = _mm_set1_ps(a[2 * aRowStep]);
+				c20 = _mm_add_ps(c20, _mm_mul_ps(aValue, b0));
+				c21 = _mm_add_ps(c21, _mm_mul_ps(aValue, b1));
+				c22 = _mm_add_ps(c22, _mm_mul_ps(aValue, b2));
+				c23 = _mm_add_ps(c23, _mm_mul_ps(aValue, b3));
+				aValue = _mm_set1_ps(a[3 * aRowStep]);
+				c30 = _mm_add_ps(c30, _mm_mul_ps(aValue, b0));
+				c31 = _mm_add_ps(c31, _mm_mul_ps(aValue, b1));
+				c32 = _mm_add_ps(c32, _mm_mul_ps(aValue, b2));
+				c33 = _mm_add_ps(c33, _mm_mul_ps(aValue, b3));
+			}
+			float *row = c;
+			_mm_storeu_ps(row, _mm_add_ps(_mm_loadu_ps(row), c00));
+			_mm_storeu_ps(row + 4, _mm_add_ps(_mm_loadu_ps(row + 4), c01));
+			_mm_storeu_ps(row + 8, _mm_add_ps(_mm_loadu_ps(row + 8), c02));
+			_mm_storeu_ps(row + 12, _mm_add_ps(_mm_loadu_ps(row + 12), c03));
+			row += cStride;
+			_mm_storeu_ps(row, _mm_add_ps(_mm_loadu_ps(row), c10));
+			_mm_storeu_ps(row + 4, _mm_add_ps(_mm_loadu_ps(row + 4), c11));
+			_mm_storeu_ps(row + 8, _mm_add_ps(_mm_loadu_ps(row + 8), c12));
+			_mm_storeu_ps(row + 12, _mm_add_ps(_mm_loadu_ps(row + 12), c13));
+			row += cStride;
+			_mm_storeu_ps(row, _mm_add_ps(_mm_loadu_ps(row), c20));
+			_mm_storeu_ps(row + 4, _mm_add_ps(_mm_loadu_ps(row + 4), c21));
+			_mm_storeu_ps(row + 8, _mm_add_ps(_mm_loadu_ps(row + 8), c22));
+			_mm_storeu_ps(row + 12, _mm_add_ps(_mm_loadu_ps(row + 12), c23));
+			row += cStride;
+			_mm_storeu_ps(row, _mm_add_ps(_mm_loadu_ps(row), c30));
+			_mm_storeu_ps(row + 4, _mm_add_ps(_mm_loadu_ps(row + 4), c31));
+			_mm_storeu_ps(row + 8, _mm_add_ps(_mm_loadu_ps(row + 8), c32));
+			_mm_storeu_ps(row + 12, _mm_add_ps(_mm_loadu_ps(row + 12), c33));
+		}
+
+		KERNEL_TARGET("sse4.2")
+		__m128 exponentialVectorSSE42(__m128 x)
+		{
+			x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_MIN_INPUT)), _mm_set1_ps(EXP_MAX_INPUT));
+			__m128 n = _mm_floor_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(EXP_LOG2E)), _mm_set1_ps(0.5f)));
+			x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(EXP_LN2_HIGH)));
+			x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(EXP_LN2_LOW)));
+			__m128 y = _mm_set1_ps(EXP_P0);
+			y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+			y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+			y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+			y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+			y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+			y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, x), x), x), _mm_set1_ps(1.0f));
+			__m128i exponent = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+			return _mm_mul_ps(y, _mm_castsi128_ps(exponent));
+		}
+
+		KERNEL_TARGET("sse4.2")
+		void exponentialSSE42(float *values, int length)
+		{
+			int i = 0;
+			for (; i + 4 <= length; i += 4)
+			{
+				_mm_storeu_ps(values + i, exponentialVectorSSE42(_mm_loadu_ps(values + i)));
+			}
+			exponentialScalar(values + i, length - i);
+		}
+
+		KERNEL_TARGET("sse4.2")
+		void fastSigmoidSSE42(float *values, int length)
+		{
+			const __m128 one = _mm_set1_ps(1.0f);
+			int i = 0;
+			for (; i + 4 <= length; i += 4)
+			{
+				__m128 power = _mm_mul_ps(_mm_loadu_ps(values + i), _mm_set1_ps(-FAST_EXP_LOG2E));
+				power = _mm_max_ps(_mm_min_ps(power, _mm_set1_ps(FAST_EXP_MAX_POWER)), _mm_set1_ps(-FAST_EXP_MAX_POWER));
+				__m128 wholePower = _mm_floor_ps(_mm_add_ps(power, _mm_set1_ps(0.5f)));
+				__m128 fraction = _mm_sub_ps(power, wholePower);
+				__m128 polynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(FAST_EXP_P3), fraction), _mm_set1_ps(FAST_EXP_P2));
+				polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(FAST_EXP_P1));
+				polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(FAST_EXP_P0));
+				__m128i exponent = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(wholePower), _mm_set1_epi32(127)), 23);
+				__m128 denominator = _mm_add_ps(one, _mm_mul_ps(polynomial, _mm_castsi128_ps(exponent)));
+				__m128 reciprocal = _mm_rcp_ps(denominator);
+				reciprocal = _mm_mul_ps(reciprocal, _mm_sub_ps(_mm_set1_ps(2.0f), _mm_mul_ps(denominator, reciprocal)));
+				_mm_storeu_ps(values + i, reciprocal);
+			}
+			fastSigmoidScalar(values + i, length - i);
+		}
+
+		KERNEL_TARGET("sse4.2")
+		void sigmoidSSE42(float *values, int length)
+		{
+			const __m128 one = _mm_set1_ps(1.0f);
+			int i = 0;
+			for (; i + 4 <= length; i += 4)
+			{
+				__m128 denominator = _mm_add_ps(one, exponentialVectorSSE42(_mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(values + i))));
+				_mm_storeu_ps(values + i, _mm_div_ps(one, denominator));
+			}
+			sigmoidScalar(values + i, length - i);
+		}
+
+		KERNEL_TARGET("sse4.2")
+		void sigmoidDeltaSSE42(float *delta, const float *error, const float *values, int length)
+		{
+			const __m128 one = _mm_set1_ps(1.0f);
+			int i = 0;
+			for (; i + 4 <= length; i += 4)
+			{
+				__m128 value = _mm_loadu_ps(values + i);
+				_mm_storeu_ps(delta + i, _mm_mul_ps(_mm_loadu_ps(error + i), _mm_mul_ps(value, _mm_sub_ps(one, value))));
+			}
+			sigmoidDeltaScalar(delta + i, error + i, values + i, length - i);
+		}
+
+		const vectorKernels SSE42_KERNELS = { sSE42, addVectorsSSE42, addWeightedRowsSSE42, convertFromHalfScalar, convertToHalfScalar, dotProductSSE42, dotProductInt8SSE42, exponentialSSE42, fastSigmoidSSE42, multiplyTileSSE42, sigmoidSSE42, sigmoidDeltaSSE42 };
+
+		//AVX2 kernels, which also use the FMA and F16C instructions that come with every AVX2 processor:
+		KERNEL_TARGET("avx2,fma")
+		void addVectorsAVX2(float *target, const float *ref, float multiplier, int length)
+		{
+			const __m256 scale = _mm256_set1_ps(multiplier);
+			int i = 0;
+			for (; i + 8 <= length; i += 8)
+			{
+				_mm256_storeu_ps(target + i, _mm256_fmadd_ps(_mm256_loadu_ps(ref + i), scale, _mm256_loadu_ps(target + i)));
+			}
+			addVectorsScalar(target + i, ref + i, multiplier, length - i);
+		}
+
+		KERNEL_TARGET("avx2,fma")
+		void addWeightedRowsAVX2(float *target, const float *const *rows, const float *weights, int rowCount, int length)
+		{
+			int i = 0;
+			for (; i + 32 <= length; i += 32)
+			{
+				__m256 sum0 = _mm256_loadu_ps(target + i), sum1 = _mm256_loadu_ps(target + i + 8), sum2 = _mm256_loadu_ps(target + i + 16), sum3 = _mm256_loadu_ps(target + i + 24);
+				for (int row = 0; row < rowCount; ++row)
+				{
+					const __m256 scale = _mm256_set1_ps(weights[row]);
+					const float *rowStart = rows[row] + i;
+					sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(rowStart), scale, sum0);
+					sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(rowStart + 8), scale, sum1);
+					sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(rowStart + 16), scale, sum2);
+					sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(rowStart + 24), scale, sum3);
+				}
+				_mm256_storeu_ps(target + i, sum0);
+				_mm256_storeu_ps(target + i + 8, sum1);
+				_mm256_storeu_ps(target + i + 16, sum2);
+				_mm256_storeu_ps(target + i + 24, sum3);
+			}
+			for (; i + 8 <= length; i += 8)
+			{
+				__m256 sum = _mm256_loadu_ps(target + i);
+				for (int row = 0; row < rowCount; ++row)
+				{
+					sum = _mm256_fmadd_ps(_mm256_loadu_ps(rows[row] + i), _mm256_set1_ps(weights[row]), sum);
+				}
+				_mm256_storeu_ps(target + i, sum);
+			}
+			addWeightedRowsTail(target, rows, weights, rowCount, i, length);
+		}
+
+		KERNEL_TARGET("avx2,f16c")
+		void convertFromHalfAVX2(const std::uint16_t *values, float *output, int length)
+		{
+			int i = 0;
+			for (; i + 8 <= length; i += 8)
+			{
+				_mm256_storeu_ps(output + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i))));
+			}
+			convertFromHalfScalar(values + i, output + i, length - i);
+		}
+
+		KERNEL_TARGET("avx2,f16c")
+		void convertToHalfAVX2(const float *values, std::uint16_t *output, int length)
+		{
+			int i = 0;
+			for (; i + 8 <= length; i += 8)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT));
+			}
+			convertToHalfScalar(values + i, output + i, length - i);
+		}
+
+		KERNEL_TARGET("avx2,fma")
+		float dotProductAVX2(const float *first, const float *second, int length)
+		{
+			__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+			int i = 0;
+			for (; i + 16 <= length; i += 16)
+			{
+				sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(first + i), _mm256_loadu_ps(second + i), sum0);
+				sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(first + i + 8), _mm256_loadu_ps(second + i + 8), sum1);
+			}
+			sum0 = _mm256_add_ps(sum0, sum1);
+			__m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+			sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+			sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+			return _mm_cvtss_f32(sum) + dotProductScalar(first + i, second + i, length - i);
+		}
+
+		KERNEL_TARGET("avx2")
+		std::int32_t dotProductInt8AVX2(const std::uint8_t *values, const std::int8_t *weights, int length)
+		{
+			__m256i sum = _mm256_setzero_si256();
+			int i = 0;
+			for (; i + 16 <= length; i += 16)
+			{
+				__m256i widenedValues = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)));
+				__m256i widenedWeights = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i)));
+				sum = _mm256_add_epi32(sum, _mm256_madd_epi16(widenedValues, widenedWeights));
+			}
+			return sumInt32(_mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1))) + dotProductInt8Scalar(values + i, weights + i, length - i);
+		}
+
+		//AVX-VNNI multiplies and sums four pairs of bytes into each 32-bit lane in one instruction.
+		KERNEL_TARGET("avx2,avxvnni")
+		std::int32_t dotProductInt8AVXVNNI(const std::uint8_t *values, const std::int8_t *weights, int length)
+		{
+			__m256i sum = _mm256_setzero_si256();
+			int i = 0;
+			for (; i + 32 <= length; i += 32)
+			{
+				sum = _mm256_dpbusd_avx_epi32(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i)));
+			}
+			return sumInt32(_mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1))) + dotProductInt8Scalar(values + i, weights + i, length - i);
+		}
+
+		KERNEL_TARGET("avx2,fma")
+		void multiplyTileAVX2(int depth, const float *a, int aRowStep, int aDepthStep, const float *packedB, float *c, int cStride)
+		{
+			__m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+			__m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+			__m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+			__m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+			for (int p = 0; p < depth; ++p, a += aDepthStep, packedB += KERNEL_TILE_COLUMNS)
+			{
+				const __m256 b0 = _mm256_loadu_ps(packedB), b1 = _mm256_loadu_ps(packedB + 8);
+				__m256 aValue = _mm256_broadcast_ss(a);
+				c00 = _mm256_fmadd_ps(aValue, b0, c00);
+				c01 = _mm256_fmadd_ps(aValue, b1, c01);
+				aValue = _mm256_broadcast_ss(a + aRowStep);
+				c10 = _mm256_fmadd_ps(aValue, b0, c10);
+				c11 = _mm256_fmadd_ps(aValue, b1, c11);
+				aValue = _mm256_broadcast_ss(a + 2 * aRowStep);
+				c20 = _mm256_fmadd_ps(aValue, b0, c20);
+				c21 = _mm256_fmadd_ps(aValue, b1, c21);
+				aValue = _mm256_broadcast_ss(a + 3 * aRowStep);
+				c30 = _mm256_fmadd_ps(aValue, b0, c30);
+				c31 = _mm256_fmadd_ps(aValue, b1, c31);
+			}
+			float *row = c;
+			_mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), c00));
+			_mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), c01));
+			row += cStride;
+			_mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), c10));
+			_mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), c11));
+			row += cStride;
+			_mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), c20));
+			_mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), c21));
+			row += cStride;
+			_mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), c30));
+			_mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), c31));
+		}
+
+		KERNEL_TARGET("avx2,fma")
+		__m256 exponentialVectorAVX2(__m256 x)
+		{
+			x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_MIN_INPUT)), _mm256_set1_ps(EXP_MAX_INPUT));
+			__m256 n = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(EXP_LOG2E), _mm256_set1_ps(0.5f)));
+			x = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXP_LN2_HIGH), x);
+			x = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXP_LN2_LOW), x);
+			__m256 y = _mm256_set1_ps(EXP_P0);
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+			y = _mm256_add_ps(_mm256_fmadd_ps(_mm256_mul_ps(y, x), x, x), _mm256_set1_ps(1.0f));
+			__m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23);
+			return _mm256_mul_ps(y, _mm256_castsi256_ps(exponent));
+		}
+
+		KERNEL_TARGET("avx2,fma")
+		void exponentialAVX2(float *values, int length)
+		{
+			int i = 0;
+			for (; i + 8 <= length; i += 8)
+			{
+				_mm256_storeu_ps(values + i, exponentialVectorAVX2(_mm256_loadu_ps(values + i)));
+			}
+			exponentialScalar(values + i, length - i);
+		}
+
+		KERNEL_TARGET("avx2,fma")
+		void fastSigmoidAVX2(float *values, int length)
+		{
+			const __m256 one = _mm256_set1_ps(1.0f);
+			int i = 0;
+			for (; i + 8 <= length; i += 8)
+			{
+				__m256 power = _mm256_mul_ps(_mm256_loadu_ps(values + i), _mm256_set1_ps(-FAST_EXP_LOG2E));
+				power = _mm256_max_ps(_mm256_min_ps(power, _mm256_set1_ps(FAST_EXP_MAX_POWER)), _mm256_set1_ps(-FAST_EXP_MAX_POWER));
+				__m256 wholePower = _mm256_floor_ps(_mm256_add_ps(power, _mm256_set1_ps(0.5f)));
+				__m256 fraction = _mm256_sub_ps(power, wholePower);
+				__m256 polynomial = _mm256_fmadd_ps(_mm256_set1_ps(FAST_EXP_P3), fraction, _mm256_set1_ps(FAST_EXP_P2));
+				polynomial = _mm256_fmadd_ps(polynomial, fraction, _mm256_set1_ps(FAST_EXP_P1));
+				polynomial = _mm256_fmadd_ps(polynomial, fraction, _mm256_set1_ps(FAST_EXP_P0));
+				__m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(wholePower), _mm256_set1_epi32(127)), 23);
+				__m256 denominator = _mm256_fmadd_ps(polynomial, _mm256_castsi256_ps(exponent), one);
+				__m256 reciprocal = _mm256_rcp_ps(denominator);
+				reciprocal = _mm256_mul_ps(reciprocal, _mm256_fnmadd_ps(denominator, reciprocal, _mm256_set1_ps(2.0f)));
+				_mm256_storeu_ps(values + i, reciprocal);
+			}
+			fastSigmoidScalar(values + i, length - i);
+		}
+
+		KERNEL_TARGET("avx2,fma")
+		void sigmoidAVX2(float *values, int length)
+		{
+			const __m256 one = _mm256_set1_ps(1.0f);
+			int i = 0;
+			for (; i + 8 <= length; i += 8)
+			{
+				__m256 denominator = _mm256_add_ps(one, exponentialVectorAVX2(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(values + i))));
+				_mm256_storeu_ps(values + i, _mm256_div_ps(one, denominator));
+			}
+			sigmoidScalar(values + i, length - i);
+		}
+
+		KERNEL_TARGET("avx2,fma")
+		void sigmoidDeltaAVX2(float *delta, const float *error, const float *values, int length)
+		{
+			const __m256 one = _mm256_set1_ps(1.0f);
+			int i = 0;
+			for (; i + 8 <= length; i += 8)
+			{
+				__m256 value = _mm256_loadu_ps(values + i);
+				_mm256_storeu_ps(delta + i, _mm256_mul_ps(_mm256_loadu_ps(error + i), _mm256_mul_ps(value, _mm256_sub_ps(one, value))));
+			}
+			sigmoidDeltaScalar(delta + i, error + i, values + i, length - i);
+		}
+
+		const vectorKernels AVX2_KERNELS = { aVX2, addVectorsAVX2, addWeightedRowsAVX2, convertFromHalfAVX2, convertToHalfAVX2, dotProductAVX2, dotProductInt8AVX2, exponentialAVX2, fastSigmoidAVX2, multiplyTileAVX2, sigmoidAVX2, sigmoidDeltaAVX2 };
+
+		//AVX-512 kernels, which handle the leftover elements with masked loads and stores:
+		KERNEL_TARGET("avx512f")
+		__mmask16 tailMask(int remaining)
+		{
+			return (__mmask16)((1u << remaining) - 1u);
+		}
+
+		KERNEL_TARGET("avx512f")
+		void addVectorsAVX512(float *target, const float *ref, float multiplier, int length)
+		{
+			const __m512 scale = _mm512_set1_ps(multiplier);
+			int i = 0;
+			for (; i + 16 <= length; i += 16)
+			{
+				_mm512_storeu_ps(target + i, _mm512_fmadd_ps(_mm512_loadu_ps(ref + i), scale, _mm512_loadu_ps(target + i)));
+			}
+			if (i < length)
+			{
+				__mmask16 mask = tailMask(length - i);
+				_mm512_mask_storeu_ps(target + i, mask, _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, ref + i), scale, _mm512_maskz_loadu_ps(mask, target + i)));
+			}
+		}
+
+		KERNEL_TARGET("avx512f")
+		void addWeightedRowsAVX512(float *target, const float *const *rows, const float *weights, int rowCount, int length)
+		{
+			int i = 0;
+			for (; i + 64 <= length; i += 64)
+			{
+				__m512 sum0 = _mm512_loadu_ps(target + i), sum1 = _mm512_loadu_ps(target + i + 16), sum2 = _mm512_loadu_ps(target + i + 32), sum3 = _mm512_loadu_ps(target + i + 48);
+				for (int row = 0; row < rowCount; ++row)
+				{
+					const __m512 scale = _mm512_set1_ps(weights[row]);
+					const float *rowStart = rows[row] + i;
+					sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(rowStart), scale, sum0);
+					sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(rowStart + 16), scale, sum1);
+					sum2 = _mm512_fmadd_ps(_mm512_loadu_ps(rowStart + 32), scale, sum2);
+					sum3 = _mm512_fmadd_ps(_mm512_loadu_ps(rowStart + 48), scale, sum3);
+				}
+				_mm512_storeu_ps(target + i, sum0);
+				_mm512_storeu_ps(target + i + 16, sum1);
+				_mm512_storeu_ps(target + i + 32, sum2);
+				_mm512_storeu_ps(target + i + 48, sum3);
+			}
+			for (; i < length; i += 16)
+			{
+				__mmask16 mask = tailMask(length - i < 16 ? length - i : 16);
+				__m512 sum = _mm512_maskz_loadu_ps(mask, target + i);
+				for (int row = 0; row < rowCount; ++row)
+				{
+					sum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, rows[row] + i), _mm512_set1_ps(weights[row]), sum);
+				}
+				_mm512_mask_storeu_ps(target + i, mask, sum);
+			}
+		}
+
+		//Masked loads of 16-bit values need AVX-512BW, so the leftover values are converted one at a time.
+		KERNEL_TARGET("avx512f")
+		void convertFromHalfAVX512(const std::uint16_t *values, float *output, int length)
+		{
+			int i = 0;
+			for (; i + 16 <= length; i += 16)
+			{
+				_mm512_storeu_ps(output + i, _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i))));
+			}
+			convertFromHalfScalar(values + i, output + i, length - i);
+		}
+
+		KERNEL_TARGET("avx512f")
+		void convertToHalfAVX512(const float *values, std::uint16_t *output, int length)
+		{
+			int i = 0;
+			for (; i + 16 <= length; i += 16)
+			{
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm512_cvtps_ph(_mm512_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT));
+			}
+			convertToHalfScalar(values + i, output + i, length - i);
+		}
+
+		KERNEL_TARGET("avx512f")
+		float dotProductAVX512(const float *first, const float *second, int length)
+		{
+			__m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+			int i = 0;
+			for (; i + 32 <= length; i += 32)
+			{
+				sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(first + i), _mm512_loadu_ps(second + i), sum0);
+				sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(first + i + 16), _mm512_loadu_ps(second + i + 16), sum1);
+			}
+			for (; i < length; i += 16)
+			{
+				__mmask16 mask = tailMask(length - i < 16 ? length - i : 16);
+				sum0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, first + i), _mm512_maskz_loadu_ps(mask, second + i), sum0);
+			}
+			return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+		}
+
+		KERNEL_TARGET("avx512f")
+		void multiplyTileAVX512(int depth, const float *a, int aRowStep, int aDepthStep, const float *packedB, float *c, int cStride)
+		{
+			__m512 c0 = _mm512_setzero_ps(), c1 = _mm512_setzero_ps(), c2 = _mm512_setzero_ps(), c3 = _mm512_setzero_ps();
+			for (int p = 0; p < depth; ++p, a += aDepthStep, packedB += KERNEL_TILE_COLUMNS)
+			{
+				const __m512 b = _mm512_loadu_ps(packedB);
+				c0 = _mm512_fmadd_ps(_mm512_set1_ps(a[0]), b, c0);
+				c1 = _mm512_fmadd_ps(_mm512_set1_ps(a[aRowStep]), b, c1);
+				c2 = _mm512_fmadd_ps(_mm512_set1_ps(a[2 * aRowStep]), b, c2);
+				c3 = _mm512_fmadd_ps(_mm512_set1_ps(a[3 * aRowStep]), b, c3);
+			}
+			_mm512_storeu_ps(c, _mm512_add_ps(_mm512_loadu_ps(c), c0));
+			_mm512_storeu_ps(c + cStride, _mm512_add_ps(_mm512_loadu_ps(c + cStride), c1));
+			_mm512_storeu_ps(c + 2 * cStride, _mm512_add_ps(_mm512_loadu_ps(c + 2 * cStride), c2));
+			_mm512_storeu_ps(c + 3 * cStride, _mm512_add_ps(_mm512_loadu_ps(c + 3 * cStride), c3));
+		}
+
+		KERNEL_TARGET("avx512f")
+		__m512 exponentialVectorAVX512(__m512 x)
+		{
+			x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_MIN_INPUT)), _mm512_set1_ps(EXP_MAX_INPUT));
+			__m512 n = _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(EXP_LOG2E), _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+			x = _mm512_fnmadd_ps(n, _mm512_set1_ps(EXP_LN2_HIGH), x);
+			x = _mm512_fnmadd_ps(n, _mm512_set1_ps(EXP_LN2_LOW), x);
+			__m512 y = _mm512_set1_ps(EXP_P0);
+			y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P1));
+			y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P2));
+			y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P3));
+			y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P4));
+			y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P5));
+			y = _mm512_add_ps(_mm512_fmadd_ps(_mm512_mul_ps(y, x), x, x), _mm512_set1_ps(1.0f));
+			//Multiplies by 2^n without building the exponent bits by hand.
+			return _mm512_scalef_ps(y, n);
+		}
+
+		KERNEL_TARGET("avx512f,avx512bw,avx512vnni")
+		std::int32_t dotProductInt8AVX512VNNI(const std::uint8_t *values, const std::int8_t *weights, int length)
+		{
+			__m512i sum = _mm512_setzero_si512();
+			for (int i = 0; i < length; i += 64)
+			{
+				int remaining = length - i;
+				__mmask64 mask = remaining < 64 ? (__mmask64)((1ull << remaining) - 1ull) : ~(__mmask64)0;
+				sum = _mm512_dpbusd_epi32(sum, _mm512_maskz_loadu_epi8(mask, values + i), _mm512_maskz_loadu_epi8(mask, weights + i));
+			}
+			return _mm512_reduce_add_epi32(sum);
+		}
+
+		KERNEL_TARGET("avx512f")
+		void exponentialAVX512(float *values, int length)
+		{
+			for (int i = 0; i < length; i += 16)
+			{
+				__mmask16 mask = tailMask(length - i < 16 ? length - i : 16);
+				_mm512_mask_storeu_ps(values + i, mask, exponentialVectorAVX512(_mm512_maskz_loadu_ps(mask, values + i)));
+			}
+		}
+
+		KERNEL_TARGET("avx512f")
+		void fastSigmoidAVX512(float *values, int length)
+		{
+			const __m512 one = _mm512_set1_ps(1.0f);
+			for (int i = 0; i < length; i += 16)
+			{
+				__mmask16 mask = tailMask(length - i < 16 ? length - i : 16);
+				__m512 power = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, values + i), _mm512_set1_ps(-FAST_EXP_LOG2E));
+				power = _mm512_max_ps(_mm512_min_ps(power, _mm512_set1_ps(FAST_EXP_MAX_POWER)), _mm512_set1_ps(-FAST_EXP_MAX_POWER));
+				__m512 wholePower = _mm512_roundscale_ps(_mm512_add_ps(power, _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+				__m512 fraction = _mm512_sub_ps(power, wholePower);
+				__m512 polynomial = _mm512_fmadd_ps(_mm512_set1_ps(FAST_EXP_P3), fraction, _mm512_set1_ps(FAST_EXP_P2));
+				polynomial = _mm512_fmadd_ps(polynomial, fraction, _mm512_set1_ps(FAST_EXP_P1));
+				polynomial = _mm512_fmadd_ps(polynomial, fraction, _mm512_set1_ps(FAST_EXP_P0));
+				__m512 denominator = _mm512_add_ps(one, _mm512_scalef_ps(polynomial, wholePower));
+				__m512 reciprocal = _mm512_rcp14_ps(denominator);
+				reciprocal = _mm512_mul_ps(reciprocal, _mm512_fnmadd_ps(denominator, reciprocal, _mm512_set1_ps(2.0f)));
+				_mm512_mask_storeu_ps(values + i, mask, reciprocal);
+			}
+		}
+
+		KERNEL_TARGET("avx512f")
+		void sigmoidAVX512(float *values, int length)
+		{
+			const __m512 one = _mm512_set1_ps(1.0f);
+			for (int i = 0; i < length; i += 16)
+			{
+				__mmask16 mask = tailMask(length - i < 16 ? length - i : 16);
+				__m512 denominator = _mm512_add_ps(one, exponentialVectorAVX512(_mm512_sub_ps(_mm512_setzero_ps(), _mm512_maskz_loadu_ps(mask, values + i))));
+				_mm512_mask_storeu_ps(values + i, mask, _mm512_div_ps(one, denominator));
+			}
+		}
+
+		KERNEL_TARGET("avx512f")
+		void sigmoidDeltaAVX512(float *delta, const float *error, const float *values, int length)
+		{
+			const __m512 one = _mm512_set1_ps(1.0f);
+			for (int i = 0; i < length; i += 16)
+			{
+				__mmask16 mask = tailMask(length - i < 16 ? length - i : 16);
+				__m512 value = _mm512_maskz_loadu_ps(mask, values + i);
+				_mm512_mask_storeu_ps(delta + i, mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, error + i), _mm512_mul_ps(value, _mm512_sub_ps(one, value))));
+			}
+		}
+
+		const vectorKernels AVX512_KERNELS = { aVX512, addVectorsAVX512, addWeightedRowsAVX512, convertFromHalfAVX512, convertToHalfAVX512, dotProductAVX512, dotProductInt8AVX2, exponentialAVX512, fastSigmoidAVX512, multiplyTileAVX512, sigmoidAVX512, sigmoidDeltaAVX512 };
+
+		//Features of the processor that decide which kernels can be used.
+		struct processorFeatures
+		{
+			bool avx2;
+			bool avx512;
+			//AVX-512 VNNI along with AVX-512BW for the masked byte loads.
+			bool avx512Vnni;
+			bool avxVnni;
+			bool sse42;
+		};
+
+		processorFeatures detectFeatures()
+		{
+			processorFeatures output = { false, false, false, false, false };
+#ifdef _MSC_VER
+			int registers[4];
+			__cpuid(registers, 0);
+			int highestLeaf = registers[0];
+			__cpuid(registers, 1);
+			bool fma = (registers[2] & (1 << 12)) != 0 && (registers[2] & (1 << 29)) != 0;
+			output.sse42 = (registers[2] & (1 << 20)) != 0;
+			//The wide registers can only be used if the operating system saves them on a context switch.
+			bool osSavesYmm = false, osSavesZmm = false;
+			if ((registers[2] & (1 << 27)) && (registers[2] & (1 << 28)))
+			{
+				unsigned long long enabledState = _xgetbv(0);
+				osSavesYmm = (enabledState & 0x6) == 0x6;
+				osSavesZmm = (enabledState & 0xE6) == 0xE6;
+			}
+			if (highestLeaf >= 7)
+			{
+				__cpuidex(registers, 7, 0);
+				int highestSubleaf = registers[0];
+				output.avx2 = osSavesYmm && fma && (registers[1] & (1 << 5)) != 0;
+				output.avx512 = osSavesZmm && (registers[1] & (1 << 16)) != 0;
+				output.avx512Vnni = output.avx512 && (registers[1] & (1 << 30)) != 0 && (registers[2] & (1 << 11)) != 0;
+				if (highestSubleaf >= 1)
+				{
+					__cpuidex(registers, 7, 1);
+					output.avxVnni = output.avx2 && (registers[0] & (1 << 4)) != 0;
+				}
+			}
+#else
+			//The GCC and Clang builtins also check the operating system saves the wide registers.
+			__builtin_cpu_init();
+			output.sse42 = __builtin_cpu_supports("sse4.2") != 0;
+			output.avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c");
+			output.avx512 = __builtin_cpu_supports("avx512f") != 0;
+			output.avx512Vnni = output.avx512 && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni");
+			output.avxVnni = output.avx2 && __builtin_cpu_supports("avxvnni");
+#endif
+			return output;
+		}
+
+		const processorFeatures& getFeatures()
+		{
+			static const processorFeatures features = detectFeatures();
+			return features;
+		}
+
+		//Returns a copy of the kernels using the given int8 dot product, which is picked apart from the rest since VNNI is its own feature.
+		vectorKernels withDotProductInt8(const vectorKernels &kernels, std::int32_t(*dotProductInt8)(const std::uint8_t*, const std::int8_t*, int))
+		{
+			vectorKernels output = kernels;
+			output.dotProductInt8 = dotProductInt8;
+			return output;
+		}
+#endif
+	}
+
+	const vectorKernels& getKernels()
+	{
+		//Picked the first time the kernels are requested and reused for the rest of the program.
+		static const vectorKernels &selected = getKernels(getSupportedInstructionSet());
+		return selected;
+	}
+
+	const vectorKernels& getKernels(instructionSet instructions)
+	{
+		if (!instructionSetSupported(instructions))
+		{
+			throw instruction_set_not_supported();
+		}
+		switch (instructions)
+		{
+#if NEURAL_NETWORK_X86_KERNELS
+		case sSE42:
+			return SSE42_KERNELS;
+		case aVX2:
+		{
+			static const vectorKernels kernels = withDotProductInt8(AVX2_KERNELS, getFeatures().avxVnni ? dotProductInt8AVXVNNI : dotProductInt8AVX2);
+			return kernels;
+		}
+		case aVX512:
+		{
+			static const vectorKernels kernels = withDotProductInt8(AVX512_KERNELS, getFeatures().avx512Vnni ? dotProductInt8AVX512VNNI
+				: getFeatures().avxVnni ? dotProductInt8AVXVNNI : dotProductInt8AVX2);
+			return kernels;
+		}
+#endif
+		default:
+			return SCALAR_KERNELS;
+		}
+	}
+
+	instructionSet getSupportedInstructionSet()
+	{
+		if (instructionSetSupported(aVX512))
+		{
+			return aVX512;
+		}
+		if (instructionSetSupported(aVX2))
+		{
+			return aVX2;
+		}
+		if (instructionSetSupported(sSE42))
+		{
+			return sSE42;
+		}
+		return scalar;
+	}
+
+	bool instructionSetSupported(instructionSet instructions)
+	{
+		switch (instructions)
+		{
+		case scalar:
+			return true;
+#if NEURAL_NETWORK_X86_KERNELS
+		case sSE42:
+			return getFeatures().sse42;
+		case aVX2:
+			return getFeatures().avx2;
+		case aVX512:
+			return getFeatures().avx512;
+#endif
+		default:
+			return false;
+		}
+	}
+}
@@ -0,0 +1,73 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Contains the vectorKernels struct, which holds the inner loops used while propagating a batch,
+ *along with the functions that pick the version of those loops written for the widest
+ *instruction set the processor supports. The choice is made once when the kernels are first
+ *requested, so one build uses AVX-512 on the processors that have it and falls back to AVX2,
+ *SSE4.2 or plain scalar loops everywhere else. The AVX2 kernels also need FMA and F16C, which
+ *every AVX2 processor has.*/
+
+#ifndef NEURAL_NETWORK_VECTOR_KERNELS
+#define NEURAL_NETWORK_VECTOR_KERNELS
+
+#include<cstdint>
+
+namespace NeuralNetwork
+{
+	//The instruction sets that have their own version of the kernels, from narrowest to widest.
+	enum instructionSet
+	{
+		scalar = 0, sSE42 = 1, aVX2 = 2, aVX512 = 3
+	};
+
+	//Number of rows and columns of C calculated by each call of the multiplyTile kernel.
+	static const int KERNEL_TILE_ROWS = 4;
+	static const int KERNEL_TILE_COLUMNS = 16;
+
+	//Table of the kernels written for one instruction set.
+	struct vectorKernels
+	{
+		instructionSet instructions;
+		//Adds the reference array multiplied by the multiplier to the target array.
+		void(*addVectors)(float *target, const float *ref, float multiplier, int length);
+		/*Adds each of the rows multiplied by its weight to the target array. A block of the target
+		 *is kept in registers while every row is added to it, so the target is only read and
+		 *written once however many rows there are.*/
+		void(*addWeightedRows)(float *target, const float *const *rows, const float *weights, int rowCount, int length);
+		//Widens each IEEE half precision value to a float.
+		void(*convertFromHalf)(const std::uint16_t *values, float *output, int length);
+		//Rounds each float to the nearest IEEE half precision value with ties going to the even value.
+		void(*convertToHalf)(const float *values, std::uint16_t *output, int length);
+		//Returns the sum of the element-wise product of the two arrays.
+		float(*dotProduct)(const float *first, const float *second, int length);
+		/*Returns the sum of the element-wise product of the unsigned 8-bit values and the signed
+		 *8-bit weights, added up exactly in 32-bit integers. Uses the VNNI instructions when the
+		 *processor has them.*/
+		std::int32_t(*dotProductInt8)(const std::uint8_t *values, const std::int8_t *weights, int length);
+		//Replaces each value with e raised to that value.
+		void(*exponential)(float *values, int length);
+		/*Applies an approximation of the sigmoid function to each value in place, which is within
+		 *FAST_ACTIVATION_MAX_ERROR of the sigmoid function and never overflows.*/
+		void(*fastSigmoid)(float *values, int length);
+		/*Adds a KERNEL_TILE_ROWS x KERNEL_TILE_COLUMNS tile of A * B to C. Element (i, p) of A is
+		 *found at a[i * aRowStep + p * aDepthStep] and B is packed with KERNEL_TILE_COLUMNS
+		 *floats for each step of the depth.*/
+		void(*multiplyTile)(int depth, const float *a, int aRowStep, int aDepthStep, const float *packedB, float *c, int cStride);
+		//Applies the sigmoid function to each value in place.
+		void(*sigmoid)(float *values, int length);
+		/*Sets each delta to the error multiplied by the gradient of the sigmoid function, given
+		 *the output of the sigmoid function.*/
+		void(*sigmoidDelta)(float *delta, const float *error, const float *values, int length);
+	};
+
+	/*Returns the kernels for the widest instruction set the processor supports. The instruction
+	 *set is found the first time this is called and the same kernels are returned afterwards.*/
+	const vectorKernels& getKernels();
+	/*Returns the kernels for the given instruction set. Throws instruction_set_not_supported if
+	 *the processor or the build doesn't support it.*/
+	const vectorKernels& getKernels(instructionSet);
+	//Returns the widest instruction set supported by both the processor and the build.
+	instructionSet getSupportedInstructionSet();
+	bool instructionSetSupported(instructionSet);
+}
+
+#endif
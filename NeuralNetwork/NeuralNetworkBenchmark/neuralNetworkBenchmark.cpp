@@ -0,0 +1,505 @@
+//Copyright(C) 2020 "Daniel Bramblett" <daniel.r.bramblett@gmail.com>
+/*Times the parts of the library that decide how fast a network trains: the vector kernels, the
+ *activation functions, a single neuron propagating forward and backward, copying a network and
+ *whole training steps. Each benchmark sweeps the sizes that change which code path is taken and
+ *writes one JSON object per line, so the results of two releases can be compared with any tool
+ *that reads JSON Lines.
+ *
+ *Usage: neuralNetworkBenchmark [--quick] [--filter name] [--label text] [--output file]
+ *  --quick   Shorter runs over fewer sizes, for checking the benchmark itself.
+ *  --filter  Only runs the groups of benchmarks whose name contains the text: activation,
+ *            addVectors, networkCopy, neuron or trainingStep.
+ *  --label   Added to every result, such as the release or commit being measured.
+ *  --output  Writes the results to the file instead of the standard output.*/
+
+#include "../NeuralNetwork/activationFunctions.h"
+#include "../NeuralNetwork/batchTensor.h"
+#include "../NeuralNetwork/helperFunctions.h"
+#include "../NeuralNetwork/neuralNetwork.h"
+#include "../NeuralNetwork/preprocessorFlags.h"
+#include "../NeuralNetwork/vectorKernels.h"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdint>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<list>
+#include<random>
+#include<sstream>
+#include<string>
+#include<thread>
+#include<utility>
+#include<vector>
+
+using namespace NeuralNetwork;
+
+namespace
+{
+	//Number of stages of neurons in the networks that are copied and trained.
+	const int BENCHMARK_STAGE_COUNT = 3;
+	//Number of times each benchmark is timed, with the median and the fastest reported.
+	const int BENCHMARK_REPETITIONS = 5;
+	const std::uint32_t BENCHMARK_SEED = 20200101;
+
+	//Exposes the neuron class so single neurons can be timed without a network around them.
+	class benchmarkNetwork : public neuralNetwork
+	{
+	public:
+		using neuralNetwork::neuron;
+	};
+
+	struct benchmarkOptions
+	{
+		std::string filter;
+		std::string label;
+		//Time each repetition of a benchmark runs for at least.
+		double minimumSeconds;
+		bool quick;
+	};
+
+	struct measurement
+	{
+		std::uint64_t iterations;
+		double medianNanoseconds;
+		double minimumNanoseconds;
+	};
+
+	//Name and JSON value of each parameter of a benchmark in the order they're written.
+	typedef std::vector<std::pair<std::string, std::string>> parameterList;
+
+	//Writes each result as a line of JSON.
+	class resultWriter
+	{
+	public:
+		resultWriter(std::ostream &newOutput, const benchmarkOptions &newOptions) :options(newOptions), output(newOutput)
+		{
+
+		}
+
+		/*Writes the result of a benchmark along with how many items, such as values or connections,
+		 *each iteration processed per second.*/
+		void write(const std::string &name, const parameterList &parameters, const measurement &result, double itemsPerIteration)
+		{
+			output << "{\"benchmark\":" << quote(name);
+			if (!options.label.empty())
+			{
+				output << ",\"label\":" << quote(options.label);
+			}
+			for (parameterList::const_iterator it = parameters.begin(); it != parameters.end(); ++it)
+			{
+				output << "," << quote(it->first) << ":" << it->second;
+			}
+			output << ",\"iterations\":" << result.iterations << ",\"medianNanoseconds\":" << result.medianNanoseconds
+				<< ",\"minimumNanoseconds\":" << result.minimumNanoseconds << ",\"itemsPerSecond\":" << itemsPerIteration * 1e9 / result.medianNanoseconds << "}" << std::endl;
+		}
+
+		//Writes what the results depend on besides the library itself as the first line.
+		void writeContext()
+		{
+			output << "{\"benchmark\":\"context\"";
+			if (!options.label.empty())
+			{
+				output << ",\"label\":" << quote(options.label);
+			}
+			output << ",\"instructions\":" << quote(instructionSetName(getSupportedInstructionSet())) << ",\"hardwareThreads\":" << std::thread::hardware_concurrency()
+				<< ",\"safeCell\":" << (SAFE_CELL ? "true" : "false") << ",\"traceEvents\":" << (TRACE_EVENTS ? "true" : "false") << ",\"quick\":" << (options.quick ? "true" : "false")
+#if defined(__VERSION__)
+				<< ",\"compiler\":" << quote(__VERSION__)
+#elif defined(_MSC_FULL_VER)
+				<< ",\"compiler\":\"MSVC " << _MSC_FULL_VER << "\""
+#endif
+				<< "}" << std::endl;
+		}
+
+		static std::string instructionSetName(instructionSet instructions)
+		{
+			switch (instructions)
+			{
+			case sSE42:
+				return "sse4.2";
+			case aVX2:
+				return "avx2";
+			case aVX512:
+				return "avx512";
+			default:
+				return "scalar";
+			}
+		}
+
+		static std::string quote(const std::string &text)
+		{
+			std::string quoted = "\"";
+			for (std::string::const_iterator it = text.begin(); it != text.end(); ++it)
+			{
+				if (*it == '"' || *it == '\\')
+				{
+					quoted += '\\';
+				}
+				if ((unsigned char)*it >= 0x20)
+				{
+					quoted += *it;
+				}
+			}
+			return quoted + "\"";
+		}
+
+	private:
+		const benchmarkOptions &options;
+		std::ostream &output;
+	};
+
+	template<typename valueType>
+	std::string toJson(valueType value)
+	{
+		std::ostringstream text;
+		text << value;
+		return text.str();
+	}
+
+	/*Finds how many iterations take at least the minimum time, then times that many iterations
+	 *BENCHMARK_REPETITIONS times.*/
+	template<typename benchmarkFunction>
+	measurement measure(const benchmarkOptions &options, const benchmarkFunction &body)
+	{
+		measurement result;
+		result.iterations = 1;
+		while (true)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (std::uint64_t i = 0; i < result.iterations; ++i)
+			{
+				body();
+			}
+			double elapsed = (double)getElapsed(start);
+			if (elapsed >= options.minimumSeconds * 1e9 || result.iterations >= (1ull << 40))
+			{
+				break;
+			}
+			//Aims a little past the minimum so the next run is usually long enough.
+			double scale = elapsed > 0 ? 1.2 * options.minimumSeconds * 1e9 / elapsed : 100.0;
+			result.iterations = std::max(result.iterations + 1, (std::uint64_t)(result.iterations * std::min(scale, 100.0)));
+		}
+
+		std::vector<double> times;
+		for (int repetition = 0; repetition < BENCHMARK_REPETITIONS; ++repetition)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (std::uint64_t i = 0; i < result.iterations; ++i)
+			{
+				body();
+			}
+			times.push_back((double)getElapsed(start) / result.iterations);
+		}
+		std::sort(times.begin(), times.end());
+		result.medianNanoseconds = times[times.size() / 2];
+		result.minimumNanoseconds = times.front();
+		return result;
+	}
+
+	/*Picks the given number of distinct indexes out of [0, range) in increasing order, so a
+	 *count equal to the range gives every index.*/
+	std::vector<int> pickConnections(int count, int range, std::mt19937 &random)
+	{
+		std::vector<int> indexes(range);
+		for (int i = 0; i < range; ++i)
+		{
+			indexes[i] = i;
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			std::swap(indexes[i], indexes[i + random() % (range - i)]);
+		}
+		indexes.resize(count);
+		std::sort(indexes.begin(), indexes.end());
+		return indexes;
+	}
+
+	/*Builds a network with BENCHMARK_STAGE_COUNT stages of the given width with each neuron
+	 *connected to the given fraction of the previous stage, chosen at random.*/
+	void buildNetwork(neuralNetwork &network, int width, float density, std::mt19937 &random)
+	{
+		int fanIn = std::max(1, (int)std::lround(density * width));
+		std::uniform_real_distribution<float> weights(-1.0f, 1.0f);
+		network = neuralNetwork(width, width);
+		for (int stage = 0; stage < BENCHMARK_STAGE_COUNT; ++stage)
+		{
+			int previousStart = stage == 0 ? 0 : width * stage;
+			for (int i = 0; i < width; ++i)
+			{
+				int cellIndex = network.addNeuron(stage, true);
+				std::vector<int> connections = pickConnections(fanIn, width, random);
+				for (std::vector<int>::const_iterator it = connections.begin(); it != connections.end(); ++it)
+				{
+					network.addConnection(cellIndex, previousStart + *it, weights(random) / std::sqrt((float)fanIn));
+				}
+			}
+		}
+		network.compactStages();
+	}
+
+	void fillRandom(batchTensor &tensor, std::mt19937 &random)
+	{
+		std::uniform_real_distribution<float> values(-1.0f, 1.0f);
+		for (int row = 0; row < tensor.getRowCount(); ++row)
+		{
+			for (int column = 0; column < tensor.getBatchSize(); ++column)
+			{
+				tensor.getRow(row)[column] = values(random);
+			}
+		}
+	}
+
+	std::vector<int> getThreadCounts(const benchmarkOptions &options)
+	{
+		int hardwareThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		std::vector<int> threadCounts;
+		threadCounts.push_back(1);
+		for (int threadCount = 2; threadCount <= hardwareThreads && threadCount <= (options.quick ? 2 : 16); threadCount *= 2)
+		{
+			threadCounts.push_back(threadCount);
+		}
+		return threadCounts;
+	}
+
+	/*Applies each predefined activation function and its gradient to a row. Applying a function
+	 *over and over to the same values would drive some of them towards denormals, so the row is
+	 *copied from the random values before each activation and the copy is part of the time.*/
+	void benchmarkActivations(const benchmarkOptions &options, resultWriter &writer)
+	{
+		const std::pair<activationFunctionType, const char*> types[] = { { sigmoidFunction, "sigmoid" }, { tanhFunction, "tanh" }, { reLUFunction, "reLU" },
+			{ leakyReLUFunction, "leakyReLU" }, { gELUFunction, "gELU" }, { softplusFunction, "softplus" } };
+		std::vector<int> lengths = options.quick ? std::vector<int>{ 1024 } : std::vector<int>{ 64, 1024, 16384 };
+		std::mt19937 random(BENCHMARK_SEED);
+		for (const std::pair<activationFunctionType, const char*> &type : types)
+		{
+			for (int fast = 0; fast < 2; ++fast)
+			{
+				//Only the functions built on sigmoid have a fast approximation.
+				if (fast == 1 && type.first != sigmoidFunction && type.first != tanhFunction && type.first != gELUFunction)
+				{
+					continue;
+				}
+				activationFunctionInfo info = buildActFuncBundle(type.first);
+				info.fastApproximation = fast == 1;
+				for (int length : lengths)
+				{
+					batchTensor values(4, length);
+					fillRandom(values, random);
+					parameterList parameters = { { "function", resultWriter::quote(type.second) }, { "fast", fast == 1 ? "true" : "false" }, { "length", toJson(length) } };
+					writer.write("activation", parameters, measure(options, [&] {
+						std::copy(values.getRow(0), values.getRow(0) + length, values.getRow(1));
+						activateSpan(info, values.getRow(1), length);
+					}), length);
+					writer.write("activationDelta", parameters, measure(options, [&] {activationDeltaSpan(info, values.getRow(2), values.getRow(3), values.getRow(0), length); }), length);
+				}
+			}
+		}
+	}
+
+	//Runs addVectors and addWeightedRows with the kernels of every instruction set the processor supports.
+	void benchmarkAddVectors(const benchmarkOptions &options, resultWriter &writer)
+	{
+		const int rowCount = 8;
+		std::vector<int> lengths = options.quick ? std::vector<int>{ 1024 } : std::vector<int>{ 16, 64, 256, 1024, 4096, 16384 };
+		std::mt19937 random(BENCHMARK_SEED);
+		for (int set = scalar; set <= aVX512; ++set)
+		{
+			if (!instructionSetSupported((instructionSet)set))
+			{
+				continue;
+			}
+			const vectorKernels &kernels = getKernels((instructionSet)set);
+			for (int length : lengths)
+			{
+				batchTensor rows(rowCount + 1, length);
+				fillRandom(rows, random);
+				std::vector<const float*> rowPointers;
+				std::vector<float> multipliers(rowCount, 1e-3f);
+				for (int i = 1; i <= rowCount; ++i)
+				{
+					rowPointers.push_back(rows.getRow(i));
+				}
+				parameterList parameters = { { "instructions", resultWriter::quote(resultWriter::instructionSetName((instructionSet)set)) }, { "length", toJson(length) } };
+				writer.write("addVectors", parameters, measure(options, [&] {kernels.addVectors(rows.getRow(0), rows.getRow(1), 1e-3f, length); }), length);
+				parameters.push_back(std::make_pair("rows", toJson(rowCount)));
+				writer.write("addWeightedRows", parameters, measure(options, [&] {
+					kernels.addWeightedRows(rows.getRow(0), rowPointers.data(), multipliers.data(), rowCount, length);
+				}), (double)length * rowCount);
+			}
+		}
+	}
+
+	/*Copies networks of each width and density. The copy shares the weights, so it's also timed
+	 *along with its first training step, which is when the weights are copied.*/
+	void benchmarkNetworkCopy(const benchmarkOptions &options, resultWriter &writer)
+	{
+		std::vector<int> widths = options.quick ? std::vector<int>{ 64 } : std::vector<int>{ 64, 256, 512 };
+		std::vector<float> densities = options.quick ? std::vector<float>{ 0.5f } : std::vector<float>{ 0.1f, 0.5f, 1.0f };
+		const int batchSize = 8;
+		std::mt19937 random(BENCHMARK_SEED);
+		for (int width : widths)
+		{
+			for (float density : densities)
+			{
+				neuralNetwork network;
+				batchTensor input(width, batchSize), target(width, batchSize);
+				buildNetwork(network, width, density, random);
+				fillRandom(input, random);
+				fillRandom(target, random);
+				network.forwardPropagate(input);
+				network.backwardPropagate(target);
+				double connections = network.getConnectionCount();
+				parameterList parameters = { { "width", toJson(width) }, { "density", toJson(density) }, { "connections", toJson(network.getConnectionCount()) } };
+				writer.write("networkCopy", parameters, measure(options, [&] {neuralNetwork copy(network); }), connections);
+				parameters.push_back(std::make_pair("batch", toJson(batchSize)));
+				writer.write("networkCopyTrain", parameters, measure(options, [&] {
+					neuralNetwork copy(network);
+					copy.forwardPropagate(input);
+					copy.backwardPropagate(target);
+				}), connections);
+			}
+		}
+	}
+
+	/*Propagates a single neuron connected to the given number of cells spread evenly at random
+	 *across a range of cells sized so the connections cover the given fraction of it.*/
+	void benchmarkNeuron(const benchmarkOptions &options, resultWriter &writer)
+	{
+		std::vector<int> fanIns = options.quick ? std::vector<int>{ 64 } : std::vector<int>{ 16, 64, 256, 1024 };
+		std::vector<float> densities = options.quick ? std::vector<float>{ 1.0f } : std::vector<float>{ 0.1f, 1.0f };
+		std::vector<int> batchSizes = options.quick ? std::vector<int>{ 32 } : std::vector<int>{ 1, 8, 32, 128 };
+		std::mt19937 random(BENCHMARK_SEED);
+		std::uniform_real_distribution<float> weights(-1.0f, 1.0f);
+		for (int fanIn : fanIns)
+		{
+			for (float density : densities)
+			{
+				int range = (int)std::lround(fanIn / density);
+				benchmarkNetwork::neuron cell(true, range);
+				std::vector<int> connections = pickConnections(fanIn, range, random);
+				for (std::vector<int>::const_iterator it = connections.begin(); it != connections.end(); ++it)
+				{
+					cell.addConnection(*it, weights(random) / std::sqrt((float)fanIn));
+				}
+				//The learning rate is kept small so the weights barely move however many times the neuron is trained.
+				cell.setLearningRate(1e-6f);
+				for (int batchSize : batchSizes)
+				{
+					batchTensor values(range + 1, batchSize), errors(range + 1, batchSize), cellErrors(1, batchSize);
+					fillRandom(values, random);
+					fillRandom(cellErrors, random);
+					cell.forwardPropagate(values, batchSize);
+					parameterList parameters = { { "fanIn", toJson(fanIn) }, { "density", toJson(density) }, { "batch", toJson(batchSize) } };
+					writer.write("neuronForward", parameters, measure(options, [&] {cell.forwardPropagate(values, batchSize); }), (double)fanIn * batchSize);
+					//The error of the neuron is set to zero by each backward propagation, so it's put back first.
+					writer.write("neuronBackward", parameters, measure(options, [&] {
+						std::copy(cellErrors.getRow(0), cellErrors.getRow(0) + batchSize, errors.getRow(range));
+						cell.backwardPropagate(values, batchSize, errors);
+					}), (double)fanIn * batchSize);
+				}
+			}
+		}
+	}
+
+	/*Runs a forward and backward propagation of networks of each width and density for each
+	 *batch size and thread count in both execution modes.*/
+	void benchmarkTrainingStep(const benchmarkOptions &options, resultWriter &writer)
+	{
+		std::vector<int> widths = options.quick ? std::vector<int>{ 64 } : std::vector<int>{ 64, 256, 512 };
+		std::vector<float> densities = options.quick ? std::vector<float>{ 0.1f, 1.0f } : std::vector<float>{ 0.1f, 0.5f, 1.0f };
+		std::vector<int> batchSizes = options.quick ? std::vector<int>{ 16 } : std::vector<int>{ 1, 16, 64 };
+		std::vector<int> threadCounts = getThreadCounts(options);
+		std::mt19937 random(BENCHMARK_SEED);
+		for (int width : widths)
+		{
+			for (float density : densities)
+			{
+				neuralNetwork network;
+				buildNetwork(network, width, density, random);
+				double connections = network.getConnectionCount();
+				for (int batchSize : batchSizes)
+				{
+					batchTensor input(width, batchSize), target(width, batchSize);
+					fillRandom(input, random);
+					fillRandom(target, random);
+					for (int threadCount : threadCounts)
+					{
+						network.setThreadCount(threadCount);
+						for (int mode = stageExecution; mode <= dataflowExecution; ++mode)
+						{
+							network.setExecutionMode((executionMode)mode);
+							parameterList parameters = { { "width", toJson(width) }, { "density", toJson(density) }, { "connections", toJson(network.getConnectionCount()) },
+								{ "batch", toJson(batchSize) }, { "threads", toJson(threadCount) }, { "execution", mode == stageExecution ? "\"stage\"" : "\"dataflow\"" } };
+							writer.write("forward", parameters, measure(options, [&] {network.forwardPropagate(input); }), connections * batchSize);
+							writer.write("trainingStep", parameters, measure(options, [&] {
+								network.forwardPropagate(input);
+								network.backwardPropagate(target);
+							}), connections * batchSize);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	benchmarkOptions options;
+	options.minimumSeconds = 0.05;
+	options.quick = false;
+	std::string outputPath;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--quick") == 0)
+		{
+			options.quick = true;
+			options.minimumSeconds = 0.002;
+		}
+		else if (i + 1 < argc && std::strcmp(argv[i], "--filter") == 0)
+		{
+			options.filter = argv[++i];
+		}
+		else if (i + 1 < argc && std::strcmp(argv[i], "--label") == 0)
+		{
+			options.label = argv[++i];
+		}
+		else if (i + 1 < argc && std::strcmp(argv[i], "--output") == 0)
+		{
+			outputPath = argv[++i];
+		}
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--quick] [--filter name] [--label text] [--output file]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::ofstream file;
+	if (!outputPath.empty())
+	{
+		file.open(outputPath.c_str());
+		if (!file)
+		{
+			std::cerr << "Couldn't open " << outputPath << " for writing." << std::endl;
+			return 1;
+		}
+	}
+	resultWriter writer(outputPath.empty() ? std::cout : file, options);
+	writer.writeContext();
+
+	const std::pair<const char*, void(*)(const benchmarkOptions&, resultWriter&)> benchmarks[] = {
+		{ "activation", benchmarkActivations }, { "addVectors", benchmarkAddVectors }, { "networkCopy", benchmarkNetworkCopy },
+		{ "neuron", benchmarkNeuron }, { "trainingStep", benchmarkTrainingStep }
+	};
+	for (const std::pair<const char*, void(*)(const benchmarkOptions&, resultWriter&)> &benchmark : benchmarks)
+	{
+		if (options.filter.empty() || std::string(benchmark.first).find(options.filter) != std::string::npos)
+		{
+			benchmark.second(options, writer);
+		}
+	}
+	return 0;
+}
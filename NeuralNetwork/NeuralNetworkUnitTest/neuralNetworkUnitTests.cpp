@@ -5,9 +5,41 @@
 #include "testHelperFunctions.h"
 #include "../NeuralNetwork/neuralNetwork.cpp"
 #include "../NeuralNetwork/activationFunctions.cpp"
+#include "../NeuralNetwork/batchTensor.cpp"
+#include "../NeuralNetwork/dataParallelTrainer.cpp"
+#include "../NeuralNetwork/dataset.cpp"
+#include "../NeuralNetwork/distributedTrainer.cpp"
+#include "../NeuralNetwork/gradualPruner.cpp"
 #include "../NeuralNetwork/helperFunctions.cpp"
+#include "../NeuralNetwork/hogwildTrainer.cpp"
+#include "../NeuralNetwork/inferencePlan.cpp"
+#include "../NeuralNetwork/mappedFile.cpp"
+#include "../NeuralNetwork/matrixFunctions.cpp"
+#include "../NeuralNetwork/memoryArena.cpp"
+#include "../NeuralNetwork/modelFile.cpp"
+#include "../NeuralNetwork/modelHandle.h"
+#include "../NeuralNetwork/philoxRandom.cpp"
+#include "../NeuralNetwork/quantizedPlan.cpp"
+#include "../NeuralNetwork/reducedPrecision.cpp"
+#include "../NeuralNetwork/ringCommunicator.cpp"
+#include "../NeuralNetwork/threadPool.cpp"
+#include "../NeuralNetwork/trace.cpp"
+#include "../NeuralNetwork/trainingDriver.cpp"
+#include "../NeuralNetwork/vectorKernels.cpp"
 
+#include<algorithm>
+#include<atomic>
+#include<cmath>
+#include<cstdint>
+#include<cstdio>
+#include<cstring>
+#include<fstream>
+#include<iterator>
 #include<list>
+#include<memory>
+#include<thread>
+#include<type_traits>
+#include<utility>
 #include<vector>
 #include<string>
 
@@ -348,59 +380,43 @@ namespace NeuralNetworkUnitTest
 			neuronTest.addConnection(0, 0.4f);
 			neuronTest.addConnection(3, 0.7f);
 			neuronTest.setBias(0.6f);
-			std::list<std::vector<float>> testValues;
-			std::list<std::vector<float>> testError;
+			batchTensor testValues(6, 2);
+			batchTensor testError(6, 2);
 			std::list<float> testList;
-			std::mutex testMutex;
-			std::vector<float> neuronError(2);
-			neuronError[0] = -0.4f;
-			neuronError[1] = 0.5f;
+			testError.getRow(2)[0] = -0.4f;
+			testError.getRow(2)[1] = 0.5f;
 			for (int i = 0; i < 6; ++i)
 			{
-				std::vector<float> temp(2);
-				temp[0] = 0.1f * (1.0f + i);
-				temp[1] = 0.15f * (1.0f + i);
-				testValues.push_back(temp);
-				if (i == 2)
-				{
-					testError.push_back(neuronError);
-				}
-				else
-				{
-					testError.push_back(std::vector<float>(2, 0.0f));
-				}
+				testValues.getRow(i)[0] = 0.1f * (1.0f + i);
+				testValues.getRow(i)[1] = 0.15f * (1.0f + i);
 			}
 
-			neuronTest.backwardPropagate(testValues, 2, testError, testMutex);
+			neuronTest.backwardPropagate(testValues, 2, testError);
 
 			//Checks to make sure the values are not changed.
-			std::list<std::vector<float>>::iterator valueIt = testValues.begin();
-			for (int i = 0; i < 6; ++i, ++valueIt)
+			for (int i = 0; i < 6; ++i)
 			{
-				Assert::AreEqual((*valueIt)[0], 0.1f * (1.0f + i));
-				Assert::AreEqual((*valueIt)[1], 0.15f * (1.0f + i));
+				Assert::AreEqual(testValues.getRow(i)[0], 0.1f * (1.0f + i));
+				Assert::AreEqual(testValues.getRow(i)[1], 0.15f * (1.0f + i));
 			}
 
 			//Checks to make sure the error was probably backpropagated.
-			std::list<std::vector<float>>::iterator errorIt = testError.begin();
-			for (int i = 0; i < 6; ++i, ++errorIt)
+			for (int i = 0; i < 6; ++i)
 			{
 				if (i == 0)
 				{
-					Assert::IsTrue(floatInBounds((*errorIt)[0], -0.0336f, FLOAT_TEST_RANGE));
-					Assert::IsTrue(floatInBounds((*errorIt)[1], 0.0495f, FLOAT_TEST_RANGE));
+					Assert::IsTrue(floatInBounds(testError.getRow(i)[0], -0.0336f, FLOAT_TEST_RANGE));
+					Assert::IsTrue(floatInBounds(testError.getRow(i)[1], 0.0495f, FLOAT_TEST_RANGE));
 				}
 				else if (i == 3)
 				{
-					Assert::IsTrue(floatInBounds((*errorIt)[0], -0.0588f, FLOAT_TEST_RANGE));
-					Assert::IsTrue(floatInBounds((*errorIt)[1], 0.086625f, FLOAT_TEST_RANGE));
+					Assert::IsTrue(floatInBounds(testError.getRow(i)[0], -0.0588f, FLOAT_TEST_RANGE));
+					Assert::IsTrue(floatInBounds(testError.getRow(i)[1], 0.086625f, FLOAT_TEST_RANGE));
 				}
 				else
 				{
-					for (std::vector<float>::iterator currentErrorIt = errorIt->begin(); currentErrorIt != errorIt->end(); ++currentErrorIt)
-					{
-						Assert::AreEqual(*currentErrorIt, 0.0f);
-					}
+					Assert::AreEqual(testError.getRow(i)[0], 0.0f);
+					Assert::AreEqual(testError.getRow(i)[1], 0.0f);
 				}
 			}
 			//Checks the weights are correct.
@@ -426,44 +442,27 @@ namespace NeuralNetworkUnitTest
 			neuronTest.addConnection(0, 0.4f);
 			neuronTest.addConnection(3, 0.7f);
 			neuronTest.setBias(0.6f);
-			std::list<std::vector<float>> testValues;
-			std::list<std::vector<float>> testError;
+			batchTensor testValues(6, 1);
+			batchTensor testError(6, 1);
 			std::list<float> testList;
-			std::mutex testMutex;
-			std::vector<float> neuronError(1);
-			neuronError[0] = -0.4f;
+			testError.getRow(2)[0] = -0.4f;
 			for (int i = 0; i < 6; ++i)
 			{
-				std::vector<float> temp(1);
-				temp[0] = 0.1f * (1.0f + i);
-				testValues.push_back(temp);
-				if (i == 2)
-				{
-					testError.push_back(neuronError);
-				}
-				else
-				{
-					testError.push_back(std::vector<float>(1, 0.0f));
-				}
+				testValues.getRow(i)[0] = 0.1f * (1.0f + i);
 			}
 
-			neuronTest.backwardPropagate(testValues, 1, testError, testMutex);
+			neuronTest.backwardPropagate(testValues, 1, testError);
 
 			//Checks to make sure the values are not changed.
-			std::list<std::vector<float>>::iterator valueIt = testValues.begin();
-			for (int i = 0; i < 6; ++i, ++valueIt)
+			for (int i = 0; i < 6; ++i)
 			{
-				Assert::AreEqual((*valueIt)[0], 0.1f * (1.0f + i));
+				Assert::AreEqual(testValues.getRow(i)[0], 0.1f * (1.0f + i));
 			}
 
 			//Checks to make sure the error wasn't propagated.
-			std::list<std::vector<float>>::iterator errorIt = testError.begin();
-			for (int i = 0; i < 6; ++i, ++errorIt)
+			for (int i = 0; i < 6; ++i)
 			{
-				for (std::vector<float>::iterator currentErrorIt = errorIt->begin(); currentErrorIt != errorIt->end(); ++currentErrorIt)
-				{
-					Assert::AreEqual(*currentErrorIt, 0.0f);
-				}
+				Assert::AreEqual(testError.getRow(i)[0], 0.0f);
 			}
 
 			//Checks the weights are correct.
@@ -487,28 +486,25 @@ namespace NeuralNetworkUnitTest
 			neuronTest.addConnection(0, 0.4f);
 			neuronTest.addConnection(3, 0.7f);
 			neuronTest.setBias(0.3f);
-			std::list<std::vector<float>> testValues;
+			batchTensor testValues(6, 2);
 			for (int i = 0; i < 6; ++i)
 			{
-				std::vector<float> temp;
-				temp.push_back(0.1f * (-2.0f + i));
-				temp.push_back(0.15f * (-2.0f + i));
-				testValues.push_back(temp);
+				testValues.getRow(i)[0] = 0.1f * (-2.0f + i);
+				testValues.getRow(i)[1] = 0.15f * (-2.0f + i);
 			}
 			neuronTest.forwardPropagate(testValues, 2);
 
-			std::list<std::vector<float>>::iterator valueIt = testValues.begin();
-			for (int i = 0; i < 6; ++i, ++valueIt)
+			for (int i = 0; i < 6; ++i)
 			{
 				if (i != 2)
 				{
-					Assert::AreEqual((*valueIt)[0], 0.1f * (-2.0f + i));
-					Assert::AreEqual((*valueIt)[1], 0.15f * (-2.0f + i));
+					Assert::AreEqual(testValues.getRow(i)[0], 0.1f * (-2.0f + i));
+					Assert::AreEqual(testValues.getRow(i)[1], 0.15f * (-2.0f + i));
 				}
 				else
 				{
-					Assert::IsTrue(floatInBounds((*valueIt)[0], sigmoid(0.29f), FLOAT_TEST_RANGE));
-					Assert::IsTrue(floatInBounds((*valueIt)[1], sigmoid(0.285f), FLOAT_TEST_RANGE));
+					Assert::IsTrue(floatInBounds(testValues.getRow(i)[0], sigmoid(0.29f), FLOAT_TEST_RANGE));
+					Assert::IsTrue(floatInBounds(testValues.getRow(i)[1], sigmoid(0.285f), FLOAT_TEST_RANGE));
 				}
 			}
 		}
@@ -575,4 +571,2647 @@ namespace NeuralNetworkUnitTest
 			Assert::AreEqual(*temp.begin(), 1.23f);
 		}
 	};
-}
\ No newline at end of file
+
+	TEST_CLASS(activationFunctionsUnitTests)
+	{
+	public:
+
+		/*Tests that the span functions match the scalar functions of every predefined bundle and
+		 *that the gradients match the slope of the functions.*/
+		TEST_METHOD(spanFunctions)
+		{
+			activationFunctionType types[] = { sigmoidFunction, tanhFunction, reLUFunction, leakyReLUFunction, gELUFunction, softplusFunction };
+			const int length = 70;
+			std::vector<float> inputs(length), outputs(length), errors(length), deltas(length);
+			for (int i = 0; i < length; ++i)
+			{
+				inputs[i] = -12.0f + 0.37f * i;
+				errors[i] = 0.5f - 0.01f * i;
+			}
+			for (int typeIndex = 0; typeIndex < 6; ++typeIndex)
+			{
+				activationFunctionInfo info = buildActFuncBundle(types[typeIndex]);
+				Assert::IsTrue(info.type == types[typeIndex]);
+				outputs = inputs;
+				activateSpan(info, outputs.data(), length);
+				const std::vector<float> &gradientInputs = info.gradientInTermsOfFunc ? outputs : inputs;
+				activationDeltaSpan(info, deltas.data(), errors.data(), gradientInputs.data(), length);
+				for (int i = 0; i < length; ++i)
+				{
+					Assert::IsTrue(floatInBounds(outputs[i], info.activationFunction(inputs[i]), FLOAT_TEST_RANGE));
+					float gradient = info.activationFunctionGradient(gradientInputs[i]);
+					Assert::IsTrue(floatInBounds(deltas[i], errors[i] * gradient, FLOAT_TEST_RANGE));
+					float slope = (info.activationFunction(inputs[i] + 0.001f) - info.activationFunction(inputs[i] - 0.001f)) / 0.002f;
+					Assert::IsTrue(floatInBounds(gradient, slope, 0.01f));
+				}
+			}
+
+			//Custom bundles are called through the function objects.
+			activationFunctionInfo custom = { [](const float input) {return input * 3.0f; }, [](const float input) {return 3.0f; }, false };
+			Assert::IsTrue(custom.type == customFunction);
+			outputs = inputs;
+			activateSpan(custom, outputs.data(), length);
+			activationDeltaSpan(custom, deltas.data(), errors.data(), inputs.data(), length);
+			for (int i = 0; i < length; ++i)
+			{
+				Assert::AreEqual(outputs[i], inputs[i] * 3.0f);
+				Assert::AreEqual(deltas[i], errors[i] * 3.0f);
+			}
+		}
+
+		/*Tests that the fast approximation of sigmoid and tanh stays within the documented error of
+		 *the exact functions, including inputs that would overflow e^x, and that networks can turn
+		 *it on for each neuron.*/
+		TEST_METHOD(fastApproximation)
+		{
+			const int length = 16003;
+			std::vector<float> inputs(length), outputs;
+			for (int i = 0; i < length - 3; ++i)
+			{
+				inputs[i] = -40.0f + 0.005f * i;
+			}
+			inputs[length - 3] = -1e30f;
+			inputs[length - 2] = 1e30f;
+			inputs[length - 1] = 88.8f;
+			activationFunctionType types[] = { sigmoidFunction, tanhFunction };
+			for (int typeIndex = 0; typeIndex < 2; ++typeIndex)
+			{
+				activationFunctionInfo info = buildActFuncBundle(types[typeIndex]);
+				info.fastApproximation = true;
+				outputs = inputs;
+				activateSpan(info, outputs.data(), length);
+				for (int i = 0; i < length; ++i)
+				{
+					Assert::IsTrue(floatInBounds(outputs[i], info.activationFunction(inputs[i]), FAST_ACTIVATION_MAX_ERROR));
+				}
+			}
+
+			neuralNetwork exact(1, 1);
+			exact.addNeuron(0, true);
+			exact.addConnection(1, 0, 0.7f);
+			neuralNetwork fast(exact);
+			fast.setFastActivations(true);
+			Assert::IsTrue(fast.getFastActivation(1));
+			Assert::IsFalse(exact.getFastActivation(1));
+			batchTensor input(1, 5), exactOutput, fastOutput;
+			for (int b = 0; b < 5; ++b)
+			{
+				input.getRow(0)[b] = 2.0f * b - 4.0f;
+			}
+			exact.forwardPropagate(input);
+			fast.forwardPropagate(input);
+			exact.getOutput(exactOutput);
+			fast.getOutput(fastOutput);
+			for (int b = 0; b < 5; ++b)
+			{
+				Assert::IsTrue(floatInBounds(fastOutput.getRow(0)[b], exactOutput.getRow(0)[b], FAST_ACTIVATION_MAX_ERROR));
+			}
+			fast.setFastActivation(1, false);
+			Assert::IsFalse(fast.getFastActivation(1));
+		}
+
+		//Tests that softmax doesn't overflow and that its delta matches the full Jacobian.
+		TEST_METHOD(softmax)
+		{
+			float values[] = { 1000.0f, 1001.0f, 1002.0f, -5.0f };
+			float errors[] = { 0.3f, -0.2f, 0.5f, 0.1f };
+			float deltas[4];
+			softmaxSpan(values, 4);
+			float sum = 0.0f;
+			for (int i = 0; i < 4; ++i)
+			{
+				sum += values[i];
+			}
+			Assert::IsTrue(floatInBounds(sum, 1.0f, FLOAT_TEST_RANGE));
+			Assert::IsTrue(floatInBounds(values[2], 1.0f / (1.0f + expf(-1.0f) + expf(-2.0f)), FLOAT_TEST_RANGE));
+			Assert::IsTrue(values[3] >= 0.0f && values[3] < FLOAT_TEST_RANGE);
+
+			softmaxDeltaSpan(deltas, errors, values, 4);
+			for (int i = 0; i < 4; ++i)
+			{
+				float expected = 0.0f;
+				for (int j = 0; j < 4; ++j)
+				{
+					expected += ((i == j ? values[i] : 0.0f) - values[i] * values[j]) * errors[j];
+				}
+				Assert::IsTrue(floatInBounds(deltas[i], expected, FLOAT_TEST_RANGE));
+			}
+		}
+
+		//Tests building the bundles from their names.
+		TEST_METHOD(buildActFuncBundles)
+		{
+			std::string names[] = { "sigmoid", "tanh", "relu", "leakyRelu", "gelu", "softplus", "softmax" };
+			activationFunctionType types[] = { sigmoidFunction, tanhFunction, reLUFunction, leakyReLUFunction, gELUFunction, softplusFunction, softmaxFunction };
+			for (int i = 0; i < 7; ++i)
+			{
+				Assert::IsTrue(buildActFuncBundle(names[i]).type == types[i]);
+			}
+			Assert::IsFalse(buildActFuncBundle("gelu").gradientInTermsOfFunc);
+			Assert::ExpectException<activation_function_not_found>([] {buildActFuncBundle("unknown"); });
+			Assert::ExpectException<activation_function_not_found>([] {buildActFuncBundle(customFunction); });
+		}
+	};
+
+	TEST_CLASS(batchTensorUnitTests)
+	{
+	public:
+
+		//Tests that every row starts on an aligned boundary and can be accessed by index.
+		TEST_METHOD(rowAlignment)
+		{
+			batchTensor x(5, 3);
+			Assert::AreEqual(x.getRowCount(), 5);
+			Assert::AreEqual(x.getBatchSize(), 3);
+			Assert::IsTrue(x.getRowStride() >= 3);
+			for (int i = 0; i < 5; ++i)
+			{
+				Assert::AreEqual((int)(reinterpret_cast<std::uintptr_t>(x.getRow(i)) % TENSOR_ALIGNMENT), 0);
+				for (int j = 0; j < 3; ++j)
+				{
+					Assert::AreEqual(x.getRow(i)[j], 0.0f);
+					x.getRow(i)[j] = (float)(i * 3 + j);
+				}
+			}
+			batchTensor y(x);
+			for (int i = 0; i < 5; ++i)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					Assert::AreEqual(y.getRow(i)[j], (float)(i * 3 + j));
+				}
+			}
+
+			//Moving hands over the rows without copying them and leaves the moved tensor empty.
+			float *firstRow = y.getRow(0);
+			batchTensor z(std::move(y));
+			Assert::IsTrue(z.getRow(0) == firstRow);
+			Assert::AreEqual(y.getRowCount(), 0);
+			y = std::move(z);
+			Assert::IsTrue(y.getRow(0) == firstRow);
+			Assert::AreEqual(y.getRow(4)[2], 14.0f);
+		}
+
+		//Tests that resizing reuses the allocation when the new shape fits and zeroes the values.
+		TEST_METHOD(resize)
+		{
+			batchTensor x(4, 20);
+			float *firstRow = x.getRow(0);
+			x.fill(2.0f);
+			x.resize(2, 7);
+			Assert::IsTrue(x.getRow(0) == firstRow);
+			Assert::AreEqual(x.getRowCount(), 2);
+			Assert::AreEqual(x.getBatchSize(), 7);
+			Assert::AreEqual(x.getRow(1)[6], 0.0f);
+#if SAFE_CELL
+			Assert::ExpectException<std::out_of_range>([&] {x.getRow(2); });
+#endif
+		}
+	};
+
+	TEST_CLASS(dataParallelTrainerUnitTests)
+	{
+	public:
+
+		/*Tests that training replicas on shards of each batch ends with the same weights as one
+		 *network trained on the whole batches, including batches smaller than the replica count.*/
+		TEST_METHOD(matchesSingleNetwork)
+		{
+			neuralNetwork single(3, 2);
+			batchTensor input(3, 10), target(2, 10), smallInput(3, 2), smallTarget(2, 2);
+			for (int i = 0; i < 5; ++i)
+			{
+				single.addNeuron(0, true);
+				for (int j = 0; j < 3; ++j)
+				{
+					single.addConnection(3 + i, j, 0.1f * (i - j));
+				}
+			}
+			for (int i = 0; i < 2; ++i)
+			{
+				single.addNeuron(1, true);
+				for (int j = i; j < 5; ++j)
+				{
+					single.addConnection(8 + i, 3 + j, 0.2f * (j - 2) + 0.1f * i);
+				}
+			}
+			for (int b = 0; b < 10; ++b)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					input.getRow(j)[b] = (float)((b * 7 + j * 3) % 10) / 10.0f - 0.4f;
+				}
+				target.getRow(0)[b] = b % 3 == 0 ? 0.9f : 0.1f;
+				target.getRow(1)[b] = b % 2 == 0 ? 0.2f : 0.7f;
+			}
+			for (int b = 0; b < 2; ++b)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					smallInput.getRow(j)[b] = input.getRow(j)[b + 3];
+				}
+				for (int j = 0; j < 2; ++j)
+				{
+					smallTarget.getRow(j)[b] = target.getRow(j)[b + 5];
+				}
+			}
+
+			dataParallelTrainer trainer(single, 3);
+			Assert::AreEqual(trainer.getReplicaCount(), 3);
+			Assert::ExpectException<std::out_of_range>([&] {dataParallelTrainer empty(single, 0); });
+			for (int step = 0; step < 3; ++step)
+			{
+				single.forwardPropagate(input);
+				single.backwardPropagate(target);
+				trainer.trainBatch(input, target);
+			}
+			single.forwardPropagate(smallInput);
+			single.backwardPropagate(smallTarget);
+			trainer.trainBatch(smallInput, smallTarget);
+
+			std::list<float> singleWeights, trainerWeights;
+			for (int cellIndex = 3; cellIndex < single.getCellCount(); ++cellIndex)
+			{
+				Assert::IsTrue(floatInBounds(trainer.getNetwork().getBias(cellIndex), single.getBias(cellIndex), FLOAT_TEST_RANGE));
+				single.getWeights(cellIndex, singleWeights);
+				trainer.getNetwork().getWeights(cellIndex, trainerWeights);
+				std::list<float>::iterator trainerIt = trainerWeights.begin();
+				for (std::list<float>::iterator singleIt = singleWeights.begin(); singleIt != singleWeights.end(); ++singleIt, ++trainerIt)
+				{
+					Assert::IsTrue(floatInBounds(*trainerIt, *singleIt, FLOAT_TEST_RANGE));
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(datasetUnitTests)
+	{
+	public:
+
+		//Tests that samples written to a dataset file are read back in place.
+		TEST_METHOD(writeAndRead)
+		{
+			{
+				datasetWriter writer("datasetUnitTest.bin", 3, 2);
+				for (int sampleIndex = 0; sampleIndex < 10; ++sampleIndex)
+				{
+					float inputs[3] = { (float)sampleIndex, sampleIndex + 0.25f, sampleIndex + 0.5f };
+					float targets[2] = { -(float)sampleIndex, sampleIndex * 2.0f };
+					writer.addSample(inputs, targets);
+				}
+				Assert::AreEqual((int)writer.getSampleCount(), 10);
+			}
+			datasetReader reader("datasetUnitTest.bin");
+			Assert::AreEqual(reader.getInputCount(), 3);
+			Assert::AreEqual(reader.getTargetCount(), 2);
+			Assert::AreEqual((int)reader.getSampleCount(), 10);
+			Assert::AreEqual(reader.getSample(7)[1], 7.25f);
+			Assert::AreEqual(reader.getSample(7)[4], 14.0f);
+			Assert::ExpectException<std::out_of_range>([&] {reader.getSample(10); });
+
+			std::ofstream broken("datasetUnitTestBroken.bin", std::ios::binary);
+			broken.write("NNDATA", 6);
+			broken.close();
+			Assert::ExpectException<dataset_file_not_valid>([&] {datasetReader brokenReader("datasetUnitTestBroken.bin"); });
+			std::remove("datasetUnitTestBroken.bin");
+			std::remove("datasetUnitTest.bin");
+		}
+
+		/*Tests that each epoch hands out every sample once in a shuffled order that only depends
+		 *on the seed, with the smaller last batch holding the samples left over.*/
+		TEST_METHOD(shuffledBatches)
+		{
+			{
+				datasetWriter writer("datasetUnitTest.bin", 2, 1);
+				for (int sampleIndex = 0; sampleIndex < 10; ++sampleIndex)
+				{
+					float inputs[2] = { (float)sampleIndex, sampleIndex + 100.0f };
+					float target = sampleIndex * 3.0f;
+					writer.addSample(inputs, &target);
+				}
+			}
+			datasetReader reader("datasetUnitTest.bin");
+			std::vector<float> orders[2];
+			for (int run = 0; run < 2; ++run)
+			{
+				batchProducer producer(reader, 4, 3, 11);
+				const batchTensor *input, *target;
+				int expectedSizes[3] = { 4, 4, 2 };
+				for (int batchIndex = 0; batchIndex < 9; ++batchIndex)
+				{
+					Assert::IsTrue(producer.nextBatch(input, target));
+					Assert::AreEqual(producer.getEpoch(), batchIndex / 3);
+					Assert::AreEqual(input->getBatchSize(), expectedSizes[batchIndex % 3]);
+					for (int b = 0; b < input->getBatchSize(); ++b)
+					{
+						Assert::AreEqual(input->getRow(1)[b], input->getRow(0)[b] + 100.0f);
+						Assert::AreEqual(target->getRow(0)[b], input->getRow(0)[b] * 3.0f);
+						orders[run].push_back(input->getRow(0)[b]);
+					}
+				}
+				Assert::IsFalse(producer.nextBatch(input, target));
+				Assert::IsFalse(producer.nextBatch(input, target));
+			}
+			Assert::IsTrue(orders[0] == orders[1]);
+			for (int epoch = 0; epoch < 3; ++epoch)
+			{
+				std::vector<float> epochOrder(orders[0].begin() + epoch * 10, orders[0].begin() + epoch * 10 + 10);
+				std::sort(epochOrder.begin(), epochOrder.end());
+				for (int sampleIndex = 0; sampleIndex < 10; ++sampleIndex)
+				{
+					Assert::AreEqual(epochOrder[sampleIndex], (float)sampleIndex);
+				}
+			}
+			Assert::IsFalse(std::equal(orders[0].begin(), orders[0].begin() + 10, orders[0].begin() + 10));
+
+			//A producer destroyed partway through stops its thread.
+			{
+				batchProducer producer(reader, 3, 100, 5);
+				const batchTensor *input, *target;
+				Assert::IsTrue(producer.nextBatch(input, target));
+			}
+			std::remove("datasetUnitTest.bin");
+		}
+	};
+
+	TEST_CLASS(distributedTrainerUnitTests)
+	{
+	public:
+
+		/*Tests that workers connected by sockets, each training on its own part of every batch, end
+		 *with the same weights as one network trained on the whole batches, even when the workers
+		 *start from different weights.*/
+		TEST_METHOD(matchesSingleNetwork)
+		{
+			const int workerCount = 3;
+			const int shardStarts[workerCount + 1] = { 0, 4, 7, 10 };
+			neuralNetwork single(3, 2);
+			batchTensor input(3, 10), target(2, 10);
+			for (int i = 0; i < 4; ++i)
+			{
+				single.addNeuron(0, true);
+				for (int j = 0; j < 3; ++j)
+				{
+					single.addConnection(3 + i, j, 0.15f * (i - j));
+				}
+			}
+			for (int i = 0; i < 2; ++i)
+			{
+				single.addNeuron(1, true);
+				for (int j = 0; j < 4; ++j)
+				{
+					single.addConnection(7 + i, 3 + j, 0.1f * (j - i) - 0.05f);
+				}
+			}
+			for (int b = 0; b < 10; ++b)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					input.getRow(j)[b] = (float)((b * 3 + j * 7) % 10) / 10.0f - 0.5f;
+				}
+				target.getRow(0)[b] = b % 2 == 0 ? 0.8f : 0.2f;
+				target.getRow(1)[b] = b % 3 == 0 ? 0.1f : 0.6f;
+			}
+
+			std::vector<std::string> addresses;
+			for (int rank = 0; rank < workerCount; ++rank)
+			{
+#ifdef _WIN32
+				addresses.push_back("tcp:127.0.0.1:" + std::to_string(47310 + rank));
+#else
+				addresses.push_back("unix:distributedUnitTest" + std::to_string(rank) + ".sock");
+#endif
+			}
+			std::vector<neuralNetwork> workers(workerCount, single);
+			workers[0].setBias(5, 0.0f);
+			workers[1].setBias(5, 0.5f);
+			workers[2].setBias(5, -0.2f);
+			std::vector<std::thread> threads;
+			std::atomic<int> failures(0);
+			for (int rank = 0; rank < workerCount; ++rank)
+			{
+				threads.push_back(std::thread([&, rank]
+				{
+					try
+					{
+						ringCommunicator ring(rank, addresses, 10000);
+						distributedTrainer trainer(workers[rank], ring);
+						int shardSize = shardStarts[rank + 1] - shardStarts[rank];
+						batchTensor shardInput(3, shardSize), shardTarget(2, shardSize);
+						for (int b = 0; b < shardSize; ++b)
+						{
+							for (int j = 0; j < 3; ++j)
+							{
+								shardInput.getRow(j)[b] = input.getRow(j)[shardStarts[rank] + b];
+							}
+							for (int j = 0; j < 2; ++j)
+							{
+								shardTarget.getRow(j)[b] = target.getRow(j)[shardStarts[rank] + b];
+							}
+						}
+						for (int step = 0; step < 3; ++step)
+						{
+							trainer.trainBatch(shardInput, shardTarget);
+						}
+					}
+					catch (const std::exception&)
+					{
+						++failures;
+					}
+				}));
+			}
+			for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+			{
+				it->join();
+			}
+			Assert::AreEqual(failures.load(), 0);
+
+			single.setBias(5, 0.1f);
+			for (int step = 0; step < 3; ++step)
+			{
+				single.forwardPropagate(input);
+				single.backwardPropagate(target);
+			}
+			std::vector<float> singleState(single.getTrainingStateSize()), workerState(single.getTrainingStateSize());
+			single.getTrainingState(singleState.data());
+			for (int rank = 0; rank < workerCount; ++rank)
+			{
+				std::vector<float> otherState(single.getTrainingStateSize());
+				workers[rank].getTrainingState(otherState.data());
+				if (rank == 0)
+				{
+					workerState = otherState;
+				}
+				Assert::IsTrue(otherState == workerState);
+			}
+			for (std::size_t stateIndex = 0; stateIndex < singleState.size(); ++stateIndex)
+			{
+				Assert::IsTrue(floatInBounds(workerState[stateIndex], singleState[stateIndex], FLOAT_TEST_RANGE));
+			}
+		}
+	};
+
+	TEST_CLASS(gradualPrunerUnitTests)
+	{
+	public:
+
+		//Tests that the network is pruned along the cubic schedule only on the pruning steps.
+		TEST_METHOD(schedule)
+		{
+			neuralNetwork network(10, 2);
+			for (int i = 0; i < 8; ++i)
+			{
+				network.addNeuron(0, true);
+				for (int j = 0; j < 10; ++j)
+				{
+					network.addConnection(10 + i, j);
+				}
+			}
+			for (int i = 0; i < 2; ++i)
+			{
+				network.addNeuron(1, true);
+				for (int j = 0; j < 8; ++j)
+				{
+					network.addConnection(18 + i, 10 + j);
+				}
+			}
+
+			gradualPruner pruner(network, 0.75f, 10, 50, 10, perStagePruning);
+			Assert::AreEqual(pruner.getScheduledSparsity(5), 0.0f);
+			Assert::IsTrue(floatInBounds(pruner.getScheduledSparsity(30), 0.75f * (1.0f - 0.125f), FLOAT_TEST_RANGE));
+			Assert::AreEqual(pruner.getScheduledSparsity(80), 0.75f);
+			Assert::IsFalse(pruner.update(10));
+			Assert::IsFalse(pruner.update(15));
+			Assert::IsTrue(pruner.update(20));
+			Assert::IsTrue(std::fabs(pruner.getSparsity() - pruner.getScheduledSparsity(20)) < 0.02f);
+			Assert::IsFalse(pruner.update(25));
+
+			float lastSparsity = pruner.getSparsity();
+			for (std::uint64_t step = 26; step <= 60; ++step)
+			{
+				pruner.update(step);
+				Assert::IsTrue(pruner.getSparsity() >= lastSparsity);
+				lastSparsity = pruner.getSparsity();
+			}
+			Assert::IsTrue(std::fabs(pruner.getSparsity() - 0.75f) < 0.02f);
+			Assert::AreEqual(network.getConnectionCount(), 96 - (int)(96 * pruner.getSparsity() + 0.5f));
+
+			Assert::ExpectException<std::out_of_range>([&] {gradualPruner(network, 1.0f, 0, 10, 1, perNeuronPruning); });
+			Assert::ExpectException<std::out_of_range>([&] {gradualPruner(network, 0.5f, 0, 10, 0, perNeuronPruning); });
+			Assert::ExpectException<std::out_of_range>([&] {gradualPruner(network, 0.5f, 10, 5, 1, perNeuronPruning); });
+		}
+	};
+
+	TEST_CLASS(hogwildTrainerUnitTests)
+	{
+	public:
+
+		/*Tests that a single thread trains the same as the pipelined driver, dropout included, and
+		 *that many threads updating the network at once still lower the loss.*/
+		TEST_METHOD(train)
+		{
+			{
+				datasetWriter writer("hogwildUnitTest.bin", 2, 1);
+				for (int sampleIndex = 0; sampleIndex < 60; ++sampleIndex)
+				{
+					float inputs[2] = { (sampleIndex % 10) / 10.0f, (sampleIndex / 10) / 6.0f };
+					float target = inputs[0] > inputs[1] ? 0.9f : 0.1f;
+					writer.addSample(inputs, &target);
+				}
+			}
+			datasetReader reader("hogwildUnitTest.bin");
+			neuralNetwork asynchronous(2, 1);
+			for (int i = 0; i < 4; ++i)
+			{
+				asynchronous.addNeuron(0, true);
+				asynchronous.addConnection(2 + i, 0, 0.5f - 0.3f * i);
+				asynchronous.addConnection(2 + i, 1, 0.2f * i - 0.4f);
+			}
+			asynchronous.addNeuron(1, true);
+			for (int i = 0; i < 4; ++i)
+			{
+				asynchronous.addConnection(6, 2 + i, 0.25f * (i % 2 == 0 ? 1 : -1));
+			}
+			asynchronous.setDropRatePercent(3, 0.3f);
+			neuralNetwork pipelined(asynchronous), threaded(asynchronous);
+			Assert::ExpectException<std::out_of_range>([&] {hogwildTrainer wrongTrainer(asynchronous, reader, 8, 0); });
+
+			hogwildTrainer singleThread(asynchronous, reader, 8, 1);
+			trainingStats stats = singleThread.train(5, 17);
+			trainingDriver driver(pipelined, reader, 8);
+			trainingStats pipelinedStats = driver.train(5, 17);
+			Assert::AreEqual((int)stats.batchCount, 5 * 8);
+			Assert::AreEqual((int)stats.sampleCount, 5 * 60);
+			Assert::IsTrue(stats.samplesPerSecond > 0.0);
+			std::list<float> asynchronousWeights, pipelinedWeights;
+			for (int cellIndex = 2; cellIndex < 7; ++cellIndex)
+			{
+				Assert::IsTrue(floatInBounds(asynchronous.getBias(cellIndex), pipelined.getBias(cellIndex), FLOAT_TEST_RANGE));
+				asynchronous.getWeights(cellIndex, asynchronousWeights);
+				pipelined.getWeights(cellIndex, pipelinedWeights);
+				std::list<float>::iterator pipelinedIt = pipelinedWeights.begin();
+				for (std::list<float>::iterator it = asynchronousWeights.begin(); it != asynchronousWeights.end(); ++it, ++pipelinedIt)
+				{
+					Assert::IsTrue(floatInBounds(*it, *pipelinedIt, FLOAT_TEST_RANGE));
+				}
+			}
+			for (int epoch = 0; epoch < 5; ++epoch)
+			{
+				Assert::IsTrue(std::abs(stats.epochLosses[epoch] - pipelinedStats.epochLosses[epoch]) < FLOAT_TEST_RANGE);
+			}
+
+			hogwildTrainer manyThreads(threaded, reader, 2, 4);
+			Assert::AreEqual(manyThreads.getThreadCount(), 4);
+			trainingStats threadedStats = manyThreads.train(20, 17);
+			Assert::IsTrue(threadedStats.epochLosses.back() < threadedStats.epochLosses.front());
+			std::remove("hogwildUnitTest.bin");
+		}
+	};
+
+	TEST_CLASS(philoxRandomUnitTests)
+	{
+	public:
+
+		//Tests the generator against the known answers published with Philox4x32-10.
+		TEST_METHOD(knownAnswers)
+		{
+			const std::uint32_t counters[3][4] = { { 0, 0, 0, 0 }, { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+				{ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 } };
+			const std::uint32_t keys[3][2] = { { 0, 0 }, { 0xffffffff, 0xffffffff }, { 0xa4093822, 0x299f31d0 } };
+			const std::uint32_t expected[3][4] = { { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 },
+				{ 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd }, { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } };
+			std::uint32_t output[4];
+			for (int test = 0; test < 3; ++test)
+			{
+				philox4x32(counters[test], keys[test], output);
+				for (int i = 0; i < 4; ++i)
+				{
+					Assert::AreEqual(output[i], expected[test][i]);
+				}
+			}
+		}
+
+		//Tests that a mask drops close to the drop rate and only changes when its key or counter does.
+		TEST_METHOD(dropoutMask)
+		{
+			std::vector<float> mask(10001), sameMask(10001), otherStep(10001), otherCell(10001);
+			int keptCount = buildDropoutMask(7, 3, 12, 0.3f, 10001, mask.data());
+			Assert::AreEqual(buildDropoutMask(7, 3, 12, 0.3f, 10001, sameMask.data()), keptCount);
+			buildDropoutMask(7, 4, 12, 0.3f, 10001, otherStep.data());
+			buildDropoutMask(7, 3, 13, 0.3f, 10001, otherCell.data());
+			Assert::IsTrue(keptCount > 6700 && keptCount < 7300);
+			Assert::IsTrue(mask == sameMask);
+			Assert::IsFalse(mask == otherStep);
+			Assert::IsFalse(mask == otherCell);
+			for (std::vector<float>::iterator it = mask.begin(); it != mask.end(); ++it)
+			{
+				Assert::IsTrue(*it == 0.0f || *it == 1.0f);
+			}
+
+			//A shorter batch gets the start of the same mask.
+			Assert::AreEqual(buildDropoutMask(7, 3, 12, 0.3f, 6, sameMask.data()), (int)std::count(mask.begin(), mask.begin() + 6, 1.0f));
+			Assert::IsTrue(std::equal(mask.begin(), mask.begin() + 6, sameMask.begin()));
+			Assert::AreEqual(buildDropoutMask(7, 3, 12, 0.0f, 100, mask.data()), 100);
+			Assert::AreEqual(buildDropoutMask(7, 3, 12, 1.0f, 100, mask.data()), 0);
+		}
+	};
+
+	TEST_CLASS(quantizedPlanUnitTests)
+	{
+	public:
+
+		/*Tests that a network quantized with each granularity stays close to the float plan,
+		 *with dense and sparse stages and softmax outputs, and that the drift report matches.*/
+		TEST_METHOD(quantizeNetwork)
+		{
+			neuralNetwork network(6, 3);
+			batchTensor input(6, 200), floatOutput, quantizedOutput;
+			for (int i = 0; i < 8; ++i)
+			{
+				network.addNeuron(0, true);
+				network.setActivationFunction(6 + i, i % 2 == 0 ? reLUFunction : tanhFunction);
+				for (int j = 0; j < 6; ++j)
+				{
+					network.addConnection(6 + i, j);
+				}
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				network.addNeuron(1, true);
+				network.setActivationFunction(14 + i, softmaxFunction);
+				for (int j = i; j < 8; j += 2)
+				{
+					network.addConnection(14 + i, 6 + j);
+				}
+				network.addConnection(14 + i, i);
+			}
+			for (int b = 0; b < 200; ++b)
+			{
+				for (int j = 0; j < 6; ++j)
+				{
+					input.getRow(j)[b] = (float)((b * 7 + j * 3) % 17) / 17.0f - 0.3f;
+				}
+			}
+
+			inferencePlan floatPlan = network.compileForInference();
+			floatPlan.run(input, floatOutput);
+			const quantizationGranularity granularities[2] = { perNeuronScales, perStageScales };
+			for (int granularityIndex = 0; granularityIndex < 2; ++granularityIndex)
+			{
+				quantizedPlan plan = NeuralNetwork::quantizeNetwork(network, input, granularities[granularityIndex]);
+				Assert::IsTrue(plan.getGranularity() == granularities[granularityIndex]);
+				Assert::AreEqual(plan.getCellCount(), 17);
+				Assert::AreEqual(plan.getStageCount(), 2);
+				for (int cellIndex = 0; cellIndex < 17; ++cellIndex)
+				{
+					Assert::IsTrue(plan.getScale(cellIndex) > 0.0f);
+					Assert::IsTrue(plan.getZeroPoint(cellIndex) >= 0 && plan.getZeroPoint(cellIndex) <= 255);
+				}
+				//The inputs are never negative past -0.3, so their zero point is low but not zero.
+				Assert::IsTrue(plan.getZeroPoint(0) > 0 && plan.getZeroPoint(0) < 128);
+				Assert::ExpectException<std::out_of_range>([&] {plan.getScale(17); });
+
+				plan.run(input, quantizedOutput);
+				double maxError = 0.0;
+				for (int i = 0; i < 3; ++i)
+				{
+					for (int b = 0; b < 200; ++b)
+					{
+						Assert::IsTrue(floatInBounds(quantizedOutput.getRow(i)[b], floatOutput.getRow(i)[b], 0.03f));
+						maxError = std::max(maxError, std::fabs((double)quantizedOutput.getRow(i)[b] - floatOutput.getRow(i)[b]));
+					}
+				}
+
+				quantizationReport report = measureQuantizationDrift(floatPlan, plan, input);
+				Assert::IsTrue(report.sampleCount == 200);
+				Assert::IsTrue(std::fabs(report.maxAbsoluteError - maxError) < 1e-9);
+				Assert::IsTrue(report.meanAbsoluteError <= report.maxAbsoluteError);
+				Assert::AreEqual((int)report.outputMaxErrors.size(), 3);
+				Assert::IsTrue(report.argmaxAgreement > 0.9);
+				Assert::ExpectException<lists_not_same_length>([&] {plan.run(floatOutput, quantizedOutput); });
+			}
+			Assert::ExpectException<lists_not_same_length>([&] {NeuralNetwork::quantizeNetwork(network, floatOutput, perNeuronScales); });
+		}
+	};
+
+	TEST_CLASS(reducedPrecisionUnitTests)
+	{
+	public:
+
+		//Tests rounding to both 16-bit formats including ties, subnormals, overflow and NaN.
+		TEST_METHOD(conversions)
+		{
+			Assert::AreEqual(toBfloat16(1.0f), (std::uint16_t)0x3F80);
+			Assert::AreEqual(toHalf(1.0f), (std::uint16_t)0x3C00);
+			Assert::AreEqual(toHalf(-2.0f), (std::uint16_t)0xC000);
+			Assert::AreEqual(toHalf(65504.0f), (std::uint16_t)0x7BFF);
+			Assert::AreEqual(toHalf(70000.0f), (std::uint16_t)0x7C00);
+			Assert::AreEqual(toBfloat16(1e38f), (std::uint16_t)0x7E96);
+
+			//Halfway between two values rounds to the one with an even last bit.
+			Assert::AreEqual(toBfloat16(1.0f + 1.0f / 256.0f), (std::uint16_t)0x3F80);
+			Assert::AreEqual(toBfloat16(1.0f + 3.0f / 256.0f), (std::uint16_t)0x3F82);
+			Assert::AreEqual(toHalf(1.0f + 1.0f / 2048.0f), (std::uint16_t)0x3C00);
+			Assert::AreEqual(toHalf(1.0f + 3.0f / 2048.0f), (std::uint16_t)0x3C02);
+
+			//The smallest half is 2^-24, and half of it rounds down to zero.
+			Assert::AreEqual(toHalf(std::ldexp(1.0f, -24)), (std::uint16_t)0x0001);
+			Assert::AreEqual(toHalf(std::ldexp(1.0f, -25)), (std::uint16_t)0x0000);
+			Assert::AreEqual(toHalf(std::ldexp(3.0f, -25)), (std::uint16_t)0x0002);
+			Assert::AreEqual(fromHalf(0x0001), std::ldexp(1.0f, -24));
+			Assert::AreEqual(fromHalf(0x03FF), std::ldexp(1023.0f, -24));
+
+			Assert::IsTrue(std::isnan(fromHalf(toHalf(std::nanf("")))));
+			Assert::IsTrue(std::isnan(fromBfloat16(toBfloat16(std::nanf("")))));
+			Assert::IsTrue(std::isinf(fromHalf(0xFC00)) && fromHalf(0xFC00) < 0.0f);
+
+			//Every value that isn't NaN survives widening and narrowing again.
+			for (int value = 0; value < 0x10000; ++value)
+			{
+				if ((value & 0x7C00) != 0x7C00 || (value & 0x03FF) == 0)
+				{
+					Assert::AreEqual(toHalf(fromHalf((std::uint16_t)value)), (std::uint16_t)value);
+				}
+				if ((value & 0x7F80) != 0x7F80 || (value & 0x007F) == 0)
+				{
+					Assert::AreEqual(toBfloat16(fromBfloat16((std::uint16_t)value)), (std::uint16_t)value);
+				}
+			}
+
+			std::vector<float> values(45), widened(45);
+			std::vector<std::uint16_t> narrowed(45);
+			for (int i = 0; i < 45; ++i)
+			{
+				values[i] = 0.37f * i - 8.0f;
+			}
+			narrowValues(bfloat16Precision, values.data(), narrowed.data(), 45);
+			widenValues(bfloat16Precision, narrowed.data(), widened.data(), 45);
+			for (int i = 0; i < 45; ++i)
+			{
+				Assert::AreEqual(narrowed[i], toBfloat16(values[i]));
+				Assert::IsTrue(floatInBounds(widened[i], values[i], 0.04f));
+			}
+			std::vector<float> target(45, 1.0f);
+			addReducedVectors(bfloat16Precision, target.data(), narrowed.data(), 2.0f, 45);
+			for (int i = 0; i < 45; ++i)
+			{
+				Assert::AreEqual(target[i], 1.0f + 2.0f * widened[i]);
+			}
+		}
+	};
+
+	TEST_CLASS(ringCommunicatorUnitTests)
+	{
+	public:
+
+		//Tests the all-reduce sums arrays that don't split evenly between the workers, including ones shorter than the ring.
+		TEST_METHOD(allReduce)
+		{
+			const int workerCount = 4;
+			std::vector<std::string> addresses;
+			for (int rank = 0; rank < workerCount; ++rank)
+			{
+#ifdef _WIN32
+				addresses.push_back("tcp:127.0.0.1:" + std::to_string(47320 + rank));
+#else
+				addresses.push_back("unix:ringUnitTest" + std::to_string(rank) + ".sock");
+#endif
+			}
+			Assert::ExpectException<std::out_of_range>([&] {ringCommunicator ring(workerCount, addresses, 0); });
+
+			std::vector<std::vector<float>> arrays(workerCount), shortArrays(workerCount);
+			std::vector<std::thread> threads;
+			std::atomic<int> failures(0);
+			for (int rank = 0; rank < workerCount; ++rank)
+			{
+				for (int i = 0; i < 1001; ++i)
+				{
+					arrays[rank].push_back((float)(rank * 1000 + i));
+				}
+				shortArrays[rank].assign(2, (float)(rank + 1));
+				threads.push_back(std::thread([&, rank]
+				{
+					try
+					{
+						ringCommunicator ring(rank, addresses, 10000);
+						if (ring.getRank() != rank || ring.getWorkerCount() != workerCount)
+						{
+							++failures;
+						}
+						ring.allReduce(arrays[rank].data(), arrays[rank].size());
+						ring.allReduce(shortArrays[rank].data(), shortArrays[rank].size());
+					}
+					catch (const std::exception&)
+					{
+						++failures;
+					}
+				}));
+			}
+			for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+			{
+				it->join();
+			}
+			Assert::AreEqual(failures.load(), 0);
+			for (int rank = 0; rank < workerCount; ++rank)
+			{
+				for (int i = 0; i < 1001; ++i)
+				{
+					Assert::AreEqual(arrays[rank][i], (float)(6000 + 4 * i));
+				}
+				Assert::AreEqual(shortArrays[rank][0], 10.0f);
+				Assert::AreEqual(shortArrays[rank][1], 10.0f);
+			}
+		}
+	};
+
+	TEST_CLASS(threadPoolUnitTests)
+	{
+	public:
+
+		//Tests that every index is run exactly once in chunks no larger than requested.
+		TEST_METHOD(parallelFor)
+		{
+			for (int threadCount = 1; threadCount <= 4; ++threadCount)
+			{
+				threadPool pool(threadCount);
+				Assert::AreEqual(pool.getThreadCount(), threadCount);
+				for (int count = 0; count < 300; count += 37)
+				{
+					std::vector<std::atomic<int>> runs(count);
+					for (int i = 0; i < count; ++i)
+					{
+						runs[i].store(0);
+					}
+					pool.parallelFor(count, 5, [&](int start, int end)
+					{
+						Assert::IsTrue(end - start <= 5 && start < end);
+						for (int i = start; i < end; ++i)
+						{
+							runs[i].fetch_add(1);
+						}
+					});
+					for (int i = 0; i < count; ++i)
+					{
+						Assert::AreEqual(runs[i].load(), 1);
+					}
+				}
+			}
+			Assert::ExpectException<std::out_of_range>([] {threadPool pool(0); });
+		}
+
+		//Tests that an exception thrown by a task is rethrown once the loop is done.
+		TEST_METHOD(parallelForException)
+		{
+			threadPool pool(3);
+			std::atomic<int> finished(0);
+			Assert::ExpectException<std::out_of_range>([&]
+			{
+				pool.parallelFor(60, 1, [&](int start, int end)
+				{
+					if (start == 17)
+					{
+						throw std::out_of_range("Test exception.");
+					}
+					finished.fetch_add(1);
+				});
+			});
+			Assert::AreEqual(finished.load(), 59);
+
+			//The pool can still be used afterwards.
+			pool.parallelFor(60, 1, [&](int start, int end) {finished.fetch_add(1); });
+			Assert::AreEqual(finished.load(), 119);
+		}
+	};
+
+	TEST_CLASS(traceUnitTests)
+	{
+	public:
+
+		//Tests that the events of each thread are written to a Chrome trace with their stats.
+		TEST_METHOD(chromeTrace)
+		{
+			clearTrace();
+			setTraceStatsEnabled(true);
+			float stageValues[] = { 1.0f, -2.0f, 4.0f };
+			{
+				traceScope scope(forwardStageEvent, 5, 2);
+				scope.setStats(stageValues, 3);
+			}
+			std::thread otherThread([]
+			{
+				traceScope scope(backwardCellEvent, 7, 3);
+			});
+			otherThread.join();
+			setTraceStatsEnabled(false);
+
+			writeChromeTrace("traceUnitTest.json");
+			std::ifstream file("traceUnitTest.json");
+			std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			file.close();
+			std::remove("traceUnitTest.json");
+			Assert::IsTrue(contents.find("\"name\":\"forward stage 2\"") != std::string::npos);
+			Assert::IsTrue(contents.find("\"name\":\"backward cell 7\"") != std::string::npos);
+			Assert::IsTrue(contents.find("\"min\":-2,\"mean\":1,\"max\":4") != std::string::npos);
+			Assert::IsTrue(contents.find("\"ph\":\"X\"") != std::string::npos);
+		}
+
+		//Tests the header and events of the binary trace, and that cleared or disabled events aren't written.
+		TEST_METHOD(binaryTrace)
+		{
+			clearTrace();
+			{
+				traceScope scope(forwardCellEvent, 1, 0);
+			}
+			setTracingEnabled(false);
+			{
+				traceScope scope(forwardCellEvent, 2, 0);
+			}
+			setTracingEnabled(true);
+
+			writeBinaryTrace("traceUnitTest.bin");
+			std::ifstream file("traceUnitTest.bin", std::ios::binary);
+			char header[8];
+			std::uint64_t eventCount = 0;
+			traceEvent event;
+			file.read(header, 8);
+			file.read(reinterpret_cast<char*>(&eventCount), sizeof(eventCount));
+			file.read(reinterpret_cast<char*>(&event), sizeof(event));
+			Assert::IsTrue((bool)file);
+			file.close();
+			Assert::AreEqual(std::string(header, 7), std::string("NNTRACE"));
+			Assert::AreEqual((int)eventCount, 1);
+			Assert::AreEqual(event.cellIndex, 1);
+			Assert::AreEqual(event.type, (std::uint32_t)forwardCellEvent);
+			Assert::AreEqual(event.hasStats, (std::uint32_t)0);
+
+			clearTrace();
+			writeBinaryTrace("traceUnitTest.bin");
+			file.open("traceUnitTest.bin", std::ios::binary);
+			file.read(header, 8);
+			file.read(reinterpret_cast<char*>(&eventCount), sizeof(eventCount));
+			file.close();
+			std::remove("traceUnitTest.bin");
+			Assert::AreEqual((int)eventCount, 0);
+		}
+	};
+
+	TEST_CLASS(trainingDriverUnitTests)
+	{
+	public:
+
+		/*Tests that the pipelined driver trains exactly like running the same batches one step at
+		 *a time, lowers the loss and reports every batch.*/
+		TEST_METHOD(train)
+		{
+			{
+				datasetWriter writer("trainingDriverUnitTest.bin", 2, 1);
+				for (int sampleIndex = 0; sampleIndex < 50; ++sampleIndex)
+				{
+					float inputs[2] = { (sampleIndex % 10) / 10.0f, (sampleIndex / 10) / 5.0f };
+					float target = inputs[0] > inputs[1] ? 0.9f : 0.1f;
+					writer.addSample(inputs, &target);
+				}
+			}
+			datasetReader reader("trainingDriverUnitTest.bin");
+			neuralNetwork pipelined(2, 1);
+			for (int i = 0; i < 4; ++i)
+			{
+				pipelined.addNeuron(0, true);
+				pipelined.addConnection(2 + i, 0, 0.5f - 0.3f * i);
+				pipelined.addConnection(2 + i, 1, 0.2f * i - 0.4f);
+			}
+			pipelined.addNeuron(1, true);
+			for (int i = 0; i < 4; ++i)
+			{
+				pipelined.addConnection(6, 2 + i, 0.25f * (i % 2 == 0 ? 1 : -1));
+			}
+			neuralNetwork serial(pipelined);
+			Assert::ExpectException<lists_not_same_length>([&] {neuralNetwork wrongNetwork(3, 1); trainingDriver wrongDriver(wrongNetwork, reader, 8); });
+
+			trainingDriver driver(pipelined, reader, 8);
+			trainingStats stats = driver.train(6, 21);
+			Assert::AreEqual((int)stats.batchCount, 6 * 7);
+			Assert::AreEqual((int)stats.sampleCount, 6 * 50);
+			Assert::AreEqual((int)stats.epochLosses.size(), 6);
+			Assert::IsTrue(stats.epochLosses.back() < stats.epochLosses.front());
+			Assert::IsTrue(stats.samplesPerSecond > 0.0);
+			Assert::IsTrue(stats.forwardTime > 0 && stats.backwardTime > 0);
+
+			{
+				batchProducer producer(reader, 8, 6, 21);
+				const batchTensor *input, *target;
+				while (producer.nextBatch(input, target))
+				{
+					serial.forwardPropagate(*input);
+					serial.backwardPropagate(*target);
+				}
+			}
+			std::list<float> pipelinedWeights, serialWeights;
+			for (int cellIndex = 2; cellIndex < 7; ++cellIndex)
+			{
+				pipelined.getWeights(cellIndex, pipelinedWeights);
+				serial.getWeights(cellIndex, serialWeights);
+				Assert::IsTrue(pipelinedWeights == serialWeights);
+			}
+			std::remove("trainingDriverUnitTest.bin");
+		}
+	};
+
+	TEST_CLASS(vectorKernelsUnitTests)
+	{
+	public:
+
+		//Tests that the kernels picked for the processor are the widest supported ones.
+		TEST_METHOD(kernelSelection)
+		{
+			Assert::IsTrue(instructionSetSupported(scalar));
+			Assert::IsTrue(getKernels().instructions == getSupportedInstructionSet());
+			Assert::IsTrue(getKernels(scalar).instructions == scalar);
+			for (int set = getSupportedInstructionSet() + 1; set <= aVX512; ++set)
+			{
+				Assert::ExpectException<instruction_set_not_supported>([&] {getKernels((instructionSet)set); });
+			}
+		}
+
+		/*Tests every kernel the processor supports against the scalar kernels with lengths that
+		 *leave elements after the vector loops.*/
+		TEST_METHOD(matchScalarKernels)
+		{
+			const vectorKernels &reference = getKernels(scalar);
+			for (int set = sSE42; set <= getSupportedInstructionSet(); ++set)
+			{
+				const vectorKernels &tested = getKernels((instructionSet)set);
+				for (int length = 0; length < 40; ++length)
+				{
+					std::vector<float> first(length), second(length), expected(length), result(length);
+					for (int i = 0; i < length; ++i)
+					{
+						first[i] = 0.37f * i - 6.0f;
+						second[i] = (float)((i * 7) % 11) / 11.0f;
+					}
+
+					expected = result = first;
+					reference.addVectors(expected.data(), second.data(), -1.5f, length);
+					tested.addVectors(result.data(), second.data(), -1.5f, length);
+					for (int i = 0; i < length; ++i)
+					{
+						Assert::IsTrue(floatInBounds(result[i], expected[i], FLOAT_TEST_RANGE));
+					}
+
+					Assert::IsTrue(floatInBounds(tested.dotProduct(first.data(), second.data(), length), reference.dotProduct(first.data(), second.data(), length), 0.001f));
+
+					//Each row is weighted differently so a kernel mixing up the rows or weights fails.
+					const float *rows[3] = { first.data(), second.data(), first.data() };
+					float rowWeights[3] = { 0.5f, -1.5f, 2.0f };
+					expected = result = second;
+					reference.addWeightedRows(expected.data(), rows, rowWeights, 3, length);
+					tested.addWeightedRows(result.data(), rows, rowWeights, 3, length);
+					for (int i = 0; i < length; ++i)
+					{
+						Assert::IsTrue(floatInBounds(result[i], expected[i], FLOAT_TEST_RANGE));
+					}
+
+					expected = result = first;
+					reference.exponential(expected.data(), length);
+					tested.exponential(result.data(), length);
+					for (int i = 0; i < length; ++i)
+					{
+						Assert::IsTrue(floatInBounds(result[i], expected[i], FLOAT_TEST_RANGE));
+					}
+
+					expected = result = first;
+					reference.fastSigmoid(expected.data(), length);
+					tested.fastSigmoid(result.data(), length);
+					for (int i = 0; i < length; ++i)
+					{
+						Assert::IsTrue(floatInBounds(result[i], expected[i], FLOAT_TEST_RANGE));
+					}
+
+					expected = result = first;
+					reference.sigmoid(expected.data(), length);
+					tested.sigmoid(result.data(), length);
+					for (int i = 0; i < length; ++i)
+					{
+						Assert::IsTrue(floatInBounds(result[i], expected[i], FLOAT_TEST_RANGE));
+					}
+
+					std::vector<std::uint8_t> bytes(length);
+					std::vector<std::int8_t> signedBytes(length);
+					for (int i = 0; i < length; ++i)
+					{
+						bytes[i] = (std::uint8_t)(255 - i * 37 % 256);
+						signedBytes[i] = (std::int8_t)(i * 53 % 256 - 128);
+					}
+					Assert::AreEqual(tested.dotProductInt8(bytes.data(), signedBytes.data(), length), reference.dotProductInt8(bytes.data(), signedBytes.data(), length));
+
+					reference.sigmoidDelta(expected.data(), first.data(), second.data(), length);
+					tested.sigmoidDelta(result.data(), first.data(), second.data(), length);
+					for (int i = 0; i < length; ++i)
+					{
+						Assert::IsTrue(floatInBounds(result[i], expected[i], FLOAT_TEST_RANGE));
+					}
+				}
+
+				//The sigmoid kernels have to stay between zero and one for inputs that overflow e^x.
+				float extremes[8] = { -1000.0f, -100.0f, -88.5f, -20.0f, 20.0f, 88.5f, 100.0f, 1000.0f };
+				float fastExtremes[8];
+				std::copy(extremes, extremes + 8, fastExtremes);
+				tested.sigmoid(extremes, 8);
+				tested.fastSigmoid(fastExtremes, 8);
+				for (int i = 0; i < 8; ++i)
+				{
+					Assert::IsTrue(extremes[i] >= 0.0f && extremes[i] <= 1.0f);
+					Assert::IsTrue(fastExtremes[i] >= 0.0f && fastExtremes[i] <= 1.0f);
+				}
+				Assert::IsTrue(floatInBounds(extremes[0], 0.0f, FLOAT_TEST_RANGE));
+				Assert::IsTrue(floatInBounds(extremes[7], 1.0f, FLOAT_TEST_RANGE));
+
+				std::vector<float> a(KERNEL_TILE_ROWS * 50), packedB(50 * KERNEL_TILE_COLUMNS), expectedC(KERNEL_TILE_ROWS * 20, 1.0f), resultC(KERNEL_TILE_ROWS * 20, 1.0f);
+				for (int i = 0; i < (int)a.size(); ++i)
+				{
+					a[i] = (float)(i % 13) / 13.0f - 0.5f;
+				}
+				for (int i = 0; i < (int)packedB.size(); ++i)
+				{
+					packedB[i] = (float)(i % 7) / 7.0f - 0.5f;
+				}
+				reference.multiplyTile(50, a.data(), 50, 1, packedB.data(), expectedC.data(), 20);
+				tested.multiplyTile(50, a.data(), 50, 1, packedB.data(), resultC.data(), 20);
+				for (int i = 0; i < (int)resultC.size(); ++i)
+				{
+					Assert::IsTrue(floatInBounds(resultC[i], expectedC[i], 0.001f));
+				}
+
+				//Long rows go through the widest blocks of the weighted rows kernels.
+				std::vector<float> longRow(150), expectedSum(150, 0.25f), resultSum(150, 0.25f);
+				for (int i = 0; i < 150; ++i)
+				{
+					longRow[i] = (float)(i % 17) / 17.0f - 0.5f;
+				}
+				std::vector<const float*> longRows(5, longRow.data());
+				float longWeights[5] = { 1.0f, -0.5f, 0.25f, 2.0f, -3.0f };
+				reference.addWeightedRows(expectedSum.data(), longRows.data(), longWeights, 5, 150);
+				tested.addWeightedRows(resultSum.data(), longRows.data(), longWeights, 5, 150);
+				for (int i = 0; i < 150; ++i)
+				{
+					Assert::IsTrue(floatInBounds(resultSum[i], expectedSum[i], FLOAT_TEST_RANGE));
+				}
+
+				//The int8 dot product has to stay exact over long rows of the largest products.
+				std::vector<std::uint8_t> largeValues(1000, 255);
+				std::vector<std::int8_t> largeWeights(1000, -128);
+				Assert::AreEqual(tested.dotProductInt8(largeValues.data(), largeWeights.data(), 1000), -255 * 128 * 1000);
+				Assert::AreEqual(tested.dotProductInt8(largeValues.data(), largeWeights.data(), 999), -255 * 128 * 999);
+
+				//The half conversions have to match bit for bit, checked over every half that isn't NaN and floats around each tie.
+				std::vector<std::uint16_t> halves, expectedHalves, resultHalves;
+				for (int value = 0; value < 0x10000; ++value)
+				{
+					if ((value & 0x7C00) != 0x7C00 || (value & 0x03FF) == 0)
+					{
+						halves.push_back((std::uint16_t)value);
+					}
+				}
+				std::vector<float> expectedFloats(halves.size()), resultFloats(halves.size());
+				reference.convertFromHalf(halves.data(), expectedFloats.data(), (int)halves.size());
+				tested.convertFromHalf(halves.data(), resultFloats.data(), (int)halves.size());
+				Assert::IsTrue(std::memcmp(expectedFloats.data(), resultFloats.data(), halves.size() * sizeof(float)) == 0);
+
+				std::vector<float> narrowed;
+				for (std::uint32_t bits = 0x30000000u; bits < 0x48000000u; bits += 0x7FFu)
+				{
+					float value;
+					std::memcpy(&value, &bits, sizeof(value));
+					narrowed.push_back(value);
+					narrowed.push_back(-value);
+				}
+				expectedHalves.resize(narrowed.size());
+				resultHalves.resize(narrowed.size());
+				reference.convertToHalf(narrowed.data(), expectedHalves.data(), (int)narrowed.size());
+				tested.convertToHalf(narrowed.data(), resultHalves.data(), (int)narrowed.size());
+				Assert::IsTrue(expectedHalves == resultHalves);
+			}
+		}
+	};
+
+	TEST_CLASS(matrixFunctionsUnitTests)
+	{
+	public:
+
+		//Tests each multiplication against a direct triple loop with sizes that don't fill the tiles.
+		TEST_METHOD(multiplyMatrices)
+		{
+			const int rows = 7, columns = 37, depth = 300;
+			std::vector<float> a(rows * depth), aTransposed(depth * rows), b(depth * columns), bTransposed(columns * depth);
+			for (int i = 0; i < rows; ++i)
+			{
+				for (int p = 0; p < depth; ++p)
+				{
+					a[i * depth + p] = aTransposed[p * rows + i] = (float)((i * 7 + p * 3) % 11) / 11.0f - 0.5f;
+				}
+			}
+			for (int p = 0; p < depth; ++p)
+			{
+				for (int j = 0; j < columns; ++j)
+				{
+					b[p * columns + j] = bTransposed[j * depth + p] = (float)((p * 5 + j * 2) % 13) / 13.0f - 0.5f;
+				}
+			}
+
+			std::vector<float> expected(rows * columns, 1.0f), normal(rows * columns, 1.0f), transposedA(rows * columns, 1.0f), transposedB(rows * columns, 1.0f);
+			for (int i = 0; i < rows; ++i)
+			{
+				for (int j = 0; j < columns; ++j)
+				{
+					for (int p = 0; p < depth; ++p)
+					{
+						expected[i * columns + j] += a[i * depth + p] * b[p * columns + j];
+					}
+				}
+			}
+			NeuralNetwork::multiplyMatrices(rows, columns, depth, a.data(), depth, b.data(), columns, normal.data(), columns);
+			multiplyMatricesTransposedA(rows, columns, depth, aTransposed.data(), rows, b.data(), columns, transposedA.data(), columns);
+			multiplyMatricesTransposedB(rows, columns, depth, a.data(), depth, bTransposed.data(), depth, transposedB.data(), columns);
+			for (int i = 0; i < rows * columns; ++i)
+			{
+				Assert::IsTrue(floatInBounds(normal[i], expected[i], 0.001f));
+				Assert::IsTrue(floatInBounds(transposedA[i], expected[i], 0.001f));
+				Assert::IsTrue(floatInBounds(transposedB[i], expected[i], 0.001f));
+			}
+		}
+		/*Tests the 16-bit multiplication against multiplyMatrices() on the widened matrices, which
+		 *it has to match since the sums are the same.*/
+		TEST_METHOD(multiplyReducedMatrices)
+		{
+			const int rows = 70, columns = 37, depth = 300;
+			const storagePrecision precisions[2] = { bfloat16Precision, halfPrecision };
+			for (int precisionIndex = 0; precisionIndex < 2; ++precisionIndex)
+			{
+				std::vector<float> a(rows * depth), b(depth * columns), expected(rows * columns, 1.0f), result(rows * columns, 1.0f);
+				std::vector<std::uint16_t> reducedA(rows * depth), reducedB(depth * columns);
+				for (int i = 0; i < rows * depth; ++i)
+				{
+					a[i] = (float)((i * 7) % 11) / 11.0f - 0.5f;
+				}
+				for (int i = 0; i < depth * columns; ++i)
+				{
+					b[i] = (float)((i * 5) % 13) / 13.0f - 0.5f;
+				}
+				narrowValues(precisions[precisionIndex], a.data(), reducedA.data(), rows * depth);
+				narrowValues(precisions[precisionIndex], b.data(), reducedB.data(), depth * columns);
+				widenValues(precisions[precisionIndex], reducedA.data(), a.data(), rows * depth);
+				widenValues(precisions[precisionIndex], reducedB.data(), b.data(), depth * columns);
+
+				NeuralNetwork::multiplyMatrices(rows, columns, depth, a.data(), depth, b.data(), columns, expected.data(), columns);
+				NeuralNetwork::multiplyReducedMatrices(precisions[precisionIndex], rows, columns, depth, reducedA.data(), depth, reducedB.data(), columns, result.data(), columns);
+				for (int i = 0; i < rows * columns; ++i)
+				{
+					Assert::IsTrue(floatInBounds(result[i], expected[i], 0.001f));
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(memoryArenaUnitTests)
+	{
+	public:
+
+		//Tests that allocations are aligned, don't overlap and are all freed by a release.
+		TEST_METHOD(allocate)
+		{
+			memoryArena arena(256);
+			std::vector<char*> allocations;
+			for (int i = 1; i <= 40; ++i)
+			{
+				char *allocation = static_cast<char*>(arena.allocate(i * 3, i % 2 == 0 ? 16 : 8));
+				Assert::AreEqual((int)((std::uintptr_t)allocation % (i % 2 == 0 ? 16 : 8)), 0);
+				std::fill(allocation, allocation + i * 3, (char)i);
+				allocations.push_back(allocation);
+			}
+			for (int i = 1; i <= 40; ++i)
+			{
+				Assert::IsTrue(arena.owns(allocations[i - 1]));
+				Assert::IsTrue(std::count(allocations[i - 1], allocations[i - 1] + i * 3, (char)i) == i * 3);
+			}
+
+			//An allocation larger than the next chunk gets a chunk of its own.
+			char *large = static_cast<char*>(arena.allocate(5000, 64));
+			Assert::AreEqual((int)((std::uintptr_t)large % 64), 0);
+			Assert::IsTrue(arena.owns(large + 4999));
+			int local = 0;
+			Assert::IsFalse(arena.owns(&local));
+			Assert::AreEqual((int)arena.getAllocatedBytes(), 3 * 40 * 41 / 2 + 5000);
+			Assert::ExpectException<std::bad_alloc>([&] {arena.allocate(8, 3); });
+
+			arena.release();
+			Assert::AreEqual((int)arena.getAllocatedBytes(), 0);
+			Assert::IsFalse(arena.owns(allocations[0]));
+		}
+	};
+
+	TEST_CLASS(modelHandleUnitTests)
+	{
+	public:
+
+		/*Tests that readers keep the model they acquired while others are published, always see
+		 *the model of the version they acquired and that replaced models are destroyed once no
+		 *reader can be using them.*/
+		TEST_METHOD(hotSwap)
+		{
+			batchTensor input(2, 4);
+			std::vector<inferencePlan> compiledPlans;
+			std::vector<std::shared_ptr<const inferencePlan>> plans;
+			std::vector<batchTensor> expectedOutputs(2);
+			for (int i = 0; i < 2; ++i)
+			{
+				neuralNetwork network(2, 1);
+				network.addNeuron(0, true);
+				network.addConnection(2, 0, 0.5f - i);
+				network.addConnection(2, 1, 0.25f + i);
+				compiledPlans.push_back(network.compileForInference());
+				plans.push_back(std::make_shared<const inferencePlan>(compiledPlans[i]));
+			}
+			for (int b = 0; b < 4; ++b)
+			{
+				input.getRow(0)[b] = 0.3f * b;
+				input.getRow(1)[b] = 1.0f - 0.2f * b;
+			}
+			for (int i = 0; i < 2; ++i)
+			{
+				plans[i]->run(input, expectedOutputs[i]);
+			}
+
+			modelHandle<inferencePlan> handle(plans[0]);
+			Assert::AreEqual((int)handle.getVersion(), 1);
+			std::weak_ptr<const inferencePlan> firstPlan(plans[0]);
+			{
+				//A reader that acquired the first model keeps it through a publish.
+				modelHandle<inferencePlan>::reader held(handle);
+				const inferencePlan &heldPlan = held.acquire();
+				Assert::AreEqual((int)handle.publish(plans[1]), 2);
+				plans[0].reset();
+				Assert::AreEqual(handle.reclaim(), 1);
+				Assert::IsFalse(firstPlan.expired());
+				Assert::IsTrue(&heldPlan == firstPlan.lock().get());
+				Assert::AreEqual((int)held.getVersion(), 1);
+				held.release();
+				Assert::AreEqual(handle.reclaim(), 0);
+				Assert::IsTrue(firstPlan.expired());
+				Assert::IsTrue(&held.acquire() == plans[1].get());
+			}
+
+			//Serving threads check every batch against the model of the version they acquired while new copies are published.
+			const int readerCount = 3;
+			std::atomic<bool> publishing(true);
+			std::atomic<int> mismatches(0);
+			std::vector<std::thread> readers;
+			for (int t = 0; t < readerCount; ++t)
+			{
+				readers.emplace_back([&] {
+					modelHandle<inferencePlan>::reader serving(handle);
+					batchTensor output;
+					std::uint64_t lastVersion = 0;
+					while (publishing.load())
+					{
+						const inferencePlan &plan = serving.acquire();
+						plan.run(input, output);
+						std::uint64_t servedVersion = serving.getVersion();
+						const batchTensor &expected = expectedOutputs[(servedVersion + 1) % 2];
+						for (int b = 0; b < 4; ++b)
+						{
+							if (output.getRow(0)[b] != expected.getRow(0)[b])
+							{
+								++mismatches;
+							}
+						}
+						if (servedVersion < lastVersion)
+						{
+							++mismatches;
+						}
+						lastVersion = servedVersion;
+						serving.release();
+					}
+				});
+			}
+			for (int i = 0; i < 200; ++i)
+			{
+				handle.publish(std::make_shared<const inferencePlan>(compiledPlans[i % 2]));
+			}
+			publishing.store(false);
+			for (std::vector<std::thread>::iterator it = readers.begin(); it != readers.end(); ++it)
+			{
+				it->join();
+			}
+			Assert::AreEqual(mismatches.load(), 0);
+			Assert::AreEqual((int)handle.getVersion(), 202);
+			Assert::AreEqual(handle.reclaim(), 0);
+			Assert::IsTrue(plans[1].use_count() == 1);
+			Assert::ExpectException<std::invalid_argument>([&] {handle.publish(std::shared_ptr<const inferencePlan>()); });
+		}
+	};
+
+	TEST_CLASS(neuralNetworkUnitTests)
+	{
+	public:
+
+		//Tests that neurons are given the next cell index and connections are checked against the schedule.
+		TEST_METHOD(addNeuronAndConnection)
+		{
+			neuralNetwork network(2, 1);
+			std::list<float> testWeights;
+			Assert::AreEqual(network.getCellCount(), 2);
+			Assert::AreEqual(network.addNeuron(0, false), 2);
+			Assert::AreEqual(network.addNeuron(1, true), 3);
+			Assert::AreEqual(network.getCellCount(), 4);
+			Assert::AreEqual(network.getStageCount(), 2);
+
+			Assert::IsTrue(network.addConnection(2, 1, 0.5f));
+			Assert::IsTrue(network.addConnection(2, 0, -0.5f));
+			Assert::IsFalse(network.addConnection(2, 0, 0.25f));
+			Assert::IsTrue(network.addConnection(3, 2, 0.75f));
+			network.getWeights(2, testWeights);
+			Assert::AreEqual((int)testWeights.size(), 2);
+			Assert::AreEqual(*testWeights.begin(), -0.5f);
+			Assert::AreEqual(*(++testWeights.begin()), 0.5f);
+
+			//A cell can't connect to itself or a cell in the same or a later stage.
+			Assert::ExpectException<connection_not_scheduled_before>([&] {network.addConnection(2, 3, 0.1f); });
+			Assert::ExpectException<connection_not_scheduled_before>([&] {network.addConnection(3, 3, 0.1f); });
+			Assert::ExpectException<std::out_of_range>([&] {network.addConnection(3, 4, 0.1f); });
+			Assert::ExpectException<std::out_of_range>([&] {network.addConnection(1, 0, 0.1f); });
+		}
+
+		//Tests that packing the stages into blocks keeps every connection and weight.
+		TEST_METHOD(compactStages)
+		{
+			neuralNetwork network(3, 2);
+			std::list<float> testWeights;
+			for (int i = 0; i < 2; ++i)
+			{
+				network.addNeuron(0, false);
+			}
+			network.addConnection(3, 0, 0.1f);
+			network.addConnection(3, 2, 0.3f);
+			network.addConnection(4, 1, 0.2f);
+			network.compactStages();
+
+			network.getWeights(3, testWeights);
+			Assert::AreEqual((int)testWeights.size(), 2);
+			Assert::AreEqual(*testWeights.begin(), 0.1f);
+			Assert::AreEqual(*(++testWeights.begin()), 0.3f);
+			network.getWeights(4, testWeights);
+			Assert::AreEqual((int)testWeights.size(), 1);
+			Assert::AreEqual(*testWeights.begin(), 0.2f);
+
+			//Changing the connections of a packed cell doesn't affect the other rows in the block.
+			Assert::IsTrue(network.addConnection(3, 1, 0.2f));
+			Assert::IsTrue(network.removeConnection(3, 0));
+			network.getWeights(3, testWeights);
+			Assert::AreEqual((int)testWeights.size(), 2);
+			Assert::AreEqual(*testWeights.begin(), 0.2f);
+			Assert::AreEqual(*(++testWeights.begin()), 0.3f);
+			network.getWeights(4, testWeights);
+			Assert::AreEqual((int)testWeights.size(), 1);
+			Assert::AreEqual(*testWeights.begin(), 0.2f);
+		}
+
+		//Tests that a copied network has its own weights.
+		TEST_METHOD(copyNetwork)
+		{
+			neuralNetwork network(1, 1);
+			std::list<float> testWeights(1, 0.4f);
+			network.addNeuron(0, false);
+			network.addConnection(1, 0, 0.2f);
+
+			neuralNetwork copy(network);
+			copy.setWeights(1, testWeights);
+			network.getWeights(1, testWeights);
+			Assert::AreEqual(*testWeights.begin(), 0.2f);
+			copy.getWeights(1, testWeights);
+			Assert::AreEqual(*testWeights.begin(), 0.4f);
+
+			copy = network;
+			copy.getWeights(1, testWeights);
+			Assert::AreEqual(*testWeights.begin(), 0.2f);
+			Assert::AreEqual(copy.getCellCount(), 2);
+
+			//A copy of a trained network with compacted stages carries on training exactly the same.
+			neuralNetwork trained(3, 2);
+			batchTensor input(3, 9), target(2, 9), trainedOutput, copiedOutput;
+			for (int i = 0; i < 4; ++i)
+			{
+				trained.addNeuron(0, true);
+				for (int j = 0; j < 3; ++j)
+				{
+					trained.addConnection(3 + i, j);
+				}
+			}
+			for (int i = 0; i < 2; ++i)
+			{
+				trained.addNeuron(1, true);
+				for (int j = i; j < 4; ++j)
+				{
+					trained.addConnection(7 + i, 3 + j);
+				}
+			}
+			for (int b = 0; b < 9; ++b)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					input.getRow(j)[b] = 0.1f * b - 0.3f * j;
+				}
+				target.getRow(0)[b] = 0.8f;
+				target.getRow(1)[b] = 0.2f;
+			}
+			trained.forwardPropagate(input);
+			trained.backwardPropagate(target);
+			neuralNetwork copied(trained);
+			for (int step = 0; step < 2; ++step)
+			{
+				trained.forwardPropagate(input);
+				copied.forwardPropagate(input);
+				trained.getOutput(trainedOutput);
+				copied.getOutput(copiedOutput);
+				for (int i = 0; i < 2; ++i)
+				{
+					for (int b = 0; b < 9; ++b)
+					{
+						Assert::AreEqual(copiedOutput.getRow(i)[b], trainedOutput.getRow(i)[b]);
+					}
+				}
+				trained.backwardPropagate(target);
+				copied.backwardPropagate(target);
+			}
+			copied.addConnection(8, 3, 0.5f);
+			Assert::AreEqual(copied.getConnectionCount(), trained.getConnectionCount() + 1);
+		}
+
+		/*Tests that copies sharing their weights are each given their own weights once any of
+		 *them writes to them, whichever network writes first and whether the others still exist.*/
+		TEST_METHOD(copyOnWrite)
+		{
+			std::unique_ptr<neuralNetwork> original(new neuralNetwork(2, 1));
+			batchTensor input(2, 6), target(1, 6), output, copyOutput;
+			std::list<float> weights, copyWeights;
+			for (int i = 0; i < 3; ++i)
+			{
+				original->addNeuron(0, true);
+				original->addConnection(2 + i, 0, 0.1f * i - 0.2f);
+				original->addConnection(2 + i, 1, 0.3f - 0.1f * i);
+			}
+			original->addNeuron(1, true);
+			for (int i = 0; i < 3; ++i)
+			{
+				original->addConnection(5, 2 + i, 0.25f * i);
+			}
+			for (int b = 0; b < 6; ++b)
+			{
+				input.getRow(0)[b] = 0.2f * b;
+				input.getRow(1)[b] = 1.0f - 0.1f * b;
+				target.getRow(0)[b] = b % 2 == 0 ? 0.9f : 0.1f;
+			}
+			original->forwardPropagate(input);
+			original->getOutput(output);
+
+			//Training one copy leaves the others with the weights they were copied with.
+			std::vector<std::unique_ptr<neuralNetwork>> copies;
+			for (int i = 0; i < 3; ++i)
+			{
+				copies.push_back(std::unique_ptr<neuralNetwork>(new neuralNetwork(*original)));
+			}
+			copies[0]->forwardPropagate(input);
+			copies[0]->backwardPropagate(target);
+			for (int i = 1; i < 3; ++i)
+			{
+				copies[i]->forwardPropagate(input);
+				copies[i]->getOutput(copyOutput);
+				for (int b = 0; b < 6; ++b)
+				{
+					Assert::AreEqual(copyOutput.getRow(0)[b], output.getRow(0)[b]);
+				}
+			}
+			original->getWeights(5, weights);
+			copies[0]->getWeights(5, copyWeights);
+			Assert::IsFalse(weights == copyWeights);
+
+			//Changing the original's connections or weights doesn't reach the copies, even after the original is gone.
+			std::list<float> newWeights(2, 0.5f);
+			original->setWeights(2, newWeights);
+			original->removeConnection(5, 3);
+			copies[1]->getWeights(2, copyWeights);
+			Assert::AreEqual(copyWeights.front(), -0.2f);
+			copies[1]->getWeights(5, copyWeights);
+			Assert::AreEqual((int)copyWeights.size(), 3);
+			original.reset();
+			copies[2]->addConnection(5, 3, 0.0f);
+			copies[2]->forwardPropagate(input);
+			copies[1]->forwardPropagate(input);
+			copies[1]->getOutput(copyOutput);
+			for (int b = 0; b < 6; ++b)
+			{
+				Assert::AreEqual(copyOutput.getRow(0)[b], output.getRow(0)[b]);
+			}
+		}
+
+		/*Tests that copies of a network that has been destroyed can be trained on their own threads
+		 *at the same time, with whichever copy writes first leaving the shared blocks to the other,
+		 *and end up the same as a copy trained by itself.*/
+		TEST_METHOD(copyOnWriteThreads)
+		{
+			std::unique_ptr<neuralNetwork> original(new neuralNetwork(3, 2));
+			batchTensor input(3, 8), target(2, 8), output, expectedOutput;
+			for (int i = 0; i < 5; ++i)
+			{
+				original->addNeuron(0, true);
+				for (int j = 0; j < 3; ++j)
+				{
+					original->addConnection(3 + i, j, 0.1f * (i - j));
+				}
+			}
+			for (int i = 0; i < 2; ++i)
+			{
+				original->addNeuron(1, true);
+				for (int j = 0; j < 5; ++j)
+				{
+					original->addConnection(8 + i, 3 + j, 0.2f * (j - i) - 0.3f);
+				}
+			}
+			for (int b = 0; b < 8; ++b)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					input.getRow(j)[b] = 0.15f * b - 0.25f * j;
+				}
+				target.getRow(0)[b] = b % 2 == 0 ? 0.8f : 0.2f;
+				target.getRow(1)[b] = 0.5f;
+			}
+			neuralNetwork expected(*original);
+			std::vector<std::unique_ptr<neuralNetwork>> copies;
+			for (int i = 0; i < 2; ++i)
+			{
+				copies.push_back(std::unique_ptr<neuralNetwork>(new neuralNetwork(*original)));
+			}
+			original.reset();
+			for (int step = 0; step < 10; ++step)
+			{
+				expected.forwardPropagate(input);
+				expected.backwardPropagate(target);
+			}
+			expected.forwardPropagate(input);
+			expected.getOutput(expectedOutput);
+
+			std::vector<std::thread> trainers;
+			for (int i = 0; i < 2; ++i)
+			{
+				neuralNetwork &copy = *copies[i];
+				trainers.emplace_back([&] {
+					for (int step = 0; step < 10; ++step)
+					{
+						copy.forwardPropagate(input);
+						copy.backwardPropagate(target);
+					}
+				});
+			}
+			for (std::vector<std::thread>::iterator it = trainers.begin(); it != trainers.end(); ++it)
+			{
+				it->join();
+			}
+			for (int i = 0; i < 2; ++i)
+			{
+				copies[i]->forwardPropagate(input);
+				copies[i]->getOutput(output);
+				for (int j = 0; j < 2; ++j)
+				{
+					for (int b = 0; b < 8; ++b)
+					{
+						Assert::AreEqual(output.getRow(j)[b], expectedOutput.getRow(j)[b]);
+					}
+				}
+			}
+		}
+
+		/*Tests that moving a network hands over its cells and state without throwing, so containers
+		 *move networks instead of copying them, and leaves the moved network empty but usable.*/
+		TEST_METHOD(moveNetwork)
+		{
+			static_assert(std::is_nothrow_move_constructible<neuralNetwork>::value, "Moving a network can't throw.");
+			static_assert(std::is_nothrow_move_assignable<neuralNetwork>::value, "Moving a network can't throw.");
+			neuralNetwork network(2, 1);
+			batchTensor input(2, 3), target(1, 3), output, movedOutput;
+			std::list<float> testWeights;
+			network.setThreadCount(2);
+			network.setExecutionMode(dataflowExecution);
+			for (int i = 0; i < 3; ++i)
+			{
+				network.addNeuron(0, true);
+				network.addConnection(2 + i, 0, 0.2f * i - 0.1f);
+				network.addConnection(2 + i, 1, 0.3f - 0.1f * i);
+			}
+			network.addNeuron(1, true);
+			for (int i = 0; i < 3; ++i)
+			{
+				network.addConnection(5, 2 + i, 0.1f + 0.2f * i);
+			}
+			for (int b = 0; b < 3; ++b)
+			{
+				input.getRow(0)[b] = 0.4f * b;
+				input.getRow(1)[b] = 0.5f - 0.2f * b;
+				target.getRow(0)[b] = 0.7f;
+			}
+			network.forwardPropagate(input);
+			network.backwardPropagate(target);
+			neuralNetwork copy(network);
+			copy.forwardPropagate(input);
+			copy.getOutput(output);
+
+			neuralNetwork moved(std::move(network));
+			Assert::AreEqual(network.getCellCount(), 0);
+			Assert::AreEqual(network.getStageCount(), 0);
+			Assert::AreEqual(moved.getCellCount(), 6);
+			Assert::AreEqual(network.getThreadCount(), DEFAULT_THREAD_COUNT);
+			Assert::AreEqual(moved.getThreadCount(), 2);
+			Assert::IsTrue(moved.getExecutionMode() == dataflowExecution);
+			moved.forwardPropagate(input);
+			moved.getOutput(movedOutput);
+			for (int b = 0; b < 3; ++b)
+			{
+				Assert::AreEqual(movedOutput.getRow(0)[b], output.getRow(0)[b]);
+			}
+
+			//Assigning destroys the old schedule and the moved network can be reused.
+			network = std::move(moved);
+			Assert::AreEqual(moved.getCellCount(), 0);
+			network.backwardPropagate(target);
+			copy.backwardPropagate(target);
+			network.getWeights(5, testWeights);
+			std::list<float> copyWeights;
+			copy.getWeights(5, copyWeights);
+			Assert::IsTrue(testWeights == copyWeights);
+			moved = neuralNetwork(1, 1);
+			Assert::AreEqual(moved.addNeuron(0, false), 1);
+
+			//A network left empty by a move gets what it needs again when it's copied into or given neurons.
+			neuralNetwork reused(std::move(moved));
+			moved = copy;
+			copy.forwardPropagate(input);
+			copy.getOutput(output);
+			moved.forwardPropagate(input);
+			moved.getOutput(movedOutput);
+			Assert::AreEqual(movedOutput.getRow(0)[0], output.getRow(0)[0]);
+			neuralNetwork emptied(std::move(reused));
+			Assert::AreEqual(reused.addNeuron(0, true), 0);
+			reused.setThreadCount(2);
+			Assert::AreEqual(reused.getThreadCount(), 2);
+		}
+
+		//Tests that a network propagates the same values as its neuron does by itself.
+		TEST_METHOD(networkPropagation)
+		{
+			neuralNetwork network(2, 1);
+			batchTensor input(2, 2), target(1, 2), output;
+			std::list<float> testWeights;
+			network.addNeuron(0, true);
+			network.addConnection(2, 0, 0.4f);
+			network.addConnection(2, 1, 0.7f);
+			input.getRow(0)[0] = -0.2f;
+			input.getRow(0)[1] = -0.3f;
+			input.getRow(1)[0] = 0.1f;
+			input.getRow(1)[1] = 0.15f;
+
+			network.forwardPropagate(input);
+			network.getOutput(output);
+			Assert::AreEqual(output.getRowCount(), 1);
+			Assert::AreEqual(output.getBatchSize(), 2);
+			float firstOutput = output.getRow(0)[0];
+			float secondOutput = output.getRow(0)[1];
+
+			//The target is set so the error of the output is 0.1 for both batch elements.
+			target.getRow(0)[0] = firstOutput + 0.1f;
+			target.getRow(0)[1] = secondOutput + 0.1f;
+			network.backwardPropagate(target);
+			network.getWeights(2, testWeights);
+			float firstChange = 0.1f * (-0.2f * firstOutput * (1 - firstOutput) - 0.3f * secondOutput * (1 - secondOutput)) / 2;
+			float secondChange = 0.1f * (0.1f * firstOutput * (1 - firstOutput) + 0.15f * secondOutput * (1 - secondOutput)) / 2;
+			Assert::IsTrue(floatInBounds(*testWeights.begin(), 0.4f + DEFAULT_LEARNING_RATE * firstChange, FLOAT_TEST_RANGE));
+			Assert::IsTrue(floatInBounds(*(++testWeights.begin()), 0.7f + DEFAULT_LEARNING_RATE * secondChange, FLOAT_TEST_RANGE));
+
+			//The target has to have a row for each output node.
+			Assert::ExpectException<lists_not_same_length>([&] {network.backwardPropagate(input); });
+			Assert::ExpectException<lists_not_same_length>([&] {network.forwardPropagate(target); });
+		}
+
+		/*Tests that fully connected stages run as matrix multiplications give the same results as
+		 *running each neuron by itself.*/
+		TEST_METHOD(denseStages)
+		{
+			//The second network has an extra input that's only connected to some neurons with a weight
+			//of zero, so its stages aren't dense but calculate the same values.
+			neuralNetwork dense(3, 2), sparse(4, 2);
+			batchTensor denseInput(3, 5), sparseInput(4, 5), target(2, 5), denseOutput, sparseOutput;
+			std::list<float> denseWeights, sparseWeights;
+			for (int i = 0; i < 4; ++i)
+			{
+				dense.addNeuron(0, true);
+				sparse.addNeuron(0, true);
+				dense.setBias(3 + i, 0.1f * i);
+				sparse.setBias(4 + i, 0.1f * i);
+				for (int j = 0; j < 3; ++j)
+				{
+					float weight = 0.1f * (i - j) + 0.05f;
+					dense.addConnection(3 + i, j, weight);
+					sparse.addConnection(4 + i, j, weight);
+				}
+			}
+			sparse.addConnection(4, 3, 0.0f);
+			for (int i = 0; i < 2; ++i)
+			{
+				dense.addNeuron(1, true);
+				sparse.addNeuron(1, true);
+				dense.setBias(7 + i, -0.2f * i);
+				sparse.setBias(8 + i, -0.2f * i);
+				for (int j = 0; j < 4; ++j)
+				{
+					float weight = 0.2f * (j - i) - 0.1f;
+					dense.addConnection(7 + i, 3 + j, weight);
+					sparse.addConnection(8 + i, 4 + j, weight);
+				}
+			}
+			sparse.addConnection(9, 3, 0.0f);
+			for (int b = 0; b < 5; ++b)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					denseInput.getRow(j)[b] = sparseInput.getRow(j)[b] = 0.1f * b - 0.2f * j;
+				}
+				target.getRow(0)[b] = 0.9f;
+				target.getRow(1)[b] = 0.1f;
+			}
+
+			//Runs two training steps so the second uses the weights updated by the matrix multiplications.
+			for (int step = 0; step < 2; ++step)
+			{
+				dense.forwardPropagate(denseInput);
+				sparse.forwardPropagate(sparseInput);
+				dense.getOutput(denseOutput);
+				sparse.getOutput(sparseOutput);
+				for (int i = 0; i < 2; ++i)
+				{
+					for (int b = 0; b < 5; ++b)
+					{
+						Assert::IsTrue(floatInBounds(denseOutput.getRow(i)[b], sparseOutput.getRow(i)[b], FLOAT_TEST_RANGE));
+					}
+				}
+				dense.backwardPropagate(target);
+				sparse.backwardPropagate(target);
+			}
+
+			//Removes the extra connections so the weights line up.
+			sparse.removeConnection(4, 3);
+			sparse.removeConnection(9, 3);
+			for (int i = 0; i < 6; ++i)
+			{
+				dense.getWeights(3 + i, denseWeights);
+				sparse.getWeights(4 + i, sparseWeights);
+				std::list<float>::iterator sparseIt = sparseWeights.begin();
+				for (std::list<float>::iterator denseIt = denseWeights.begin(); denseIt != denseWeights.end(); ++denseIt, ++sparseIt)
+				{
+					Assert::IsTrue(floatInBounds(*denseIt, *sparseIt, FLOAT_TEST_RANGE));
+				}
+			}
+		}
+
+		/*Tests that splitting the stages across threads gives the same training results as
+		 *running them on one thread for both dense and sparse stages.*/
+		TEST_METHOD(threadedPropagation)
+		{
+			neuralNetwork single(30, 3);
+			batchTensor input(30, 70), target(3, 70), singleOutput, threadedOutput;
+			std::list<float> singleWeights, threadedWeights;
+			for (int i = 0; i < 40; ++i)
+			{
+				single.addNeuron(0, true);
+				for (int j = 0; j < 30; ++j)
+				{
+					single.addConnection(30 + i, j);
+				}
+			}
+			for (int i = 0; i < 20; ++i)
+			{
+				single.addNeuron(1, true);
+				for (int j = i % 3; j < 40; j += 1 + i % 4)
+				{
+					single.addConnection(70 + i, 30 + j);
+				}
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				single.addNeuron(2, true);
+				for (int j = 0; j < 20; ++j)
+				{
+					single.addConnection(90 + i, 70 + j);
+				}
+			}
+			for (int b = 0; b < 70; ++b)
+			{
+				for (int j = 0; j < 30; ++j)
+				{
+					input.getRow(j)[b] = (float)((b * 3 + j * 7) % 17) / 17.0f - 0.5f;
+				}
+				for (int j = 0; j < 3; ++j)
+				{
+					target.getRow(j)[b] = (b + j) % 2 == 0 ? 0.8f : 0.2f;
+				}
+			}
+
+			neuralNetwork threaded(single);
+			threaded.setThreadCount(4);
+			Assert::AreEqual(threaded.getThreadCount(), 4);
+			Assert::ExpectException<std::out_of_range>([&] {threaded.setThreadCount(0); });
+			for (int step = 0; step < 3; ++step)
+			{
+				single.forwardPropagate(input);
+				threaded.forwardPropagate(input);
+				single.getOutput(singleOutput);
+				threaded.getOutput(threadedOutput);
+				for (int i = 0; i < 3; ++i)
+				{
+					for (int b = 0; b < 70; ++b)
+					{
+						Assert::IsTrue(floatInBounds(singleOutput.getRow(i)[b], threadedOutput.getRow(i)[b], FLOAT_TEST_RANGE));
+					}
+				}
+				single.backwardPropagate(target);
+				threaded.backwardPropagate(target);
+			}
+			for (int cellIndex = 30; cellIndex < single.getCellCount(); ++cellIndex)
+			{
+				single.getWeights(cellIndex, singleWeights);
+				threaded.getWeights(cellIndex, threadedWeights);
+				std::list<float>::iterator threadedIt = threadedWeights.begin();
+				for (std::list<float>::iterator singleIt = singleWeights.begin(); singleIt != singleWeights.end(); ++singleIt, ++threadedIt)
+				{
+					Assert::IsTrue(floatInBounds(*singleIt, *threadedIt, FLOAT_TEST_RANGE));
+				}
+			}
+		}
+
+		/*Tests that running the cells in dataflow order gives the same training results as
+		 *running the stages in order on a network with skip connections.*/
+		TEST_METHOD(dataflowPropagation)
+		{
+			neuralNetwork staged(4, 2);
+			batchTensor input(4, 9), target(2, 9), stagedOutput, dataflowOutput;
+			std::list<float> stagedWeights, dataflowWeights;
+			for (int stage = 0; stage < 4; ++stage)
+			{
+				for (int i = 0; i < 3; ++i)
+				{
+					int cellIndex = staged.addNeuron(stage, stage > 0 || i != 1);
+					//Each neuron connects to some inputs and cells from every earlier stage.
+					for (int connection = (cellIndex + i) % 3; connection < cellIndex - i; connection += 2 + i)
+					{
+						staged.addConnection(cellIndex, connection);
+					}
+				}
+			}
+			for (int i = 0; i < 2; ++i)
+			{
+				int cellIndex = staged.addNeuron(4, true);
+				for (int connection = 4 + i; connection < 16; connection += 3)
+				{
+					staged.addConnection(cellIndex, connection);
+				}
+			}
+			for (int b = 0; b < 9; ++b)
+			{
+				for (int j = 0; j < 4; ++j)
+				{
+					input.getRow(j)[b] = (float)((b * 5 + j * 3) % 7) / 7.0f - 0.4f;
+				}
+				target.getRow(0)[b] = b % 2 == 0 ? 0.9f : 0.1f;
+				target.getRow(1)[b] = b % 3 == 0 ? 0.7f : 0.3f;
+			}
+
+			for (int threadCount = 1; threadCount <= 3; threadCount += 2)
+			{
+				neuralNetwork stagedCopy(staged), dataflow(staged);
+				dataflow.setExecutionMode(dataflowExecution);
+				dataflow.setThreadCount(threadCount);
+				Assert::IsTrue(dataflow.getExecutionMode() == dataflowExecution);
+				for (int step = 0; step < 3; ++step)
+				{
+					stagedCopy.forwardPropagate(input);
+					dataflow.forwardPropagate(input);
+					stagedCopy.getOutput(stagedOutput);
+					dataflow.getOutput(dataflowOutput);
+					for (int i = 0; i < 2; ++i)
+					{
+						for (int b = 0; b < 9; ++b)
+						{
+							Assert::IsTrue(floatInBounds(stagedOutput.getRow(i)[b], dataflowOutput.getRow(i)[b], FLOAT_TEST_RANGE));
+						}
+					}
+					stagedCopy.backwardPropagate(target);
+					dataflow.backwardPropagate(target);
+				}
+				for (int cellIndex = 4; cellIndex < staged.getCellCount(); ++cellIndex)
+				{
+					Assert::IsTrue(floatInBounds(stagedCopy.getBias(cellIndex), dataflow.getBias(cellIndex), FLOAT_TEST_RANGE));
+					stagedCopy.getWeights(cellIndex, stagedWeights);
+					dataflow.getWeights(cellIndex, dataflowWeights);
+					Assert::AreEqual((int)stagedWeights.size(), (int)dataflowWeights.size());
+					std::list<float>::iterator dataflowIt = dataflowWeights.begin();
+					for (std::list<float>::iterator stagedIt = stagedWeights.begin(); stagedIt != stagedWeights.end(); ++stagedIt, ++dataflowIt)
+					{
+						Assert::IsTrue(floatInBounds(*stagedIt, *dataflowIt, FLOAT_TEST_RANGE));
+					}
+				}
+			}
+		}
+
+		/*Tests that dense stages, which apply predefined activations to each group of columns,
+		 *match sparse stages for every activation and that softmax outputs sum to one.*/
+		TEST_METHOD(activationFunctions)
+		{
+			activationFunctionType hiddenTypes[2][4] = { { tanhFunction, leakyReLUFunction, reLUFunction, softplusFunction },
+				{ gELUFunction, tanhFunction, sigmoidFunction, leakyReLUFunction } };
+			for (int config = 0; config < 2; ++config)
+			{
+				//The sparse network has an extra input connected with a weight of zero like in the denseStages test.
+				neuralNetwork dense(3, 2), sparse(4, 2);
+				batchTensor denseInput(3, 6), sparseInput(4, 6), target(2, 6), denseOutput, sparseOutput;
+				std::list<float> denseWeights, sparseWeights;
+				for (int i = 0; i < 4; ++i)
+				{
+					dense.addNeuron(0, true);
+					sparse.addNeuron(0, true);
+					dense.setActivationFunction(3 + i, hiddenTypes[config][i]);
+					sparse.setActivationFunction(4 + i, hiddenTypes[config][i]);
+					dense.setBias(3 + i, 0.1f * i);
+					sparse.setBias(4 + i, 0.1f * i);
+					for (int j = 0; j < 3; ++j)
+					{
+						float weight = 0.3f * (i - j) + 0.1f;
+						dense.addConnection(3 + i, j, weight);
+						sparse.addConnection(4 + i, j, weight);
+					}
+				}
+				sparse.addConnection(4, 3, 0.0f);
+				for (int i = 0; i < 2; ++i)
+				{
+					dense.addNeuron(1, true);
+					sparse.addNeuron(1, true);
+					dense.setActivationFunction(7 + i, softmaxFunction);
+					sparse.setActivationFunction(8 + i, softmaxFunction);
+					dense.setBias(7 + i, 0.1f * i);
+					sparse.setBias(8 + i, 0.1f * i);
+					for (int j = 0; j < 4; ++j)
+					{
+						float weight = 0.2f * (j - i) - 0.1f;
+						dense.addConnection(7 + i, 3 + j, weight);
+						sparse.addConnection(8 + i, 4 + j, weight);
+					}
+				}
+				Assert::IsTrue(dense.getActivationFunction(3) == hiddenTypes[config][0]);
+				Assert::IsTrue(dense.getActivationFunction(7) == softmaxFunction);
+				Assert::ExpectException<std::out_of_range>([&] {dense.setActivationFunction(3, softmaxFunction); });
+				for (int b = 0; b < 6; ++b)
+				{
+					for (int j = 0; j < 3; ++j)
+					{
+						denseInput.getRow(j)[b] = sparseInput.getRow(j)[b] = 0.4f * b - 0.5f * j - 0.3f;
+					}
+					target.getRow(0)[b] = b % 2 == 0 ? 1.0f : 0.0f;
+					target.getRow(1)[b] = 1.0f - target.getRow(0)[b];
+				}
+
+				for (int step = 0; step < 2; ++step)
+				{
+					dense.forwardPropagate(denseInput);
+					sparse.forwardPropagate(sparseInput);
+					dense.getOutput(denseOutput);
+					sparse.getOutput(sparseOutput);
+					for (int b = 0; b < 6; ++b)
+					{
+						Assert::IsTrue(floatInBounds(denseOutput.getRow(0)[b] + denseOutput.getRow(1)[b], 1.0f, FLOAT_TEST_RANGE));
+						for (int i = 0; i < 2; ++i)
+						{
+							Assert::IsTrue(floatInBounds(denseOutput.getRow(i)[b], sparseOutput.getRow(i)[b], FLOAT_TEST_RANGE));
+						}
+					}
+					dense.backwardPropagate(target);
+					sparse.backwardPropagate(target);
+				}
+
+				sparse.removeConnection(4, 3);
+				for (int i = 0; i < 6; ++i)
+				{
+					dense.getWeights(3 + i, denseWeights);
+					sparse.getWeights(4 + i, sparseWeights);
+					std::list<float>::iterator sparseIt = sparseWeights.begin();
+					for (std::list<float>::iterator denseIt = denseWeights.begin(); denseIt != denseWeights.end(); ++denseIt, ++sparseIt)
+					{
+						Assert::IsTrue(floatInBounds(*denseIt, *sparseIt, FLOAT_TEST_RANGE));
+					}
+				}
+			}
+		}
+
+		/*Tests that the dropout masks are the same for any thread count or execution mode, that
+		 *dropped outputs are zero and that a neuron with every element dropped isn't trained.*/
+		TEST_METHOD(dropout)
+		{
+			neuralNetwork staged(3, 4);
+			batchTensor input(3, 37), target(4, 37), stagedOutput, otherOutput;
+			std::vector<float> mask(37);
+			std::list<float> stagedWeights, otherWeights, droppedWeights;
+			for (int i = 0; i < 8; ++i)
+			{
+				staged.addNeuron(0, true);
+				staged.setDropRatePercent(3 + i, 0.25f);
+				for (int j = 0; j < 3; ++j)
+				{
+					staged.addConnection(3 + i, j);
+				}
+			}
+			for (int i = 0; i < 4; ++i)
+			{
+				staged.addNeuron(1, true);
+				for (int j = i % 2; j < 8; j += 1 + i % 2)
+				{
+					staged.addConnection(11 + i, 3 + j);
+				}
+			}
+			staged.setDropRatePercent(13, 0.5f);
+			staged.setDropRatePercent(14, 1.0f);
+			staged.setDropoutSeed(99);
+			Assert::AreEqual(staged.getDropRatePercent(13), 0.5f);
+			Assert::IsTrue(staged.getDropoutSeed() == 99);
+			Assert::ExpectException<std::out_of_range>([&] {staged.setDropRatePercent(13, 1.5f); });
+			for (int b = 0; b < 37; ++b)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					input.getRow(j)[b] = (float)((b * 5 + j * 3) % 11) / 11.0f - 0.5f;
+				}
+				for (int j = 0; j < 4; ++j)
+				{
+					target.getRow(j)[b] = (b + j) % 3 == 0 ? 0.9f : 0.1f;
+				}
+			}
+
+			neuralNetwork threaded(staged), dataflow(staged);
+			threaded.setThreadCount(4);
+			dataflow.setThreadCount(3);
+			dataflow.setExecutionMode(dataflowExecution);
+			staged.getWeights(14, droppedWeights);
+			for (int step = 0; step < 3; ++step)
+			{
+				staged.forwardPropagate(input);
+				staged.getOutput(stagedOutput);
+				buildDropoutMask(99, step, 13, 0.5f, 37, mask.data());
+				for (int b = 0; b < 37; ++b)
+				{
+					Assert::IsTrue(mask[b] != 0.0f || stagedOutput.getRow(2)[b] == 0.0f);
+					Assert::AreEqual(stagedOutput.getRow(3)[b], 0.0f);
+				}
+				neuralNetwork *others[2] = { &threaded, &dataflow };
+				for (int other = 0; other < 2; ++other)
+				{
+					others[other]->forwardPropagate(input);
+					others[other]->getOutput(otherOutput);
+					for (int i = 0; i < 4; ++i)
+					{
+						for (int b = 0; b < 37; ++b)
+						{
+							Assert::IsTrue(floatInBounds(stagedOutput.getRow(i)[b], otherOutput.getRow(i)[b], FLOAT_TEST_RANGE));
+						}
+					}
+					others[other]->backwardPropagate(target);
+				}
+				staged.backwardPropagate(target);
+			}
+
+			staged.getWeights(14, stagedWeights);
+			Assert::IsTrue(stagedWeights == droppedWeights);
+			for (int cellIndex = 3; cellIndex < staged.getCellCount(); ++cellIndex)
+			{
+				staged.getWeights(cellIndex, stagedWeights);
+				dataflow.getWeights(cellIndex, otherWeights);
+				std::list<float>::iterator otherIt = otherWeights.begin();
+				for (std::list<float>::iterator stagedIt = stagedWeights.begin(); stagedIt != stagedWeights.end(); ++stagedIt, ++otherIt)
+				{
+					Assert::IsTrue(floatInBounds(*stagedIt, *otherIt, FLOAT_TEST_RANGE));
+				}
+			}
+		}
+
+		/*Tests that a compiled plan gives the same outputs as the network it was compiled from,
+		 *from several threads at once, and isn't changed by training the network afterwards.*/
+		TEST_METHOD(compileForInference)
+		{
+			neuralNetwork network(5, 3);
+			batchTensor input(5, 21), target(3, 21), networkOutput, planOutput;
+			for (int i = 0; i < 6; ++i)
+			{
+				network.addNeuron(0, true);
+				network.setActivationFunction(5 + i, i % 2 == 0 ? reLUFunction : tanhFunction);
+				for (int j = 0; j < 5; ++j)
+				{
+					network.addConnection(5 + i, j);
+				}
+			}
+			for (int i = 0; i < 4; ++i)
+			{
+				network.addNeuron(1, true);
+				for (int j = i % 3; j < 6; j += 2)
+				{
+					network.addConnection(11 + i, 5 + j);
+				}
+				network.addConnection(11 + i, i);
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				network.addNeuron(2, true);
+				network.setActivationFunction(15 + i, softmaxFunction);
+				for (int j = 0; j < 4; ++j)
+				{
+					network.addConnection(15 + i, 11 + j);
+				}
+			}
+			for (int b = 0; b < 21; ++b)
+			{
+				for (int j = 0; j < 5; ++j)
+				{
+					input.getRow(j)[b] = (float)((b * 7 + j * 2) % 13) / 13.0f - 0.5f;
+				}
+				for (int j = 0; j < 3; ++j)
+				{
+					target.getRow(j)[b] = b % 3 == j ? 1.0f : 0.0f;
+				}
+			}
+			network.forwardPropagate(input);
+			network.backwardPropagate(target);
+
+			inferencePlan plan = network.compileForInference();
+			Assert::AreEqual(plan.getInputNodes(), 5);
+			Assert::AreEqual(plan.getOutputNodes(), 3);
+			Assert::AreEqual(plan.getCellCount(), 18);
+			Assert::AreEqual(plan.getStageCount(), 3);
+			network.forwardPropagate(input);
+			network.getOutput(networkOutput);
+
+			//Dropout isn't part of the plan, so it's turned on afterwards to check the plan still matches.
+			network.setDropRatePercent(5, 0.5f);
+			std::atomic<int> mismatches(0);
+			std::vector<std::thread> threads;
+			for (int threadIndex = 0; threadIndex < 4; ++threadIndex)
+			{
+				threads.push_back(std::thread([&]
+				{
+					batchTensor threadOutput;
+					for (int run = 0; run < 20; ++run)
+					{
+						plan.run(input, threadOutput);
+						for (int i = 0; i < 3; ++i)
+						{
+							for (int b = 0; b < 21; ++b)
+							{
+								if (!floatInBounds(threadOutput.getRow(i)[b], networkOutput.getRow(i)[b], FLOAT_TEST_RANGE))
+								{
+									++mismatches;
+								}
+							}
+						}
+					}
+				}));
+			}
+			for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+			{
+				it->join();
+			}
+			Assert::AreEqual(mismatches.load(), 0);
+
+			network.forwardPropagate(input);
+			network.backwardPropagate(target);
+			plan.run(input, planOutput);
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int b = 0; b < 21; ++b)
+				{
+					Assert::IsTrue(floatInBounds(planOutput.getRow(i)[b], networkOutput.getRow(i)[b], FLOAT_TEST_RANGE));
+				}
+			}
+			Assert::ExpectException<lists_not_same_length>([&] {plan.run(target, planOutput); });
+		}
+
+		/*Tests that plans compiled with 16-bit precisions stay close to the float plan, with
+		 *a dense stage, a sparse stage and softmax outputs.*/
+		TEST_METHOD(compileForReducedPrecision)
+		{
+			neuralNetwork network(6, 3);
+			batchTensor input(6, 45), floatOutput, reducedOutput;
+			for (int i = 0; i < 8; ++i)
+			{
+				network.addNeuron(0, true);
+				network.setActivationFunction(6 + i, i % 2 == 0 ? reLUFunction : tanhFunction);
+				for (int j = 0; j < 6; ++j)
+				{
+					network.addConnection(6 + i, j);
+				}
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				network.addNeuron(1, true);
+				network.setActivationFunction(14 + i, softmaxFunction);
+				for (int j = i; j < 8; j += 2)
+				{
+					network.addConnection(14 + i, 6 + j);
+				}
+			}
+			for (int b = 0; b < 45; ++b)
+			{
+				for (int j = 0; j < 6; ++j)
+				{
+					input.getRow(j)[b] = (float)((b * 7 + j * 3) % 17) / 17.0f - 0.5f;
+				}
+			}
+
+			inferencePlan floatPlan = network.compileForInference(), bfloat16Plan = network.compileForInference(bfloat16Precision), halfPlan = network.compileForInference(halfPrecision);
+			Assert::IsTrue(floatPlan.getPrecision() == floatPrecision);
+			Assert::IsTrue(bfloat16Plan.getPrecision() == bfloat16Precision);
+			Assert::IsTrue(halfPlan.getPrecision() == halfPrecision);
+			floatPlan.run(input, floatOutput);
+			bfloat16Plan.run(input, reducedOutput);
+			Assert::AreEqual(reducedOutput.getRowCount(), 3);
+			Assert::AreEqual(reducedOutput.getBatchSize(), 45);
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int b = 0; b < 45; ++b)
+				{
+					Assert::IsTrue(floatInBounds(reducedOutput.getRow(i)[b], floatOutput.getRow(i)[b], 0.02f));
+				}
+			}
+			halfPlan.run(input, reducedOutput);
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int b = 0; b < 45; ++b)
+				{
+					Assert::IsTrue(floatInBounds(reducedOutput.getRow(i)[b], floatOutput.getRow(i)[b], 0.002f));
+				}
+			}
+			Assert::ExpectException<lists_not_same_length>([&] {halfPlan.run(reducedOutput, floatOutput); });
+		}
+
+		/*Tests that a saved network loads back with the same outputs and training state, that a
+		 *plan loaded from the mapped file matches the compiled plan and that broken files throw.*/
+		TEST_METHOD(saveAndLoad)
+		{
+			neuralNetwork network(4, 2), loaded, withoutState;
+			batchTensor input(4, 19), target(2, 19), networkOutput, loadedOutput;
+			std::list<float> networkWeights, loadedWeights;
+			for (int i = 0; i < 5; ++i)
+			{
+				network.addNeuron(0, true);
+				for (int j = 0; j < 4; ++j)
+				{
+					network.addConnection(4 + i, j);
+				}
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				network.addNeuron(1, true);
+				network.setActivationFunction(9 + i, gELUFunction);
+				for (int j = i; j < 5; j += 2)
+				{
+					network.addConnection(9 + i, 4 + j);
+				}
+			}
+			for (int i = 0; i < 2; ++i)
+			{
+				network.addNeuron(2, true);
+				network.setActivationFunction(12 + i, softmaxFunction);
+				for (int j = 0; j < 3; ++j)
+				{
+					network.addConnection(12 + i, 9 + j);
+				}
+				network.addConnection(12 + i, 4 + i);
+			}
+			network.setFastActivation(5, true);
+			network.setDropRatePercent(10, 0.3f);
+			for (int b = 0; b < 19; ++b)
+			{
+				for (int j = 0; j < 4; ++j)
+				{
+					input.getRow(j)[b] = (float)((b * 3 + j * 5) % 7) / 7.0f - 0.5f;
+				}
+				target.getRow(0)[b] = b % 2 == 0 ? 1.0f : 0.0f;
+				target.getRow(1)[b] = 1.0f - target.getRow(0)[b];
+			}
+			network.forwardPropagate(input);
+			network.backwardPropagate(target);
+
+			network.save("modelUnitTest.bin", true);
+			network.save("modelUnitTestWithoutState.bin", false);
+			loaded.load("modelUnitTest.bin");
+			withoutState.load("modelUnitTestWithoutState.bin");
+			Assert::AreEqual(loaded.getCellCount(), 14);
+			Assert::AreEqual(loaded.getStageCount(), 3);
+			Assert::AreEqual(loaded.getOutputNodes(), 2);
+			Assert::IsTrue(loaded.getActivationFunction(9) == gELUFunction);
+			Assert::IsTrue(loaded.getFastActivation(5));
+			Assert::AreEqual(loaded.getDropRatePercent(10), 0.3f);
+			Assert::AreEqual(withoutState.getBias(11), network.getBias(11));
+
+			//The plan from the mapped file is checked before training the network changes its weights.
+			inferencePlan compiled = network.compileForInference(), mapped = loadInferencePlan("modelUnitTest.bin");
+			compiled.run(input, networkOutput);
+			mapped.run(input, loadedOutput);
+			for (int i = 0; i < 2; ++i)
+			{
+				for (int b = 0; b < 19; ++b)
+				{
+					Assert::AreEqual(loadedOutput.getRow(i)[b], networkOutput.getRow(i)[b]);
+				}
+			}
+
+			//With the previous changes and training step loaded, training carries on exactly the same.
+			for (int step = 0; step < 2; ++step)
+			{
+				network.forwardPropagate(input);
+				loaded.forwardPropagate(input);
+				network.getOutput(networkOutput);
+				loaded.getOutput(loadedOutput);
+				for (int i = 0; i < 2; ++i)
+				{
+					for (int b = 0; b < 19; ++b)
+					{
+						Assert::AreEqual(loadedOutput.getRow(i)[b], networkOutput.getRow(i)[b]);
+					}
+				}
+				network.backwardPropagate(target);
+				loaded.backwardPropagate(target);
+			}
+			for (int cellIndex = 4; cellIndex < network.getCellCount(); ++cellIndex)
+			{
+				network.getWeights(cellIndex, networkWeights);
+				loaded.getWeights(cellIndex, loadedWeights);
+				Assert::IsTrue(networkWeights == loadedWeights);
+			}
+
+			std::ifstream file("modelUnitTest.bin", std::ios::binary);
+			std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			file.close();
+			modelFileHeader header;
+			std::copy(contents.begin(), contents.begin() + sizeof(header), reinterpret_cast<char*>(&header));
+			Assert::AreEqual((int)(header.weightsOffset % MODEL_FILE_ALIGNMENT), 0);
+			Assert::AreEqual((int)header.connectionCount, 4 * 5 + 3 + 2 + 2 + 4 * 2);
+			std::ofstream broken("modelUnitTestBroken.bin", std::ios::binary);
+			broken.write(contents.data(), contents.size() - 4);
+			broken.close();
+			Assert::ExpectException<model_file_not_valid>([&] {withoutState.load("modelUnitTestBroken.bin"); });
+			contents[header.columnsOffset] = 12;
+			broken.open("modelUnitTestBroken.bin", std::ios::binary);
+			broken.write(contents.data(), contents.size());
+			broken.close();
+			Assert::ExpectException<model_file_not_valid>([&] {loadInferencePlan("modelUnitTestBroken.bin"); });
+			Assert::ExpectException<std::runtime_error>([&] {withoutState.load("modelUnitTestMissing.bin"); });
+			std::remove("modelUnitTest.bin");
+			std::remove("modelUnitTestWithoutState.bin");
+			std::remove("modelUnitTestBroken.bin");
+		}
+
+		/*Tests that pruning removes the smallest weights of each neuron, that the packed stages it
+		 *leaves give the same values as running each neuron by itself, and that sparser stages
+		 *give the same values as the inference plan.*/
+		TEST_METHOD(pruneConnections)
+		{
+			neuralNetwork network(20, 3);
+			batchTensor input(20, 37), target(3, 37), prunedOutput, expectedOutput;
+			for (int i = 0; i < 16; ++i)
+			{
+				network.addNeuron(0, true);
+				network.setActivationFunction(20 + i, reLUFunction);
+				for (int j = 0; j < 20; ++j)
+				{
+					network.addConnection(20 + i, j);
+				}
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				network.addNeuron(1, true);
+				for (int j = 0; j < 16; ++j)
+				{
+					network.addConnection(36 + i, 20 + j);
+				}
+			}
+			for (int b = 0; b < 37; ++b)
+			{
+				for (int j = 0; j < 20; ++j)
+				{
+					input.getRow(j)[b] = (float)((b * 7 + j * 3) % 13) / 13.0f - 0.5f;
+				}
+				for (int i = 0; i < 3; ++i)
+				{
+					target.getRow(i)[b] = b % 3 == i ? 1.0f : 0.0f;
+				}
+			}
+			Assert::AreEqual(network.getConnectionCount(), 16 * 20 + 3 * 16);
+
+			//The manually pruned network removes every connection below the magnitude of the last pruned weight.
+			neuralNetwork pruned(network), manual(network);
+			Assert::AreEqual(pruned.pruneConnections(0.5f, perNeuronPruning), 16 * 10 + 3 * 8);
+			Assert::AreEqual(pruned.getConnectionCount(), 16 * 10 + 3 * 8);
+			std::list<float> weights, prunedWeights;
+			for (int cellIndex = 20; cellIndex < 39; ++cellIndex)
+			{
+				network.getWeights(cellIndex, weights);
+				std::vector<float> magnitudes;
+				for (std::list<float>::iterator it = weights.begin(); it != weights.end(); ++it)
+				{
+					magnitudes.push_back(std::fabs(*it));
+				}
+				std::sort(magnitudes.begin(), magnitudes.end());
+				float threshold = magnitudes[magnitudes.size() / 2];
+				int column = cellIndex < 36 ? 0 : 20;
+				for (std::list<float>::iterator it = weights.begin(); it != weights.end(); ++it, ++column)
+				{
+					if (std::fabs(*it) < threshold)
+					{
+						manual.removeConnection(cellIndex, column);
+					}
+				}
+
+				pruned.getWeights(cellIndex, prunedWeights);
+				Assert::AreEqual((int)prunedWeights.size(), (int)magnitudes.size() / 2);
+				for (std::list<float>::iterator it = prunedWeights.begin(); it != prunedWeights.end(); ++it)
+				{
+					Assert::IsTrue(std::fabs(*it) >= threshold);
+				}
+			}
+			Assert::AreEqual(manual.getConnectionCount(), pruned.getConnectionCount());
+
+			//Dataflow execution runs every neuron by itself, so it checks the packed stages of the pruned network.
+			manual.setExecutionMode(dataflowExecution);
+			for (int step = 0; step < 2; ++step)
+			{
+				pruned.forwardPropagate(input);
+				manual.forwardPropagate(input);
+				pruned.getOutput(prunedOutput);
+				manual.getOutput(expectedOutput);
+				for (int i = 0; i < 3; ++i)
+				{
+					for (int b = 0; b < 37; ++b)
+					{
+						Assert::IsTrue(floatInBounds(prunedOutput.getRow(i)[b], expectedOutput.getRow(i)[b], FLOAT_TEST_RANGE));
+					}
+				}
+				pruned.backwardPropagate(target);
+				manual.backwardPropagate(target);
+			}
+
+			//The packed weights are reused by forward propagations that don't follow a write and packed again after one.
+			pruned.getWeights(20, prunedWeights);
+			std::list<float> newWeights(prunedWeights.size(), 0.05f);
+			for (int step = 0; step < 3; ++step)
+			{
+				if (step == 2)
+				{
+					pruned.setWeights(20, newWeights);
+					manual.setWeights(20, newWeights);
+				}
+				pruned.forwardPropagate(input);
+				manual.forwardPropagate(input);
+				pruned.getOutput(prunedOutput);
+				manual.getOutput(expectedOutput);
+				for (int i = 0; i < 3; ++i)
+				{
+					for (int b = 0; b < 37; ++b)
+					{
+						Assert::IsTrue(floatInBounds(prunedOutput.getRow(i)[b], expectedOutput.getRow(i)[b], FLOAT_TEST_RANGE));
+					}
+				}
+			}
+
+			//Pruning most of the stage leaves it too sparse to pack, which the inference plan runs through its sparse stages as well.
+			int remaining = pruned.getConnectionCount();
+			Assert::AreEqual(pruned.pruneConnections(0.8f, perStagePruning), (int)std::lround(16 * 10 * 0.8) + (int)std::lround(3 * 8 * 0.8));
+			Assert::AreEqual(pruned.getConnectionCount(), remaining - 128 - 19);
+			inferencePlan plan = pruned.compileForInference();
+			pruned.forwardPropagate(input);
+			pruned.getOutput(prunedOutput);
+			plan.run(input, expectedOutput);
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int b = 0; b < 37; ++b)
+				{
+					Assert::IsTrue(floatInBounds(prunedOutput.getRow(i)[b], expectedOutput.getRow(i)[b], FLOAT_TEST_RANGE));
+				}
+			}
+
+			Assert::AreEqual(pruned.pruneConnections(0.0f, perNeuronPruning), 0);
+			Assert::ExpectException<std::out_of_range>([&] {pruned.pruneConnections(1.5f, perNeuronPruning); });
+			Assert::ExpectException<std::out_of_range>([&] {pruned.pruneConnections(-0.1f, perStagePruning); });
+		}
+	};
+}
@@ -6,7 +6,7 @@ testNeuralNetwork::testCell::testCell(bool propFurther, int newIndex):cell(propF
 {
 }
 
-void testNeuralNetwork::testCell::backwardPropagate(std::list<std::vector<float>> &x, int a, std::list<std::vector<float>> &y, std::mutex &z)
+void testNeuralNetwork::testCell::backwardPropagate(NeuralNetwork::batchTensor &x, int a, NeuralNetwork::batchTensor &y)
 {
 }
 
@@ -15,7 +15,7 @@ void testNeuralNetwork::testCell::copy(cell *&ptr) const
 
 }
 
-void testNeuralNetwork::testCell::forwardPropagate(std::list<std::vector<float>> &x, int a)
+void testNeuralNetwork::testCell::forwardPropagate(NeuralNetwork::batchTensor &x, int a)
 {
 }
 
@@ -12,9 +12,9 @@ public:
 	{
 	public:
 		testCell(bool, int);
-		void backwardPropagate(std::list < std::vector<float>>&, int, std::list<std::vector<float>>&, std::mutex&);
+		void backwardPropagate(NeuralNetwork::batchTensor&, int, NeuralNetwork::batchTensor&);
 		void copy(cell*&) const;
-		void forwardPropagate(std::list < std::vector<float>>&, int);
+		void forwardPropagate(NeuralNetwork::batchTensor&, int);
 	};
 
 	class testNeuron : public neuron